@@ -15,12 +15,194 @@
 // Official SVN repository and contact information can be found at
 // http://code.google.com/p/dolphin-emu/
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <snappy-c.h>
 
+#include "ppsspp_config.h"
+#ifdef _WIN32
+#include "CommonWindows.h"
+#include "util/text/utf8.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "ChunkFile.h"
+#include "CPUDetect.h"
 #include "StringUtils.h"
+#include "ThreadPools.h"
+
+// Bulk streams are page aligned in the file, so they can be mapped efficiently.
+static const u64 BULK_ALIGNMENT = 4096;
+
+// Compression threads, started on the first save and kept for later ones until
+// StopWorkers().  Not the global thread pool: that runs a loop to completion on the calling thread, while these compress
+// while the rest of the state is still being serialized.  A save would also hold the pool
+// for its whole duration, stalling audio mixing and texture scaling.
+struct ChunkedSaveBuffer::Workers {
+	struct Job {
+		Block *block;
+		// Owned by the buffer being saved, only touched under mutex.
+		int *pending;
+	};
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::condition_variable doneCond;
+	std::deque<Job> queue;
+	std::vector<std::thread> threads;
+	bool stopping = false;
+
+	void Start(int numThreads) {
+		for (int i = 0; i < numThreads; ++i)
+			threads.push_back(std::thread(&Workers::Run, this));
+	}
+
+	void Stop() {
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			stopping = true;
+		}
+		cond.notify_all();
+		for (std::thread &thread : threads)
+			thread.join();
+		threads.clear();
+	}
+
+	void Queue(Block *block, int *pending) {
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			queue.push_back(Job{ block, pending });
+			++*pending;
+		}
+		cond.notify_one();
+	}
+
+	void Wait(int *pending) {
+		std::unique_lock<std::mutex> guard(mutex);
+		doneCond.wait(guard, [&] { return *pending == 0; });
+	}
+
+	void Run() {
+		std::vector<u8> scratch;
+		while (true) {
+			Job job;
+			{
+				std::unique_lock<std::mutex> guard(mutex);
+				cond.wait(guard, [&] { return !queue.empty() || stopping; });
+				if (queue.empty())
+					return;
+				job = queue.front();
+				queue.pop_front();
+			}
+
+			Block *block = job.block;
+			scratch.resize(snappy_max_compressed_length(block->rawSize));
+			size_t len = scratch.size();
+			if (snappy_compress((const char *)block->data.data(), block->rawSize, (char *)scratch.data(), &len) == SNAPPY_OK && len < block->rawSize) {
+				// Swap rather than assign, so the raw block's memory is actually released.
+				std::vector<u8>(scratch.begin(), scratch.begin() + len).swap(block->data);
+			}
+
+			{
+				std::lock_guard<std::mutex> guard(mutex);
+				--*job.pending;
+			}
+			doneCond.notify_all();
+		}
+	}
+};
+
+ChunkedSaveBuffer::ChunkedSaveBuffer(size_t blockSize, bool separateBulk) : blockSize_(blockSize), separateBulk_(separateBulk) {
+}
+
+ChunkedSaveBuffer::~ChunkedSaveBuffer() {
+	// Bulk streams are finished along with their parent.
+	if (!parent_)
+		Finish();
+}
+
+void ChunkedSaveBuffer::Write(const void *data, size_t size) {
+	const u8 *src = (const u8 *)data;
+	while (size > 0) {
+		if (!current_) {
+			blocks_.emplace_back(new Block());
+			current_ = blocks_.back().get();
+			current_->data.resize(blockSize_);
+			current_->rawSize = 0;
+		}
+
+		size_t n = std::min(size, blockSize_ - current_->rawSize);
+		memcpy(&current_->data[current_->rawSize], src, n);
+		current_->rawSize += n;
+		totalSize_ += n;
+		src += n;
+		size -= n;
+
+		if (current_->rawSize == blockSize_)
+			QueueCurrent();
+	}
+}
+
+u32 ChunkedSaveBuffer::AddBulk(const void *data, size_t size) {
+	ChunkedSaveBuffer *bulk = new ChunkedSaveBuffer(blockSize_);
+	bulk->parent_ = this;
+	bulk_.emplace_back(bulk);
+	bulk->Write(data, size);
+	return (u32)bulk_.size() - 1;
+}
+
+static std::mutex sharedWorkersLock;
+ChunkedSaveBuffer::Workers *ChunkedSaveBuffer::sharedWorkers_ = nullptr;
+
+ChunkedSaveBuffer::Workers *ChunkedSaveBuffer::StartWorkers() {
+	std::lock_guard<std::mutex> guard(sharedWorkersLock);
+	if (!sharedWorkers_) {
+		sharedWorkers_ = new Workers();
+		// The serializing thread stays busy, so leave it a core.
+		sharedWorkers_->Start(std::max(1, std::min(cpu_info.num_cores - 1, 8)));
+	}
+	return sharedWorkers_;
+}
+
+void ChunkedSaveBuffer::StopWorkers() {
+	std::lock_guard<std::mutex> guard(sharedWorkersLock);
+	if (sharedWorkers_) {
+		sharedWorkers_->Stop();
+		delete sharedWorkers_;
+		sharedWorkers_ = nullptr;
+	}
+}
+
+void ChunkedSaveBuffer::QueueCurrent() {
+	current_->data.resize(current_->rawSize);
+	// Bulk streams are waited for by their parent.
+	ChunkedSaveBuffer *root = parent_ ? parent_ : this;
+	if (!root->workers_)
+		root->workers_ = StartWorkers();
+	root->workers_->Queue(current_, &root->pending_);
+	current_ = nullptr;
+}
+
+void ChunkedSaveBuffer::Finish() {
+	for (auto &bulk : bulk_) {
+		if (bulk->current_)
+			bulk->QueueCurrent();
+	}
+	if (current_)
+		QueueCurrent();
+	if (workers_)
+		workers_->Wait(&pending_);
+}
 
 PointerWrapSection PointerWrap::Section(const char *title, int ver) {
 	return Section(title, ver, ver);
@@ -62,10 +244,19 @@ void PointerWrap::SetError(Error error_) {
 	}
 }
 
+void PointerWrap::WriteBytes(const void *data, int size) {
+	if (stream)
+		stream->Write(data, size);
+	else if (growBuffer)
+		growBuffer->insert(growBuffer->end(), (const u8 *)data, (const u8 *)data + size);
+	else
+		memcpy(*ptr, data, size);
+}
+
 bool PointerWrap::ExpectVoid(void *data, int size) {
 	switch (mode) {
 	case MODE_READ:	if (memcmp(data, *ptr, size) != 0) return false; break;
-	case MODE_WRITE: memcpy(*ptr, data, size); break;
+	case MODE_WRITE: WriteBytes(data, size); break;
 	case MODE_MEASURE: break;  // MODE_MEASURE - don't need to do anything
 	case MODE_VERIFY:
 		for (int i = 0; i < size; i++)
@@ -80,7 +271,7 @@ bool PointerWrap::ExpectVoid(void *data, int size) {
 void PointerWrap::DoVoid(void *data, int size) {
 	switch (mode) {
 	case MODE_READ:	memcpy(data, *ptr, size); break;
-	case MODE_WRITE: memcpy(*ptr, data, size); break;
+	case MODE_WRITE: WriteBytes(data, size); break;
 	case MODE_MEASURE: break;  // MODE_MEASURE - don't need to do anything
 	case MODE_VERIFY:
 		for (int i = 0; i < size; i++)
@@ -91,13 +282,32 @@ void PointerWrap::DoVoid(void *data, int size) {
 	(*ptr) += size;
 }
 
+void PointerWrap::DoBulk(void *data, u32 size) {
+	if (mode == MODE_WRITE && stream && stream->SeparatesBulk()) {
+		u32 index = stream->AddBulk(data, size);
+		Do(index);
+		Do(size);
+	} else if (mode == MODE_READ && bulkReader && bulkReader->IsOpen()) {
+		u32 index = 0;
+		u32 storedSize = 0;
+		Do(index);
+		Do(storedSize);
+		if (storedSize != size || !bulkReader->Read(index, data, size)) {
+			WARN_LOG(SAVESTATE, "Savestate failure: unable to read bulk data %d (%d bytes, expected %d)", index, storedSize, size);
+			SetError(ERROR_FAILURE);
+		}
+	} else {
+		DoVoid(data, size);
+	}
+}
+
 void PointerWrap::Do(std::string &x) {
 	int stringLen = (int)x.length() + 1;
 	Do(stringLen);
 
 	switch (mode) {
 	case MODE_READ:		x = (char*)*ptr; break;
-	case MODE_WRITE:	memcpy(*ptr, x.c_str(), stringLen); break;
+	case MODE_WRITE:	WriteBytes(x.c_str(), stringLen); break;
 	case MODE_MEASURE: break;
 	case MODE_VERIFY: _dbg_assert_msg_(COMMON, !strcmp(x.c_str(), (char*)*ptr), "Savestate verification failure: \"%s\" != \"%s\" (at %p).\n", x.c_str(), (char*)*ptr, ptr); break;
 	}
@@ -110,7 +320,7 @@ void PointerWrap::Do(std::wstring &x) {
 
 	switch (mode) {
 	case MODE_READ:		x = (wchar_t*)*ptr; break;
-	case MODE_WRITE:	memcpy(*ptr, x.c_str(), stringLen); break;
+	case MODE_WRITE:	WriteBytes(x.c_str(), stringLen); break;
 	case MODE_MEASURE: break;
 	case MODE_VERIFY: _dbg_assert_msg_(COMMON, x == (wchar_t*)*ptr, "Savestate verification failure: \"%ls\" != \"%ls\" (at %p).\n", x.c_str(), (wchar_t*)*ptr, ptr); break;
 	}
@@ -206,7 +416,13 @@ CChunkFileReader::Error CChunkFileReader::LoadFileHeader(File::IOFile &pFile, SC
 	}
 
 	u32 sz = (u32)(fileSize - headerSize);
-	if (header.ExpectedSize != sz) {
+	if (header.Revision >= REVISION_BULK) {
+		// The bulk streams come after, ExpectedSize only covers the main state.
+		if (header.ExpectedSize > fileSize - headerSize) {
+			ERROR_LOG(SAVESTATE, "ChunkReader: Bad file size, got %u expected at least %u", sz, header.ExpectedSize);
+			return ERROR_BAD_FILE;
+		}
+	} else if (header.ExpectedSize != sz) {
 		ERROR_LOG(SAVESTATE, "ChunkReader: Bad file size, got %u expected %u", sz, header.ExpectedSize);
 		return ERROR_BAD_FILE;
 	}
@@ -225,7 +441,7 @@ CChunkFileReader::Error CChunkFileReader::GetFileTitle(const std::string &filena
 	return LoadFileHeader(pFile, header, title);
 }
 
-CChunkFileReader::Error CChunkFileReader::LoadFile(const std::string &filename, const char *gitVersion, u8 *&_buffer, size_t &sz, std::string *failureReason) {
+CChunkFileReader::Error CChunkFileReader::LoadFile(const std::string &filename, const char *gitVersion, u8 *&_buffer, size_t &sz, std::string *failureReason, ChunkFileBulkReader *bulk) {
 	if (!File::Exists(filename)) {
 		*failureReason = "LoadStateDoesntExist";
 		ERROR_LOG(SAVESTATE, "ChunkReader: File doesn't exist");
@@ -249,8 +465,36 @@ CChunkFileReader::Error CChunkFileReader::LoadFile(const std::string &filename,
 		return ERROR_BAD_FILE;
 	}
 
+	if (header.Revision >= REVISION_BULK) {
+		// The bulk directory directly follows the state.
+		u32 numBulk = 0;
+		std::vector<std::pair<u64, u64>> segments;
+		bool valid = pFile.ReadArray(&numBulk, 1);
+		if (valid && numBulk != 0) {
+			segments.resize(numBulk);
+			valid = numBulk < 0x10000 && pFile.ReadArray(&segments[0], numBulk);
+		}
+		if (valid && numBulk != 0)
+			valid = bulk && bulk->Open(filename, segments);
+		if (!valid) {
+			ERROR_LOG(SAVESTATE, "ChunkReader: Unable to read bulk data");
+			delete [] buffer;
+			return ERROR_BAD_FILE;
+		}
+	}
+
 	_buffer = buffer;
-	if (header.Compress) {
+	if (header.Compress == COMPRESS_SNAPPY_BLOCKS) {
+		u8 *uncomp_buffer = new u8[header.UncompressedSize];
+		err = UncompressBlocks(buffer, sz, uncomp_buffer, header.UncompressedSize);
+		delete [] buffer;
+		if (err != ERROR_NONE) {
+			delete [] uncomp_buffer;
+			return err;
+		}
+		_buffer = uncomp_buffer;
+		sz = header.UncompressedSize;
+	} else if (header.Compress) {
 		u8 *uncomp_buffer = new u8[header.UncompressedSize];
 		size_t uncomp_size = header.UncompressedSize;
 		snappy_uncompress((const char *)buffer, sz, (char *)uncomp_buffer, &uncomp_size);
@@ -267,38 +511,116 @@ CChunkFileReader::Error CChunkFileReader::LoadFile(const std::string &filename,
 	return ERROR_NONE;
 }
 
-// Takes ownership of buffer.
-CChunkFileReader::Error CChunkFileReader::SaveFile(const std::string &filename, const std::string &title, const char *gitVersion, u8 *buffer, size_t sz) {
+CChunkFileReader::Error CChunkFileReader::UncompressBlocks(const u8 *data, size_t sz, u8 *out, size_t outSize) {
+	u32 blockSize, numBlocks;
+	if (sz < sizeof(blockSize) + sizeof(numBlocks)) {
+		ERROR_LOG(SAVESTATE, "ChunkReader: Missing block table");
+		return ERROR_BAD_FILE;
+	}
+	memcpy(&blockSize, data, sizeof(blockSize));
+	memcpy(&numBlocks, data + sizeof(blockSize), sizeof(numBlocks));
+	size_t tableSize = sizeof(blockSize) + sizeof(numBlocks) + (size_t)numBlocks * sizeof(u32);
+	if (blockSize == 0 || tableSize > sz || (u64)numBlocks * blockSize < outSize || (numBlocks != 0 && (u64)(numBlocks - 1) * blockSize >= outSize)) {
+		ERROR_LOG(SAVESTATE, "ChunkReader: Bad block table (%u blocks of %u bytes)", numBlocks, blockSize);
+		return ERROR_BAD_FILE;
+	}
+
+	// Each block is independent, so they can be placed and uncompressed in parallel.
+	std::vector<size_t> offsets(numBlocks + 1);
+	offsets[0] = tableSize;
+	for (u32 i = 0; i < numBlocks; ++i) {
+		u32 compSize;
+		memcpy(&compSize, data + sizeof(blockSize) + sizeof(numBlocks) + i * sizeof(u32), sizeof(compSize));
+		offsets[i + 1] = offsets[i] + compSize;
+	}
+	if (offsets[numBlocks] != sz) {
+		ERROR_LOG(SAVESTATE, "ChunkReader: Block sizes don't add up, got %u expected %u", (u32)offsets[numBlocks], (u32)sz);
+		return ERROR_BAD_FILE;
+	}
+
+	std::atomic<bool> failed(false);
+	auto uncompress = [&](int lower, int upper) {
+		for (int i = lower; i < upper; ++i) {
+			size_t rawStart = (size_t)i * blockSize;
+			size_t rawSize = std::min((size_t)blockSize, outSize - rawStart);
+			size_t compSize = offsets[i + 1] - offsets[i];
+			if (compSize == rawSize) {
+				// Didn't compress, stored as is.
+				memcpy(out + rawStart, data + offsets[i], rawSize);
+				continue;
+			}
+
+			size_t len = rawSize;
+			if (snappy_uncompress((const char *)data + offsets[i], compSize, (char *)out + rawStart, &len) != SNAPPY_OK || len != rawSize)
+				failed = true;
+		}
+	};
+	if (numBlocks > 1)
+		GlobalThreadPool::Loop(uncompress, 0, numBlocks);
+	else
+		uncompress(0, numBlocks);
+
+	if (failed) {
+		ERROR_LOG(SAVESTATE, "ChunkReader: Corrupt compressed block");
+		return ERROR_BAD_FILE;
+	}
+	return ERROR_NONE;
+}
+
+// The block table goes first, so loading can find every block up front.
+static std::vector<u32> MakeBlockTable(const ChunkedSaveBuffer &buffer, u64 *totalSize) {
+	std::vector<u32> table;
+	table.reserve(buffer.NumBlocks() + 2);
+	table.push_back((u32)buffer.BlockSize());
+	table.push_back((u32)buffer.NumBlocks());
+	u64 size = 0;
+	for (size_t i = 0; i < buffer.NumBlocks(); ++i) {
+		table.push_back((u32)buffer.BlockCompressedSize(i));
+		size += buffer.BlockCompressedSize(i);
+	}
+	*totalSize = size + table.size() * sizeof(u32);
+	return table;
+}
+
+static bool WriteBlocks(File::IOFile &pFile, const ChunkedSaveBuffer &buffer) {
+	u64 totalSize;
+	std::vector<u32> table = MakeBlockTable(buffer, &totalSize);
+	if (!pFile.WriteArray(&table[0], table.size()))
+		return false;
+	for (size_t i = 0; i < buffer.NumBlocks(); ++i) {
+		if (!pFile.WriteBytes(buffer.BlockData(i), buffer.BlockCompressedSize(i)))
+			return false;
+	}
+	return true;
+}
+
+static bool WritePadding(File::IOFile &pFile, u64 pos, u64 target) {
+	static const u8 zeros[BULK_ALIGNMENT] = {};
+	return target == pos || pFile.WriteBytes(zeros, (size_t)(target - pos));
+}
+
+static u64 AlignBulk(u64 pos) {
+	return (pos + BULK_ALIGNMENT - 1) & ~(BULK_ALIGNMENT - 1);
+}
+
+CChunkFileReader::Error CChunkFileReader::SaveFile(const std::string &filename, const std::string &title, const char *gitVersion, const ChunkedSaveBuffer &buffer) {
 	INFO_LOG(SAVESTATE, "ChunkReader: Writing %s", filename.c_str());
 
 	File::IOFile pFile(filename, "wb");
 	if (!pFile) {
 		ERROR_LOG(SAVESTATE, "ChunkReader: Error opening file for write");
-		free(buffer);
 		return ERROR_BAD_FILE;
 	}
 
-	// Make sure we can allocate a buffer to compress before compressing.
-	size_t write_len = snappy_max_compressed_length(sz);
-	u8 *compressed_buffer = (u8 *)malloc(write_len);
-	u8 *write_buffer = buffer;
-	if (!compressed_buffer) {
-		ERROR_LOG(SAVESTATE, "ChunkReader: Unable to allocate compressed buffer");
-		// We'll save uncompressed.  Better than not saving...
-		write_len = sz;
-	} else {
-		snappy_compress((const char *)buffer, sz, (char *)compressed_buffer, &write_len);
-		free(buffer);
-
-		write_buffer = compressed_buffer;
-	}
+	u64 write_len;
+	MakeBlockTable(buffer, &write_len);
 
 	// Create header
 	SChunkHeader header;
-	header.Compress = compressed_buffer ? 1 : 0;
+	header.Compress = COMPRESS_SNAPPY_BLOCKS;
 	header.Revision = REVISION_CURRENT;
 	header.ExpectedSize = (u32)write_len;
-	header.UncompressedSize = (u32)sz;
+	header.UncompressedSize = (u32)buffer.UncompressedSize();
 	truncate_cpy(header.GitVersion, gitVersion);
 
 	// Setup the fixed-length title.
@@ -308,24 +630,139 @@ CChunkFileReader::Error CChunkFileReader::SaveFile(const std::string &filename,
 	// Now let's start writing out the file...
 	if (!pFile.WriteArray(&header, 1)) {
 		ERROR_LOG(SAVESTATE, "ChunkReader: Failed writing header");
-		free(write_buffer);
 		return ERROR_BAD_FILE;
 	}
 	if (!pFile.WriteArray(titleFixed, sizeof(titleFixed))) {
 		ERROR_LOG(SAVESTATE, "ChunkReader: Failed writing title");
-		free(write_buffer);
 		return ERROR_BAD_FILE;
 	}
-
-	if (!pFile.WriteBytes(write_buffer, write_len)) {
+	if (!WriteBlocks(pFile, buffer)) {
 		ERROR_LOG(SAVESTATE, "ChunkReader: Failed writing compressed data");
-		free(write_buffer);
 		return ERROR_BAD_FILE;
-	} else if (sz != write_len) {
-		INFO_LOG(SAVESTATE, "Savestate: Compressed %i bytes into %i", (int)sz, (int)write_len);
 	}
-	free(write_buffer);
+
+	// Then the bulk directory, and the page aligned bulk streams.
+	u32 numBulk = (u32)buffer.NumBulk();
+	u64 pos = sizeof(header) + sizeof(titleFixed) + write_len + sizeof(numBulk) + numBulk * sizeof(u64) * 2;
+	std::vector<std::pair<u64, u64>> segments;
+	u64 end = AlignBulk(pos);
+	for (u32 i = 0; i < numBulk; ++i) {
+		u64 bulkSize;
+		MakeBlockTable(buffer.Bulk(i), &bulkSize);
+		segments.push_back(std::make_pair(end, bulkSize));
+		end = AlignBulk(end + bulkSize);
+	}
+
+	bool success = pFile.WriteArray(&numBulk, 1);
+	if (success && numBulk != 0)
+		success = pFile.WriteArray(&segments[0], numBulk);
+	for (u32 i = 0; success && i < numBulk; ++i) {
+		success = WritePadding(pFile, pos, segments[i].first) && WriteBlocks(pFile, buffer.Bulk(i));
+		pos = segments[i].first + segments[i].second;
+		write_len += segments[i].second;
+	}
+	if (!success) {
+		ERROR_LOG(SAVESTATE, "ChunkReader: Failed writing bulk data");
+		return ERROR_BAD_FILE;
+	}
+
+	INFO_LOG(SAVESTATE, "Savestate: Compressed %i bytes into %i (%i blocks, %i bulk)", (int)buffer.UncompressedSize(), (int)write_len, (int)buffer.NumBlocks(), (int)numBulk);
 
 	INFO_LOG(SAVESTATE, "ChunkReader: Done writing %s", filename.c_str());
 	return ERROR_NONE;
 }
+
+ChunkFileBulkReader::~ChunkFileBulkReader() {
+	Close();
+}
+
+bool ChunkFileBulkReader::Open(const std::string &filename, const std::vector<std::pair<u64, u64>> &segments) {
+	Close();
+
+#if defined(_WIN32) && !PPSSPP_PLATFORM(UWP)
+	HANDLE file = CreateFileW(ConvertUTF8ToWString(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file != INVALID_HANDLE_VALUE) {
+		LARGE_INTEGER fileSize;
+		HANDLE mapping = nullptr;
+		if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart != 0)
+			mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		void *view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+		if (view) {
+			fileHandle_ = file;
+			mappingHandle_ = mapping;
+			base_ = (const u8 *)view;
+			size_ = fileSize.QuadPart;
+			mapped_ = true;
+		} else {
+			if (mapping)
+				CloseHandle(mapping);
+			CloseHandle(file);
+		}
+	}
+#elif !defined(_WIN32)
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd != -1) {
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size != 0) {
+			void *view = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (view != MAP_FAILED) {
+				// Get the reads going, the streams are decompressed in parallel.
+				madvise(view, (size_t)st.st_size, MADV_WILLNEED);
+				base_ = (const u8 *)view;
+				size_ = st.st_size;
+				mapped_ = true;
+			}
+		}
+		// The mapping stays valid.
+		close(fd);
+	}
+#endif
+
+	if (!mapped_) {
+		File::IOFile pFile(filename, "rb");
+		u64 fileSize = pFile.GetSize();
+		fallback_.resize((size_t)fileSize);
+		if (!pFile || fileSize == 0 || !pFile.ReadBytes(&fallback_[0], (size_t)fileSize)) {
+			Close();
+			return false;
+		}
+		base_ = &fallback_[0];
+		size_ = fileSize;
+	}
+
+	for (const auto &segment : segments) {
+		if (segment.first > size_ || segment.second > size_ - segment.first) {
+			ERROR_LOG(SAVESTATE, "ChunkReader: Bulk data past the end of the file");
+			Close();
+			return false;
+		}
+	}
+	segments_ = segments;
+	return true;
+}
+
+bool ChunkFileBulkReader::Read(u32 index, void *dest, size_t size) {
+	if (index >= segments_.size())
+		return false;
+	const auto &segment = segments_[index];
+	return CChunkFileReader::UncompressBlocks(base_ + segment.first, (size_t)segment.second, (u8 *)dest, size) == CChunkFileReader::ERROR_NONE;
+}
+
+void ChunkFileBulkReader::Close() {
+	if (mapped_) {
+#ifdef _WIN32
+		UnmapViewOfFile((LPCVOID)base_);
+		CloseHandle((HANDLE)mappingHandle_);
+		CloseHandle((HANDLE)fileHandle_);
+		mappingHandle_ = nullptr;
+		fileHandle_ = nullptr;
+#else
+		munmap((void *)base_, (size_t)size_);
+#endif
+	}
+	base_ = nullptr;
+	size_ = 0;
+	mapped_ = false;
+	fallback_.clear();
+	segments_.clear();
+}
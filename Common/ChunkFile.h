@@ -34,8 +34,10 @@
 #include <unordered_map>
 #include <deque>
 #include <list>
+#include <memory>
 #include <set>
 #include <type_traits>
+#include <vector>
 
 #include "Common.h"
 #include "Swap.h"
@@ -49,6 +51,104 @@ struct LinkedListItem : public T
 
 class PointerWrap;
 
+// Output for single pass saves.  State is written into fixed size blocks, which grow
+// as needed, and each full block is snappy compressed on a (shared, persistent) worker
+// thread while the rest of the state is still being serialized.  Raw blocks are freed
+// once compressed.
+class ChunkedSaveBuffer
+{
+public:
+	// With separateBulk, PointerWrap::DoBulk() data gets its own compressed stream, which
+	// is stored out of line in the file (see ChunkFileBulkReader.)
+	ChunkedSaveBuffer(size_t blockSize = DEFAULT_BLOCK_SIZE, bool separateBulk = false);
+	~ChunkedSaveBuffer();
+
+	void Write(const void *data, size_t size);
+	// Returns the index of the new bulk stream.
+	u32 AddBulk(const void *data, size_t size);
+	// Compresses the last partial block and waits for all workers.
+	void Finish();
+
+	bool SeparatesBulk() const { return separateBulk_; }
+	size_t NumBulk() const { return bulk_.size(); }
+	const ChunkedSaveBuffer &Bulk(size_t i) const { return *bulk_[i]; }
+
+	size_t UncompressedSize() const { return totalSize_; }
+	size_t BlockSize() const { return blockSize_; }
+	size_t NumBlocks() const { return blocks_.size(); }
+	// Only valid after Finish().  Blocks that didn't compress are stored raw (same size.)
+	const u8 *BlockData(size_t i) const { return blocks_[i]->data.data(); }
+	size_t BlockCompressedSize(size_t i) const { return blocks_[i]->data.size(); }
+	size_t BlockRawSize(size_t i) const { return blocks_[i]->rawSize; }
+
+	// Joins the compression threads.  No buffer may be saving at the time.
+	static void StopWorkers();
+
+	enum {
+		DEFAULT_BLOCK_SIZE = 1024 * 1024,
+	};
+
+private:
+	struct Block {
+		std::vector<u8> data;
+		size_t rawSize;
+	};
+	struct Workers;
+
+	ChunkedSaveBuffer(const ChunkedSaveBuffer &) = delete;
+	void operator =(const ChunkedSaveBuffer &) = delete;
+
+	void QueueCurrent();
+	static Workers *StartWorkers();
+
+	size_t blockSize_;
+	size_t totalSize_ = 0;
+	bool separateBulk_;
+	std::vector<std::unique_ptr<Block>> blocks_;
+	Block *current_ = nullptr;
+	Workers *workers_ = nullptr;
+	// Blocks still being compressed, including those of bulk streams.
+	int pending_ = 0;
+	// Bulk streams share their parent's workers.
+	std::vector<std::unique_ptr<ChunkedSaveBuffer>> bulk_;
+	ChunkedSaveBuffer *parent_ = nullptr;
+
+	static Workers *sharedWorkers_;
+};
+
+// The out of line bulk streams of a loaded state file, which start at page aligned
+// offsets after the rest of the state.  The file is mapped, and each stream is
+// uncompressed straight from the mapping into its destination (e.g. emulated RAM.)
+class ChunkFileBulkReader
+{
+public:
+	ChunkFileBulkReader() {}
+	~ChunkFileBulkReader();
+
+	bool Open(const std::string &filename, const std::vector<std::pair<u64, u64>> &segments);
+	bool Read(u32 index, void *dest, size_t size);
+	// Older revisions (and states without bulk data) have it all inline.
+	bool IsOpen() const { return !segments_.empty(); }
+
+private:
+	ChunkFileBulkReader(const ChunkFileBulkReader &) = delete;
+	void operator =(const ChunkFileBulkReader &) = delete;
+
+	void Close();
+
+	// Offset and length of each stream.
+	std::vector<std::pair<u64, u64>> segments_;
+	const u8 *base_ = nullptr;
+	u64 size_ = 0;
+	bool mapped_ = false;
+	// Used when the file can't be mapped.
+	std::vector<u8> fallback_;
+#ifdef _WIN32
+	void *fileHandle_ = nullptr;
+	void *mappingHandle_ = nullptr;
+#endif
+};
+
 class PointerWrapSection
 {
 public:
@@ -132,6 +232,11 @@ class PointerWrap
 public:
 	PointerWrap(u8 **ptr_, Mode mode_) : ptr(ptr_), mode(mode_), error(ERROR_NONE) {}
 	PointerWrap(unsigned char **ptr_, int mode_) : ptr((u8**)ptr_), mode((Mode)mode_), error(ERROR_NONE) {}
+	// Streaming write: no measure pass needed, data goes to the buffer as it's written.
+	// In this mode, *ptr is only an offset (like in MODE_MEASURE), not a real pointer.
+	PointerWrap(ChunkedSaveBuffer *stream_) : ptr(&streamOffset), mode(MODE_WRITE), error(ERROR_NONE), stream(stream_) {}
+	// Same, but appends raw to a vector, for states kept in memory.
+	PointerWrap(std::vector<u8> *growBuffer_) : ptr(&streamOffset), mode(MODE_WRITE), error(ERROR_NONE), growBuffer(growBuffer_) {}
 
 	PointerWrapSection Section(const char *title, int ver);
 
@@ -144,10 +249,14 @@ class PointerWrap
 	Mode GetMode() const {return mode;}
 	u8 **GetPPtr() {return ptr;}
 	void SetError(Error error_);
+	void SetBulkReader(ChunkFileBulkReader *reader) {bulkReader = reader;}
 
 	// Same as DoVoid, except doesn't advance pointer if it doesn't match on read.
 	bool ExpectVoid(void *data, int size);
 	void DoVoid(void *data, int size);
+	// For large raw memory (RAM, VRAM.)  Same as DoVoid, except that files may store it
+	// out of line, so it can be loaded straight from a mapping of the file.
+	void DoBulk(void *data, u32 size);
 	
 	template<class K, class T>
 	void Do(std::map<K, T *> &x)
@@ -571,6 +680,14 @@ class PointerWrap
 	}
 
 	void DoMarker(const char *prevName, u32 arbitraryNumber = 0x42);
+
+private:
+	void WriteBytes(const void *data, int size);
+
+	u8 *streamOffset = nullptr;
+	ChunkedSaveBuffer *stream = nullptr;
+	std::vector<u8> *growBuffer = nullptr;
+	ChunkFileBulkReader *bulkReader = nullptr;
 };
 
 class CChunkFileReader
@@ -585,9 +702,10 @@ class CChunkFileReader
 
 	// May fail badly if ptr doesn't point to valid data.
 	template<class T>
-	static Error LoadPtr(u8 *ptr, T &_class)
+	static Error LoadPtr(u8 *ptr, T &_class, ChunkFileBulkReader *bulk = nullptr)
 	{
 		PointerWrap p(&ptr, PointerWrap::MODE_READ);
+		p.SetBulkReader(bulk);
 		_class.DoState(p);
 
 		if (p.error != p.ERROR_FAILURE) {
@@ -620,6 +738,22 @@ class CChunkFileReader
 		}
 	}
 
+	// Single pass into buffer, which is cleared first.  It keeps its capacity, so saving
+	// into the same buffer again doesn't have to reallocate or touch new pages.
+	template<class T>
+	static Error SaveVector(std::vector<u8> &buffer, T &_class)
+	{
+		buffer.clear();
+		PointerWrap p(&buffer);
+		_class.DoState(p);
+
+		if (p.error != p.ERROR_FAILURE) {
+			return ERROR_NONE;
+		} else {
+			return ERROR_BROKEN_STATE;
+		}
+	}
+
 	// Load file template
 	template<class T>
 	static Error Load(const std::string &filename, const char *gitVersion, T& _class, std::string *failureReason)
@@ -628,9 +762,10 @@ class CChunkFileReader
 
 		u8 *ptr = nullptr;
 		size_t sz;
-		Error error = LoadFile(filename, gitVersion, ptr, sz, failureReason);
+		ChunkFileBulkReader bulk;
+		Error error = LoadFile(filename, gitVersion, ptr, sz, failureReason, &bulk);
 		if (error == ERROR_NONE) {
-			error = LoadPtr(ptr, _class);
+			error = LoadPtr(ptr, _class, bulk.IsOpen() ? &bulk : nullptr);
 			delete [] ptr;
 		}
 		
@@ -641,20 +776,29 @@ class CChunkFileReader
 		return error;
 	}
 
+	// Single pass, compressing as it goes.
+	template<class T>
+	static Error SaveStream(ChunkedSaveBuffer &buffer, T &_class)
+	{
+		PointerWrap p(&buffer);
+		_class.DoState(p);
+		buffer.Finish();
+
+		if (p.error != p.ERROR_FAILURE) {
+			return ERROR_NONE;
+		} else {
+			return ERROR_BROKEN_STATE;
+		}
+	}
+
 	// Save file template
 	template<class T>
 	static Error Save(const std::string &filename, const std::string &title, const char *gitVersion, T& _class)
 	{
-		// Get data
-		size_t const sz = MeasurePtr(_class);
-		u8 *buffer = (u8 *)malloc(sz);
-		if (!buffer)
-			return ERROR_BAD_ALLOC;
-		Error error = SavePtr(buffer, _class);
-
-		// SaveFile takes ownership of buffer
+		ChunkedSaveBuffer buffer(ChunkedSaveBuffer::DEFAULT_BLOCK_SIZE, true);
+		Error error = SaveStream(buffer, _class);
 		if (error == ERROR_NONE)
-			error = SaveFile(filename, title, gitVersion, buffer, sz);
+			error = SaveFile(filename, title, gitVersion, buffer);
 		return error;
 	}
 	
@@ -683,6 +827,8 @@ class CChunkFileReader
 	}
 
 	static Error GetFileTitle(const std::string &filename, std::string *title);
+	// Uncompresses a block table and its blocks, as written by ChunkedSaveBuffer.
+	static Error UncompressBlocks(const u8 *data, size_t sz, u8 *out, size_t outSize);
 
 private:
 	struct SChunkHeader
@@ -697,10 +843,20 @@ class CChunkFileReader
 	enum {
 		REVISION_MIN = 4,
 		REVISION_TITLE = 5,
-		REVISION_CURRENT = REVISION_TITLE,
+		REVISION_BLOCKS = 6,
+		// Bulk streams follow the rest of the state, see ChunkFileBulkReader.
+		REVISION_BULK = 7,
+		REVISION_CURRENT = REVISION_BULK,
+	};
+
+	enum {
+		COMPRESS_NONE = 0,
+		COMPRESS_SNAPPY = 1,
+		// A block count and size table, followed by independently compressed blocks.
+		COMPRESS_SNAPPY_BLOCKS = 2,
 	};
 
-	static Error LoadFile(const std::string &filename, const char *gitVersion, u8 *&buffer, size_t &sz, std::string *failureReason);
-	static Error SaveFile(const std::string &filename, const std::string &title, const char *gitVersion, u8 *buffer, size_t sz);
+	static Error LoadFile(const std::string &filename, const char *gitVersion, u8 *&buffer, size_t &sz, std::string *failureReason, ChunkFileBulkReader *bulk);
+	static Error SaveFile(const std::string &filename, const std::string &title, const char *gitVersion, const ChunkedSaveBuffer &buffer);
 	static Error LoadFileHeader(File::IOFile &pFile, SChunkHeader &header, std::string *title);
 };
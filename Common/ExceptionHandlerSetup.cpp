@@ -0,0 +1,158 @@
+// Copyright (c) 2017- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include "ppsspp_config.h"
+
+#include "Common/ExceptionHandlerSetup.h"
+
+// Only the x64 jit needs this so far, so the context handling is x64 only.
+#if PPSSPP_ARCH(AMD64) && !PPSSPP_PLATFORM(UWP) && (PPSSPP_PLATFORM(WINDOWS) || PPSSPP_PLATFORM(LINUX) || PPSSPP_PLATFORM(MAC) || defined(__FreeBSD__))
+
+static BadAccessHandler g_badAccessHandler = nullptr;
+
+#if PPSSPP_PLATFORM(WINDOWS)
+
+#include "Common/CommonWindows.h"
+
+static PVOID g_vectoredHandle = nullptr;
+
+static LONG NTAPI VectoredExceptionHandler(PEXCEPTION_POINTERS pointers) {
+	if (pointers->ExceptionRecord->ExceptionCode != EXCEPTION_ACCESS_VIOLATION || pointers->ExceptionRecord->NumberParameters < 2) {
+		return EXCEPTION_CONTINUE_SEARCH;
+	}
+
+	// The first parameter is read/write/execute, the second the address.
+	uintptr_t address = (uintptr_t)pointers->ExceptionRecord->ExceptionInformation[1];
+	uintptr_t pc = (uintptr_t)pointers->ContextRecord->Rip;
+	if (!g_badAccessHandler || !g_badAccessHandler(address, &pc)) {
+		return EXCEPTION_CONTINUE_SEARCH;
+	}
+
+	pointers->ContextRecord->Rip = pc;
+	return EXCEPTION_CONTINUE_EXECUTION;
+}
+
+bool InstallExceptionHandler(BadAccessHandler handler) {
+	g_badAccessHandler = handler;
+	if (!g_vectoredHandle) {
+		g_vectoredHandle = AddVectoredExceptionHandler(TRUE, &VectoredExceptionHandler);
+	}
+	return g_vectoredHandle != nullptr;
+}
+
+void UninstallExceptionHandler() {
+	if (g_vectoredHandle) {
+		RemoveVectoredExceptionHandler(g_vectoredHandle);
+		g_vectoredHandle = nullptr;
+	}
+	g_badAccessHandler = nullptr;
+}
+
+bool IsExceptionHandlerInstalled() {
+	return g_vectoredHandle != nullptr;
+}
+
+#else
+
+#include <csignal>
+#include <cstring>
+#include <ucontext.h>
+
+#if PPSSPP_PLATFORM(MAC)
+#define CTX_PC(ctx) ((ctx)->uc_mcontext->__ss.__rip)
+#elif defined(__FreeBSD__)
+#define CTX_PC(ctx) ((ctx)->uc_mcontext.mc_rip)
+#else
+#define CTX_PC(ctx) ((ctx)->uc_mcontext.gregs[REG_RIP])
+#endif
+
+static bool g_installed = false;
+static struct sigaction g_oldSegvAction;
+static struct sigaction g_oldBusAction;
+
+static void SignalHandler(int sig, siginfo_t *info, void *rawContext) {
+	ucontext_t *context = (ucontext_t *)rawContext;
+	uintptr_t pc = (uintptr_t)CTX_PC(context);
+	if (g_badAccessHandler && g_badAccessHandler((uintptr_t)info->si_addr, &pc)) {
+		CTX_PC(context) = pc;
+		return;
+	}
+
+	// Not ours, pass it on to whoever was installed before us.
+	const struct sigaction &old = sig == SIGSEGV ? g_oldSegvAction : g_oldBusAction;
+	if (old.sa_flags & SA_SIGINFO) {
+		old.sa_sigaction(sig, info, rawContext);
+	} else if (old.sa_handler == SIG_DFL) {
+		// The process is about to die anyway.  Let the fault happen again with the default action.
+		signal(sig, SIG_DFL);
+	} else if (old.sa_handler != SIG_IGN) {
+		old.sa_handler(sig);
+	}
+}
+
+bool InstallExceptionHandler(BadAccessHandler handler) {
+	g_badAccessHandler = handler;
+	if (g_installed) {
+		return true;
+	}
+
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = &SignalHandler;
+	sa.sa_flags = SA_SIGINFO;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGSEGV, &sa, &g_oldSegvAction) != 0) {
+		return false;
+	}
+	// Mac reports some of these as SIGBUS.
+	if (sigaction(SIGBUS, &sa, &g_oldBusAction) != 0) {
+		sigaction(SIGSEGV, &g_oldSegvAction, nullptr);
+		return false;
+	}
+	g_installed = true;
+	return true;
+}
+
+void UninstallExceptionHandler() {
+	if (g_installed) {
+		sigaction(SIGSEGV, &g_oldSegvAction, nullptr);
+		sigaction(SIGBUS, &g_oldBusAction, nullptr);
+		g_installed = false;
+	}
+	g_badAccessHandler = nullptr;
+}
+
+bool IsExceptionHandlerInstalled() {
+	return g_installed;
+}
+
+#endif
+
+#else
+
+bool InstallExceptionHandler(BadAccessHandler handler) {
+	return false;
+}
+
+void UninstallExceptionHandler() {
+}
+
+bool IsExceptionHandlerInstalled() {
+	return false;
+}
+
+#endif
@@ -0,0 +1,30 @@
+// Copyright (c) 2017- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <cstdint>
+
+// Called on a host access violation, with the data address that faulted.
+// Return true to resume execution at *pc (which may be changed), or false to crash as usual.
+// This runs inside the signal handler, so it must not lock or allocate.
+typedef bool (*BadAccessHandler)(uintptr_t address, uintptr_t *pc);
+
+// Returns false if not supported on this platform.
+bool InstallExceptionHandler(BadAccessHandler handler);
+void UninstallExceptionHandler();
+bool IsExceptionHandlerInstalled();
@@ -0,0 +1,152 @@
+// Copyright (c) 2015- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <atomic>
+
+#include "Common/CommonTypes.h"
+
+// A multi-producer, single-consumer FIFO queue that never takes a lock.
+// Push() may be called from any thread, Pop() only from one consumer thread.
+//
+// This is Vyukov's intrusive MPSC queue: producers swap themselves in at the head,
+// the consumer walks from the tail.  Nodes come from a fixed pool (a tagged free list,
+// so there's no ABA problem) and only fall back to the heap if the pool runs dry.
+template <typename T, int POOL_SIZE>
+class LockFreeMPSCQueue {
+public:
+	LockFreeMPSCQueue() : head_(&stub_), tail_(&stub_) {
+		stub_.next.store(nullptr, std::memory_order_relaxed);
+		// Chain up the whole pool as free.
+		for (int i = 0; i < POOL_SIZE; ++i) {
+			pool_[i].poolIndex = i;
+			pool_[i].nextFree.store(i + 1 < POOL_SIZE ? i + 2 : 0, std::memory_order_relaxed);
+		}
+		freeList_.store(POOL_SIZE > 0 ? 1 : 0, std::memory_order_release);
+	}
+
+	~LockFreeMPSCQueue() {
+		T discard;
+		while (Pop(discard)) {
+			continue;
+		}
+	}
+
+	void Push(const T &value) {
+		Node *node = AllocNode();
+		node->value = value;
+		PushNode(node);
+	}
+
+	// Returns false if empty.  May also return false while a Push() is half done,
+	// in which case the item (and anything after it) shows up on a later call.
+	bool Pop(T &value) {
+		Node *tail = tail_;
+		Node *next = tail->next.load(std::memory_order_acquire);
+		if (tail == &stub_) {
+			if (!next)
+				return false;
+			tail_ = next;
+			tail = next;
+			next = next->next.load(std::memory_order_acquire);
+		}
+
+		if (!next) {
+			if (tail != head_.load(std::memory_order_acquire)) {
+				// A producer swapped in the head, but hasn't linked it yet.
+				return false;
+			}
+			// This is the last item, put the stub back behind it so we can take it.
+			PushNode(&stub_);
+			next = tail->next.load(std::memory_order_acquire);
+			if (!next)
+				return false;
+		}
+
+		tail_ = next;
+		value = tail->value;
+		FreeNode(tail);
+		return true;
+	}
+
+	// Only a hint when producers are active.
+	bool Empty() const {
+		return tail_ == &stub_ && stub_.next.load(std::memory_order_acquire) == nullptr;
+	}
+
+	// For statistics/tests: how many nodes had to be allocated because the pool was empty.
+	int OverflowAllocations() const {
+		return overflowAllocs_.load(std::memory_order_relaxed);
+	}
+
+private:
+	struct Node {
+		std::atomic<Node *> next;
+		// Index + 1 of the next free pool node, 0 for none.
+		std::atomic<u32> nextFree;
+		// -1 if not from the pool.
+		int poolIndex;
+		T value;
+	};
+
+	void PushNode(Node *node) {
+		node->next.store(nullptr, std::memory_order_relaxed);
+		Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+		prev->next.store(node, std::memory_order_release);
+	}
+
+	// The free list is (tag << 32) | (index + 1), the tag changes on every update.
+	Node *AllocNode() {
+		u64 old = freeList_.load(std::memory_order_acquire);
+		while ((u32)old != 0) {
+			Node *node = &pool_[(u32)old - 1];
+			u64 next = ((old >> 32) + 1) << 32 | node->nextFree.load(std::memory_order_relaxed);
+			if (freeList_.compare_exchange_weak(old, next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+				return node;
+			}
+		}
+
+		overflowAllocs_.fetch_add(1, std::memory_order_relaxed);
+		Node *node = new Node();
+		node->poolIndex = -1;
+		return node;
+	}
+
+	void FreeNode(Node *node) {
+		if (node->poolIndex < 0) {
+			delete node;
+			return;
+		}
+
+		u64 old = freeList_.load(std::memory_order_acquire);
+		u64 next;
+		do {
+			node->nextFree.store((u32)old, std::memory_order_relaxed);
+			next = ((old >> 32) + 1) << 32 | (u32)(node->poolIndex + 1);
+		} while (!freeList_.compare_exchange_weak(old, next, std::memory_order_acq_rel, std::memory_order_acquire));
+	}
+
+	std::atomic<Node *> head_;
+	// Only touched by the consumer.
+	Node *tail_;
+	Node stub_;
+
+	std::atomic<u64> freeList_;
+	std::atomic<int> overflowAllocs_{ 0 };
+	Node pool_[POOL_SIZE];
+};
@@ -7,6 +7,9 @@ class GlobalThreadPool {
 	// will execute slices of "loop" from "lower" to "upper"
 	// in parallel on the global thread pool
 	static void Loop(const std::function<void(int,int)>& loop, int lower, int upper);
+	// Same, but returns false without running anything if the pool is busy with another loop.
+	// For callers that would rather do the work themselves than wait.
+	static bool TryLoop(const std::function<void(int,int)>& loop, int lower, int upper);
 
 private:
 	static std::shared_ptr<ThreadPool> pool;
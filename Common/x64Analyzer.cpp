@@ -30,6 +30,9 @@ bool DisassembleMov(const unsigned char *codePtr, InstructionInfo &info, int acc
 	info.signExtend = false;
 	info.hasImmediate = false;
 	info.isMemoryWrite = false;
+	info.otherReg = -1;
+	info.scaledReg = -1;
+	info.scale = 1;
 
 	int addressSize = 8;
 	u8 modRMbyte = 0;
@@ -111,13 +114,28 @@ bool DisassembleMov(const unsigned char *codePtr, InstructionInfo &info, int acc
 				sibByte = *codePtr++;
 				info.scaledReg = (sibByte >> 3) & 7;
 				info.otherReg = (sibByte & 7);
+				info.scale = 1 << (sibByte >> 6);
 				if (rex & 2) info.scaledReg += 8;
 				if (rex & 1) info.otherReg += 8;
+				// An index of RSP means there's no index.
+				if (info.scaledReg == 4)
+					info.scaledReg = -1;
+				// No base register, just a 32-bit displacement.
+				if (mrm.mod == 0 && (sibByte & 7) == 5)
+				{
+					info.otherReg = -1;
+					displacementSize = 4;
+				}
 				hasSIBbyte = true;
 			}
+			else if (mrm.mod == 0 && mrm.rm == 5)
+			{
+				// RIP relative.
+				displacementSize = 4;
+			}
 			else
 			{
-				//info.scaledReg = 
+				info.otherReg = mrm.rm | ((rex & 1) ? 8 : 0);
 			}
 		}
 		if (mrm.mod == 1 || mrm.mod == 2)
@@ -145,6 +163,7 @@ bool DisassembleMov(const unsigned char *codePtr, InstructionInfo &info, int acc
 		{
 		case MOVE_8BIT: //move 8-bit immediate
 			{
+				info.operandSize = 1;
 				info.hasImmediate = true;
 				info.immediate = *codePtr;
 				codePtr++; //move past immediate
@@ -173,6 +192,13 @@ bool DisassembleMov(const unsigned char *codePtr, InstructionInfo &info, int acc
 				}
 			}
 			break;
+		case MOVE_8BIT_REG_TO_MEM: //move 8-bit reg to memory
+			// Without REX, 4-7 are AH-BH, not SPL-DIL.
+			if (info.operandSize != 4 || (rex == 0 && info.regOperandReg >= 4))
+				return false;
+			info.operandSize = 1;
+			break;
+
 		case MOVE_REG_TO_MEM: //move reg to memory
 			break;
 
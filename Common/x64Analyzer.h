@@ -24,8 +24,11 @@ struct InstructionInfo
 	int operandSize; //8, 16, 32, 64
 	int instructionSize;
 	int regOperandReg;
+	// Base register of the memory operand, -1 if none.
 	int otherReg;
+	// Index register of the memory operand, -1 if none.
 	int scaledReg;
+	int scale;
 	bool zeroExtend;
 	bool signExtend;
 	bool hasImmediate;
@@ -52,6 +55,7 @@ enum {
 	MOVSX_SHORT     = 0xBF, //movsx on short
 	MOVE_8BIT	    = 0xC6, //move 8-bit immediate
 	MOVE_16_32BIT   = 0xC7, //move 16 or 32-bit immediate
+	MOVE_8BIT_REG_TO_MEM = 0x88, //move 8-bit reg to memory
 	MOVE_REG_TO_MEM = 0x89, //move reg to memory
 };
 
@@ -35,6 +35,8 @@ enum class CPUCore {
 	INTERPRETER = 0,
 	JIT = 1,
 	IR_JIT = 2,
+	// IR compiled to native code, where supported.
+	IR_NATIVE = 3,
 };
 
 enum {
@@ -64,6 +66,12 @@ enum AudioBackendType {
 	AUDIO_BACKEND_WASAPI,
 };
 
+// For iAudioResamplerType.
+enum AudioResamplerType {
+	AUDIO_RESAMPLER_LINEAR = 0,
+	AUDIO_RESAMPLER_SINC = 1,
+};
+
 // For iIOTimingMethod.
 enum IOTimingMethods {
 	IOTIMING_FAST = 0,
@@ -127,6 +135,7 @@ struct Config {
 	bool bFuncReplacements;
 	bool bHideSlowWarnings;
 	bool bPreloadFunctions;
+	bool bPreloadFunctionsAsync;
 
 	bool bSeparateSASThread;
 	bool bSeparateIOThread;
@@ -153,6 +162,8 @@ struct Config {
 	// GFX
 	int iGPUBackend;
 	bool bSoftwareRendering;
+	bool bSoftwareRenderingJit;
+	bool bDisplayListThread;  // Run display lists on a separate thread (software renderer only.)
 	bool bHardwareTransform; // only used in the GLES backend
 
 	int iRenderingMode; // 0 = non-buffered rendering 1 = buffered rendering
@@ -194,11 +205,13 @@ struct Config {
 	int iTexScalingLevel; // 1 = off, 2 = 2x, ..., 5 = 5x
 	int iTexScalingType; // 0 = xBRZ, 1 = Hybrid
 	bool bTexDeposterize;
+	bool bTexAsyncScaling;
 	int iFpsLimit;
 	int iForceMaxEmulatedFPS;
 	int iMaxRecent;
 	int iCurrentStateSlot;
 	int iRewindFlipFrequency;
+	int iRewindBudgetMB;
 	bool bEnableAutoLoad;
 	bool bEnableCheats;
 	bool bReloadCheats;
@@ -263,6 +276,7 @@ struct Config {
 	bool bShowDebugStats;
 	bool bShowAudioDebug;
 	bool bAudioResampler;
+	int iAudioResamplerType;
 
 	//Analog stick tilting
 	//the base x and y tilt. this inclination is treated as (0,0) and the tilt input
@@ -450,6 +464,8 @@ struct Config {
 	// Double edged sword: much easier debugging, but not accurate.
 	bool bSkipDeadbeefFilling;
 	bool bFuncHashMap;
+	// Counts block executions in the jit, for finding hot code.
+	bool bJitBlockProfiling;
 
 	// Volatile development settings
 	bool bShowFrameProfiler;
@@ -16,15 +16,17 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 
+#include <algorithm>
+#include <unordered_map>
 #include <vector>
 #include <cstdio>
-#include <mutex>
 
 #include "base/logging.h"
 #include "profiler/profiler.h"
 
 #include "Common/MsgHandler.h"
 #include "Common/Atomics.h"
+#include "Common/LockFreeQueue.h"
 #include "Core/CoreTiming.h"
 #include "Core/Core.h"
 #include "Core/Config.h"
@@ -66,14 +68,72 @@ struct BaseEvent
 
 typedef LinkedListItem<BaseEvent> Event;
 
-Event *first;
-Event *tsFirst;
-Event *tsLast;
+// Pending events, as a binary min-heap on (time, order).
+// The order makes events with the same time fire in the order they were scheduled.
+// Unscheduled events stay in the heap and are dropped when they reach the top,
+// so the top is always a live event.
+struct HeapEvent
+{
+	s64 time;
+	u64 order;
+	u64 userdata;
+	int type;
+};
+
+// Events are also tracked by (type, userdata), which is how they get unscheduled.
+// Unscheduling cancels every event of that key with a lower order, without touching the heap.
+struct EventKey
+{
+	int type;
+	u64 userdata;
+
+	bool operator ==(const EventKey &other) const {
+		return type == other.type && userdata == other.userdata;
+	}
+};
+
+struct EventKeyHash
+{
+	size_t operator ()(const EventKey &key) const {
+		return std::hash<u64>()(key.userdata ^ ((u64)key.type << 48));
+	}
+};
+
+struct EventKeyState
+{
+	// Events in the heap that are still live, or cancelled but not yet dropped.
+	int live;
+	int cancelled;
+	// Events of this key with a lower order are cancelled.
+	u64 cancelledBefore;
+	// The live event that fires last (they fire in order, so it stays live the longest.)
+	s64 lastTime;
+	u64 lastOrder;
+};
+
+struct HeapEventLater
+{
+	bool operator ()(const HeapEvent &a, const HeapEvent &b) const {
+		if (a.time != b.time)
+			return a.time > b.time;
+		return a.order > b.order;
+	}
+};
+
+static std::vector<HeapEvent> eventHeap;
+// Kept around after they go idle, so timers that keep rescheduling don't allocate.
+static std::unordered_map<EventKey, EventKeyState, EventKeyHash> eventKeys;
+static u64 nextEventOrder;
+// Cancelled events still in the heap.
+static int cancelledEvents;
+// Live events per type, lets IsScheduled and unscheduling skip the lookup most of the time.
+static std::vector<int> pendingByType;
+
+// Events from other threads, moved into the heap by MoveEvents() on the CPU thread.
+static LockFreeMPSCQueue<BaseEvent, 256> tsQueue;
 
-// event pools
+// event pool, only used for save states now.
 Event *eventPool = 0;
-Event *eventTsPool = 0;
-int allocatedTsEvents = 0;
 // Optimization to skip MoveEvents when possible.
 volatile u32 hasTsEvents = 0;
 
@@ -86,8 +146,6 @@ s64 idledCycles;
 s64 lastGlobalTimeTicks;
 s64 lastGlobalTimeUs;
 
-static std::mutex externalEventLock;
-
 std::vector<MHzChangeCallback> mhzChangeCallbacks;
 
 void FireMhzChange() {
@@ -148,17 +206,6 @@ Event* GetNewEvent()
 	return ev;
 }
 
-Event* GetNewTsEvent()
-{
-	allocatedTsEvents++;
-
-	if(!eventTsPool)
-		return new Event;
-
-	Event* ev = eventTsPool;
-	eventTsPool = ev->next;
-	return ev;
-}
 
 void FreeEvent(Event* ev)
 {
@@ -166,12 +213,6 @@ void FreeEvent(Event* ev)
 	eventPool = ev;
 }
 
-void FreeTsEvent(Event* ev)
-{
-	ev->next = eventTsPool;
-	eventTsPool = ev;
-	allocatedTsEvents--;
-}
 
 int RegisterEvent(const char *name, TimedCallback callback)
 {
@@ -196,7 +237,7 @@ void RestoreRegisterEvent(int event_type, const char *name, TimedCallback callba
 
 void UnregisterAllEvents()
 {
-	if (first)
+	if (!eventHeap.empty())
 		PanicAlert("Cannot unregister events with events pending");
 	event_types.clear();
 }
@@ -225,14 +266,6 @@ void Shutdown()
 		eventPool = ev->next;
 		delete ev;
 	}
-
-	std::lock_guard<std::mutex> lk(externalEventLock);
-	while(eventTsPool)
-	{
-		Event *ev = eventTsPool;
-		eventTsPool = ev->next;
-		delete ev;
-	}
 }
 
 u64 GetTicks()
@@ -247,21 +280,16 @@ u64 GetIdleTicks()
 
 
 // This is to be called when outside threads, such as the graphics thread, wants to
-// schedule things to be executed on the main thread.
+// schedule things to be executed on the main thread.  It never blocks.
 void ScheduleEvent_Threadsafe(s64 cyclesIntoFuture, int event_type, u64 userdata)
 {
-	std::lock_guard<std::mutex> lk(externalEventLock);
-	Event *ne = GetNewTsEvent();
-	ne->time = GetTicks() + cyclesIntoFuture;
-	ne->type = event_type;
-	ne->next = 0;
-	ne->userdata = userdata;
-	if(!tsFirst)
-		tsFirst = ne;
-	if(tsLast)
-		tsLast->next = ne;
-	tsLast = ne;
+	BaseEvent ev;
+	ev.time = GetTicks() + cyclesIntoFuture;
+	ev.userdata = userdata;
+	ev.type = event_type;
+	tsQueue.Push(ev);
 
+	// Only after the push, so MoveEvents() can't clear this before seeing the event.
 	Common::AtomicStoreRelease(hasTsEvents, 1);
 }
 
@@ -271,7 +299,6 @@ void ScheduleEvent_Threadsafe_Immediate(int event_type, u64 userdata)
 {
 	if(false) //Core::IsCPUThread())
 	{
-		std::lock_guard<std::mutex> lk(externalEventLock);
 		event_types[event_type].callback(userdata, 0);
 	}
 	else
@@ -280,138 +307,156 @@ void ScheduleEvent_Threadsafe_Immediate(int event_type, u64 userdata)
 
 void ClearPendingEvents()
 {
-	while (first)
+	eventHeap.clear();
+	eventKeys.clear();
+	cancelledEvents = 0;
+	pendingByType.clear();
+}
+
+// Drops idle keys once there are a lot more of them than events.
+static void PurgeEventKeys()
+{
+	if (eventKeys.size() <= 64 || eventKeys.size() <= eventHeap.size() * 2)
+		return;
+	for (auto it = eventKeys.begin(); it != eventKeys.end(); )
 	{
-		Event *e = first->next;
-		FreeEvent(first);
-		first = e;
+		if (it->second.live == 0 && it->second.cancelled == 0)
+			it = eventKeys.erase(it);
+		else
+			++it;
 	}
 }
 
-void AddEventToQueue(Event* ne)
+void AddEventToQueue(s64 time, int event_type, u64 userdata)
 {
-	Event* prev = NULL;
-	Event** pNext = &first;
-	for(;;)
+	HeapEvent ev;
+	ev.time = time;
+	ev.order = nextEventOrder++;
+	ev.userdata = userdata;
+	ev.type = event_type;
+	eventHeap.push_back(ev);
+	std::push_heap(eventHeap.begin(), eventHeap.end(), HeapEventLater());
+
+	PurgeEventKeys();
+	EventKeyState &state = eventKeys[EventKey{ event_type, userdata }];
+	if (state.live == 0 || HeapEventLater()(ev, HeapEvent{ state.lastTime, state.lastOrder }))
 	{
-		Event*& next = *pNext;
-		if(!next || ne->time < next->time)
-		{
-			ne->next = next;
-			next = ne;
-			break;
-		}
-		prev = next;
-		pNext = &prev->next;
+		state.lastTime = time;
+		state.lastOrder = ev.order;
 	}
+	state.live++;
+
+	if (event_type >= (int)pendingByType.size())
+		pendingByType.resize(event_type + 1);
+	pendingByType[event_type]++;
 }
 
-// This must be run ONLY from within the cpu thread
-// cyclesIntoFuture may be VERY inaccurate if called from anything else
-// than Advance
-void ScheduleEvent(s64 cyclesIntoFuture, int event_type, u64 userdata)
+static void PopEvent()
 {
-	Event *ne = GetNewEvent();
-	ne->userdata = userdata;
-	ne->type = event_type;
-	ne->time = GetTicks() + cyclesIntoFuture;
-	AddEventToQueue(ne);
+	std::pop_heap(eventHeap.begin(), eventHeap.end(), HeapEventLater());
+	eventHeap.pop_back();
 }
 
-// Returns cycles left in timer.
-s64 UnscheduleEvent(int event_type, u64 userdata)
+static EventKeyState &GetKeyState(const HeapEvent &ev)
 {
-	s64 result = 0;
-	if (!first)
-		return result;
-	while(first)
-	{
-		if (first->type == event_type && first->userdata == userdata)
-		{
-			result = first->time - GetTicks();
-
-			Event *next = first->next;
-			FreeEvent(first);
-			first = next;
-		}
-		else
-		{
-			break;
-		}
-	}
-	if (!first)
-		return result;
-	Event *prev = first;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type && ptr->userdata == userdata)
-		{
-			result = ptr->time - GetTicks();
+	// Every event in the heap has one.
+	return eventKeys.find(EventKey{ ev.type, ev.userdata })->second;
+}
 
-			prev->next = ptr->next;
-			FreeEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
-	}
+static bool IsLiveEvent(const HeapEvent &ev)
+{
+	return ev.order >= GetKeyState(ev).cancelledBefore;
+}
 
-	return result;
+// Cancels all live events of a key, returns how many.
+static int CancelKeyEvents(EventKeyState &state)
+{
+	int count = state.live;
+	state.cancelled += count;
+	state.live = 0;
+	state.cancelledBefore = nextEventOrder;
+	cancelledEvents += count;
+	return count;
 }
 
-s64 UnscheduleThreadsafeEvent(int event_type, u64 userdata)
+// Restores the invariant that the top of the heap is a live event.
+static void PruneCancelledEvents()
 {
-	s64 result = 0;
-	std::lock_guard<std::mutex> lk(externalEventLock);
-	if (!tsFirst)
-		return result;
-	while(tsFirst)
+	if (cancelledEvents == 0)
+		return;
+
+	// If most of the heap is dead, it's cheaper to rebuild than to keep sifting through it.
+	if (cancelledEvents > 16 && cancelledEvents * 2 > (int)eventHeap.size())
 	{
-		if (tsFirst->type == event_type && tsFirst->userdata == userdata)
-		{
-			result = tsFirst->time - GetTicks();
+		eventHeap.erase(std::remove_if(eventHeap.begin(), eventHeap.end(), [](const HeapEvent &ev) {
+			return !IsLiveEvent(ev);
+		}), eventHeap.end());
+		std::make_heap(eventHeap.begin(), eventHeap.end(), HeapEventLater());
+		for (auto &it : eventKeys)
+			it.second.cancelled = 0;
+		cancelledEvents = 0;
+		return;
+	}
 
-			Event *next = tsFirst->next;
-			FreeTsEvent(tsFirst);
-			tsFirst = next;
-		}
-		else
-		{
+	while (!eventHeap.empty())
+	{
+		EventKeyState &state = GetKeyState(eventHeap.front());
+		if (eventHeap.front().order >= state.cancelledBefore)
 			break;
-		}
+		state.cancelled--;
+		PopEvent();
+		cancelledEvents--;
 	}
-	if (!tsFirst)
+}
+
+// Live events in the order they will fire.
+static std::vector<HeapEvent> GetSortedEvents()
+{
+	std::vector<HeapEvent> sorted;
+	sorted.reserve(eventHeap.size());
+	for (const HeapEvent &ev : eventHeap)
 	{
-		tsLast = NULL;
-		return result;
+		if (cancelledEvents == 0 || IsLiveEvent(ev))
+			sorted.push_back(ev);
 	}
+	std::sort(sorted.begin(), sorted.end(), [](const HeapEvent &a, const HeapEvent &b) {
+		return HeapEventLater()(b, a);
+	});
+	return sorted;
+}
 
-	Event *prev = tsFirst;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type && ptr->userdata == userdata)
-		{
-			result = ptr->time - GetTicks();
+// This must be run ONLY from within the cpu thread
+// cyclesIntoFuture may be VERY inaccurate if called from anything else
+// than Advance
+void ScheduleEvent(s64 cyclesIntoFuture, int event_type, u64 userdata)
+{
+	AddEventToQueue(GetTicks() + cyclesIntoFuture, event_type, userdata);
+}
 
-			prev->next = ptr->next;
-			if (ptr == tsLast)
-				tsLast = prev;
-			FreeTsEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
-	}
+// Returns cycles left in timer.
+s64 UnscheduleEvent(int event_type, u64 userdata)
+{
+	if (!IsScheduled(event_type))
+		return 0;
+
+	auto it = eventKeys.find(EventKey{ event_type, userdata });
+	if (it == eventKeys.end() || it->second.live == 0)
+		return 0;
+
+	// If there are several, report the one that would have fired last.
+	s64 lastTime = it->second.lastTime;
+	pendingByType[event_type] -= CancelKeyEvents(it->second);
+	PruneCancelledEvents();
+
+	return lastTime - GetTicks();
+}
 
-	return result;
+// These are only really threadsafe in that they also catch events from other threads.
+// They must be called from the CPU thread.
+s64 UnscheduleThreadsafeEvent(int event_type, u64 userdata)
+{
+	MoveEvents();
+	return UnscheduleEvent(event_type, userdata);
 }
 
 void RegisterMHzChangeCallback(MHzChangeCallback callback) {
@@ -420,97 +465,35 @@ void RegisterMHzChangeCallback(MHzChangeCallback callback) {
 
 bool IsScheduled(int event_type)
 {
-	if (!first)
+	return event_type >= 0 && event_type < (int)pendingByType.size() && pendingByType[event_type] != 0;
+}
+
+bool IsScheduled(int event_type, u64 userdata)
+{
+	if (!IsScheduled(event_type))
 		return false;
-	Event *e = first;
-	while (e) {
-		if (e->type == event_type)
-			return true;
-		e = e->next;
-	}
-	return false;
+	auto it = eventKeys.find(EventKey{ event_type, userdata });
+	return it != eventKeys.end() && it->second.live != 0;
 }
 
 void RemoveEvent(int event_type)
 {
-	if (!first)
+	if (!IsScheduled(event_type))
 		return;
-	while(first)
+
+	for (auto &it : eventKeys)
 	{
-		if (first->type == event_type)
-		{
-			Event *next = first->next;
-			FreeEvent(first);
-			first = next;
-		}
-		else
-		{
-			break;
-		}
-	}
-	if (!first)
-		return;
-	Event *prev = first;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type)
-		{
-			prev->next = ptr->next;
-			FreeEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
+		if (it.first.type == event_type)
+			CancelKeyEvents(it.second);
 	}
+	pendingByType[event_type] = 0;
+	PruneCancelledEvents();
 }
 
 void RemoveThreadsafeEvent(int event_type)
 {
-	std::lock_guard<std::mutex> lk(externalEventLock);
-	if (!tsFirst)
-	{
-		return;
-	}
-	while(tsFirst)
-	{
-		if (tsFirst->type == event_type)
-		{
-			Event *next = tsFirst->next;
-			FreeTsEvent(tsFirst);
-			tsFirst = next;
-		}
-		else
-		{
-			break;
-		}
-	}
-	if (!tsFirst)
-	{
-		tsLast = NULL;
-		return;
-	}
-	Event *prev = tsFirst;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type)
-		{
-			prev->next = ptr->next;
-			if (ptr == tsLast)
-				tsLast = prev;
-			FreeTsEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
-	}
+	MoveEvents();
+	RemoveEvent(event_type);
 }
 
 void RemoveAllEvents(int event_type)
@@ -522,16 +505,17 @@ void RemoveAllEvents(int event_type)
 //This raise only the events required while the fifo is processing data
 void ProcessFifoWaitEvents()
 {
-	while (first)
+	while (!eventHeap.empty())
 	{
-		if (first->time <= (s64)GetTicks())
+		if (eventHeap.front().time <= (s64)GetTicks())
 		{
-//			LOG(CPU, "[Scheduler] %s		 (%lld, %lld) ",
-//				first->name ? first->name : "?", (u64)GetTicks(), (u64)first->time);
-			Event* evt = first;
-			first = first->next;
-			event_types[evt->type].callback(evt->userdata, (int)(GetTicks() - evt->time));
-			FreeEvent(evt);
+			// The callback may schedule more events, so take it off the heap first.
+			const HeapEvent evt = eventHeap.front();
+			PopEvent();
+			GetKeyState(evt).live--;
+			pendingByType[evt.type]--;
+			PruneCancelledEvents();
+			event_types[evt.type].callback(evt.userdata, (int)(GetTicks() - evt.time));
 		}
 		else
 		{
@@ -544,24 +528,12 @@ void MoveEvents()
 {
 	Common::AtomicStoreRelease(hasTsEvents, 0);
 
-	std::lock_guard<std::mutex> lk(externalEventLock);
 	// Move events from async queue into main queue
-	while (tsFirst)
+	// If a push is still in progress, its producer sets hasTsEvents again afterward.
+	BaseEvent ev;
+	while (tsQueue.Pop(ev))
 	{
-		Event *next = tsFirst->next;
-		AddEventToQueue(tsFirst);
-		tsFirst = next;
-	}
-	tsLast = NULL;
-
-	// Move free events to threadsafe pool
-	while(allocatedTsEvents > 0 && eventPool)
-	{
-		Event *ev = eventPool;
-		eventPool = ev->next;
-		ev->next = eventTsPool;
-		eventTsPool = ev;
-		allocatedTsEvents--;
+		AddEventToQueue(ev.time, ev.type, ev.userdata);
 	}
 }
 
@@ -590,7 +562,7 @@ void Advance()
 		MoveEvents();
 	ProcessFifoWaitEvents();
 
-	if (!first)
+	if (eventHeap.empty())
 	{
 		// This should never happen in PPSSPP.
 		// WARN_LOG_REPORT(TIME, "WARNING - no events in queue. Setting currentMIPS->downcount to 10000");
@@ -602,7 +574,7 @@ void Advance()
 	else
 	{
 		// Note that events can eat cycles as well.
-		int target = (int)(first->time - globalTimer);
+		int target = (int)(eventHeap.front().time - globalTimer);
 		if (target > MAX_SLICE_LENGTH)
 			target = MAX_SLICE_LENGTH;
 
@@ -614,11 +586,9 @@ void Advance()
 
 void LogPendingEvents()
 {
-	Event *ptr = first;
-	while (ptr)
+	for (const HeapEvent &ev : GetSortedEvents())
 	{
-		//INFO_LOG(CPU, "PENDING: Now: %lld Pending: %lld Type: %d", globalTimer, ptr->time, ptr->type);
-		ptr = ptr->next;
+		DEBUG_LOG(CPU, "PENDING: Now: %lld Pending: %lld Type: %d", (long long)globalTimer, (long long)ev.time, ev.type);
 	}
 }
 
@@ -628,10 +598,10 @@ void Idle(int maxIdle)
 	if (maxIdle != 0 && cyclesDown > maxIdle)
 		cyclesDown = maxIdle;
 
-	if (first && cyclesDown > 0)
+	if (!eventHeap.empty() && cyclesDown > 0)
 	{
 		int cyclesExecuted = slicelength - currentMIPS->downcount;
-		int cyclesNextEvent = (int) (first->time - globalTimer);
+		int cyclesNextEvent = (int) (eventHeap.front().time - globalTimer);
 
 		if (cyclesNextEvent < cyclesExecuted + cyclesDown)
 		{
@@ -652,21 +622,19 @@ void Idle(int maxIdle)
 
 std::string GetScheduledEventsSummary()
 {
-	Event *ptr = first;
 	std::string text = "Scheduled events\n";
 	text.reserve(1000);
-	while (ptr)
+	for (const HeapEvent &ev : GetSortedEvents())
 	{
-		unsigned int t = ptr->type;
+		unsigned int t = ev.type;
 		if (t >= event_types.size())
 			PanicAlert("Invalid event type"); // %i", t);
-		const char *name = event_types[ptr->type].name;
+		const char *name = event_types[ev.type].name;
 		if (!name)
 			name = "[unknown]";
 		char temp[512];
-		sprintf(temp, "%s : %i %08x%08x\n", name, (int)ptr->time, (u32)(ptr->userdata >> 32), (u32)(ptr->userdata));
+		sprintf(temp, "%s : %i %08x%08x\n", name, (int)ev.time, (u32)(ev.userdata >> 32), (u32)(ev.userdata));
 		text += temp;
-		ptr = ptr->next;
 	}
 	return text;
 }
@@ -686,8 +654,6 @@ void Event_DoStateOld(PointerWrap &p, BaseEvent *ev)
 
 void DoState(PointerWrap &p)
 {
-	std::lock_guard<std::mutex> lk(externalEventLock);
-
 	auto s = p.Section("CoreTiming", 1, 3);
 	if (!s)
 		return;
@@ -697,12 +663,48 @@ void DoState(PointerWrap &p)
 	// These (should) be filled in later by the modules.
 	event_types.resize(n, EventType(AntiCrashCallback, "INVALID EVENT"));
 
+	// The format is still a sorted linked list, so convert the heap to and from one.
+	// Events from other threads are saved as part of the main list, leaving the second list empty.
+	MoveEvents();
+	Event *first = nullptr;
+	Event *tsFirst = nullptr;
+	if (p.mode != PointerWrap::MODE_READ) {
+		Event **pNext = &first;
+		for (const HeapEvent &ev : GetSortedEvents()) {
+			Event *e = GetNewEvent();
+			e->time = ev.time;
+			e->userdata = ev.userdata;
+			e->type = ev.type;
+			e->next = nullptr;
+			*pNext = e;
+			pNext = &e->next;
+		}
+	}
+
 	if (s >= 3) {
 		p.DoLinkedList<BaseEvent, GetNewEvent, FreeEvent, Event_DoState>(first, (Event **) NULL);
-		p.DoLinkedList<BaseEvent, GetNewTsEvent, FreeTsEvent, Event_DoState>(tsFirst, &tsLast);
+		p.DoLinkedList<BaseEvent, GetNewEvent, FreeEvent, Event_DoState>(tsFirst, (Event **) NULL);
 	} else {
 		p.DoLinkedList<BaseEvent, GetNewEvent, FreeEvent, Event_DoStateOld>(first, (Event **) NULL);
-		p.DoLinkedList<BaseEvent, GetNewTsEvent, FreeTsEvent, Event_DoStateOld>(tsFirst, &tsLast);
+		p.DoLinkedList<BaseEvent, GetNewEvent, FreeEvent, Event_DoStateOld>(tsFirst, (Event **) NULL);
+	}
+
+	if (p.mode == PointerWrap::MODE_READ) {
+		ClearPendingEvents();
+		for (Event *e = first; e; e = e->next)
+			AddEventToQueue(e->time, e->type, e->userdata);
+		for (Event *e = tsFirst; e; e = e->next)
+			AddEventToQueue(e->time, e->type, e->userdata);
+	}
+	while (first) {
+		Event *next = first->next;
+		FreeEvent(first);
+		first = next;
+	}
+	while (tsFirst) {
+		Event *next = tsFirst->next;
+		FreeEvent(tsFirst);
+		tsFirst = next;
 	}
 
 	p.Do(CPU_HZ);
@@ -101,6 +101,7 @@ namespace CoreTiming
 	void RemoveThreadsafeEvent(int event_type);
 	void RemoveAllEvents(int event_type);
 	bool IsScheduled(int event_type);
+	bool IsScheduled(int event_type, u64 userdata);
 	void Advance();
 	void MoveEvents();
 	void ProcessFifoWaitEvents();
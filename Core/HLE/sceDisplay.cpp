@@ -290,6 +290,8 @@ void __DisplayDoState(PointerWrap &p) {
 		ScheduleLagSync();
 	}
 
+	// The list thread must be idle before we touch gstate.
+	gpu->SyncListThread();
 	p.Do(gstate);
 
 	// TODO: GPU stuff is really not the responsibility of sceDisplay.
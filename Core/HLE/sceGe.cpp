@@ -56,6 +56,7 @@ static ThreadSafeList<GeInterruptData> ge_pending_cb;
 static int geSyncEvent;
 static int geInterruptEvent;
 static int geCycleEvent;
+static int geListThreadEvent;
 
 class GeIntrHandler : public IntrHandler {
 public:
@@ -193,6 +194,11 @@ static void __GeCheckCycles(u64 userdata, int cyclesLate) {
 	// Deprecated
 }
 
+static void __GeListThreadDone(u64 userdata, int cyclesLate) {
+	// Delivers any interrupts or syncs the list thread produced.
+	gpu->SyncListThread();
+}
+
 void __GeInit() {
 	memset(&ge_used_callbacks, 0, sizeof(ge_used_callbacks));
 	memset(&ge_callback_data, 0, sizeof(ge_callback_data));
@@ -204,6 +210,7 @@ void __GeInit() {
 
 	// Deprecated
 	geCycleEvent = CoreTiming::RegisterEvent("GeCycleEvent", &__GeCheckCycles);
+	geListThreadEvent = CoreTiming::RegisterEvent("GeListThreadEvent", &__GeListThreadDone);
 
 	listWaitingThreads.clear();
 	drawWaitingThreads.clear();
@@ -215,7 +222,7 @@ struct GeInterruptData_v1 {
 };
 
 void __GeDoState(PointerWrap &p) {
-	auto s = p.Section("sceGe", 1, 2);
+	auto s = p.Section("sceGe", 1, 3);
 	if (!s)
 		return;
 
@@ -241,6 +248,12 @@ void __GeDoState(PointerWrap &p) {
 	CoreTiming::RestoreRegisterEvent(geInterruptEvent, "GeInterruptEvent", &__GeExecuteInterrupt);
 	p.Do(geCycleEvent);
 	CoreTiming::RestoreRegisterEvent(geCycleEvent, "GeCycleEvent", &__GeCheckCycles);
+	if (s >= 3) {
+		p.Do(geListThreadEvent);
+		CoreTiming::RestoreRegisterEvent(geListThreadEvent, "GeListThreadEvent", &__GeListThreadDone);
+	} else {
+		geListThreadEvent = CoreTiming::RegisterEvent("GeListThreadEvent", &__GeListThreadDone);
+	}
 
 	p.Do(listWaitingThreads);
 	p.Do(drawWaitingThreads);
@@ -263,6 +276,11 @@ bool __GeTriggerSync(GPUSyncType type, int id, u64 atTicks) {
 	return true;
 }
 
+// Called on the GPU list thread, when it has interrupts or syncs for us.
+void __GeNotifyListThreadDone() {
+	CoreTiming::ScheduleEvent_Threadsafe(0, geListThreadEvent);
+}
+
 bool __GeTriggerInterrupt(int listid, u32 pc, u64 atTicks) {
 	GeInterruptData intrdata;
 	intrdata.listid = listid;
@@ -529,6 +547,7 @@ static int sceGeGetMtx(int type, u32 matrixPtr) {
 	}
 
 	INFO_LOG(SCEGE, "sceGeGetMtx(%d, %08x)", type, matrixPtr);
+	gpu->SyncListThread();
 	switch (type) {
 	case GE_MTX_BONE0:
 	case GE_MTX_BONE1:
@@ -563,6 +582,7 @@ static int sceGeGetMtx(int type, u32 matrixPtr) {
 
 static u32 sceGeGetCmd(int cmd) {
 	INFO_LOG(SCEGE, "sceGeGetCmd(%i)", cmd);
+	gpu->SyncListThread();
 	if (cmd >= 0 && cmd < (int)ARRAY_SIZE(gstate.cmdmem)) {
 		return gstate.cmdmem[cmd];  // Does not mask away the high bits.
 	} else {
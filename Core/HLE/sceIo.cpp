@@ -119,6 +119,8 @@ const int PSP_STDERR = 2;
 const int PSP_STDIN = 3;
 static int asyncNotifyEvent = -1;
 static int syncNotifyEvent = -1;
+static int asyncWakeEvent = -1;
+static int syncWakeEvent = -1;
 static SceUID fds[PSP_COUNT_FDS];
 
 static std::vector<SceUID> memStickCallbacks;
@@ -342,7 +344,8 @@ static void __IoAsyncNotify(u64 userdata, int cyclesLate) {
 	if (g_Config.iIOTimingMethod == IOTIMING_HOST) {
 		// Not all async operations actually queue up.  Maybe should separate them?
 		if (!ioManager.HasResult(f->handle) && ioManager.HasOperation(f->handle)) {
-			// Try again in another 0.5ms until the IO completes on the host.
+			// The IO thread wakes us when it's done, but also try again in another 0.5ms.
+			ioManager.NotifyOnResult(f->handle, asyncWakeEvent, userdata);
 			CoreTiming::ScheduleEvent(usToCycles(500) - cyclesLate, asyncNotifyEvent, userdata);
 			return;
 		}
@@ -398,7 +401,8 @@ static void __IoSyncNotify(u64 userdata, int cyclesLate) {
 
 	if (g_Config.iIOTimingMethod == IOTIMING_HOST) {
 		if (!ioManager.HasResult(f->handle)) {
-			// Try again in another 0.5ms until the IO completes on the host.
+			// The IO thread wakes us when it's done, but also try again in another 0.5ms.
+			ioManager.NotifyOnResult(f->handle, syncWakeEvent, userdata);
 			CoreTiming::ScheduleEvent(usToCycles(500) - cyclesLate, syncNotifyEvent, userdata);
 			return;
 		}
@@ -428,6 +432,23 @@ static void __IoSyncNotify(u64 userdata, int cyclesLate) {
 	f->waitingSyncThreads.erase(std::remove(f->waitingSyncThreads.begin(), f->waitingSyncThreads.end(), threadID), f->waitingSyncThreads.end());
 }
 
+// The host finished an operation we were polling for, so check now instead of at the next poll.
+static void __IoWakeNotify(int notifyEvent, u64 userdata) {
+	// If it's not scheduled, the poll already noticed.
+	if (CoreTiming::IsScheduled(notifyEvent, userdata)) {
+		CoreTiming::UnscheduleEvent(notifyEvent, userdata);
+		CoreTiming::ScheduleEvent(0, notifyEvent, userdata);
+	}
+}
+
+static void __IoAsyncWake(u64 userdata, int cyclesLate) {
+	__IoWakeNotify(asyncNotifyEvent, userdata);
+}
+
+static void __IoSyncWake(u64 userdata, int cyclesLate) {
+	__IoWakeNotify(syncNotifyEvent, userdata);
+}
+
 static void __IoAsyncBeginCallback(SceUID threadID, SceUID prevCallbackId) {
 	auto result = HLEKernel::WaitBeginCallback<FileNode, WAITTYPE_ASYNCIO, SceUID>(threadID, prevCallbackId, -1);
 	if (result == HLEKernel::WAIT_CB_SUCCESS) {
@@ -555,6 +576,8 @@ void __IoInit() {
 
 	asyncNotifyEvent = CoreTiming::RegisterEvent("IoAsyncNotify", __IoAsyncNotify);
 	syncNotifyEvent = CoreTiming::RegisterEvent("IoSyncNotify", __IoSyncNotify);
+	asyncWakeEvent = CoreTiming::RegisterEvent("IoAsyncWake", __IoAsyncWake);
+	syncWakeEvent = CoreTiming::RegisterEvent("IoSyncWake", __IoSyncWake);
 
 	memstickSystem = new DirectoryFileSystem(&pspFileSystem, g_Config.memStickDirectory, FILESYSTEM_SIMULATE_FAT32);
 #if defined(USING_WIN_UI) || defined(APPLE)
@@ -600,7 +623,7 @@ void __IoInit() {
 }
 
 void __IoDoState(PointerWrap &p) {
-	auto s = p.Section("sceIo", 1, 3);
+	auto s = p.Section("sceIo", 1, 4);
 	if (!s)
 		return;
 
@@ -633,6 +656,16 @@ void __IoDoState(PointerWrap &p) {
 		p.Do(lastMemStickState);
 		p.Do(lastMemStickFatState);
 	}
+
+	if (s >= 4) {
+		p.Do(asyncWakeEvent);
+		CoreTiming::RestoreRegisterEvent(asyncWakeEvent, "IoAsyncWake", __IoAsyncWake);
+		p.Do(syncWakeEvent);
+		CoreTiming::RestoreRegisterEvent(syncWakeEvent, "IoSyncWake", __IoSyncWake);
+	} else {
+		asyncWakeEvent = CoreTiming::RegisterEvent("IoAsyncWake", __IoAsyncWake);
+		syncWakeEvent = CoreTiming::RegisterEvent("IoSyncWake", __IoSyncWake);
+	}
 }
 
 void __IoShutdown() {
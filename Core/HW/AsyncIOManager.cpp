@@ -49,6 +49,7 @@ void AsyncIOManager::Shutdown() {
 	std::lock_guard<std::mutex> guard(resultsLock_);
 	resultsPending_.clear();
 	results_.clear();
+	resultNotify_.clear();
 }
 
 bool AsyncIOManager::HasResult(u32 handle) {
@@ -110,6 +111,15 @@ u64 AsyncIOManager::ResultFinishTicks(u32 handle) {
 	return 0;
 }
 
+void AsyncIOManager::NotifyOnResult(u32 handle, int event_type, u64 userdata) {
+	std::lock_guard<std::mutex> guard(resultsLock_);
+	if (results_.find(handle) != results_.end()) {
+		CoreTiming::ScheduleEvent_Threadsafe(0, event_type, userdata);
+	} else {
+		resultNotify_[handle] = std::make_pair(event_type, userdata);
+	}
+}
+
 void AsyncIOManager::ProcessEvent(AsyncIOEvent ev) {
 	switch (ev.type) {
 	case IO_EVENT_READ:
@@ -144,6 +154,12 @@ void AsyncIOManager::EventResult(u32 handle, AsyncIOResult result) {
 	}
 	results_[handle] = result;
 	resultsWait_.notify_one();
+
+	auto notify = resultNotify_.find(handle);
+	if (notify != resultNotify_.end()) {
+		CoreTiming::ScheduleEvent_Threadsafe(0, notify->second.first, notify->second.second);
+		resultNotify_.erase(notify);
+	}
 }
 
 void AsyncIOManager::DoState(PointerWrap &p) {
@@ -153,6 +169,8 @@ void AsyncIOManager::DoState(PointerWrap &p) {
 
 	SyncThread();
 	std::lock_guard<std::mutex> guard(resultsLock_);
+	// Anyone waiting still polls, so this is safe to drop.
+	resultNotify_.clear();
 	p.Do(resultsPending_);
 	if (s >= 2) {
 		p.Do(results_);
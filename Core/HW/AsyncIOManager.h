@@ -88,6 +88,10 @@ class AsyncIOManager : public IOThreadEventQueue {
 	bool WaitResult(u32 handle, AsyncIOResult &result);
 	u64 ResultFinishTicks(u32 handle);
 
+	// Schedules a CoreTiming event (from the IO thread) once the result is ready, instead of polling.
+	// If it's already ready, the event is scheduled right away.  Not kept in save states.
+	void NotifyOnResult(u32 handle, int event_type, u64 userdata);
+
 protected:
 	void ProcessEvent(AsyncIOEvent ref) override;
 	bool ShouldExitEventLoop() override {
@@ -106,4 +110,5 @@ class AsyncIOManager : public IOThreadEventQueue {
 	std::condition_variable resultsWait_;
 	std::set<u32> resultsPending_;
 	std::map<u32, AsyncIOResult> results_;
+	std::map<u32, std::pair<int, u64>> resultNotify_;
 };
\ No newline at end of file
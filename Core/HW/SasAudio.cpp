@@ -20,6 +20,7 @@
 #include "base/basictypes.h"
 #include "profiler/profiler.h"
 
+#include "Common/ThreadPools.h"
 #include "Core/MemMapHelpers.h"
 #include "Core/HLE/sceAtrac.h"
 #include "Core/Config.h"
@@ -27,6 +28,10 @@
 #include "Core/Util/AudioFormat.h"
 #include "SasAudio.h"
 
+#ifdef _M_SSE
+#include <emmintrin.h>
+#endif
+
 // #define AUDIO_TO_FILE
 
 static const u8 f[16][2] = {
@@ -84,6 +89,31 @@ void VagDecoder::DecodeBlock(u8 *&read_pointer) {
 		}
 	}
 
+	// The filter depends on the previous samples, but unpacking the nibbles doesn't.
+	alignas(16) s16 unpacked[32];
+#ifdef _M_SSE
+	// The data is the last 14 bytes of the block.  Put each nibble in the top of a 16-bit lane.
+	const __m128i data = _mm_srli_si128(_mm_loadu_si128((const __m128i *)read_pointer), 2);
+	const __m128i lowMask = _mm_set1_epi8(0x0F);
+	const __m128i lo = _mm_and_si128(data, lowMask);
+	const __m128i hi = _mm_and_si128(_mm_srli_epi16(data, 4), lowMask);
+	const __m128i nibbles1 = _mm_unpacklo_epi8(lo, hi);
+	const __m128i nibbles2 = _mm_unpackhi_epi8(lo, hi);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i shift = _mm_cvtsi32_si128(shift_factor);
+	_mm_store_si128((__m128i *)unpacked + 0, _mm_sra_epi16(_mm_slli_epi16(_mm_unpacklo_epi8(zero, nibbles1), 4), shift));
+	_mm_store_si128((__m128i *)unpacked + 1, _mm_sra_epi16(_mm_slli_epi16(_mm_unpackhi_epi8(zero, nibbles1), 4), shift));
+	_mm_store_si128((__m128i *)unpacked + 2, _mm_sra_epi16(_mm_slli_epi16(_mm_unpacklo_epi8(zero, nibbles2), 4), shift));
+	_mm_store_si128((__m128i *)unpacked + 3, _mm_sra_epi16(_mm_slli_epi16(_mm_unpackhi_epi8(zero, nibbles2), 4), shift));
+	readp += 14;
+#else
+	for (int i = 0; i < 28; i += 2) {
+		u8 d = *readp++;
+		unpacked[i] = (short)((d & 0xf) << 12) >> shift_factor;
+		unpacked[i + 1] = (short)((d & 0xf0) << 8) >> shift_factor;
+	}
+#endif
+
 	// Keep state in locals to avoid bouncing to memory.
 	int s1 = s_1;
 	int s2 = s_2;
@@ -91,15 +121,18 @@ void VagDecoder::DecodeBlock(u8 *&read_pointer) {
 	int coef1 = f[predict_nr][0];
 	int coef2 = -f[predict_nr][1];
 
-	// TODO: Unroll once more and interleave the unpacking with the decoding more?
-	for (int i = 0; i < 28; i += 2) {
-		u8 d = *readp++;
-		int sample1 = (short)((d & 0xf) << 12) >> shift_factor;
-		int sample2 = (short)((d & 0xf0) << 8) >> shift_factor;
-		s2 = clamp_s16(sample1 + ((s1 * coef1 + s2 * coef2) >> 6));
-		s1 = clamp_s16(sample2 + ((s2 * coef1 + s1 * coef2) >> 6));
-		samples[i] = s2;
-		samples[i + 1] = s1;
+	if (coef1 == 0 && coef2 == 0) {
+		// No prediction (common for noisy sounds), the unpacked samples are already the output.
+		memcpy(samples, unpacked, sizeof(samples));
+		s1 = samples[27];
+		s2 = samples[26];
+	} else {
+		for (int i = 0; i < 28; i += 2) {
+			s2 = clamp_s16(unpacked[i] + ((s1 * coef1 + s2 * coef2) >> 6));
+			s1 = clamp_s16(unpacked[i + 1] + ((s2 * coef1 + s1 * coef2) >> 6));
+			samples[i] = s2;
+			samples[i + 1] = s1;
+		}
 	}
 
 	s_1 = s1;
@@ -472,7 +505,49 @@ bool SasVoice::HaveSamplesEnded() const {
 	}
 }
 
+// Adds (sample * vol) >> 12 for each channel of a stereo 32-bit buffer.
+static void MixSamplesStereo(s32 *dest, const s16 *samples, int count, int leftVol, int rightVol) {
+	if (leftVol == 0 && rightVol == 0)
+		return;
+
+	int i = 0;
+#ifdef _M_SSE
+	// Volumes are normally within +/- 0x1000, but they have to fit in 16 bits for this.
+	if (leftVol <= 0x7FFF && -leftVol <= 0x8000 && rightVol <= 0x7FFF && -rightVol <= 0x8000) {
+		const __m128i volume = _mm_set_epi16(rightVol, leftVol, rightVol, leftVol, rightVol, leftVol, rightVol, leftVol);
+		for (; i + 8 <= count; i += 8) {
+			const __m128i in = _mm_loadu_si128((const __m128i *)(samples + i));
+			// Each sample twice, to line up with L/R pairs.
+			const __m128i in1 = _mm_unpacklo_epi16(in, in);
+			const __m128i in2 = _mm_unpackhi_epi16(in, in);
+			// Full 32-bit products from the low and high halves.
+			const __m128i lo1 = _mm_mullo_epi16(in1, volume);
+			const __m128i hi1 = _mm_mulhi_epi16(in1, volume);
+			const __m128i lo2 = _mm_mullo_epi16(in2, volume);
+			const __m128i hi2 = _mm_mulhi_epi16(in2, volume);
+
+			__m128i *d = (__m128i *)(dest + i * 2);
+			_mm_storeu_si128(d + 0, _mm_add_epi32(_mm_loadu_si128(d + 0), _mm_srai_epi32(_mm_unpacklo_epi16(lo1, hi1), 12)));
+			_mm_storeu_si128(d + 1, _mm_add_epi32(_mm_loadu_si128(d + 1), _mm_srai_epi32(_mm_unpackhi_epi16(lo1, hi1), 12)));
+			_mm_storeu_si128(d + 2, _mm_add_epi32(_mm_loadu_si128(d + 2), _mm_srai_epi32(_mm_unpacklo_epi16(lo2, hi2), 12)));
+			_mm_storeu_si128(d + 3, _mm_add_epi32(_mm_loadu_si128(d + 3), _mm_srai_epi32(_mm_unpackhi_epi16(lo2, hi2), 12)));
+		}
+	}
+#endif
+	for (; i < count; i++) {
+		dest[i * 2] += (samples[i] * leftVol) >> 12;
+		dest[i * 2 + 1] += (samples[i] * rightVol) >> 12;
+	}
+}
+
 void SasInstance::MixVoice(SasVoice &voice) {
+	MixVoice(voice, mixBuffer, sendBuffer, scratch_);
+}
+
+void SasInstance::MixVoice(SasVoice &voice, s32 *mixBuf, s32 *sendBuf, SasMixScratch &scratch) {
+	int16_t *mixTemp = scratch.mixTemp;
+	int16_t *voiceSamples = scratch.voiceSamples;
+
 	switch (voice.type) {
 	case VOICETYPE_VAG:
 		if (voice.type == VOICETYPE_VAG && !voice.vagAddr)
@@ -498,21 +573,22 @@ void SasInstance::MixVoice(SasVoice &voice) {
 		// TODO: Special case no-resample case (and 2x and 0.5x) for speed, it's not uncommon
 
 		// Two passes: First read, then resample.
-		mixTemp_[0] = voice.resampleHist[0];
-		mixTemp_[1] = voice.resampleHist[1];
+		mixTemp[0] = voice.resampleHist[0];
+		mixTemp[1] = voice.resampleHist[1];
 
 		int voicePitch = voice.pitch;
 		u32 sampleFrac = voice.sampleFrac;
 		int samplesToRead = (sampleFrac + voicePitch * std::max(0, grainSize - delay)) >> PSP_SAS_PITCH_BASE_SHIFT;
-		if (samplesToRead > ARRAY_SIZE(mixTemp_) - 2) {
+		if (samplesToRead > ARRAY_SIZE(scratch.mixTemp) - 2) {
 			ERROR_LOG(SCESAS, "Too many samples to read (%d)! This shouldn't happen.", samplesToRead);
-			samplesToRead = ARRAY_SIZE(mixTemp_) - 2;
+			samplesToRead = ARRAY_SIZE(scratch.mixTemp) - 2;
 		}
-		voice.ReadSamples(&mixTemp_[2], samplesToRead);
+		voice.ReadSamples(&mixTemp[2], samplesToRead);
 		int tempPos = 2 + samplesToRead;
 
+		// Resampling and the envelope are serial, so they're done first.  Volumes are applied in bulk afterward.
 		for (int i = delay; i < grainSize; i++) {
-			const int16_t *s = mixTemp_ + (sampleFrac >> PSP_SAS_PITCH_BASE_SHIFT);
+			const int16_t *s = mixTemp + (sampleFrac >> PSP_SAS_PITCH_BASE_SHIFT);
 
 			// Linear interpolation. Good enough. Need to make resampleHist bigger if we want more.
 			int f = sampleFrac & PSP_SAS_PITCH_MASK;
@@ -527,19 +603,16 @@ void SasInstance::MixVoice(SasVoice &voice) {
 
 			// We just scale by the envelope before we scale by volumes.
 			// Again, we round up by adding (1 << 14) first (*after* multiplying.)
-			sample = ((sample * envelopeValue) + (1 << 14)) >> 15;
-
-			// We mix into this 32-bit temp buffer and clip in a second loop
-			// Ideally, the shift right should be there too but for now I'm concerned about
-			// not overflowing.
-			mixBuffer[i * 2] += (sample * voice.volumeLeft) >> 12;
-			mixBuffer[i * 2 + 1] += (sample * voice.volumeRight) >> 12;
-			sendBuffer[i * 2] += sample * voice.effectLeft >> 12;
-			sendBuffer[i * 2 + 1] += sample * voice.effectRight >> 12;
+			// The interpolation and envelope keep this within 16 bits.
+			voiceSamples[i] = clamp_s16(((sample * envelopeValue) + (1 << 14)) >> 15);
 		}
 
-		voice.resampleHist[0] = mixTemp_[tempPos - 2];
-		voice.resampleHist[1] = mixTemp_[tempPos - 1];
+		// We mix into these 32-bit temp buffers and clip when writing the output.
+		MixSamplesStereo(mixBuf + delay * 2, voiceSamples + delay, grainSize - delay, voice.volumeLeft, voice.volumeRight);
+		MixSamplesStereo(sendBuf + delay * 2, voiceSamples + delay, grainSize - delay, voice.effectLeft, voice.effectRight);
+
+		voice.resampleHist[0] = mixTemp[tempPos - 2];
+		voice.resampleHist[1] = mixTemp[tempPos - 1];
 
 		voice.sampleFrac = sampleFrac - (tempPos - 2) * PSP_SAS_PITCH_BASE;;
 
@@ -553,17 +626,66 @@ void SasInstance::MixVoice(SasVoice &voice) {
 	}
 }
 
-void SasInstance::Mix(u32 outAddr, u32 inAddr, int leftVol, int rightVol) {
-	int voicesPlayingCount = 0;
-
+void SasInstance::MixVoices() {
+	// Only VAG voices are mixed on other threads.  PCM and ATRAC3 read through other modules.
+	const bool parallel = g_Config.iNumWorkerThreads > 1;
+	int vagVoices[PSP_SAS_VOICES_MAX];
+	int vagCount = 0;
 	for (int v = 0; v < PSP_SAS_VOICES_MAX; v++) {
 		SasVoice &voice = voices[v];
 		if (!voice.playing || voice.paused)
 			continue;
-		voicesPlayingCount++;
-		MixVoice(voice);
+		if (parallel && voice.type == VOICETYPE_VAG)
+			vagVoices[vagCount++] = v;
+		else
+			MixVoice(voice);
 	}
 
+	// A couple of slices per worker, as in other parallel loops.  Not worth it for fewer voices.
+	const int slices = g_Config.iNumWorkerThreads * 2;
+	if (vagCount < slices) {
+		for (int i = 0; i < vagCount; i++) {
+			MixVoice(voices[vagVoices[i]]);
+		}
+		return;
+	}
+
+	const int sliceSize = grainSize * 4;
+	if ((int)sliceScratch_.size() < slices)
+		sliceScratch_.resize(slices);
+	if ((int)sliceBuffers_.size() < slices * sliceSize)
+		sliceBuffers_.resize(slices * sliceSize);
+
+	auto mixSlices = [&](int lower, int upper) {
+		for (int s = lower; s < upper; ++s) {
+			s32 *sliceMix = &sliceBuffers_[s * sliceSize];
+			s32 *sliceSend = sliceMix + grainSize * 2;
+			memset(sliceMix, 0, sliceSize * sizeof(s32));
+			for (int i = s * vagCount / slices; i < (s + 1) * vagCount / slices; i++) {
+				MixVoice(voices[vagVoices[i]], sliceMix, sliceSend, sliceScratch_[s]);
+			}
+		}
+	};
+	// The pool can be busy for a while (rewind snapshots, texture scaling.)  Waking it only
+	// pays off if it's free, otherwise mix here rather than wait behind that.
+	if (!GlobalThreadPool::TryLoop(mixSlices, 0, slices)) {
+		mixSlices(0, slices);
+	}
+
+	// Each voice is summed into the buffers without clamping, so this matches mixing them serially.
+	for (int s = 0; s < slices; ++s) {
+		const s32 *sliceMix = &sliceBuffers_[s * sliceSize];
+		const s32 *sliceSend = sliceMix + grainSize * 2;
+		for (int i = 0; i < grainSize * 2; i++) {
+			mixBuffer[i] += sliceMix[i];
+			sendBuffer[i] += sliceSend[i];
+		}
+	}
+}
+
+void SasInstance::Mix(u32 outAddr, u32 inAddr, int leftVol, int rightVol) {
+	MixVoices();
+
 	// Then mix the send buffer in with the rest.
 
 	// Alright, all voices mixed. Let's convert and clip, and at the same time, wipe mixBuffer for next time. Could also dither.
@@ -600,51 +722,22 @@ void SasInstance::WriteMixedOutput(s16 *outp, const s16 *inp, int leftVol, int r
 		ApplyWaveformEffect();
 	}
 
+	// mixBuffer is cleared after this anyway, so sum everything into it and clamp once.
+	if (!dry) {
+		memset(mixBuffer, 0, grainSize * sizeof(int) * 2);
+	}
+	if (wet) {
+		for (int i = 0; i < grainSize * 2; i++) {
+			mixBuffer[i] += sendBufferProcessed[i];
+		}
+	}
 	if (inp) {
 		for (int i = 0; i < grainSize * 2; i += 2) {
-			int sampleL = ((*inp++) * leftVol >> 12);
-			int sampleR = ((*inp++) * rightVol >> 12);
-			if (dry) {
-				sampleL += mixBuffer[i + 0];
-				sampleR += mixBuffer[i + 1];
-			}
-			if (wet) {
-				sampleL += sendBufferProcessed[i + 0];
-				sampleR += sendBufferProcessed[i + 1];
-			}
-			*outp++ = clamp_s16(sampleL);
-			*outp++ = clamp_s16(sampleR);
-		}
-	} else {
-		// These are the optimal cases.
-		if (dry && wet) {
-			for (int i = 0; i < grainSize * 2; i += 2) {
-				*outp++ = clamp_s16(mixBuffer[i + 0] + sendBufferProcessed[i + 0]);
-				*outp++ = clamp_s16(mixBuffer[i + 1] + sendBufferProcessed[i + 1]);
-			}
-		} else if (dry) {
-			for (int i = 0; i < grainSize * 2; i += 2) {
-				*outp++ = clamp_s16(mixBuffer[i + 0]);
-				*outp++ = clamp_s16(mixBuffer[i + 1]);
-			}
-		} else {
-			// This is another uncommon case, dry must be off but let's keep it for clarity.
-			for (int i = 0; i < grainSize * 2; i += 2) {
-				int sampleL = 0;
-				int sampleR = 0;
-				if (dry) {
-					sampleL += mixBuffer[i + 0];
-					sampleR += mixBuffer[i + 1];
-				}
-				if (wet) {
-					sampleL += sendBufferProcessed[i + 0];
-					sampleR += sendBufferProcessed[i + 1];
-				}
-				*outp++ = clamp_s16(sampleL);
-				*outp++ = clamp_s16(sampleR);
-			}
+			mixBuffer[i + 0] += (*inp++) * leftVol >> 12;
+			mixBuffer[i + 1] += (*inp++) * rightVol >> 12;
 		}
 	}
+	ClampBufferToS16(outp, mixBuffer, grainSize * 2);
 }
 
 void SasInstance::SetWaveformEffectType(int type) {
@@ -22,6 +22,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "Common/CommonTypes.h"
 #include "Core/HW/BufferQueue.h"
 #include "Core/HW/SasReverb.h"
@@ -272,6 +274,12 @@ struct SasVoice {
 	SasAtrac3 atrac3;
 };
 
+// Temporary buffers for mixing one voice at a time.  Each worker thread needs its own.
+struct SasMixScratch {
+	int16_t mixTemp[PSP_SAS_MAX_GRAIN * 4 + 2 + 8];  // some extra margin for very high pitches.
+	int16_t voiceSamples[PSP_SAS_MAX_GRAIN];  // one voice after the envelope, before volumes.
+};
+
 class SasInstance {
 public:
 	SasInstance();
@@ -295,6 +303,7 @@ class SasInstance {
 
 	void Mix(u32 outAddr, u32 inAddr = 0, int leftVol = 0, int rightVol = 0);
 	void MixVoice(SasVoice &voice);
+	void MixVoice(SasVoice &voice, s32 *mixBuf, s32 *sendBuf, SasMixScratch &scratch);
 
 	// Applies reverb to send buffer, according to waveformEffect.
 	void ApplyWaveformEffect();
@@ -309,7 +318,13 @@ class SasInstance {
 	WaveformEffect waveformEffect;
 
 private:
+	void MixVoices();
+
 	SasReverb reverb_;
 	int grainSize;
-	int16_t mixTemp_[PSP_SAS_MAX_GRAIN * 4 + 2 + 8];  // some extra margin for very high pitches.
+	SasMixScratch scratch_;
+
+	// For mixing voices in parallel: per slice scratch, and mix and send buffers to sum afterward.
+	std::vector<SasMixScratch> sliceScratch_;
+	std::vector<s32> sliceBuffers_;
 };
@@ -29,6 +29,18 @@
 #define CONTROL_FACTOR  0.2f // in freq_shift per fifo size offset
 #define CONTROL_AVG     32
 
+// The sinc resampler filters each output frame with SINC_TAPS input frames, using one of
+// SINC_PHASES precomputed filters picked by the fractional position.  Coefficients are 2.14 fixed point.
+#define SINC_TAPS        16
+#define SINC_PHASE_BITS  10
+#define SINC_PHASES      (1 << SINC_PHASE_BITS)
+#define SINC_SHIFT       14
+#define SINC_KAISER_BETA 7.0
+
+static const double PI = 3.14159265358979323846;
+
+#include <algorithm>
+#include <cmath>
 #include <cstring>
 
 #include "base/logging.h"
@@ -60,7 +72,11 @@ StereoResampler::StereoResampler()
 		, underrunCount_(0)
 		, overrunCount_(0)
 		, sample_rate_(0.0f)
-		, lastBufSize_(0) {
+		, lastBufSize_(0)
+		, m_sincTable(nullptr)
+		, m_sincOutputRate(0)
+		, m_sincInputRate(0)
+		, m_sincWantedRate(0) {
 	// Need to have space for the worst case in case it changes.
 	m_buffer = new int16_t[MAX_SAMPLES_EXTRA * 2]();
 
@@ -79,6 +95,8 @@ StereoResampler::StereoResampler()
 StereoResampler::~StereoResampler() {
 	delete[] m_buffer;
 	m_buffer = nullptr;
+	delete[] m_sincTable;
+	m_sincTable = nullptr;
 }
 
 void StereoResampler::UpdateBufferSize() {
@@ -141,6 +159,131 @@ inline void ClampBufferToS16WithVolume(s16 *out, const s32 *in, size_t size) {
 	}
 }
 
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+static double BesselI0(double x) {
+	double sum = 1.0;
+	double term = 1.0;
+	for (int k = 1; k < 32; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if (term < sum * 1e-12)
+			break;
+	}
+	return sum;
+}
+
+// Called with m_sincLock held.
+void StereoResampler::UpdateSincTable(int outputRate) {
+	if (!m_sincTable)
+		m_sincTable = new int16_t[SINC_PHASES * SINC_TAPS];
+	m_sincOutputRate = outputRate;
+	m_sincInputRate = m_input_sample_rate;
+
+	// Cut off a bit under the lower of the two Nyquist frequencies, relative to the input's.
+	const double cutoff = 0.92 * std::min(1.0, (double)outputRate / (double)m_input_sample_rate);
+	const double half = SINC_TAPS / 2;
+	const double windowScale = 1.0 / BesselI0(SINC_KAISER_BETA);
+
+	double taps[SINC_TAPS];
+	for (int phase = 0; phase < SINC_PHASES; phase++) {
+		// The output frame lies between taps SINC_TAPS / 2 - 1 and SINC_TAPS / 2.
+		const double t = (double)phase / SINC_PHASES;
+		double sum = 0.0;
+		for (int k = 0; k < SINC_TAPS; k++) {
+			double x = k - (half - 1.0) - t;
+			double w = x / half;
+			double window = BesselI0(SINC_KAISER_BETA * sqrt(std::max(0.0, 1.0 - w * w))) * windowScale;
+			double sinc = x == 0.0 ? cutoff : sin(PI * cutoff * x) / (PI * x);
+			taps[k] = sinc * window;
+			sum += taps[k];
+		}
+
+		// Normalize for unity gain, and put any rounding error on the largest tap so DC stays exact.
+		int16_t *coefs = m_sincTable + phase * SINC_TAPS;
+		int total = 0;
+		int largest = 0;
+		for (int k = 0; k < SINC_TAPS; k++) {
+			coefs[k] = (int16_t)floor(taps[k] / sum * (1 << SINC_SHIFT) + 0.5);
+			total += coefs[k];
+			if (taps[k] > taps[largest])
+				largest = k;
+		}
+		coefs[largest] += (1 << SINC_SHIFT) - total;
+	}
+}
+
+// Filters one output frame from SINC_TAPS interleaved stereo frames.
+static inline void SincFilterFrame(short *out, const int16_t *in, const int16_t *coefs) {
+#ifdef _M_SSE
+	__m128i acc = _mm_setzero_si128();
+	for (int k = 0; k < SINC_TAPS; k += 8) {
+		__m128i c = _mm_loadu_si128((const __m128i *)(coefs + k));
+		// Pair up the frames as L0 L1 R0 R1 L2 L3 R2 R3, and the coefficients as c0 c1 c0 c1 c2 c3 c2 c3.
+		__m128i in1 = _mm_loadu_si128((const __m128i *)(in + k * 2));
+		__m128i in2 = _mm_loadu_si128((const __m128i *)(in + k * 2 + 8));
+		in1 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(in1, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+		in2 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(in2, _MM_SHUFFLE(3, 1, 2, 0)), _MM_SHUFFLE(3, 1, 2, 0));
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(in1, _mm_unpacklo_epi32(c, c)));
+		acc = _mm_add_epi32(acc, _mm_madd_epi16(in2, _mm_unpackhi_epi32(c, c)));
+	}
+	// Now L R L R, sum the halves.
+	acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+	acc = _mm_srai_epi32(_mm_add_epi32(acc, _mm_set1_epi32(1 << (SINC_SHIFT - 1))), SINC_SHIFT);
+	u32 packed = (u32)_mm_cvtsi128_si32(_mm_packs_epi32(acc, acc));
+	memcpy(out, &packed, sizeof(packed));
+#elif PPSSPP_ARCH(ARM_NEON)
+	int32x4_t accL = vdupq_n_s32(0);
+	int32x4_t accR = vdupq_n_s32(0);
+	for (int k = 0; k < SINC_TAPS; k += 8) {
+		int16x8x2_t frames = vld2q_s16(in + k * 2);
+		int16x8_t c = vld1q_s16(coefs + k);
+		accL = vmlal_s16(accL, vget_low_s16(frames.val[0]), vget_low_s16(c));
+		accL = vmlal_s16(accL, vget_high_s16(frames.val[0]), vget_high_s16(c));
+		accR = vmlal_s16(accR, vget_low_s16(frames.val[1]), vget_low_s16(c));
+		accR = vmlal_s16(accR, vget_high_s16(frames.val[1]), vget_high_s16(c));
+	}
+	int32x2_t sumL = vpadd_s32(vget_low_s32(accL), vget_high_s32(accL));
+	int32x2_t sumR = vpadd_s32(vget_low_s32(accR), vget_high_s32(accR));
+	int32x2_t sum = vpadd_s32(sumL, sumR);
+	int16x4_t packed = vqrshrn_n_s32(vcombine_s32(sum, sum), SINC_SHIFT);
+	vst1_lane_s32((int32_t *)out, vreinterpret_s32_s16(packed), 0);
+#else
+	int sumL = 0;
+	int sumR = 0;
+	for (int k = 0; k < SINC_TAPS; k++) {
+		sumL += in[k * 2] * coefs[k];
+		sumR += in[k * 2 + 1] * coefs[k];
+	}
+	out[0] = clamp_s16((sumL + (1 << (SINC_SHIFT - 1))) >> SINC_SHIFT);
+	out[1] = clamp_s16((sumR + (1 << (SINC_SHIFT - 1))) >> SINC_SHIFT);
+#endif
+}
+
+// Here indexR points at the oldest frame the filter reads, SINC_TAPS / 2 - 1 frames behind the
+// output position.  That way the history can't be overwritten by PushSamples.
+unsigned int StereoResampler::MixSinc(short *samples, unsigned int numSamples, u32 ratio, u32 &indexR, u32 indexW) {
+	const int INDEX_MASK = (m_bufsize * 2 - 1);
+	const u32 windowEnd = m_bufsize * 2 - SINC_TAPS * 2;
+	int16_t wrapped[SINC_TAPS * 2];
+
+	unsigned int currentSample = 0;
+	for (; currentSample < numSamples * 2 && ((indexW - indexR) & INDEX_MASK) >= SINC_TAPS * 2; currentSample += 2) {
+		const int16_t *in;
+		if ((indexR & INDEX_MASK) <= windowEnd) {
+			in = &m_buffer[indexR & INDEX_MASK];
+		} else {
+			for (int i = 0; i < SINC_TAPS * 2; i++)
+				wrapped[i] = m_buffer[(indexR + i) & INDEX_MASK];
+			in = wrapped;
+		}
+		SincFilterFrame(&samples[currentSample], in, m_sincTable + (m_frac >> (16 - SINC_PHASE_BITS)) * SINC_TAPS);
+		m_frac += ratio;
+		indexR += 2 * (u16)(m_frac >> 16);
+		m_frac &= 0xffff;
+	}
+	return currentSample;
+}
+
 void StereoResampler::Clear() {
 	memset(m_buffer, 0, m_bufsize * 2 * sizeof(int16_t));
 }
@@ -185,21 +328,33 @@ unsigned int StereoResampler::Mix(short* samples, unsigned int numSamples, bool
 		sample_rate_ = (float)(m_input_sample_rate + offset);
 		const u32 ratio = (u32)(65536.0 * sample_rate_ / (double)sample_rate);
 
-		// TODO: consider a higher-quality resampling algorithm.
-		// TODO: Add a fast path for 1:1.
-		for (; currentSample < numSamples * 2 && ((indexW - indexR) & INDEX_MASK) > 2; currentSample += 2) {
-			u32 indexR2 = indexR + 2; //next sample
-			s16 l1 = m_buffer[indexR & INDEX_MASK]; //current
-			s16 r1 = m_buffer[(indexR + 1) & INDEX_MASK]; //current
-			s16 l2 = m_buffer[indexR2 & INDEX_MASK]; //next
-			s16 r2 = m_buffer[(indexR2 + 1) & INDEX_MASK]; //next
-			int sampleL = ((l1 << 16) + (l2 - l1) * (u16)m_frac) >> 16;
-			int sampleR = ((r1 << 16) + (r2 - r1) * (u16)m_frac) >> 16;
-			samples[currentSample] = sampleL;
-			samples[currentSample + 1] = sampleR;
-			m_frac += ratio;
-			indexR += 2 * (u16)(m_frac >> 16);
-			m_frac &= 0xffff;
+		bool mixedSinc = false;
+		if (g_Config.iAudioResamplerType == AUDIO_RESAMPLER_SINC) {
+			// The filter bank is built by PushSamples, off the audio thread.  Interpolate until it's ready.
+			m_sincWantedRate = sample_rate;
+			std::unique_lock<std::mutex> guard(m_sincLock, std::try_to_lock);
+			if (guard.owns_lock() && m_sincTable && m_sincOutputRate == sample_rate && m_sincInputRate == m_input_sample_rate) {
+				currentSample = MixSinc(samples, numSamples, ratio, indexR, indexW);
+				mixedSinc = true;
+			}
+		}
+
+		if (!mixedSinc) {
+			// TODO: Add a fast path for 1:1.
+			for (; currentSample < numSamples * 2 && ((indexW - indexR) & INDEX_MASK) > 2; currentSample += 2) {
+				u32 indexR2 = indexR + 2; //next sample
+				s16 l1 = m_buffer[indexR & INDEX_MASK]; //current
+				s16 r1 = m_buffer[(indexR + 1) & INDEX_MASK]; //current
+				s16 l2 = m_buffer[indexR2 & INDEX_MASK]; //next
+				s16 r2 = m_buffer[(indexR2 + 1) & INDEX_MASK]; //next
+				int sampleL = ((l1 << 16) + (l2 - l1) * (u16)m_frac) >> 16;
+				int sampleR = ((r1 << 16) + (r2 - r1) * (u16)m_frac) >> 16;
+				samples[currentSample] = sampleL;
+				samples[currentSample + 1] = sampleR;
+				m_frac += ratio;
+				indexR += 2 * (u16)(m_frac >> 16);
+				m_frac &= 0xffff;
+			}
 		}
 	}
 
@@ -229,6 +384,15 @@ unsigned int StereoResampler::Mix(short* samples, unsigned int numSamples, bool
 
 void StereoResampler::PushSamples(const s32 *samples, unsigned int num_samples) {
 	UpdateBufferSize();
+	if (g_Config.iAudioResamplerType == AUDIO_RESAMPLER_SINC) {
+		// Only this thread changes the table, so it's safe to check before locking.
+		int wantedRate = m_sincWantedRate;
+		if (wantedRate != 0 && (!m_sincTable || wantedRate != m_sincOutputRate || m_input_sample_rate != m_sincInputRate)) {
+			std::lock_guard<std::mutex> guard(m_sincLock);
+			UpdateSincTable(wantedRate);
+		}
+	}
+
 	const int INDEX_MASK = (m_bufsize * 2 - 1);
 	// Cache access in non-volatile variable
 	// indexR isn't allowed to cache in the audio throttling loop as it
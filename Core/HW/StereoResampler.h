@@ -19,6 +19,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <mutex>
 #include <string>
 
 #include "Common/ChunkFile.h"
@@ -47,6 +49,8 @@ class StereoResampler {
 protected:
 	void UpdateBufferSize();
 	void SetInputSampleRate(unsigned int rate);
+	void UpdateSincTable(int outputRate);
+	unsigned int MixSinc(short *samples, unsigned int numSamples, u32 ratio, u32 &indexR, u32 indexW);
 
 	int m_bufsize;
 	int m_lowwatermark;
@@ -61,4 +65,12 @@ class StereoResampler {
 	float sample_rate_;
 	int lastBufSize_;
 	int lastPushSize_;
+
+	// Polyphase filter bank for the sinc resampler, built for one pair of rates.
+	// PushSamples builds it for the rate Mix asks for, since that's too slow for the audio thread.
+	int16_t *m_sincTable;
+	int m_sincOutputRate;
+	unsigned int m_sincInputRate;
+	std::atomic<int> m_sincWantedRate;
+	std::mutex m_sincLock;
 };
@@ -0,0 +1,231 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <cstring>
+
+#include "base/logging.h"
+#include "base/timeutil.h"
+#include "ext/xxhash.h"
+#include "Common/FileUtil.h"
+#include "Common/StringUtils.h"
+#include "Core/Debugger/Breakpoints.h"
+#include "Core/MIPS/IR/IRDiskCache.h"
+#include "Core/MIPS/IR/IRJit.h"
+
+namespace MIPSComp {
+
+// Bump this when the frontend or passes change what IR they generate.
+// Changes to the op enum or metadata are caught by the layout hash automatically.
+#define IR_CACHE_HEADER_MAGIC 0x43524950
+#define IR_CACHE_VERSION 2
+
+struct IRCacheHeader {
+	u32 magic;
+	u32 version;
+	u32 instSize;
+	u32 layoutHash;
+	u32 numEntries;
+	u32 reserved;
+};
+
+struct IRCacheEntryHeader {
+	u32 em_address;
+	u32 compileFlags;
+	u32 exitFlags;
+	u32 mipsBytes;
+	u32 numInstructions;
+	u32 reserved;
+	u64 hash;
+};
+
+static u32 ComputeIRLayoutHash() {
+	XXH32_state_t *state = XXH32_createState();
+	XXH32_reset(state, 0x1E5A7C3B);
+	for (int i = 0; i < 256; ++i) {
+		const IRMeta *meta = GetIRMeta((IROp)i);
+		if (!meta)
+			continue;
+		u32 op = (u32)meta->op;
+		XXH32_update(state, &op, sizeof(op));
+		XXH32_update(state, meta->name, strlen(meta->name));
+		XXH32_update(state, meta->types, sizeof(meta->types));
+		XXH32_update(state, &meta->flags, sizeof(meta->flags));
+	}
+	u32 result = XXH32_digest(state);
+	XXH32_freeState(state);
+	return result;
+}
+
+void IRDiskCache::Load(const std::string &filename) {
+	File::IOFile f(filename, "rb");
+	if (!f.IsOpen()) {
+		return;
+	}
+	u64 sz = f.GetSize();
+	IRCacheHeader header;
+	if (!f.ReadArray(&header, 1)) {
+		return;
+	}
+	if (header.magic != IR_CACHE_HEADER_MAGIC || header.version != IR_CACHE_VERSION) {
+		return;
+	}
+	if (header.instSize != sizeof(IRInst) || header.layoutHash != ComputeIRLayoutHash()) {
+		INFO_LOG(JIT, "IR cache was built with a different IR layout, ignoring");
+		return;
+	}
+
+	u64 pos = sizeof(header);
+	for (u32 i = 0; i < header.numEntries; ++i) {
+		IRCacheEntryHeader eh;
+		if (pos + sizeof(eh) > sz || !f.ReadArray(&eh, 1)) {
+			break;
+		}
+		pos += sizeof(eh);
+
+		u64 instBytes = (u64)eh.numInstructions * sizeof(IRInst);
+		if (eh.numInstructions == 0 || pos + instBytes > sz || (eh.mipsBytes & 3) != 0) {
+			ERROR_LOG(JIT, "Corrupt IR cache file, discarding the rest");
+			break;
+		}
+
+		Entry &entry = entries_[eh.em_address];
+		entry.compileFlags = eh.compileFlags;
+		entry.exitFlags = eh.exitFlags;
+		entry.mipsBytes = eh.mipsBytes;
+		entry.hash = eh.hash;
+		entry.instructions.resize(eh.numInstructions);
+		if (!f.ReadArray(&entry.instructions[0], eh.numInstructions)) {
+			entries_.erase(eh.em_address);
+			break;
+		}
+		pos += instBytes;
+	}
+
+	NOTICE_LOG(JIT, "Loaded %d blocks from the IR cache '%s'", (int)entries_.size(), filename.c_str());
+	dirty_ = false;
+}
+
+void IRDiskCache::Save(const std::string &filename) {
+	if (!dirty_ || entries_.empty()) {
+		return;
+	}
+
+	INFO_LOG(JIT, "Saving the IR cache to '%s'", filename.c_str());
+	FILE *f = File::OpenCFile(filename, "wb");
+	if (!f) {
+		// Can't save, give up for now.
+		dirty_ = false;
+		return;
+	}
+
+	IRCacheHeader header;
+	header.magic = IR_CACHE_HEADER_MAGIC;
+	header.version = IR_CACHE_VERSION;
+	header.instSize = sizeof(IRInst);
+	header.layoutHash = ComputeIRLayoutHash();
+	header.numEntries = (u32)entries_.size();
+	header.reserved = 0;
+	fwrite(&header, 1, sizeof(header), f);
+
+	for (const auto &it : entries_) {
+		const Entry &entry = it.second;
+		IRCacheEntryHeader eh;
+		eh.em_address = it.first;
+		eh.compileFlags = entry.compileFlags;
+		eh.exitFlags = entry.exitFlags;
+		eh.mipsBytes = entry.mipsBytes;
+		eh.numInstructions = (u32)entry.instructions.size();
+		eh.reserved = 0;
+		eh.hash = entry.hash;
+		fwrite(&eh, 1, sizeof(eh), f);
+		fwrite(&entry.instructions[0], sizeof(IRInst), entry.instructions.size(), f);
+	}
+	fclose(f);
+	dirty_ = false;
+}
+
+void IRDiskCache::Clear() {
+	entries_.clear();
+	dirty_ = false;
+}
+
+bool IRDiskCache::Lookup(u32 em_address, u32 compileFlags, std::vector<IRInst> &instructions, u32 &mipsBytes, u64 &hash, u32 &exitFlags) {
+	auto it = entries_.find(em_address);
+	if (it == entries_.end()) {
+		misses_++;
+		return false;
+	}
+
+	double st = real_time_now();
+	const Entry &entry = it->second;
+	if (entry.compileFlags != compileFlags || IRBlock::CalculateHash(em_address, entry.mipsBytes) != entry.hash) {
+		// The code changed (or it's an overlay sharing the address.)  The recompile will replace it.
+		rejects_++;
+		misses_++;
+		lookupTime_ += real_time_now() - st;
+		return false;
+	}
+	// Breakpoint and memcheck IR is only added when compiling, so those need a real compile.
+	if (CBreakPoints::HasMemChecks() || CBreakPoints::RangeContainsBreakPoint(em_address, entry.mipsBytes)) {
+		misses_++;
+		lookupTime_ += real_time_now() - st;
+		return false;
+	}
+
+	instructions = entry.instructions;
+	mipsBytes = entry.mipsBytes;
+	hash = entry.hash;
+	exitFlags = entry.exitFlags;
+	hits_++;
+	lookupTime_ += real_time_now() - st;
+	return true;
+}
+
+void IRDiskCache::Add(u32 em_address, u32 compileFlags, u32 exitFlags, u32 mipsBytes, u64 hash, const std::vector<IRInst> &instructions) {
+	if (instructions.empty() || !CanCache(instructions)) {
+		return;
+	}
+
+	Entry &entry = entries_[em_address];
+	entry.compileFlags = compileFlags;
+	entry.exitFlags = exitFlags;
+	entry.mipsBytes = mipsBytes;
+	entry.hash = hash;
+	entry.instructions = instructions;
+	dirty_ = true;
+}
+
+bool IRDiskCache::CanCache(const std::vector<IRInst> &instructions) {
+	for (const IRInst &inst : instructions) {
+		switch (inst.op) {
+		case IROp::CallReplacement:
+		case IROp::Breakpoint:
+		case IROp::MemoryCheck:
+			return false;
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
+std::string IRDiskCache::GetStatsString() const {
+	return StringFromFormat("%d hits, %d misses (%d stale), %0.2f ms validating hits, %0.2f ms compiling misses",
+		hits_, misses_, rejects_, lookupTime_ * 1000.0, compileTime_ * 1000.0);
+}
+
+}  // namespace MIPSComp
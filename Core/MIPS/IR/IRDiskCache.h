@@ -0,0 +1,75 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Core/MIPS/IR/IRInst.h"
+
+namespace MIPSComp {
+
+// Persists compiled (and simplified) IR blocks per game, so the next boot can skip
+// the frontend and passes.  Entries are validated against a hash of the MIPS code
+// they were compiled from, so stale entries are simply recompiled.
+class IRDiskCache {
+public:
+	void Load(const std::string &filename);
+	void Save(const std::string &filename);
+	void Clear();
+
+	// Returns true and fills in the block if a valid entry exists for this address.
+	// compileFlags are the frontend's flags before compiling, exitFlags what they were after.
+	bool Lookup(u32 em_address, u32 compileFlags, std::vector<IRInst> &instructions, u32 &mipsBytes, u64 &hash, u32 &exitFlags);
+	void Add(u32 em_address, u32 compileFlags, u32 exitFlags, u32 mipsBytes, u64 hash, const std::vector<IRInst> &instructions);
+
+	// Some blocks depend on state outside the MIPS code (replacements, breakpoints.)
+	static bool CanCache(const std::vector<IRInst> &instructions);
+
+	void AddCompileTime(double t) {
+		compileTime_ += t;
+	}
+
+	int Hits() const { return hits_; }
+	int Misses() const { return misses_; }
+	int Rejects() const { return rejects_; }
+	std::string GetStatsString() const;
+
+private:
+	struct Entry {
+		u32 compileFlags;
+		u32 exitFlags;
+		u32 mipsBytes;
+		u64 hash;
+		std::vector<IRInst> instructions;
+	};
+
+	std::unordered_map<u32, Entry> entries_;
+	bool dirty_ = false;
+
+	int hits_ = 0;
+	int misses_ = 0;
+	// Entries found, but with a mismatching hash or flags.
+	int rejects_ = 0;
+	double compileTime_ = 0.0;
+	double lookupTime_ = 0.0;
+};
+
+}  // namespace MIPSComp
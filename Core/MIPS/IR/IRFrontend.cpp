@@ -15,6 +15,8 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+
 #include "base/logging.h"
 
 #include "Common/ChunkFile.h"
@@ -59,6 +61,30 @@ void IRFrontend::DoState(PointerWrap &p) {
 	CBreakPoints::SetSkipFirst(0);
 }
 
+u32 IRFrontend::GetCompileFlags() const {
+	u32 flags = 0;
+	if (js.startDefaultPrefix)
+		flags |= 1;
+	if (js.hasSetRounding)
+		flags |= 2;
+	if (opts.unalignedLoadStore)
+		flags |= 4;
+	return flags;
+}
+
+void IRFrontend::RestoreCompileFlags(u32 flags) {
+	// Only ever set, like when compiling.
+	if (flags & 2)
+		js.hasSetRounding = 1;
+}
+
+void IRFrontend::InheritCompileState(const IRFrontend &other) {
+	js.startDefaultPrefix = other.js.startDefaultPrefix;
+	js.hasSetRounding = other.js.hasSetRounding;
+	js.lastSetRounding = other.js.lastSetRounding;
+	opts = other.opts;
+}
+
 void IRFrontend::FlushAll() {
 	FlushPrefixV();
 }
@@ -219,7 +245,17 @@ MIPSOpcode IRFrontend::GetOffsetInstruction(int offset) {
 	return Memory::Read_Instruction(GetCompilerPC() + 4 * offset);
 }
 
-void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload) {
+static const IRPassFunc defaultPasses[] = {
+	&RemoveLoadStoreLeftRight,
+	&OptimizeFPMoves,
+	&PropagateConstants,
+	&PurgeTemps,
+	// &ReorderLoadStore,
+	// &MergeLoadStore,
+	// &ThreeOpToTwoOp,
+};
+
+void IRFrontend::CompileIR(u32 em_address, bool preload) {
 	js.cancel = false;
 	js.preloading = preload;
 	js.blockStart = em_address;
@@ -251,22 +287,16 @@ void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &m
 		// Clear the instructions to signal this was not compiled.
 		ir.Clear();
 	}
+}
 
+void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload) {
+	CompileIR(em_address, preload);
 	mipsBytes = js.compilerPC - em_address;
 
 	IRWriter simplified;
 	IRWriter *code = &ir;
 	if (!js.hadBreakpoints) {
-		static const IRPassFunc passes[] = {
-			&RemoveLoadStoreLeftRight,
-			&OptimizeFPMoves,
-			&PropagateConstants,
-			&PurgeTemps,
-			// &ReorderLoadStore,
-			// &MergeLoadStore,
-			// &ThreeOpToTwoOp,
-		};
-		if (IRApplyPasses(passes, ARRAY_SIZE(passes), ir, simplified, opts))
+		if (IRApplyPasses(defaultPasses, ARRAY_SIZE(defaultPasses), ir, simplified, opts))
 			logBlocks = 1;
 		code = &simplified;
 		//if (ir.GetInstructions().size() >= 24)
@@ -311,6 +341,51 @@ void IRFrontend::DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &m
 		dontLogBlocks--;
 }
 
+int IRFrontend::DoJitTrace(const std::vector<u32> &blockAddresses, std::vector<IRInst> &instructions, u32 &endAddress) {
+	IRWriter trace;
+	IRInst pendingExit{};
+	bool hasPendingExit = false;
+	int merged = 0;
+	endAddress = 0;
+
+	for (size_t i = 0; i < blockAddresses.size(); ++i) {
+		CompileIR(blockAddresses[i], false);
+		if (js.hadBreakpoints || ir.GetInstructions().empty()) {
+			break;
+		}
+
+		// We made it into this block, so the jump to it isn't needed.
+		hasPendingExit = false;
+		const std::vector<IRInst> &insts = ir.GetInstructions();
+		size_t count = insts.size();
+		const IRInst &exit = insts.back();
+		if (i + 1 < blockAddresses.size() && exit.op == IROp::ExitToConst && exit.constant == blockAddresses[i + 1]) {
+			// Side exits within the block stay, only the final jump is dropped.
+			pendingExit = exit;
+			hasPendingExit = true;
+			count--;
+		}
+		for (size_t j = 0; j < count; ++j) {
+			trace.Write(insts[j]);
+		}
+
+		endAddress = std::max(endAddress, js.compilerPC);
+		merged++;
+		if (!hasPendingExit) {
+			break;
+		}
+	}
+
+	if (hasPendingExit) {
+		trace.Write(pendingExit);
+	}
+
+	IRWriter simplified;
+	IRApplyPasses(defaultPasses, ARRAY_SIZE(defaultPasses), trace, simplified, opts);
+	instructions = simplified.GetInstructions();
+	return merged;
+}
+
 void IRFrontend::Comp_RunBlock(MIPSOpcode op) {
 	// This shouldn't be necessary, the dispatcher should catch us before we get here.
 	ERROR_LOG(JIT, "Comp_RunBlock should never be reached!");
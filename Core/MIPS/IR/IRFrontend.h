@@ -87,8 +87,17 @@ class IRFrontend : public MIPSFrontendInterface {
 	int Replace_fabsf() override;
 	void DoState(PointerWrap &p);
 	bool CheckRounding(u32 blockAddress);  // returns true if we need a do-over
+	// State that affects the generated IR, other than the MIPS code itself.
+	u32 GetCompileFlags() const;
+	// Applies the state a compile would have left behind, for blocks that skip DoJit.
+	void RestoreCompileFlags(u32 flags);
+	// Used to keep a second frontend (for background preloading) generating the same IR.
+	void InheritCompileState(const IRFrontend &other);
 
 	void DoJit(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload);
+	// Compiles a chain of blocks, each ending with a jump to the next, as one unit so the passes
+	// can work across them.  Returns how many blocks were merged, and the end of the MIPS code used.
+	int DoJitTrace(const std::vector<u32> &blockAddresses, std::vector<IRInst> &instructions, u32 &endAddress);
 
 	void EatPrefix() override {
 		js.EatPrefix();
@@ -99,6 +108,8 @@ class IRFrontend : public MIPSFrontendInterface {
 	}
 
 private:
+	void CompileIR(u32 em_address, bool preload);
+
 	void RestoreRoundingMode(bool force = false);
 	void ApplyRoundingMode(bool force = false);
 	void UpdateRoundingMode();
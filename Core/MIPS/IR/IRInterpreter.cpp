@@ -25,6 +25,7 @@
 #include "Core/MIPS/MIPSVFPUUtils.h"
 #include "Core/MIPS/IR/IRInst.h"
 #include "Core/MIPS/IR/IRInterpreter.h"
+#include "Core/MIPS/IR/IRJit.h"
 #include "Core/System.h"
 
 alignas(16) static const float vec4InitValues[8][4] = {
@@ -67,116 +68,311 @@ u32 RunMemCheck(u32 pc, u32 addr) {
 	return coreState != CORE_RUNNING ? 1 : 0;
 }
 
+#if defined(__GNUC__) || defined(__clang__)
+// Dispatch using computed goto.  This skips the switch's range check, and each op jumps
+// straight to the next handler through a table, which branch predictors handle better.
+#define IR_THREADED_DISPATCH 1
+#define IR_CASE(op) case IROp::op: IRLabel_##op:
+#define IR_DISPATCH_ENTRY(op) dispatchTable[(int)IROp::op] = &&IRLabel_##op
+#else
+#define IR_THREADED_DISPATCH 0
+#define IR_CASE(op) case IROp::op:
+#endif
+
+#if IR_THREADED_DISPATCH && !defined(_DEBUG)
+// Ends a handler.  Each one has its own copy of the indirect jump, so the predictor can
+// learn which op tends to follow which, instead of sharing one jump for every op.
+#define IR_NEXT() \
+	if (threaded) { \
+		inst++; \
+		if (inst == end) \
+			goto badBlock; \
+		goto *dispatchTable[(int)inst->op]; \
+	} \
+	break
+#else
+// Debug builds go through the bottom of the loop, to check r0.
+#define IR_NEXT() break
+#endif
+
+// Constant exits can continue straight into a linked block, when chaining.
+#define IR_EXIT_CONST(pc) \
+	do { \
+		if (chained) { \
+			exitPC = (pc); \
+			goto constExit; \
+		} \
+		return (pc); \
+	} while (false)
+
 // We cannot use NEON on ARM32 here until we make it a hard dependency. We can, however, on ARM64.
-u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
+template <bool threaded, bool partial, bool chained>
+static u32 IRInterpretImpl(MIPSState *mips, const IRInst *inst, int count, IRChainState *chain) {
 	const IRInst *end = inst + count;
+	u32 exitPC = 0;
+#if IR_THREADED_DISPATCH
+	static const void *dispatchTable[256];
+	if (threaded) {
+		if (!dispatchTable[0]) {
+			for (int i = 0; i < 256; ++i) {
+				dispatchTable[i] = &&IRLabel_Unknown;
+			}
+			IR_DISPATCH_ENTRY(Nop);
+			IR_DISPATCH_ENTRY(SetConst);
+			IR_DISPATCH_ENTRY(SetConstF);
+			IR_DISPATCH_ENTRY(Add);
+			IR_DISPATCH_ENTRY(Sub);
+			IR_DISPATCH_ENTRY(And);
+			IR_DISPATCH_ENTRY(Or);
+			IR_DISPATCH_ENTRY(Xor);
+			IR_DISPATCH_ENTRY(Mov);
+			IR_DISPATCH_ENTRY(AddConst);
+			IR_DISPATCH_ENTRY(SubConst);
+			IR_DISPATCH_ENTRY(AndConst);
+			IR_DISPATCH_ENTRY(OrConst);
+			IR_DISPATCH_ENTRY(XorConst);
+			IR_DISPATCH_ENTRY(Neg);
+			IR_DISPATCH_ENTRY(Not);
+			IR_DISPATCH_ENTRY(Ext8to32);
+			IR_DISPATCH_ENTRY(Ext16to32);
+			IR_DISPATCH_ENTRY(ReverseBits);
+			IR_DISPATCH_ENTRY(Load8);
+			IR_DISPATCH_ENTRY(Load8Ext);
+			IR_DISPATCH_ENTRY(Load16);
+			IR_DISPATCH_ENTRY(Load16Ext);
+			IR_DISPATCH_ENTRY(Load32);
+			IR_DISPATCH_ENTRY(Load32Left);
+			IR_DISPATCH_ENTRY(Load32Right);
+			IR_DISPATCH_ENTRY(LoadFloat);
+			IR_DISPATCH_ENTRY(Store8);
+			IR_DISPATCH_ENTRY(Store16);
+			IR_DISPATCH_ENTRY(Store32);
+			IR_DISPATCH_ENTRY(Store32Left);
+			IR_DISPATCH_ENTRY(Store32Right);
+			IR_DISPATCH_ENTRY(StoreFloat);
+			IR_DISPATCH_ENTRY(LoadVec4);
+			IR_DISPATCH_ENTRY(StoreVec4);
+			IR_DISPATCH_ENTRY(Vec4Init);
+			IR_DISPATCH_ENTRY(Vec4Shuffle);
+			IR_DISPATCH_ENTRY(Vec4Mov);
+			IR_DISPATCH_ENTRY(Vec4Add);
+			IR_DISPATCH_ENTRY(Vec4Sub);
+			IR_DISPATCH_ENTRY(Vec4Mul);
+			IR_DISPATCH_ENTRY(Vec4Div);
+			IR_DISPATCH_ENTRY(Vec4Scale);
+			IR_DISPATCH_ENTRY(Vec4Neg);
+			IR_DISPATCH_ENTRY(Vec4Abs);
+			IR_DISPATCH_ENTRY(Vec2Unpack16To31);
+			IR_DISPATCH_ENTRY(Vec2Unpack16To32);
+			IR_DISPATCH_ENTRY(Vec4Unpack8To32);
+			IR_DISPATCH_ENTRY(Vec2Pack32To16);
+			IR_DISPATCH_ENTRY(Vec2Pack31To16);
+			IR_DISPATCH_ENTRY(Vec4Pack32To8);
+			IR_DISPATCH_ENTRY(Vec4Pack31To8);
+			IR_DISPATCH_ENTRY(Vec2ClampToZero);
+			IR_DISPATCH_ENTRY(Vec4ClampToZero);
+			IR_DISPATCH_ENTRY(Vec4DuplicateUpperBitsAndShift1);
+			IR_DISPATCH_ENTRY(FCmpVfpuBit);
+			IR_DISPATCH_ENTRY(FCmpVfpuAggregate);
+			IR_DISPATCH_ENTRY(FCmovVfpuCC);
+			IR_DISPATCH_ENTRY(Vec4Dot);
+			IR_DISPATCH_ENTRY(FSin);
+			IR_DISPATCH_ENTRY(FCos);
+			IR_DISPATCH_ENTRY(FRSqrt);
+			IR_DISPATCH_ENTRY(FRecip);
+			IR_DISPATCH_ENTRY(FAsin);
+			IR_DISPATCH_ENTRY(ShlImm);
+			IR_DISPATCH_ENTRY(ShrImm);
+			IR_DISPATCH_ENTRY(SarImm);
+			IR_DISPATCH_ENTRY(RorImm);
+			IR_DISPATCH_ENTRY(Shl);
+			IR_DISPATCH_ENTRY(Shr);
+			IR_DISPATCH_ENTRY(Sar);
+			IR_DISPATCH_ENTRY(Ror);
+			IR_DISPATCH_ENTRY(Clz);
+			IR_DISPATCH_ENTRY(Slt);
+			IR_DISPATCH_ENTRY(SltU);
+			IR_DISPATCH_ENTRY(SltConst);
+			IR_DISPATCH_ENTRY(SltUConst);
+			IR_DISPATCH_ENTRY(MovZ);
+			IR_DISPATCH_ENTRY(MovNZ);
+			IR_DISPATCH_ENTRY(Max);
+			IR_DISPATCH_ENTRY(Min);
+			IR_DISPATCH_ENTRY(MtLo);
+			IR_DISPATCH_ENTRY(MtHi);
+			IR_DISPATCH_ENTRY(MfLo);
+			IR_DISPATCH_ENTRY(MfHi);
+			IR_DISPATCH_ENTRY(Mult);
+			IR_DISPATCH_ENTRY(MultU);
+			IR_DISPATCH_ENTRY(Madd);
+			IR_DISPATCH_ENTRY(MaddU);
+			IR_DISPATCH_ENTRY(Msub);
+			IR_DISPATCH_ENTRY(MsubU);
+			IR_DISPATCH_ENTRY(Div);
+			IR_DISPATCH_ENTRY(DivU);
+			IR_DISPATCH_ENTRY(BSwap16);
+			IR_DISPATCH_ENTRY(BSwap32);
+			IR_DISPATCH_ENTRY(FAdd);
+			IR_DISPATCH_ENTRY(FSub);
+			IR_DISPATCH_ENTRY(FMul);
+			IR_DISPATCH_ENTRY(FDiv);
+			IR_DISPATCH_ENTRY(FMin);
+			IR_DISPATCH_ENTRY(FMax);
+			IR_DISPATCH_ENTRY(FMov);
+			IR_DISPATCH_ENTRY(FAbs);
+			IR_DISPATCH_ENTRY(FSqrt);
+			IR_DISPATCH_ENTRY(FNeg);
+			IR_DISPATCH_ENTRY(FSat0_1);
+			IR_DISPATCH_ENTRY(FSatMinus1_1);
+			IR_DISPATCH_ENTRY(FSign);
+			IR_DISPATCH_ENTRY(FpCondToReg);
+			IR_DISPATCH_ENTRY(VfpuCtrlToReg);
+			IR_DISPATCH_ENTRY(FRound);
+			IR_DISPATCH_ENTRY(FTrunc);
+			IR_DISPATCH_ENTRY(FCeil);
+			IR_DISPATCH_ENTRY(FFloor);
+			IR_DISPATCH_ENTRY(FCmp);
+			IR_DISPATCH_ENTRY(FCvtSW);
+			IR_DISPATCH_ENTRY(FCvtWS);
+			IR_DISPATCH_ENTRY(ZeroFpCond);
+			IR_DISPATCH_ENTRY(FMovFromGPR);
+			IR_DISPATCH_ENTRY(FMovToGPR);
+			IR_DISPATCH_ENTRY(ExitToConst);
+			IR_DISPATCH_ENTRY(ExitToReg);
+			IR_DISPATCH_ENTRY(ExitToConstIfEq);
+			IR_DISPATCH_ENTRY(ExitToConstIfNeq);
+			IR_DISPATCH_ENTRY(ExitToConstIfGtZ);
+			IR_DISPATCH_ENTRY(ExitToConstIfGeZ);
+			IR_DISPATCH_ENTRY(ExitToConstIfLtZ);
+			IR_DISPATCH_ENTRY(ExitToConstIfLeZ);
+			IR_DISPATCH_ENTRY(Downcount);
+			IR_DISPATCH_ENTRY(SetPC);
+			IR_DISPATCH_ENTRY(SetPCConst);
+			IR_DISPATCH_ENTRY(Syscall);
+			IR_DISPATCH_ENTRY(ExitToPC);
+			IR_DISPATCH_ENTRY(Interpret);
+			IR_DISPATCH_ENTRY(CallReplacement);
+			IR_DISPATCH_ENTRY(Break);
+			IR_DISPATCH_ENTRY(SetCtrlVFPU);
+			IR_DISPATCH_ENTRY(SetCtrlVFPUReg);
+			IR_DISPATCH_ENTRY(SetCtrlVFPUFReg);
+			IR_DISPATCH_ENTRY(Breakpoint);
+			IR_DISPATCH_ENTRY(MemoryCheck);
+		}
+		if (inst == end)
+			goto badBlock;
+		goto *dispatchTable[(int)inst->op];
+	}
+#endif
+
+nextBlock:
 	while (inst != end) {
 		switch (inst->op) {
-		case IROp::Nop:
+		IR_CASE(Nop)
 			_assert_(false);
-			break;
-		case IROp::SetConst:
+			IR_NEXT();
+		IR_CASE(SetConst)
 			mips->r[inst->dest] = inst->constant;
-			break;
-		case IROp::SetConstF:
+			IR_NEXT();
+		IR_CASE(SetConstF)
 			memcpy(&mips->f[inst->dest], &inst->constant, 4);
-			break;
-		case IROp::Add:
+			IR_NEXT();
+		IR_CASE(Add)
 			mips->r[inst->dest] = mips->r[inst->src1] + mips->r[inst->src2];
-			break;
-		case IROp::Sub:
+			IR_NEXT();
+		IR_CASE(Sub)
 			mips->r[inst->dest] = mips->r[inst->src1] - mips->r[inst->src2];
-			break;
-		case IROp::And:
+			IR_NEXT();
+		IR_CASE(And)
 			mips->r[inst->dest] = mips->r[inst->src1] & mips->r[inst->src2];
-			break;
-		case IROp::Or:
+			IR_NEXT();
+		IR_CASE(Or)
 			mips->r[inst->dest] = mips->r[inst->src1] | mips->r[inst->src2];
-			break;
-		case IROp::Xor:
+			IR_NEXT();
+		IR_CASE(Xor)
 			mips->r[inst->dest] = mips->r[inst->src1] ^ mips->r[inst->src2];
-			break;
-		case IROp::Mov:
+			IR_NEXT();
+		IR_CASE(Mov)
 			mips->r[inst->dest] = mips->r[inst->src1];
-			break;
-		case IROp::AddConst:
+			IR_NEXT();
+		IR_CASE(AddConst)
 			mips->r[inst->dest] = mips->r[inst->src1] + inst->constant;
-			break;
-		case IROp::SubConst:
+			IR_NEXT();
+		IR_CASE(SubConst)
 			mips->r[inst->dest] = mips->r[inst->src1] - inst->constant;
-			break;
-		case IROp::AndConst:
+			IR_NEXT();
+		IR_CASE(AndConst)
 			mips->r[inst->dest] = mips->r[inst->src1] & inst->constant;
-			break;
-		case IROp::OrConst:
+			IR_NEXT();
+		IR_CASE(OrConst)
 			mips->r[inst->dest] = mips->r[inst->src1] | inst->constant;
-			break;
-		case IROp::XorConst:
+			IR_NEXT();
+		IR_CASE(XorConst)
 			mips->r[inst->dest] = mips->r[inst->src1] ^ inst->constant;
-			break;
-		case IROp::Neg:
+			IR_NEXT();
+		IR_CASE(Neg)
 			mips->r[inst->dest] = -(s32)mips->r[inst->src1];
-			break;
-		case IROp::Not:
+			IR_NEXT();
+		IR_CASE(Not)
 			mips->r[inst->dest] = ~mips->r[inst->src1];
-			break;
-		case IROp::Ext8to32:
+			IR_NEXT();
+		IR_CASE(Ext8to32)
 			mips->r[inst->dest] = (s32)(s8)mips->r[inst->src1];
-			break;
-		case IROp::Ext16to32:
+			IR_NEXT();
+		IR_CASE(Ext16to32)
 			mips->r[inst->dest] = (s32)(s16)mips->r[inst->src1];
-			break;
-		case IROp::ReverseBits:
+			IR_NEXT();
+		IR_CASE(ReverseBits)
 			mips->r[inst->dest] = ReverseBits32(mips->r[inst->src1]);
-			break;
+			IR_NEXT();
 
-		case IROp::Load8:
+		IR_CASE(Load8)
 			mips->r[inst->dest] = Memory::ReadUnchecked_U8(mips->r[inst->src1] + inst->constant);
-			break;
-		case IROp::Load8Ext:
+			IR_NEXT();
+		IR_CASE(Load8Ext)
 			mips->r[inst->dest] = (s32)(s8)Memory::ReadUnchecked_U8(mips->r[inst->src1] + inst->constant);
-			break;
-		case IROp::Load16:
+			IR_NEXT();
+		IR_CASE(Load16)
 			mips->r[inst->dest] = Memory::ReadUnchecked_U16(mips->r[inst->src1] + inst->constant);
-			break;
-		case IROp::Load16Ext:
+			IR_NEXT();
+		IR_CASE(Load16Ext)
 			mips->r[inst->dest] = (s32)(s16)Memory::ReadUnchecked_U16(mips->r[inst->src1] + inst->constant);
-			break;
-		case IROp::Load32:
+			IR_NEXT();
+		IR_CASE(Load32)
 			mips->r[inst->dest] = Memory::ReadUnchecked_U32(mips->r[inst->src1] + inst->constant);
-			break;
-		case IROp::Load32Left:
+			IR_NEXT();
+		IR_CASE(Load32Left)
 		{
 			u32 addr = mips->r[inst->src1] + inst->constant;
 			u32 shift = (addr & 3) * 8;
 			u32 mem = Memory::ReadUnchecked_U32(addr & 0xfffffffc);
 			u32 destMask = 0x00ffffff >> shift;
 			mips->r[inst->dest] = (mips->r[inst->dest] & destMask) | (mem << (24 - shift));
-			break;
+			IR_NEXT();
 		}
-		case IROp::Load32Right:
+		IR_CASE(Load32Right)
 		{
 			u32 addr = mips->r[inst->src1] + inst->constant;
 			u32 shift = (addr & 3) * 8;
 			u32 mem = Memory::ReadUnchecked_U32(addr & 0xfffffffc);
 			u32 destMask = 0xffffff00 << (24 - shift);
 			mips->r[inst->dest] = (mips->r[inst->dest] & destMask) | (mem >> shift);
-			break;
+			IR_NEXT();
 		}
-		case IROp::LoadFloat:
+		IR_CASE(LoadFloat)
 			mips->f[inst->dest] = Memory::ReadUnchecked_Float(mips->r[inst->src1] + inst->constant);
-			break;
+			IR_NEXT();
 
-		case IROp::Store8:
+		IR_CASE(Store8)
 			Memory::WriteUnchecked_U8(mips->r[inst->src3], mips->r[inst->src1] + inst->constant);
-			break;
-		case IROp::Store16:
+			IR_NEXT();
+		IR_CASE(Store16)
 			Memory::WriteUnchecked_U16(mips->r[inst->src3], mips->r[inst->src1] + inst->constant);
-			break;
-		case IROp::Store32:
+			IR_NEXT();
+		IR_CASE(Store32)
 			Memory::WriteUnchecked_U32(mips->r[inst->src3], mips->r[inst->src1] + inst->constant);
-			break;
-		case IROp::Store32Left:
+			IR_NEXT();
+		IR_CASE(Store32Left)
 		{
 			u32 addr = mips->r[inst->src1] + inst->constant;
 			u32 shift = (addr & 3) * 8;
@@ -184,9 +380,9 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			u32 memMask = 0xffffff00 << shift;
 			u32 result = (mips->r[inst->src3] >> (24 - shift)) | (mem & memMask);
 			Memory::WriteUnchecked_U32(result, addr & 0xfffffffc);
-			break;
+			IR_NEXT();
 		}
-		case IROp::Store32Right:
+		IR_CASE(Store32Right)
 		{
 			u32 addr = mips->r[inst->src1] + inst->constant;
 			u32 shift = (addr & 3) * 8;
@@ -194,13 +390,13 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			u32 memMask = 0x00ffffff >> (24 - shift);
 			u32 result = (mips->r[inst->src3] << shift) | (mem & memMask);
 			Memory::WriteUnchecked_U32(result, addr & 0xfffffffc);
-			break;
+			IR_NEXT();
 		}
-		case IROp::StoreFloat:
+		IR_CASE(StoreFloat)
 			Memory::WriteUnchecked_Float(mips->f[inst->src3], mips->r[inst->src1] + inst->constant);
-			break;
+			IR_NEXT();
 
-		case IROp::LoadVec4:
+		IR_CASE(LoadVec4)
 		{
 			u32 base = mips->r[inst->src1] + inst->constant;
 #if defined(_M_SSE)
@@ -209,9 +405,9 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			for (int i = 0; i < 4; i++)
 				mips->f[inst->dest + i] = Memory::ReadUnchecked_Float(base + 4 * i);
 #endif
-			break;
+			IR_NEXT();
 		}
-		case IROp::StoreVec4:
+		IR_CASE(StoreVec4)
 		{
 			u32 base = mips->r[inst->src1] + inst->constant;
 #if defined(_M_SSE)
@@ -220,29 +416,29 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			for (int i = 0; i < 4; i++)
 				Memory::WriteUnchecked_Float(mips->f[inst->dest + i], base + 4 * i);
 #endif
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4Init:
+		IR_CASE(Vec4Init)
 		{
 #if defined(_M_SSE)
 			_mm_store_ps(&mips->f[inst->dest], _mm_load_ps(vec4InitValues[inst->src1]));
 #else
 			memcpy(&mips->f[inst->dest], vec4InitValues[inst->src1], 4 * sizeof(float));
 #endif
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4Shuffle:
+		IR_CASE(Vec4Shuffle)
 		{
 			// Can't use the SSE shuffle here because it takes an immediate. pshufb with a table would work though,
 			// or a big switch - there are only 256 shuffles possible (4^4)
 			for (int i = 0; i < 4; i++)
 				mips->f[inst->dest + i] = mips->f[inst->src1 + ((inst->src2 >> (i * 2)) & 3)];
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4Mov:
+		IR_CASE(Vec4Mov)
 		{
 #if defined(_M_SSE)
 			_mm_store_ps(&mips->f[inst->dest], _mm_load_ps(&mips->f[inst->src1]));
@@ -251,10 +447,10 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 #else
 			memcpy(&mips->f[inst->dest], &mips->f[inst->src1], 4 * sizeof(float));
 #endif
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4Add:
+		IR_CASE(Vec4Add)
 		{
 #if defined(_M_SSE)
 			_mm_store_ps(&mips->f[inst->dest], _mm_add_ps(_mm_load_ps(&mips->f[inst->src1]), _mm_load_ps(&mips->f[inst->src2])));
@@ -264,10 +460,10 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			for (int i = 0; i < 4; i++)
 				mips->f[inst->dest + i] = mips->f[inst->src1 + i] + mips->f[inst->src2 + i];
 #endif
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4Sub:
+		IR_CASE(Vec4Sub)
 		{
 #if defined(_M_SSE)
 			_mm_store_ps(&mips->f[inst->dest], _mm_sub_ps(_mm_load_ps(&mips->f[inst->src1]), _mm_load_ps(&mips->f[inst->src2])));
@@ -277,10 +473,10 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			for (int i = 0; i < 4; i++)
 				mips->f[inst->dest + i] = mips->f[inst->src1 + i] - mips->f[inst->src2 + i];
 #endif
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4Mul:
+		IR_CASE(Vec4Mul)
 		{
 #if defined(_M_SSE)
 			_mm_store_ps(&mips->f[inst->dest], _mm_mul_ps(_mm_load_ps(&mips->f[inst->src1]), _mm_load_ps(&mips->f[inst->src2])));
@@ -290,10 +486,10 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			for (int i = 0; i < 4; i++)
 				mips->f[inst->dest + i] = mips->f[inst->src1 + i] * mips->f[inst->src2 + i];
 #endif
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4Div:
+		IR_CASE(Vec4Div)
 		{
 #if defined(_M_SSE)
 			_mm_store_ps(&mips->f[inst->dest], _mm_div_ps(_mm_load_ps(&mips->f[inst->src1]), _mm_load_ps(&mips->f[inst->src2])));
@@ -301,10 +497,10 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			for (int i = 0; i < 4; i++)
 				mips->f[inst->dest + i] = mips->f[inst->src1 + i] / mips->f[inst->src2 + i];
 #endif
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4Scale:
+		IR_CASE(Vec4Scale)
 		{
 #if defined(_M_SSE)
 			_mm_store_ps(&mips->f[inst->dest], _mm_mul_ps(_mm_load_ps(&mips->f[inst->src1]), _mm_set1_ps(mips->f[inst->src2])));
@@ -312,10 +508,10 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			for (int i = 0; i < 4; i++)
 				mips->f[inst->dest + i] = mips->f[inst->src1 + i] * mips->f[inst->src2];
 #endif
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4Neg:
+		IR_CASE(Vec4Neg)
 		{
 #if defined(_M_SSE)
 			_mm_store_ps(&mips->f[inst->dest], _mm_xor_ps(_mm_load_ps(&mips->f[inst->src1]), _mm_load_ps((const float *)signBits)));
@@ -325,10 +521,10 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			for (int i = 0; i < 4; i++)
 				mips->f[inst->dest + i] = -mips->f[inst->src1 + i];
 #endif
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4Abs:
+		IR_CASE(Vec4Abs)
 		{
 #if defined(_M_SSE)
 			_mm_store_ps(&mips->f[inst->dest], _mm_and_ps(_mm_load_ps(&mips->f[inst->src1]), _mm_load_ps((const float *)noSignMask)));
@@ -338,24 +534,24 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			for (int i = 0; i < 4; i++)
 				mips->f[inst->dest + i] = fabsf(mips->f[inst->src1 + i]);
 #endif
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec2Unpack16To31:
+		IR_CASE(Vec2Unpack16To31)
 		{
 			mips->fi[inst->dest] = (mips->fi[inst->src1] << 16) >> 1;
 			mips->fi[inst->dest + 1] = (mips->fi[inst->src1] & 0xFFFF0000) >> 1;
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec2Unpack16To32:
+		IR_CASE(Vec2Unpack16To32)
 		{
 			mips->fi[inst->dest] = (mips->fi[inst->src1] << 16);
 			mips->fi[inst->dest + 1] = (mips->fi[inst->src1] & 0xFFFF0000);
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4Unpack8To32:
+		IR_CASE(Vec4Unpack8To32)
 		{
 #if defined(_M_SSE)
 			__m128i src = _mm_cvtsi32_si128(mips->fi[inst->src1]);
@@ -368,25 +564,25 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			mips->fi[inst->dest + 2] = (mips->fi[inst->src1] << 8) & 0xFF000000;
 			mips->fi[inst->dest + 3] = (mips->fi[inst->src1]) & 0xFF000000;
 #endif
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec2Pack32To16:
+		IR_CASE(Vec2Pack32To16)
 		{
 			u32 val = mips->fi[inst->src1] >> 16;
 			mips->fi[inst->dest] = (mips->fi[inst->src1 + 1] & 0xFFFF0000) | val;
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec2Pack31To16:
+		IR_CASE(Vec2Pack31To16)
 		{
 			u32 val = (mips->fi[inst->src1] >> 15) & 0xFFFF;
 			val |= (mips->fi[inst->src1 + 1] << 1) & 0xFFFF0000;
 			mips->fi[inst->dest] = val;
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4Pack32To8:
+		IR_CASE(Vec4Pack32To8)
 		{
 			// Removed previous SSE code due to the need for unsigned 16-bit pack, which I'm too lazy to work around the lack of in SSE2.
 			// pshufb or SSE4 instructions can be used instead.
@@ -395,10 +591,10 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			val |= (mips->fi[inst->src1 + 2] >> 8) & 0xFF0000;
 			val |= (mips->fi[inst->src1 + 3]) & 0xFF000000;
 			mips->fi[inst->dest] = val;
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4Pack31To8:
+		IR_CASE(Vec4Pack31To8)
 		{
 			// Removed previous SSE code due to the need for unsigned 16-bit pack, which I'm too lazy to work around the lack of in SSE2.
 			// pshufb or SSE4 instructions can be used instead.
@@ -407,19 +603,19 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			val |= (mips->fi[inst->src1 + 2] >> 7) & 0xFF0000;
 			val |= (mips->fi[inst->src1 + 3] << 1) & 0xFF000000;
 			mips->fi[inst->dest] = val;
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec2ClampToZero:
+		IR_CASE(Vec2ClampToZero)
 		{
 			for (int i = 0; i < 2; i++) {
 				u32 val = mips->fi[inst->src1 + i];
 				mips->fi[inst->dest + i] = (int)val >= 0 ? val : 0;
 			}
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4ClampToZero:
+		IR_CASE(Vec4ClampToZero)
 		{
 #if defined(_M_SSE)
 			// Trickery: Expand the sign bit, and use andnot to zero negative values.
@@ -433,10 +629,10 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 				mips->fi[inst->dest + i] = (int)val >= 0 ? val : 0;
 			}
 #endif
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Vec4DuplicateUpperBitsAndShift1:  // For vuc2i, the weird one.
+		IR_CASE(Vec4DuplicateUpperBitsAndShift1)  // For vuc2i, the weird one.
 		{
 			for (int i = 0; i < 4; i++) {
 				u32 val = mips->fi[inst->src1 + i];
@@ -445,10 +641,10 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 				val >>= 1;
 				mips->fi[inst->dest + i] = val;
 			}
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::FCmpVfpuBit:
+		IR_CASE(FCmpVfpuBit)
 		{
 			int op = inst->dest & 0xF;
 			int bit = inst->dest >> 4;
@@ -478,86 +674,86 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			} else {
 				mips->vfpuCtrl[VFPU_CTRL_CC] &= ~(1 << bit);
 			}
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::FCmpVfpuAggregate:
+		IR_CASE(FCmpVfpuAggregate)
 		{
 			u32 mask = inst->dest;
 			u32 cc = mips->vfpuCtrl[VFPU_CTRL_CC];
 			int anyBit = (cc & mask) ? 0x10 : 0x00;
 			int allBit = (cc & mask) == mask ? 0x20 : 0x00;
 			mips->vfpuCtrl[VFPU_CTRL_CC] = (cc & ~0x30) | anyBit | allBit;
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::FCmovVfpuCC:
+		IR_CASE(FCmovVfpuCC)
 			if (((mips->vfpuCtrl[VFPU_CTRL_CC] >> (inst->src2 & 0xf)) & 1) == ((u32)inst->src2 >> 7)) {
 				mips->f[inst->dest] = mips->f[inst->src1];
 			}
-			break;
+			IR_NEXT();
 
 		// Not quickly implementable on all platforms, unfortunately.
-		case IROp::Vec4Dot:
+		IR_CASE(Vec4Dot)
 		{
 			float dot = mips->f[inst->src1] * mips->f[inst->src2];
 			for (int i = 1; i < 4; i++)
 				dot += mips->f[inst->src1 + i] * mips->f[inst->src2 + i];
 			mips->f[inst->dest] = dot;
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::FSin:
+		IR_CASE(FSin)
 			mips->f[inst->dest] = vfpu_sin(mips->f[inst->src1]);
-			break;
-		case IROp::FCos:
+			IR_NEXT();
+		IR_CASE(FCos)
 			mips->f[inst->dest] = vfpu_cos(mips->f[inst->src1]);
-			break;
-		case IROp::FRSqrt:
+			IR_NEXT();
+		IR_CASE(FRSqrt)
 			mips->f[inst->dest] = 1.0f / sqrtf(mips->f[inst->src1]);
-			break;
-		case IROp::FRecip:
+			IR_NEXT();
+		IR_CASE(FRecip)
 			mips->f[inst->dest] = 1.0f / mips->f[inst->src1];
-			break;
-		case IROp::FAsin:
+			IR_NEXT();
+		IR_CASE(FAsin)
 			mips->f[inst->dest] = vfpu_asin(mips->f[inst->src1]);
-			break;
+			IR_NEXT();
 
-		case IROp::ShlImm:
+		IR_CASE(ShlImm)
 			mips->r[inst->dest] = mips->r[inst->src1] << (int)inst->src2;
-			break;
-		case IROp::ShrImm:
+			IR_NEXT();
+		IR_CASE(ShrImm)
 			mips->r[inst->dest] = mips->r[inst->src1] >> (int)inst->src2;
-			break;
-		case IROp::SarImm:
+			IR_NEXT();
+		IR_CASE(SarImm)
 			mips->r[inst->dest] = (s32)mips->r[inst->src1] >> (int)inst->src2;
-			break;
-		case IROp::RorImm:
+			IR_NEXT();
+		IR_CASE(RorImm)
 		{
 			u32 x = mips->r[inst->src1];
 			int sa = inst->src2;
 			mips->r[inst->dest] = (x >> sa) | (x << (32 - sa));
 		}
-		break;
+		IR_NEXT();
 
-		case IROp::Shl:
+		IR_CASE(Shl)
 			mips->r[inst->dest] = mips->r[inst->src1] << (mips->r[inst->src2] & 31);
-			break;
-		case IROp::Shr:
+			IR_NEXT();
+		IR_CASE(Shr)
 			mips->r[inst->dest] = mips->r[inst->src1] >> (mips->r[inst->src2] & 31);
-			break;
-		case IROp::Sar:
+			IR_NEXT();
+		IR_CASE(Sar)
 			mips->r[inst->dest] = (s32)mips->r[inst->src1] >> (mips->r[inst->src2] & 31);
-			break;
-		case IROp::Ror:
+			IR_NEXT();
+		IR_CASE(Ror)
 		{
 			u32 x = mips->r[inst->src1];
 			int sa = mips->r[inst->src2] & 31;
 			mips->r[inst->dest] = (x >> sa) | (x << (32 - sa));
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Clz:
+		IR_CASE(Clz)
 		{
 			int x = 31;
 			int count = 0;
@@ -567,100 +763,100 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 				x--;
 			}
 			mips->r[inst->dest] = count;
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Slt:
+		IR_CASE(Slt)
 			mips->r[inst->dest] = (s32)mips->r[inst->src1] < (s32)mips->r[inst->src2];
-			break;
+			IR_NEXT();
 
-		case IROp::SltU:
+		IR_CASE(SltU)
 			mips->r[inst->dest] = mips->r[inst->src1] < mips->r[inst->src2];
-			break;
+			IR_NEXT();
 
-		case IROp::SltConst:
+		IR_CASE(SltConst)
 			mips->r[inst->dest] = (s32)mips->r[inst->src1] < (s32)inst->constant;
-			break;
+			IR_NEXT();
 
-		case IROp::SltUConst:
+		IR_CASE(SltUConst)
 			mips->r[inst->dest] = mips->r[inst->src1] < inst->constant;
-			break;
+			IR_NEXT();
 
-		case IROp::MovZ:
+		IR_CASE(MovZ)
 			if (mips->r[inst->src1] == 0)
 				mips->r[inst->dest] = mips->r[inst->src2];
-			break;
-		case IROp::MovNZ:
+			IR_NEXT();
+		IR_CASE(MovNZ)
 			if (mips->r[inst->src1] != 0)
 				mips->r[inst->dest] = mips->r[inst->src2];
-			break;
+			IR_NEXT();
 
-		case IROp::Max:
+		IR_CASE(Max)
 			mips->r[inst->dest] = (s32)mips->r[inst->src1] > (s32)mips->r[inst->src2] ? mips->r[inst->src1] : mips->r[inst->src2];
-			break;
-		case IROp::Min:
+			IR_NEXT();
+		IR_CASE(Min)
 			mips->r[inst->dest] = (s32)mips->r[inst->src1] < (s32)mips->r[inst->src2] ? mips->r[inst->src1] : mips->r[inst->src2];
-			break;
+			IR_NEXT();
 
-		case IROp::MtLo:
+		IR_CASE(MtLo)
 			mips->lo = mips->r[inst->src1];
-			break;
-		case IROp::MtHi:
+			IR_NEXT();
+		IR_CASE(MtHi)
 			mips->hi = mips->r[inst->src1];
-			break;
-		case IROp::MfLo:
+			IR_NEXT();
+		IR_CASE(MfLo)
 			mips->r[inst->dest] = mips->lo;
-			break;
-		case IROp::MfHi:
+			IR_NEXT();
+		IR_CASE(MfHi)
 			mips->r[inst->dest] = mips->hi;
-			break;
+			IR_NEXT();
 
-		case IROp::Mult:
+		IR_CASE(Mult)
 		{
 			s64 result = (s64)(s32)mips->r[inst->src1] * (s64)(s32)mips->r[inst->src2];
 			memcpy(&mips->lo, &result, 8);
-			break;
+			IR_NEXT();
 		}
-		case IROp::MultU:
+		IR_CASE(MultU)
 		{
 			u64 result = (u64)mips->r[inst->src1] * (u64)mips->r[inst->src2];
 			memcpy(&mips->lo, &result, 8);
-			break;
+			IR_NEXT();
 		}
-		case IROp::Madd:
+		IR_CASE(Madd)
 		{
 			s64 result;
 			memcpy(&result, &mips->lo, 8);
 			result += (s64)(s32)mips->r[inst->src1] * (s64)(s32)mips->r[inst->src2];
 			memcpy(&mips->lo, &result, 8);
-			break;
+			IR_NEXT();
 		}
-		case IROp::MaddU:
+		IR_CASE(MaddU)
 		{
 			s64 result;
 			memcpy(&result, &mips->lo, 8);
 			result += (u64)mips->r[inst->src1] * (u64)mips->r[inst->src2];
 			memcpy(&mips->lo, &result, 8);
-			break;
+			IR_NEXT();
 		}
-		case IROp::Msub:
+		IR_CASE(Msub)
 		{
 			s64 result;
 			memcpy(&result, &mips->lo, 8);
 			result -= (s64)(s32)mips->r[inst->src1] * (s64)(s32)mips->r[inst->src2];
 			memcpy(&mips->lo, &result, 8);
-			break;
+			IR_NEXT();
 		}
-		case IROp::MsubU:
+		IR_CASE(MsubU)
 		{
 			s64 result;
 			memcpy(&result, &mips->lo, 8);
 			result -= (u64)mips->r[inst->src1] * (u64)mips->r[inst->src2];
 			memcpy(&mips->lo, &result, 8);
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Div:
+		IR_CASE(Div)
 		{
 			s32 numerator = (s32)mips->r[inst->src1];
 			s32 denominator = (s32)mips->r[inst->src2];
@@ -674,9 +870,9 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 				mips->lo = numerator < 0 ? 1 : -1;
 				mips->hi = numerator;
 			}
-			break;
+			IR_NEXT();
 		}
-		case IROp::DivU:
+		IR_CASE(DivU)
 		{
 			u32 numerator = mips->r[inst->src1];
 			u32 denominator = mips->r[inst->src2];
@@ -687,63 +883,63 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 				mips->lo = numerator <= 0xFFFF ? 0xFFFF : -1;
 				mips->hi = numerator;
 			}
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::BSwap16:
+		IR_CASE(BSwap16)
 		{
 			u32 x = mips->r[inst->src1];
 			mips->r[inst->dest] = ((x & 0xFF00FF00) >> 8) | ((x & 0x00FF00FF) << 8);
-			break;
+			IR_NEXT();
 		}
-		case IROp::BSwap32:
+		IR_CASE(BSwap32)
 		{
 			u32 x = mips->r[inst->src1];
 			mips->r[inst->dest] = ((x & 0xFF000000) >> 24) | ((x & 0x00FF0000) >> 8) | ((x & 0x0000FF00) << 8) | ((x & 0x000000FF) << 24);
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::FAdd:
+		IR_CASE(FAdd)
 			mips->f[inst->dest] = mips->f[inst->src1] + mips->f[inst->src2];
-			break;
-		case IROp::FSub:
+			IR_NEXT();
+		IR_CASE(FSub)
 			mips->f[inst->dest] = mips->f[inst->src1] - mips->f[inst->src2];
-			break;
-		case IROp::FMul:
+			IR_NEXT();
+		IR_CASE(FMul)
 			mips->f[inst->dest] = mips->f[inst->src1] * mips->f[inst->src2];
-			break;
-		case IROp::FDiv:
+			IR_NEXT();
+		IR_CASE(FDiv)
 			mips->f[inst->dest] = mips->f[inst->src1] / mips->f[inst->src2];
-			break;
-		case IROp::FMin:
+			IR_NEXT();
+		IR_CASE(FMin)
 			mips->f[inst->dest] = std::min(mips->f[inst->src1], mips->f[inst->src2]);
-			break;
-		case IROp::FMax:
+			IR_NEXT();
+		IR_CASE(FMax)
 			mips->f[inst->dest] = std::max(mips->f[inst->src1], mips->f[inst->src2]);
-			break;
+			IR_NEXT();
 
-		case IROp::FMov:
+		IR_CASE(FMov)
 			mips->f[inst->dest] = mips->f[inst->src1];
-			break;
-		case IROp::FAbs:
+			IR_NEXT();
+		IR_CASE(FAbs)
 			mips->f[inst->dest] = fabsf(mips->f[inst->src1]);
-			break;
-		case IROp::FSqrt:
+			IR_NEXT();
+		IR_CASE(FSqrt)
 			mips->f[inst->dest] = sqrtf(mips->f[inst->src1]);
-			break;
-		case IROp::FNeg:
+			IR_NEXT();
+		IR_CASE(FNeg)
 			mips->f[inst->dest] = -mips->f[inst->src1];
-			break;
-		case IROp::FSat0_1:
+			IR_NEXT();
+		IR_CASE(FSat0_1)
 			// We have to do this carefully to handle NAN and -0.0f.
 			mips->f[inst->dest] = vfpu_clamp(mips->f[inst->src1], 0.0f, 1.0f);
-			break;
-		case IROp::FSatMinus1_1:
+			IR_NEXT();
+		IR_CASE(FSatMinus1_1)
 			mips->f[inst->dest] = vfpu_clamp(mips->f[inst->src1], -1.0f, 1.0f);
-			break;
+			IR_NEXT();
 
 		// Bitwise trickery
-		case IROp::FSign:
+		IR_CASE(FSign)
 		{
 			u32 val;
 			memcpy(&val, &mips->f[inst->src1], sizeof(u32));
@@ -753,32 +949,32 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 				mips->f[inst->dest] = 1.0f;
 			else
 				mips->f[inst->dest] = -1.0f;
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::FpCondToReg:
+		IR_CASE(FpCondToReg)
 			mips->r[inst->dest] = mips->fpcond;
-			break;
-		case IROp::VfpuCtrlToReg:
+			IR_NEXT();
+		IR_CASE(VfpuCtrlToReg)
 			mips->r[inst->dest] = mips->vfpuCtrl[inst->src1];
-			break;
-		case IROp::FRound:
+			IR_NEXT();
+		IR_CASE(FRound)
 		{
 			float value = mips->f[inst->src1];
 			if (my_isnanorinf(value)) {
 				mips->fi[inst->dest] = my_isinf(value) && value < 0.0f ? -2147483648LL : 2147483647LL;
-				break;
+				IR_NEXT();
 			} else {
 				mips->fs[inst->dest] = (int)floorf(value + 0.5f);
 			}
-			break;
+			IR_NEXT();
 		}
-		case IROp::FTrunc:
+		IR_CASE(FTrunc)
 		{
 			float value = mips->f[inst->src1];
 			if (my_isnanorinf(value)) {
 				mips->fi[inst->dest] = my_isinf(value) && value < 0.0f ? -2147483648LL : 2147483647LL;
-				break;
+				IR_NEXT();
 			} else {
 				if (value >= 0.0f) {
 					mips->fs[inst->dest] = (int)floorf(value);
@@ -790,32 +986,32 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 					// Overflow happens to be the right value anyway.
 					mips->fs[inst->dest] = (int)ceilf(value);
 				}
-				break;
+				IR_NEXT();
 			}
 		}
-		case IROp::FCeil:
+		IR_CASE(FCeil)
 		{
 			float value = mips->f[inst->src1];
 			if (my_isnanorinf(value)) {
 				mips->fi[inst->dest] = my_isinf(value) && value < 0.0f ? -2147483648LL : 2147483647LL;
-				break;
+				IR_NEXT();
 			} else {
 				mips->fs[inst->dest] = (int)ceilf(value);
 			}
-			break;
+			IR_NEXT();
 		}
-		case IROp::FFloor:
+		IR_CASE(FFloor)
 		{
 			float value = mips->f[inst->src1];
 			if (my_isnanorinf(value)) {
 				mips->fi[inst->dest] = my_isinf(value) && value < 0.0f ? -2147483648LL : 2147483647LL;
-				break;
+				IR_NEXT();
 			} else {
 				mips->fs[inst->dest] = (int)floorf(value);
 			}
-			break;
+			IR_NEXT();
 		}
-		case IROp::FCmp:
+		IR_CASE(FCmp)
 			switch (inst->dest) {
 			case IRFpCompareMode::False:
 				mips->fpcond = 0;
@@ -840,17 +1036,17 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 				mips->fpcond = mips->f[inst->src1] < mips->f[inst->src2];
 				break;
 			}
-			break;
+			IR_NEXT();
 
-		case IROp::FCvtSW:
+		IR_CASE(FCvtSW)
 			mips->f[inst->dest] = (float)mips->fs[inst->src1];
-			break;
-		case IROp::FCvtWS:
+			IR_NEXT();
+		IR_CASE(FCvtWS)
 		{
 			float src = mips->f[inst->src1];
 			if (my_isnanorinf(src)) {
 				mips->fs[inst->dest] = my_isinf(src) && src < 0.0f ? -2147483648LL : 2147483647LL;
-				break;
+				IR_NEXT();
 			}
 			switch (mips->fcr31 & 3) {
 			case 0: mips->fs[inst->dest] = (int)round_ieee_754(src); break;  // RINT_0
@@ -858,126 +1054,129 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			case 2: mips->fs[inst->dest] = (int)ceilf(src); break;  // CEIL_2
 			case 3: mips->fs[inst->dest] = (int)floorf(src); break;  // FLOOR_3
 			}
-			break; //cvt.w.s
+			IR_NEXT(); //cvt.w.s
 		}
 
-		case IROp::ZeroFpCond:
+		IR_CASE(ZeroFpCond)
 			mips->fpcond = 0;
-			break;
+			IR_NEXT();
 
-		case IROp::FMovFromGPR:
+		IR_CASE(FMovFromGPR)
 			memcpy(&mips->f[inst->dest], &mips->r[inst->src1], 4);
-			break;
-		case IROp::FMovToGPR:
+			IR_NEXT();
+		IR_CASE(FMovToGPR)
 			memcpy(&mips->r[inst->dest], &mips->f[inst->src1], 4);
-			break;
+			IR_NEXT();
 
-		case IROp::ExitToConst:
-			return inst->constant;
+		IR_CASE(ExitToConst)
+			IR_EXIT_CONST(inst->constant);
 
-		case IROp::ExitToReg:
+		IR_CASE(ExitToReg)
 			return mips->r[inst->src1];
 
-		case IROp::ExitToConstIfEq:
+		IR_CASE(ExitToConstIfEq)
 			if (mips->r[inst->src1] == mips->r[inst->src2])
-				return inst->constant;
-			break;
-		case IROp::ExitToConstIfNeq:
+				IR_EXIT_CONST(inst->constant);
+			IR_NEXT();
+		IR_CASE(ExitToConstIfNeq)
 			if (mips->r[inst->src1] != mips->r[inst->src2])
-				return inst->constant;
-			break;
-		case IROp::ExitToConstIfGtZ:
+				IR_EXIT_CONST(inst->constant);
+			IR_NEXT();
+		IR_CASE(ExitToConstIfGtZ)
 			if ((s32)mips->r[inst->src1] > 0)
-				return inst->constant;
-			break;
-		case IROp::ExitToConstIfGeZ:
+				IR_EXIT_CONST(inst->constant);
+			IR_NEXT();
+		IR_CASE(ExitToConstIfGeZ)
 			if ((s32)mips->r[inst->src1] >= 0)
-				return inst->constant;
-			break;
-		case IROp::ExitToConstIfLtZ:
+				IR_EXIT_CONST(inst->constant);
+			IR_NEXT();
+		IR_CASE(ExitToConstIfLtZ)
 			if ((s32)mips->r[inst->src1] < 0)
-				return inst->constant;
-			break;
-		case IROp::ExitToConstIfLeZ:
+				IR_EXIT_CONST(inst->constant);
+			IR_NEXT();
+		IR_CASE(ExitToConstIfLeZ)
 			if ((s32)mips->r[inst->src1] <= 0)
-				return inst->constant;
-			break;
+				IR_EXIT_CONST(inst->constant);
+			IR_NEXT();
 
-		case IROp::Downcount:
+		IR_CASE(Downcount)
 			mips->downcount -= inst->constant;
-			break;
+			IR_NEXT();
 
-		case IROp::SetPC:
+		IR_CASE(SetPC)
 			mips->pc = mips->r[inst->src1];
-			break;
+			IR_NEXT();
 
-		case IROp::SetPCConst:
+		IR_CASE(SetPCConst)
 			mips->pc = inst->constant;
-			break;
+			IR_NEXT();
 
-		case IROp::Syscall:
+		IR_CASE(Syscall)
 			// IROp::SetPC was (hopefully) executed before.
 		{
 			MIPSOpcode op(inst->constant);
 			CallSyscall(op);
 			if (coreState != CORE_RUNNING)
 				CoreTiming::ForceCheck();
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::ExitToPC:
+		IR_CASE(ExitToPC)
 			return mips->pc;
 
-		case IROp::Interpret:  // SLOW fallback. Can be made faster. Ideally should be removed but may be useful for debugging.
+		IR_CASE(Interpret)  // SLOW fallback. Can be made faster. Ideally should be removed but may be useful for debugging.
 		{
 			MIPSOpcode op(inst->constant);
 			MIPSInterpret(op);
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::CallReplacement:
+		IR_CASE(CallReplacement)
 		{
 			int funcIndex = inst->constant;
 			const ReplacementTableEntry *f = GetReplacementFunc(funcIndex);
 			int cycles = f->replaceFunc();
 			mips->downcount -= cycles;
-			break;
+			IR_NEXT();
 		}
 
-		case IROp::Break:
+		IR_CASE(Break)
 			if (!g_Config.bIgnoreBadMemAccess) {
 				Core_EnableStepping(true);
 				host->SetDebugMode(true);
 			}
 			return mips->pc + 4;
 
-		case IROp::SetCtrlVFPU:
+		IR_CASE(SetCtrlVFPU)
 			mips->vfpuCtrl[inst->dest] = inst->constant;
-			break;
+			IR_NEXT();
 
-		case IROp::SetCtrlVFPUReg:
+		IR_CASE(SetCtrlVFPUReg)
 			mips->vfpuCtrl[inst->dest] = mips->r[inst->src1];
-			break;
+			IR_NEXT();
 
-		case IROp::SetCtrlVFPUFReg:
+		IR_CASE(SetCtrlVFPUFReg)
 			memcpy(&mips->vfpuCtrl[inst->dest], &mips->f[inst->src1], 4);
-			break;
+			IR_NEXT();
 
-		case IROp::Breakpoint:
+		IR_CASE(Breakpoint)
 			if (RunBreakpoint(mips->pc)) {
 				CoreTiming::ForceCheck();
 				return mips->pc;
 			}
-			break;
+			IR_NEXT();
 
-		case IROp::MemoryCheck:
+		IR_CASE(MemoryCheck)
 			if (RunMemCheck(mips->pc, mips->r[inst->src1] + inst->constant)) {
 				CoreTiming::ForceCheck();
 				return mips->pc;
 			}
-			break;
+			IR_NEXT();
 
 		default:
+#if IR_THREADED_DISPATCH
+		IRLabel_Unknown:
+#endif
 			Crash();
 		}
 #ifdef _DEBUG
@@ -985,9 +1184,59 @@ u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
 			Crash();
 #endif
 		inst++;
+#if IR_THREADED_DISPATCH
+		if (threaded && inst != end)
+			goto *dispatchTable[(int)inst->op];
+#endif
 	}
 
+	if (chained) {
+constExit:
+		int next = chain->blocks->FindLink(chain->block, exitPC);
+		if (next < 0) {
+			chain->unlinkedExit = chain->block;
+			return exitPC;
+		}
+		if (mips->downcount < 0)
+			return exitPC;
+
+		// The dispatcher forms traces, so go back to it when one is due.
+		MIPSComp::IRBlock *block = chain->blocks->GetBlock(next);
+		u32 runs = block->IncrementRunCount();
+		if (runs >= chain->traceThreshold && runs >= block->GetNextTraceRun())
+			return exitPC;
+
+		chain->block = next;
+		inst = block->GetInstructions();
+		end = inst + block->GetNumInstructions();
+		goto nextBlock;
+	}
+
+#if IR_THREADED_DISPATCH
+badBlock:
+#endif
+	// Native code runs single ops this way, and handles the exits itself.
+	if (partial)
+		return 0;
 	// If we got here, the block was badly constructed.
 	Crash();
 	return 0;
 }
+
+u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count) {
+	return IRInterpretImpl<IR_THREADED_DISPATCH != 0, false, false>(mips, inst, count, nullptr);
+}
+
+u32 IRInterpretSwitch(MIPSState *mips, const IRInst *inst, int count) {
+	return IRInterpretImpl<false, false, false>(mips, inst, count, nullptr);
+}
+
+u32 IRInterpretPartial(MIPSState *mips, const IRInst *inst, int count) {
+	return IRInterpretImpl<false, true, false>(mips, inst, count, nullptr);
+}
+
+u32 IRInterpretChained(MIPSState *mips, IRChainState &chain) {
+	const MIPSComp::IRBlock *block = chain.blocks->GetBlock(chain.block);
+	chain.unlinkedExit = -1;
+	return IRInterpretImpl<IR_THREADED_DISPATCH != 0, false, true>(mips, block->GetInstructions(), block->GetNumInstructions(), &chain);
+}
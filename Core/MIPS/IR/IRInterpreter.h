@@ -5,6 +5,21 @@
 class MIPSState;
 struct IRInst;
 
+namespace MIPSComp {
+class IRBlockCache;
+}
+
+// For running blocks that continue straight into the next at linked constant exits.
+struct IRChainState {
+	MIPSComp::IRBlockCache *blocks;
+	// Run counts at which traces may form, which is left to the dispatcher.
+	u32 traceThreshold;
+	// The block running, updated as links are followed.
+	int block;
+	// The block that left through a constant exit that isn't linked yet, or -1.
+	int unlinkedExit;
+};
+
 inline static u32 ReverseBits32(u32 v) {
 	// http://graphics.stanford.edu/~seander/bithacks.html#ReverseParallel
 	// swap odd and even bits
@@ -20,4 +35,11 @@ inline static u32 ReverseBits32(u32 v) {
 	return v;
 }
 
+// Returns the new PC.  Uses threaded dispatch where the compiler supports it.
 u32 IRInterpret(MIPSState *mips, const IRInst *inst, int count);
+// Plain switch dispatch, for comparison.
+u32 IRInterpretSwitch(MIPSState *mips, const IRInst *inst, int count);
+// Runs chain.block and any blocks linked from it, while there's downcount left.
+u32 IRInterpretChained(MIPSState *mips, IRChainState &chain);
+// Runs ops that may not end the block.  Returns 0 if no exit was taken, otherwise the new PC.
+u32 IRInterpretPartial(MIPSState *mips, const IRInst *inst, int count);
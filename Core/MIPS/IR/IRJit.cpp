@@ -15,14 +15,20 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+
 #include "base/logging.h"
+#include "base/timeutil.h"
 #include "ext/xxhash.h"
 #include "profiler/profiler.h"
+#include "thread/threadutil.h"
 #include "Common/ChunkFile.h"
+#include "Common/FileUtil.h"
 #include "Common/StringUtils.h"
 
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
+#include "Core/ELF/ParamSFO.h"
 #include "Core/HLE/sceKernelMemory.h"
 #include "Core/MemMap.h"
 #include "Core/MIPS/MIPS.h"
@@ -35,10 +41,33 @@
 #include "Core/MIPS/IR/IRInterpreter.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/Reporting.h"
+#include "Core/System.h"
 
 namespace MIPSComp {
 
-IRJit::IRJit(MIPSState *mips) : frontend_(mips->HasDefaultPrefix()), mips_(mips) {
+// Most blocks are much shorter than this.  Longer ones are left to compile when first run.
+static const u32 PRELOAD_SNAPSHOT_WORDS = 1024;
+
+static void SnapshotCode(u32 addr, std::vector<u32> &words) {
+	u32 count = PRELOAD_SNAPSHOT_WORDS;
+	while (count > 0 && !Memory::IsValidRange(addr, count * 4))
+		count /= 2;
+	words.resize(count);
+	for (u32 i = 0; i < count; ++i)
+		words[i] = Memory::ReadUnchecked_Instruction(addr + i * 4, false).encoding;
+}
+
+static bool CodeMatchesSnapshot(u32 addr, u32 size, const std::vector<u32> &words) {
+	if (size > words.size() * 4)
+		return false;
+	for (u32 i = 0; i < size / 4; ++i) {
+		if (Memory::ReadUnchecked_Instruction(addr + i * 4, false).encoding != words[i])
+			return false;
+	}
+	return true;
+}
+
+IRJit::IRJit(MIPSState *mips, bool native) : frontend_(mips->HasDefaultPrefix()), preloadFrontend_(mips->HasDefaultPrefix()), preloadResultsPending_(false), mips_(mips) {
 	u32 size = 128 * 1024;
 	// blTrampolines_ = kernelMemory.Alloc(size, true, "trampoline");
 	InitIR();
@@ -46,9 +75,35 @@ IRJit::IRJit(MIPSState *mips) : frontend_(mips->HasDefaultPrefix()), mips_(mips)
 	IROptions opts{};
 	opts.unalignedLoadStore = true;
 	frontend_.SetOptions(opts);
+
+	std::string discID = g_paramSFO.GetDiscID();
+	if (discID.size()) {
+		File::CreateFullPath(GetSysDirectory(DIRECTORY_APP_CACHE));
+		diskCachePath_ = GetSysDirectory(DIRECTORY_APP_CACHE) + "/" + discID + ".ircache";
+		diskCache_.Load(diskCachePath_);
+	}
+
+	profiling_ = g_Config.bJitBlockProfiling;
+
+	if (native) {
+#if PPSSPP_ARCH(AMD64)
+		native_ = new IRToX86(mips);
+		blocks_.SetNativeBackend(native_);
+#else
+		WARN_LOG(JIT, "No native IR backend for this platform, using the IR interpreter");
+#endif
+	}
 }
 
 IRJit::~IRJit() {
+	StopPreloadThread();
+	if (!diskCachePath_.empty()) {
+		NOTICE_LOG(JIT, "IR cache: %s", diskCache_.GetStatsString().c_str());
+		diskCache_.Save(diskCachePath_);
+	}
+	// Restore the original ops, in case another core takes over.
+	blocks_.Clear();
+	delete native_;
 }
 
 void IRJit::DoState(PointerWrap &p) {
@@ -57,15 +112,41 @@ void IRJit::DoState(PointerWrap &p) {
 
 void IRJit::ClearCache() {
 	ILOG("IRJit: Clearing the cache!");
+	std::lock_guard<std::recursive_mutex> guard(compileLock_);
 	blocks_.Clear();
+	if (native_) {
+		native_->ClearCode();
+	}
+
+	// Anything still in flight was compiled with the old state, which may be why we're clearing.
+	std::lock_guard<std::mutex> preloadGuard(preloadLock_);
+	preloadResults_.clear();
+	preloadResultsPending_ = false;
+	preloadGeneration_++;
 }
 
 void IRJit::InvalidateCacheAt(u32 em_address, int length) {
+	std::lock_guard<std::recursive_mutex> guard(compileLock_);
 	blocks_.InvalidateICache(em_address, length);
 }
 
 void IRJit::Compile(u32 em_address) {
 	PROFILE_THIS_SCOPE("jitc");
+	std::lock_guard<std::recursive_mutex> guard(compileLock_);
+
+	if (preloadResultsPending_) {
+		FlushPreloadedBlocks();
+	}
+
+	// We're between blocks, so this is a safe time to move instructions around.
+	if (blocks_.ShouldCompact()) {
+		blocks_.Compact();
+		if (native_) {
+			// The native code points at the old instructions.
+			native_->ClearCode();
+			blocks_.ClearNativeEntries();
+		}
+	}
 
 	if (g_Config.bPreloadFunctions) {
 		// Look to see if we've preloaded this block.
@@ -98,7 +179,23 @@ void IRJit::Compile(u32 em_address) {
 }
 
 bool IRJit::CompileBlock(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload) {
-	frontend_.DoJit(em_address, instructions, mipsBytes, preload);
+	u64 hash = 0;
+	bool cached = false;
+	// The cache is keyed on the flags the block was compiled with, not what it changed them to.
+	const u32 compileFlags = frontend_.GetCompileFlags();
+	if (!diskCachePath_.empty()) {
+		u32 exitFlags;
+		cached = diskCache_.Lookup(em_address, compileFlags, instructions, mipsBytes, hash, exitFlags);
+		if (cached)
+			frontend_.RestoreCompileFlags(exitFlags);
+	}
+	if (!cached) {
+		double st = real_time_now();
+		frontend_.DoJit(em_address, instructions, mipsBytes, preload);
+		if (!diskCachePath_.empty()) {
+			diskCache_.AddCompileTime(real_time_now() - st);
+		}
+	}
 	if (instructions.empty()) {
 		_dbg_assert_(JIT, preload);
 		// We return true when preloading so it doesn't abort.
@@ -112,11 +209,18 @@ bool IRJit::CompileBlock(u32 em_address, std::vector<IRInst> &instructions, u32
 	}
 
 	IRBlock *b = blocks_.GetBlock(block_num);
-	b->SetInstructions(instructions);
+	blocks_.SetBlockInstructions(block_num, instructions);
 	b->SetOriginalSize(mipsBytes);
-	if (preload) {
-		// Hash, then only update page stats, don't link yet.
+	if (cached) {
+		b->SetHash(hash);
+	} else if (preload || !diskCachePath_.empty()) {
 		b->UpdateHash();
+		if (!diskCachePath_.empty()) {
+			diskCache_.Add(em_address, compileFlags, frontend_.GetCompileFlags(), mipsBytes, b->GetHash(), instructions);
+		}
+	}
+	if (preload) {
+		// Only update page stats, don't link yet.
 		blocks_.FinalizeBlock(block_num, true);
 	} else {
 		// Overwrites the first instruction, and also updates stats.
@@ -130,36 +234,83 @@ bool IRJit::CompileBlock(u32 em_address, std::vector<IRInst> &instructions, u32
 void IRJit::CompileFunction(u32 start_address, u32 length) {
 	PROFILE_THIS_SCOPE("jitc");
 
+	if (g_Config.bPreloadFunctionsAsync) {
+		StartPreloadThread();
+		std::lock_guard<std::mutex> guard(preloadLock_);
+		preloadRequests_.push_back(PreloadRequest{ start_address, length });
+		preloadCond_.notify_one();
+		return;
+	}
+
+	std::lock_guard<std::recursive_mutex> guard(compileLock_);
+	std::vector<PreloadedBlock> preloaded;
+	PreloadFunction(frontend_, start_address, length, preloaded, true);
+	AddPreloadedBlocks(preloaded);
+}
+
+void IRJit::PreloadFunction(IRFrontend &frontend, u32 start_address, u32 length, std::vector<PreloadedBlock> &results, bool locked) {
 	// Note: we don't actually write emuhacks yet, so we can validate hashes.
 	// This way, if the game changes the code afterward, we'll catch even without icache invalidation.
 
 	// We may go up and down from branches, so track all block starts done here.
 	std::set<u32> doneAddresses;
 	std::vector<u32> pendingAddresses;
+	std::vector<u32> snapshot;
 	pendingAddresses.push_back(start_address);
 	while (!pendingAddresses.empty()) {
 		u32 em_address = pendingAddresses.back();
 		pendingAddresses.pop_back();
 
+		if (!locked) {
+			compileLock_.lock();
+		}
+
 		// To be safe, also check if a real block is there.  This can be a runtime module load.
 		u32 inst = Memory::ReadUnchecked_U32(em_address);
 		if (MIPS_IS_RUNBLOCK(inst) || doneAddresses.find(em_address) != doneAddresses.end()) {
 			// Already compiled this address.
+			if (!locked) {
+				compileLock_.unlock();
+			}
 			continue;
 		}
 
-		std::vector<IRInst> instructions;
-		u32 mipsBytes;
-		if (!CompileBlock(em_address, instructions, mipsBytes, true)) {
-			// Ran out of block numbers - let's hope there's no more code it needs to run.
-			// Will flush when actually compiling.
-			ERROR_LOG(JIT, "Ran out of block numbers while compiling function");
-			return;
+		PreloadedBlock block;
+		block.em_address = em_address;
+		bool cached = false;
+		const u32 compileFlags = frontend.GetCompileFlags();
+		if (!diskCachePath_.empty()) {
+			u32 exitFlags;
+			cached = diskCache_.Lookup(em_address, compileFlags, block.instructions, block.mipsBytes, block.hash, exitFlags);
+			if (cached)
+				frontend.RestoreCompileFlags(exitFlags);
+		}
+		if (!cached) {
+			// The game keeps running while we preload, so the code could change under DoJit.
+			// Hash after compiling, then make sure nothing changed since before we started.
+			SnapshotCode(em_address, snapshot);
+			frontend.DoJit(em_address, block.instructions, block.mipsBytes, true);
+			if (!block.instructions.empty()) {
+				block.hash = IRBlock::CalculateHash(em_address, block.mipsBytes);
+				if (!CodeMatchesSnapshot(em_address, block.mipsBytes, snapshot)) {
+					// Changed, or too long to check.  It'll be compiled when it's run.
+					block.instructions.clear();
+				} else if (!diskCachePath_.empty()) {
+					diskCache_.Add(em_address, compileFlags, frontend.GetCompileFlags(), block.mipsBytes, block.hash, block.instructions);
+				}
+			}
+		}
+
+		if (!locked) {
+			compileLock_.unlock();
 		}
 
 		doneAddresses.insert(em_address);
+		if (block.instructions.empty()) {
+			continue;
+		}
 
-		for (const IRInst &inst : instructions) {
+		for (const IRInst &inst : block.instructions) {
 			u32 exit = 0;
 
 			switch (inst.op) {
@@ -194,9 +345,98 @@ void IRJit::CompileFunction(u32 start_address, u32 length) {
 		}
 
 		// Also include after the block for jal returns.
+		u32 mipsBytes = block.mipsBytes;
 		if (em_address + mipsBytes < start_address + length) {
 			pendingAddresses.push_back(em_address + mipsBytes);
 		}
+
+		results.push_back(std::move(block));
+	}
+}
+
+void IRJit::AddPreloadedBlocks(std::vector<PreloadedBlock> &preloaded) {
+	for (PreloadedBlock &pb : preloaded) {
+		int block_num = blocks_.AllocateBlock(pb.em_address);
+		if ((block_num & ~MIPS_EMUHACK_VALUE_MASK) != 0) {
+			// Ran out of block numbers - let's hope there's no more code it needs to run.
+			// Will flush when actually compiling.
+			ERROR_LOG(JIT, "Ran out of block numbers while compiling function");
+			return;
+		}
+
+		IRBlock *b = blocks_.GetBlock(block_num);
+		blocks_.SetBlockInstructions(block_num, pb.instructions);
+		b->SetOriginalSize(pb.mipsBytes);
+		b->SetHash(pb.hash);
+		// Only update page stats, don't link yet.  Compile() will check the hash before using it.
+		blocks_.FinalizeBlock(block_num, true);
+	}
+}
+
+void IRJit::FlushPreloadedBlocks() {
+	std::vector<PreloadedBlock> preloaded;
+	{
+		std::lock_guard<std::mutex> guard(preloadLock_);
+		preloaded.swap(preloadResults_);
+		preloadResultsPending_ = false;
+	}
+	AddPreloadedBlocks(preloaded);
+}
+
+void IRJit::StartPreloadThread() {
+	if (preloadThread_.joinable()) {
+		return;
+	}
+	preloadThreadStop_ = false;
+	preloadThread_ = std::thread([this] {
+		PreloadThreadFunc();
+	});
+}
+
+void IRJit::StopPreloadThread() {
+	if (!preloadThread_.joinable()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> guard(preloadLock_);
+		preloadThreadStop_ = true;
+		preloadRequests_.clear();
+		preloadCond_.notify_one();
+	}
+	preloadThread_.join();
+}
+
+void IRJit::PreloadThreadFunc() {
+	setCurrentThreadName("IRPreload");
+
+	std::unique_lock<std::mutex> guard(preloadLock_);
+	while (!preloadThreadStop_) {
+		if (preloadRequests_.empty()) {
+			preloadCond_.wait(guard);
+			continue;
+		}
+
+		PreloadRequest req = preloadRequests_.front();
+		preloadRequests_.pop_front();
+		int generation = preloadGeneration_;
+		guard.unlock();
+
+		std::vector<PreloadedBlock> preloaded;
+		compileLock_.lock();
+		preloadFrontend_.InheritCompileState(frontend_);
+		compileLock_.unlock();
+		PreloadFunction(preloadFrontend_, req.start, req.length, preloaded, false);
+
+		guard.lock();
+		if (generation != preloadGeneration_) {
+			continue;
+		}
+		for (PreloadedBlock &pb : preloaded) {
+			preloadResults_.push_back(std::move(pb));
+		}
+		if (!preloadResults_.empty()) {
+			preloadResultsPending_ = true;
+		}
 	}
 }
 
@@ -205,7 +445,10 @@ void IRJit::RunLoopUntil(u64 globalticks) {
 
 	// ApplyRoundingMode(true);
 	// IR Dispatcher
-	
+
+	// Profiling counts cycles per block, so it can't skip the dispatcher.
+	const bool chaining = !native_ && !profiling_;
+	IRChainState chain{ &blocks_, TRACE_THRESHOLD, -1, -1 };
 	while (true) {
 		// RestoreRoundingMode(true);
 		CoreTiming::Advance();
@@ -218,8 +461,38 @@ void IRJit::RunLoopUntil(u64 globalticks) {
 			u32 opcode = inst & 0xFF000000;
 			if (opcode == MIPS_EMUHACK_OPCODE) {
 				u32 data = inst & 0xFFFFFF;
+				if (chain.unlinkedExit >= 0) {
+					blocks_.LinkExit(chain.unlinkedExit, mips_->pc, data);
+					chain.unlinkedExit = -1;
+				}
 				IRBlock *block = blocks_.GetBlock(data);
-				mips_->pc = IRInterpret(mips_, block->GetInstructions(), block->GetNumInstructions());
+				u32 runs = block->IncrementRunCount();
+				if (runs >= TRACE_THRESHOLD && runs >= block->GetNextTraceRun()) {
+					FormTrace(data);
+					// This might have cleared the cache, if the rounding mode assumptions changed.
+					block = blocks_.GetBlock(data);
+					if (!block)
+						continue;
+				}
+				int startDowncount = mips_->downcount;
+				if (native_) {
+					IRNativeFunc func = block->GetNativeEntry();
+					if (!func) {
+						func = CompileNative(data);
+					}
+					mips_->pc = func(mips_);
+				} else if (chaining) {
+					chain.block = data;
+					mips_->pc = IRInterpretChained(mips_, chain);
+				} else {
+					mips_->pc = IRInterpret(mips_, block->GetInstructions(), block->GetNumInstructions());
+				}
+				if (profiling_) {
+					// Look it up again, the block may have been cleared by a syscall.
+					block = blocks_.GetBlock(data);
+					if (block)
+						block->AddCycles(startDowncount - mips_->downcount);
+				}
 			} else {
 				// RestoreRoundingMode(true);
 				Compile(mips_->pc);
@@ -231,8 +504,107 @@ void IRJit::RunLoopUntil(u64 globalticks) {
 	// RestoreRoundingMode(true);
 }
 
+bool IRJit::FormTrace(int block_num) {
+	std::lock_guard<std::recursive_mutex> guard(compileLock_);
+	IRBlock *head = blocks_.GetBlock(block_num);
+	u32 start, size;
+	head->GetRange(start, size);
+	// Only tried again if this fails below.
+	head->SetNextTraceRun(0xFFFFFFFF);
+
+	auto retryLater = [&] {
+		// The successors might just not be hot yet.  Try again later, but not forever.
+		u32 runs = head->GetRunCount();
+		if (runs < (TRACE_THRESHOLD << MAX_TRACE_RETRIES))
+			head->SetNextTraceRun(runs * 2);
+		return false;
+	};
+
+	// Follow unconditional exits (fall-throughs after branches, j, jal) while the target is also hot.
+	// Backward jumps are fine too, but it all has to fit in a small window, so the trace is still
+	// one range for invalidation.
+	std::vector<u32> chain;
+	chain.push_back(start);
+	u32 lowest = start;
+	u32 highest = start + size;
+	bool closesLoop = false;
+	const IRBlock *cur = head;
+	while (chain.size() < MAX_TRACE_BLOCKS) {
+		int count = cur->GetNumInstructions();
+		if (count == 0)
+			break;
+		const IRInst &exit = cur->GetInstructions()[count - 1];
+		if (exit.op != IROp::ExitToConst)
+			break;
+		u32 next = exit.constant;
+		if (next == start) {
+			// Back to the head, so this is a whole loop and the trace's exit re-enters it.
+			closesLoop = true;
+			break;
+		}
+		if (std::find(chain.begin(), chain.end(), next) != chain.end())
+			break;
+		u32 inst = Memory::ReadUnchecked_U32(next);
+		if (!MIPS_IS_RUNBLOCK(inst))
+			break;
+		const IRBlock *nextBlock = blocks_.GetBlock(inst & MIPS_EMUHACK_VALUE_MASK);
+		if (!nextBlock || nextBlock->GetRunCount() < TRACE_THRESHOLD / 2)
+			break;
+		u32 nextStart, nextSize;
+		nextBlock->GetRange(nextStart, nextSize);
+		if (std::max(highest, nextStart + nextSize) - std::min(lowest, nextStart) > MAX_TRACE_BYTES)
+			break;
+		lowest = std::min(lowest, nextStart);
+		highest = std::max(highest, nextStart + nextSize);
+		chain.push_back(next);
+		cur = nextBlock;
+	}
+
+	if (chain.size() < 2)
+		return retryLater();
+
+	std::vector<IRInst> instructions;
+	u32 endAddress;
+	int merged = frontend_.DoJitTrace(chain, instructions, endAddress);
+	if (frontend_.CheckRounding(start)) {
+		// Like in Compile(), our assumptions are all wrong so it's clean-slate time.
+		ClearCache();
+		return false;
+	}
+	if (merged < 2 || instructions.empty() || instructions.size() > 0xFFFF)
+		return retryLater();
+
+	u32 traceStart = *std::min_element(chain.begin(), chain.begin() + merged);
+	blocks_.ReplaceWithTrace(block_num, instructions, traceStart, endAddress);
+	DEBUG_LOG(JIT, "Formed a trace of %d blocks at %08x (%d IR instructions%s)", merged, start, (int)instructions.size(), closesLoop && merged == (int)chain.size() ? ", loop" : "");
+	return true;
+}
+
+IRNativeFunc IRJit::CompileNative(int block_num) {
+	// Done lazily on first run, so preloaded blocks that never run don't use space.
+	std::lock_guard<std::recursive_mutex> guard(compileLock_);
+	IRBlock *block = blocks_.GetBlock(block_num);
+	const u8 *entry = native_->ConvertIRToNative(block->GetInstructions(), block->GetNumInstructions());
+	if (!entry) {
+		// Out of space.  The IR is still fine, so just start over on the native code.
+		INFO_LOG(JIT, "IR native code space full, clearing");
+		native_->ClearCode();
+		blocks_.ClearNativeEntries();
+		entry = native_->ConvertIRToNative(block->GetInstructions(), block->GetNumInstructions());
+		_assert_msg_(JIT, entry != nullptr, "Block too large for native code space");
+	}
+
+	IRNativeFunc func = (IRNativeFunc)entry;
+	block->SetNativeEntry(func);
+	return func;
+}
+
 bool IRJit::DescribeCodePtr(const u8 *ptr, std::string &name) {
 	// Used in target disassembly viewer.
+	if (native_ && native_->IsInSpace(ptr)) {
+		name = "IRNative";
+		return true;
+	}
 	return false;
 }
 
@@ -255,6 +627,8 @@ void IRBlockCache::Clear() {
 	}
 	blocks_.clear();
 	byPage_.clear();
+	linkedFrom_.clear();
+	arena_.Reset();
 }
 
 void IRBlockCache::InvalidateICache(u32 address, u32 length) {
@@ -271,6 +645,9 @@ void IRBlockCache::InvalidateICache(u32 address, u32 length) {
 			if (blocks_[i].OverlapsRange(address, length)) {
 				// Not removing from the page, hopefully doesn't build up with small recompiles.
 				blocks_[i].Destroy(i);
+				Unlink(i);
+				// Might still be running (if it invalidated itself), so this only counts the space.
+				blocks_[i].ReleaseInstructions(arena_);
 			}
 		}
 	}
@@ -292,11 +669,80 @@ void IRBlockCache::FinalizeBlock(int i, bool preload) {
 	}
 }
 
+void IRBlockCache::LinkExit(int from, u32 pc, int to) {
+	if (from < 0 || from >= (int)blocks_.size() || to < 0 || to >= (int)blocks_.size())
+		return;
+	if (blocks_[from].GetNumInstructions() == 0)
+		return;
+	if (blocks_[from].AddLink(pc, to))
+		linkedFrom_[to].push_back(from);
+}
+
+void IRBlockCache::Unlink(int i) {
+	// Nothing may enter it directly anymore.
+	auto iter = linkedFrom_.find(i);
+	if (iter != linkedFrom_.end()) {
+		for (int from : iter->second)
+			blocks_[from].RemoveLinksTo(i);
+		linkedFrom_.erase(iter);
+	}
+
+	// And it no longer enters others, so drop it from their lists.
+	for (int l = 0; l < IRBlock::MAX_LINKS; ++l) {
+		int to = blocks_[i].GetLink(l);
+		if (to < 0 || to == i)
+			continue;
+		auto toIter = linkedFrom_.find(to);
+		if (toIter != linkedFrom_.end()) {
+			std::vector<int> &sources = toIter->second;
+			sources.erase(std::remove(sources.begin(), sources.end(), i), sources.end());
+		}
+	}
+	blocks_[i].ClearLinks();
+}
+
 u32 IRBlockCache::AddressToPage(u32 addr) const {
 	// Use relatively small pages since basic blocks are typically small.
 	return (addr & 0x3FFFFFFF) >> 10;
 }
 
+void IRBlockCache::ReplaceWithTrace(int i, const std::vector<IRInst> &inst, u32 start, u32 end) {
+	IRBlock &b = blocks_[i];
+	u32 startAddr, oldSize;
+	b.GetRange(startAddr, oldSize);
+
+	arena_.Free(b.GetNumInstructions());
+	b.SetInstructions(arena_, inst);
+	b.SetTraceRange(start, end);
+	b.UpdateHash();
+	b.SetNativeEntry(nullptr);
+
+	// The original block's pages already point to this block.
+	u32 oldStartPage = AddressToPage(startAddr);
+	u32 oldEndPage = AddressToPage(startAddr + oldSize);
+	u32 endPage = AddressToPage(end);
+	for (u32 page = AddressToPage(start); page <= endPage; ++page) {
+		if (page < oldStartPage || page > oldEndPage)
+			byPage_[page].push_back(i);
+	}
+}
+
+void IRBlockCache::Compact() {
+	size_t before = arena_.BytesReserved();
+	IRArena compacted;
+	for (IRBlock &b : blocks_) {
+		b.MoveInstructions(compacted);
+	}
+	arena_.Swap(compacted);
+	INFO_LOG(JIT, "Compacted IR block storage from %d KB to %d KB", (int)(before / 1024), (int)(arena_.BytesReserved() / 1024));
+}
+
+void IRBlockCache::ClearNativeEntries() {
+	for (IRBlock &b : blocks_) {
+		b.SetNativeEntry(nullptr);
+	}
+}
+
 int IRBlockCache::FindPreloadBlock(u32 em_address) {
 	u32 page = AddressToPage(em_address);
 	auto iter = byPage_.find(page);
@@ -372,6 +818,20 @@ JitBlockDebugInfo IRBlockCache::GetBlockDebugInfo(int blockNum) const {
 	return debugInfo;
 }
 
+JitBlockProfileStats IRBlockCache::GetBlockProfileStats(int blockNum) const {
+	const IRBlock &b = blocks_[blockNum];
+	JitBlockProfileStats stats;
+	stats.executions = b.GetRunCount();
+	stats.cycles = b.GetCycles();
+	return stats;
+}
+
+u32 IRBlockCache::GetBlockStartAddress(int blockNum) const {
+	u32 start, size;
+	blocks_[blockNum].GetRange(start, size);
+	return start;
+}
+
 void IRBlockCache::ComputeStats(BlockCacheStats &bcStats) const {
 	double totalBloat = 0.0;
 	double maxBloat = 0.0;
@@ -400,6 +860,14 @@ void IRBlockCache::ComputeStats(BlockCacheStats &bcStats) const {
 	bcStats.minBloat = minBloat;
 	bcStats.maxBloat = maxBloat;
 	bcStats.avgBloat = totalBloat / (double)blocks_.size();
+	bcStats.storageUsed = arena_.BytesUsed() + blocks_.capacity() * sizeof(IRBlock);
+	bcStats.storageReserved = arena_.BytesReserved() + blocks_.capacity() * sizeof(IRBlock);
+	if (native_) {
+		bcStats.nativeOps = native_->NumNativeOps();
+		bcStats.fallbackOps = native_->NumFallbackOps();
+		bcStats.interpretedBlocks = native_->NumInterpretedBlocks();
+		bcStats.interpretedOps = native_->NumInterpretedOps();
+	}
 }
 
 int IRBlockCache::GetBlockNumberFromStartAddress(u32 em_address, bool realBlocksOnly) const {
@@ -424,6 +892,70 @@ int IRBlockCache::GetBlockNumberFromStartAddress(u32 em_address, bool realBlocks
 	return best;
 }
 
+IRArena::~IRArena() {
+	for (Chunk &chunk : chunks_) {
+		delete[] chunk.data;
+	}
+}
+
+IRInst *IRArena::Alloc(size_t count) {
+	while (cur_ < chunks_.size() && pos_ + count > chunks_[cur_].size) {
+		// Doesn't fit, move on (wastes the tail, but blocks are small.)
+		cur_++;
+		pos_ = 0;
+	}
+
+	if (cur_ >= chunks_.size()) {
+		Chunk chunk;
+		chunk.size = count > CHUNK_INSTS ? count : (size_t)CHUNK_INSTS;
+		chunk.data = new IRInst[chunk.size];
+		chunks_.push_back(chunk);
+		reserved_ += chunk.size * sizeof(IRInst);
+		cur_ = chunks_.size() - 1;
+		pos_ = 0;
+	}
+
+	IRInst *result = chunks_[cur_].data + pos_;
+	pos_ += count;
+	used_ += count * sizeof(IRInst);
+	return result;
+}
+
+void IRArena::Reset() {
+	// Keep one chunk around, the rest are likely to be reallocated again anyway but let's not hog memory.
+	for (size_t i = 1; i < chunks_.size(); ++i) {
+		delete[] chunks_[i].data;
+		reserved_ -= chunks_[i].size * sizeof(IRInst);
+	}
+	if (chunks_.size() > 1) {
+		chunks_.resize(1);
+	}
+	cur_ = 0;
+	pos_ = 0;
+	used_ = 0;
+	dead_ = 0;
+}
+
+void IRArena::Swap(IRArena &other) {
+	std::swap(chunks_, other.chunks_);
+	std::swap(cur_, other.cur_);
+	std::swap(pos_, other.pos_);
+	std::swap(used_, other.used_);
+	std::swap(dead_, other.dead_);
+	std::swap(reserved_, other.reserved_);
+}
+
+void IRBlock::MoveInstructions(IRArena &arena) {
+	if (origAddr_ == 0 || numInstructions_ == 0) {
+		instr_ = nullptr;
+		numInstructions_ = 0;
+		return;
+	}
+	IRInst *moved = arena.Alloc(numInstructions_);
+	memcpy(moved, instr_, sizeof(IRInst) * numInstructions_);
+	instr_ = moved;
+}
+
 bool IRBlock::HasOriginalFirstOp() const {
 	return Memory::ReadUnchecked_U32(origAddr_) == origFirstOpcode_.encoding;
 }
@@ -447,6 +979,26 @@ void IRBlock::Finalize(int number) {
 	}
 }
 
+bool IRBlock::AddLink(u32 pc, int block) {
+	if (FindLink(pc) >= 0)
+		return false;
+	for (int i = 0; i < MAX_LINKS; ++i) {
+		if (linkBlock_[i] < 0) {
+			linkPC_[i] = pc;
+			linkBlock_[i] = block;
+			return true;
+		}
+	}
+	return false;
+}
+
+void IRBlock::RemoveLinksTo(int block) {
+	for (int i = 0; i < MAX_LINKS; ++i) {
+		if (linkBlock_[i] == block)
+			linkBlock_[i] = -1;
+	}
+}
+
 void IRBlock::Destroy(int number) {
 	if (origAddr_) {
 		MIPSOpcode opcode = MIPSOpcode(MIPS_EMUHACK_OPCODE | number);
@@ -460,26 +1012,34 @@ void IRBlock::Destroy(int number) {
 
 u64 IRBlock::CalculateHash() const {
 	if (origAddr_) {
-		// This is unfortunate.  In case of emuhacks, we have to make a copy.
-		std::vector<u32> buffer;
-		buffer.resize(origSize_ / 4);
-		size_t pos = 0;
-		for (u32 off = 0; off < origSize_; off += 4) {
-			// Let's actually hash the replacement, if any.
-			MIPSOpcode instr = Memory::ReadUnchecked_Instruction(origAddr_ + off, false);
-			buffer[pos++] = instr.encoding;
-		}
-
-		return XXH64(&buffer[0], origSize_, 0x9A5C33B8);
+		return CalculateHash(origAddr_ - preSize_, preSize_ + origSize_);
 	}
 
 	return 0;
 }
 
+u64 IRBlock::CalculateHash(u32 addr, u32 size) {
+	if (size == 0 || !Memory::IsValidRange(addr, size)) {
+		return 0;
+	}
+
+	// This is unfortunate.  In case of emuhacks, we have to make a copy.
+	std::vector<u32> buffer;
+	buffer.resize(size / 4);
+	size_t pos = 0;
+	for (u32 off = 0; off < size; off += 4) {
+		// Let's actually hash the replacement, if any.
+		MIPSOpcode instr = Memory::ReadUnchecked_Instruction(addr + off, false);
+		buffer[pos++] = instr.encoding;
+	}
+
+	return XXH64(&buffer[0], size, 0x9A5C33B8);
+}
+
 bool IRBlock::OverlapsRange(u32 addr, u32 size) const {
 	addr &= 0x3FFFFFFF;
 	u32 origAddr = origAddr_ & 0x3FFFFFFF;
-	return addr + size > origAddr && addr < origAddr + origSize_;
+	return addr + size > origAddr - preSize_ && addr < origAddr + origSize_;
 }
 
 MIPSOpcode IRJit::GetOriginalOp(MIPSOpcode op) {
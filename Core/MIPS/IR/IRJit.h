@@ -17,7 +17,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
 
 #include "Common/Common.h"
@@ -27,7 +33,9 @@
 #include "Core/MIPS/IR/IRRegCache.h"
 #include "Core/MIPS/IR/IRInst.h"
 #include "Core/MIPS/IR/IRFrontend.h"
+#include "Core/MIPS/IR/IRDiskCache.h"
 #include "Core/MIPS/MIPSVFPUUtils.h"
+#include "Core/MIPS/x86/IRToX86.h"
 
 #ifndef offsetof
 #include "stddef.h"
@@ -35,33 +43,78 @@
 
 namespace MIPSComp {
 
-// TODO : Use arena allocators. For now let's just malloc.
-class IRBlock {
+// Owns the instructions of all the blocks in an IRBlockCache.  Blocks aren't freed
+// individually, so we can just bump allocate.  This also keeps the instructions of blocks
+// compiled together close in memory.  Space of invalidated blocks is only counted, and
+// once most of the arena is dead, the block cache copies the live blocks into a new one.
+class IRArena {
 public:
-	IRBlock() : instr_(nullptr), numInstructions_(0), origAddr_(0), origSize_(0) {}
-	IRBlock(u32 emAddr) : instr_(nullptr), numInstructions_(0), origAddr_(emAddr), origSize_(0) {}
-	IRBlock(IRBlock &&b) {
-		instr_ = b.instr_;
-		numInstructions_ = b.numInstructions_;
-		origAddr_ = b.origAddr_;
-		origSize_ = b.origSize_;
-		origFirstOpcode_ = b.origFirstOpcode_;
-		hash_ = b.hash_;
-		b.instr_ = nullptr;
+	IRArena() {}
+	~IRArena();
+
+	IRInst *Alloc(size_t count);
+	// The instructions of a block that was invalidated or replaced, no longer used.
+	void Free(size_t count) {
+		dead_ += count * sizeof(IRInst);
 	}
+	// Keeps the memory around for reuse.
+	void Reset();
+	void Swap(IRArena &other);
 
-	~IRBlock() {
-		delete[] instr_;
+	bool ShouldCompact() const {
+		return dead_ >= COMPACT_MIN_BYTES && dead_ * 2 > used_;
 	}
 
-	void SetInstructions(const std::vector<IRInst> &inst) {
-		instr_ = new IRInst[inst.size()];
+	size_t BytesUsed() const { return used_ - dead_; }
+	size_t BytesReserved() const { return reserved_; }
+
+private:
+	IRArena(const IRArena &) = delete;
+	void operator =(const IRArena &) = delete;
+
+	// 256 KB per chunk.
+	static const size_t CHUNK_INSTS = 32768;
+	// Copying is cheap, but not worth it for a few small recompiles.
+	static const size_t COMPACT_MIN_BYTES = 1024 * 1024;
+
+	struct Chunk {
+		IRInst *data;
+		size_t size;
+	};
+
+	std::vector<Chunk> chunks_;
+	size_t cur_ = 0;
+	size_t pos_ = 0;
+	size_t used_ = 0;
+	size_t dead_ = 0;
+	size_t reserved_ = 0;
+};
+
+class IRBlock {
+public:
+	IRBlock() : instr_(nullptr), numInstructions_(0), origAddr_(0), origSize_(0) {}
+	IRBlock(u32 emAddr) : instr_(nullptr), numInstructions_(0), origAddr_(emAddr), origSize_(0) {}
+
+	// The instructions are owned by the arena, which must outlive the block.
+	void SetInstructions(IRArena &arena, const std::vector<IRInst> &inst) {
 		numInstructions_ = (u16)inst.size();
 		if (!inst.empty()) {
+			instr_ = arena.Alloc(inst.size());
 			memcpy(instr_, &inst[0], sizeof(IRInst) * inst.size());
+		} else {
+			instr_ = nullptr;
 		}
 	}
 
+	// Hands the instructions back to the arena, for invalidated blocks.
+	void ReleaseInstructions(IRArena &arena) {
+		arena.Free(numInstructions_);
+		instr_ = nullptr;
+		numInstructions_ = 0;
+	}
+	// Copies the instructions into another arena, dropping them if the block was invalidated.
+	void MoveInstructions(IRArena &arena);
+
 	const IRInst *GetInstructions() const { return instr_; }
 	int GetNumInstructions() const { return numInstructions_; }
 	MIPSOpcode GetOriginalFirstOp() const { return origFirstOpcode_; }
@@ -74,6 +127,32 @@ class IRBlock {
 	void UpdateHash() {
 		hash_ = CalculateHash();
 	}
+	void SetHash(u64 hash) {
+		hash_ = hash;
+	}
+	u32 IncrementRunCount() {
+		return ++runCount_;
+	}
+	u32 GetRunCount() const { return runCount_; }
+	// Run count at which to try forming a trace here (again.)  Backs off when it fails.
+	u32 GetNextTraceRun() const { return nextTraceRun_; }
+	void SetNextTraceRun(u32 runs) {
+		nextTraceRun_ = runs;
+	}
+	// Traces can also cover code before their entry, when they jump backward.
+	void SetTraceRange(u32 start, u32 end) {
+		preSize_ = origAddr_ - start;
+		origSize_ = end - origAddr_;
+	}
+	void AddCycles(int cycles) {
+		cycles_ += cycles;
+	}
+	u64 GetCycles() const { return cycles_; }
+	IRNativeFunc GetNativeEntry() const { return nativeEntry_; }
+	void SetNativeEntry(IRNativeFunc entry) {
+		nativeEntry_ = entry;
+	}
+	u64 GetHash() const { return hash_; }
 	bool HashMatches() const {
 		return origAddr_ && hash_ == CalculateHash();
 	}
@@ -84,9 +163,31 @@ class IRBlock {
 		size = origSize_;
 	}
 
+	// The block a constant exit to pc was linked to, or -1.
+	int FindLink(u32 pc) const {
+		for (int i = 0; i < MAX_LINKS; ++i) {
+			if (linkBlock_[i] >= 0 && linkPC_[i] == pc)
+				return linkBlock_[i];
+		}
+		return -1;
+	}
+	// Only fills free slots, so blocks with more exits don't keep relinking.
+	bool AddLink(u32 pc, int block);
+	void RemoveLinksTo(int block);
+	int GetLink(int i) const { return linkBlock_[i]; }
+	void ClearLinks() {
+		for (int i = 0; i < MAX_LINKS; ++i)
+			linkBlock_[i] = -1;
+	}
+
 	void Finalize(int number);
 	void Destroy(int number);
 
+	static u64 CalculateHash(u32 addr, u32 size);
+
+	// Most blocks end in a branch, with one exit each way.
+	static const int MAX_LINKS = 2;
+
 private:
 	u64 CalculateHash() const;
 
@@ -94,13 +195,23 @@ class IRBlock {
 	u16 numInstructions_;
 	u32 origAddr_;
 	u32 origSize_;
+	// Bytes covered before origAddr_, only for traces.
+	u32 preSize_ = 0;
 	u64 hash_ = 0;
+	IRNativeFunc nativeEntry_ = nullptr;
+	u32 runCount_ = 0;
+	u32 nextTraceRun_ = 0;
+	u64 cycles_ = 0;
 	MIPSOpcode origFirstOpcode_ = MIPSOpcode(0x68FFFFFF);
+	u32 linkPC_[MAX_LINKS]{};
+	int linkBlock_[MAX_LINKS]{ -1, -1 };
 };
 
 class IRBlockCache : public JitBlockCacheDebugInterface {
 public:
-	IRBlockCache() {}
+	IRBlockCache() {
+		blocks_.reserve(INITIAL_BLOCK_CAPACITY);
+	}
 	void Clear();
 	void InvalidateICache(u32 address, u32 length);
 	void FinalizeBlock(int i, bool preload = false);
@@ -109,6 +220,11 @@ class IRBlockCache : public JitBlockCacheDebugInterface {
 		blocks_.push_back(IRBlock(emAddr));
 		return (int)blocks_.size() - 1;
 	}
+	void SetBlockInstructions(int i, const std::vector<IRInst> &inst) {
+		blocks_[i].SetInstructions(arena_, inst);
+	}
+	// Replaces a block with a trace that covers more code (from start to end), entered at the same address.
+	void ReplaceWithTrace(int i, const std::vector<IRInst> &inst, u32 start, u32 end);
 	IRBlock *GetBlock(int i) {
 		if (i >= 0 && i < (int)blocks_.size()) {
 			return &blocks_[i];
@@ -117,25 +233,56 @@ class IRBlockCache : public JitBlockCacheDebugInterface {
 		}
 	}
 
+	// Lets the interpreter go straight from block from to block to, when from exits to pc
+	// through a constant exit.  Undone when either block is invalidated.
+	void LinkExit(int from, u32 pc, int to);
+	int FindLink(int from, u32 pc) const {
+		if (from < 0 || from >= (int)blocks_.size())
+			return -1;
+		return blocks_[from].FindLink(pc);
+	}
+
 	int FindPreloadBlock(u32 em_address);
+	// When the native code space is reset, the IR stays valid.
+	void ClearNativeEntries();
+	bool ShouldCompact() const {
+		return arena_.ShouldCompact();
+	}
+	// Only safe between blocks, instruction pointers change (including those in native code.)
+	void Compact();
 
 	std::vector<u32> SaveAndClearEmuHackOps();
 	void RestoreSavedEmuHackOps(std::vector<u32> saved);
 
 	JitBlockDebugInfo GetBlockDebugInfo(int blockNum) const override;
 	void ComputeStats(BlockCacheStats &bcStats) const override;
+	JitBlockProfileStats GetBlockProfileStats(int blockNum) const override;
+	u32 GetBlockStartAddress(int blockNum) const override;
 	int GetBlockNumberFromStartAddress(u32 em_address, bool realBlocksOnly = true) const override;
 
+	// Only for stats.
+	void SetNativeBackend(const IRToNativeInterface *native) {
+		native_ = native;
+	}
+
 private:
 	u32 AddressToPage(u32 addr) const;
+	void Unlink(int i);
+
+	// Most games stay well below this, so we rarely need to grow.
+	static const size_t INITIAL_BLOCK_CAPACITY = 16384;
 
 	std::vector<IRBlock> blocks_;
 	std::unordered_map<u32, std::vector<int>> byPage_;
+	// The blocks linked to each block.
+	std::unordered_map<int, std::vector<int>> linkedFrom_;
+	IRArena arena_;
+	const IRToNativeInterface *native_ = nullptr;
 };
 
 class IRJit : public JitInterface {
 public:
-	IRJit(MIPSState *mips);
+	IRJit(MIPSState *mips, bool native = false);
 	virtual ~IRJit();
 
 	void DoState(PointerWrap &p) override;
@@ -165,13 +312,62 @@ class IRJit : public JitInterface {
 	void UnlinkBlock(u8 *checkedEntry, u32 originalAddress) override;
 
 private:
+	struct PreloadRequest {
+		u32 start;
+		u32 length;
+	};
+	struct PreloadedBlock {
+		u32 em_address;
+		u32 mipsBytes;
+		u64 hash;
+		std::vector<IRInst> instructions;
+	};
+
+	// Blocks run this many times are turned into traces with their hot successors.
+	static const u32 TRACE_THRESHOLD = 1000;
+	// If that fails (maybe the successors weren't hot yet), retry at twice the runs, up to this many times.
+	static const int MAX_TRACE_RETRIES = 4;
+	static const size_t MAX_TRACE_BLOCKS = 8;
+	static const u32 MAX_TRACE_BYTES = 0x1000;
+
 	bool CompileBlock(u32 em_address, std::vector<IRInst> &instructions, u32 &mipsBytes, bool preload);
+	IRNativeFunc CompileNative(int block_num);
+	bool FormTrace(int block_num);
 	bool ReplaceJalTo(u32 dest);
 
+	void PreloadFunction(IRFrontend &frontend, u32 start_address, u32 length, std::vector<PreloadedBlock> &results, bool locked);
+	void AddPreloadedBlocks(std::vector<PreloadedBlock> &preloaded);
+	void FlushPreloadedBlocks();
+	void StartPreloadThread();
+	void StopPreloadThread();
+	void PreloadThreadFunc();
+
 	JitOptions jo;
 
 	IRFrontend frontend_;
 	IRBlockCache blocks_;
+	IRDiskCache diskCache_;
+	std::string diskCachePath_;
+	// Only set when running the IR as native code.
+	IRToNativeInterface *native_ = nullptr;
+	// Block run counts are always kept (for traces), cycles only when profiling.
+	bool profiling_ = false;
+
+	// Held while compiling, or while changing anything the frontend reads (blocks, emuhacks.)
+	// The preload thread only takes it for one block at a time.
+	std::recursive_mutex compileLock_;
+
+	// Background preloading of functions (see CompileFunction.)
+	IRFrontend preloadFrontend_;
+	std::thread preloadThread_;
+	std::mutex preloadLock_;
+	std::condition_variable preloadCond_;
+	std::deque<PreloadRequest> preloadRequests_;
+	std::vector<PreloadedBlock> preloadResults_;
+	std::atomic<bool> preloadResultsPending_;
+	// Bumped on ClearCache so in-flight results get discarded.
+	int preloadGeneration_ = 0;
+	bool preloadThreadStop_ = false;
 
 	MIPSState *mips_;
 
@@ -26,6 +26,7 @@
 #include <algorithm>
 
 #include "Common.h"
+#include "Common/StringUtils.h"
 
 #ifdef _WIN32
 #include "Common/CommonWindows.h"
@@ -35,6 +36,7 @@
 #include "Core/MemMap.h"
 #include "Core/CoreTiming.h"
 #include "Core/Reporting.h"
+#include "Core/Debugger/SymbolMap.h"
 
 #include "Core/MIPS/MIPS.h"
 #include "Core/MIPS/MIPSTables.h"
@@ -82,6 +84,8 @@ void JitBlockCache::Init() {
 	agent = op_open_agent();
 #endif
 	blocks_ = new JitBlock[MAX_NUM_BLOCKS];
+	profile_ = new JitBlockProfile[MAX_NUM_BLOCKS];
+	pageBlocks_.resize(NUM_BLOCK_PAGES);
 	Clear();
 }
 
@@ -89,6 +93,8 @@ void JitBlockCache::Shutdown() {
 	Clear(); // Make sure proxy block links are deleted
 	delete [] blocks_;
 	blocks_ = 0;
+	delete [] profile_;
+	profile_ = nullptr;
 	num_blocks_ = 0;
 #if defined USE_OPROFILE && USE_OPROFILE
 	op_close_agent(agent);
@@ -102,7 +108,9 @@ void JitBlockCache::Shutdown() {
 // This clears the JIT cache. It's called from JitCache.cpp when the JIT cache
 // is full and when saving and loading states.
 void JitBlockCache::Clear() {
-	block_map_.clear();
+	for (auto &page : pageBlocks_) {
+		page.clear();
+	}
 	proxyBlockMap_.clear();
 	for (int i = 0; i < num_blocks_; i++)
 		DestroyBlock(i, DestroyType::CLEAR);
@@ -147,6 +155,7 @@ int JitBlockCache::AllocateBlock(u32 startAddress) {
 	}
 
 	b.invalid = false;
+	profile_[num_blocks_] = JitBlockProfile{};
 	b.originalAddress = startAddress;
 	for (int i = 0; i < MAX_JIT_BLOCK_EXITS; ++i) {
 		b.exitAddress[i] = INVALID_EXIT;
@@ -172,6 +181,7 @@ void JitBlockCache::ProxyBlock(u32 rootAddress, u32 startAddress, u32 size, cons
 
 	JitBlock &b = blocks_[num_blocks_];
 	b.invalid = false;
+	profile_[num_blocks_] = JitBlockProfile{};
 	b.originalAddress = startAddress;
 	b.originalSize = size;
 	for (int i = 0; i < MAX_JIT_BLOCK_EXITS; ++i) {
@@ -193,12 +203,51 @@ void JitBlockCache::ProxyBlock(u32 rootAddress, u32 startAddress, u32 size, cons
 	num_blocks_++; //commit the current block
 }
 
+bool JitBlockCache::GetScratchPageRange(u32 pStart, u32 pEnd, int &firstPage, int &lastPage) {
+	const u32 scratchStart = 0x00010000;
+	const u32 scratchEnd = scratchStart + (NUM_SCRATCH_PAGES << BLOCK_PAGE_SHIFT);
+	if (pEnd <= scratchStart || pStart >= scratchEnd)
+		return false;
+	firstPage = (std::max(pStart, scratchStart) - scratchStart) >> BLOCK_PAGE_SHIFT;
+	lastPage = (std::min(pEnd, scratchEnd) - 1 - scratchStart) >> BLOCK_PAGE_SHIFT;
+	return true;
+}
+
+bool JitBlockCache::GetPageRange(u32 pStart, u32 pEnd, int &firstPage, int &lastPage) {
+	const u32 ramStart = 0x08000000;
+	const u32 ramEnd = ramStart + ((u32)NUM_RAM_PAGES << BLOCK_PAGE_SHIFT);
+	if (pEnd <= ramStart || pStart >= ramEnd)
+		return false;
+	firstPage = NUM_SCRATCH_PAGES + ((std::max(pStart, ramStart) - ramStart) >> BLOCK_PAGE_SHIFT);
+	lastPage = NUM_SCRATCH_PAGES + ((std::min(pEnd, ramEnd) - 1 - ramStart) >> BLOCK_PAGE_SHIFT);
+	return true;
+}
+
 void JitBlockCache::AddBlockMap(int block_num) {
 	const JitBlock &b = blocks_[block_num];
-	// Convert the logical address to a physical address for the block map
-	// Yeah, this'll work fine for PSP too I think.
-	u32 pAddr = b.originalAddress & 0x1FFFFFFF;
-	block_map_[std::make_pair(pAddr + 4 * b.originalSize, pAddr)] = block_num;
+	// Convert the logical address to a physical address for the page index.
+	const u32 pAddr = b.originalAddress & 0x1FFFFFFF;
+	const u32 pEnd = pAddr + std::max(4 * (u32)b.originalSize, 4U);
+
+	int first, last;
+	if (GetScratchPageRange(pAddr, pEnd, first, last) || GetPageRange(pAddr, pEnd, first, last)) {
+		for (int page = first; page <= last; ++page) {
+			pageBlocks_[page].push_back(block_num);
+		}
+	} else {
+		pageBlocks_[PAGE_OTHER].push_back(block_num);
+	}
+}
+
+static void RemoveFromPage(std::vector<int> &page, int block_num) {
+	for (size_t i = 0; i < page.size(); ++i) {
+		if (page[i] == block_num) {
+			// Order doesn't matter.
+			page[i] = page.back();
+			page.pop_back();
+			return;
+		}
+	}
 }
 
 void JitBlockCache::RemoveBlockMap(int block_num) {
@@ -208,17 +257,15 @@ void JitBlockCache::RemoveBlockMap(int block_num) {
 	}
 
 	const u32 pAddr = b.originalAddress & 0x1FFFFFFF;
-	auto it = block_map_.find(std::make_pair(pAddr + 4 * b.originalSize, pAddr));
-	if (it != block_map_.end() && it->second == (u32)block_num) {
-		block_map_.erase(it);
-	} else {
-		// It wasn't in there, or it has the wrong key.  Let's search...
-		for (auto it = block_map_.begin(); it != block_map_.end(); ++it) {
-			if (it->second == (u32)block_num) {
-				block_map_.erase(it);
-				break;
-			}
+	const u32 pEnd = pAddr + std::max(4 * (u32)b.originalSize, 4U);
+
+	int first, last;
+	if (GetScratchPageRange(pAddr, pEnd, first, last) || GetPageRange(pAddr, pEnd, first, last)) {
+		for (int page = first; page <= last; ++page) {
+			RemoveFromPage(pageBlocks_[page], block_num);
 		}
+	} else {
+		RemoveFromPage(pageBlocks_[PAGE_OTHER], block_num);
 	}
 }
 
@@ -563,25 +610,36 @@ void JitBlockCache::InvalidateICache(u32 address, const u32 length) {
 		return;
 	}
 
-	// Blocks may start and end in overlapping ways, and destroying one invalidates iterators.
-	// So after destroying one, we start over.
-	do {
-	restart:
-		auto next = block_map_.lower_bound(std::make_pair(pAddr, 0));
-		auto last = block_map_.upper_bound(std::make_pair(pEnd + MAX_BLOCK_INSTRUCTIONS, 0));
-		// Note that if next is end(), last will be end() too (equal.)
-		for (; next != last; ++next) {
-			const u32 blockStart = next->first.second;
-			const u32 blockEnd = next->first.first;
+	// Destroying a block changes the page lists (and may destroy others), so collect first.
+	std::vector<int> toDestroy;
+	auto checkPage = [&](const std::vector<int> &page) {
+		for (int block_num : page) {
+			const JitBlock &b = blocks_[block_num];
+			const u32 blockStart = b.originalAddress & 0x1FFFFFFF;
+			const u32 blockEnd = blockStart + 4 * b.originalSize;
 			if (blockStart < pEnd && blockEnd > pAddr) {
-				DestroyBlock(next->second, DestroyType::INVALIDATE);
-				// Our iterator is now invalid.  Break and search again.
-				// Most of the time there shouldn't be a bunch of matching blocks.
-				goto restart;
+				toDestroy.push_back(block_num);
 			}
 		}
-		// We got here - it wasn't in the map at all (or anymore.)
-	} while (false);
+	};
+
+	int first, last;
+	if (GetScratchPageRange(pAddr, pEnd, first, last)) {
+		for (int page = first; page <= last; ++page)
+			checkPage(pageBlocks_[page]);
+	}
+	if (GetPageRange(pAddr, pEnd, first, last)) {
+		for (int page = first; page <= last; ++page)
+			checkPage(pageBlocks_[page]);
+	}
+	checkPage(pageBlocks_[PAGE_OTHER]);
+
+	for (int block_num : toDestroy) {
+		// Blocks spanning pages show up more than once.
+		if (!blocks_[block_num].invalid) {
+			DestroyBlock(block_num, DestroyType::INVALIDATE);
+		}
+	}
 }
 
 void JitBlockCache::InvalidateChangedBlocks() {
@@ -663,3 +721,55 @@ JitBlockDebugInfo JitBlockCache::GetBlockDebugInfo(int blockNum) const {
 
 	return debugInfo;
 }
+
+JitBlockProfileStats JitBlockCache::GetBlockProfileStats(int blockNum) const {
+	const JitBlockProfile &profile = profile_[blockNum];
+	JitBlockProfileStats stats;
+	stats.executions = profile.executions;
+	stats.cycles = profile.executions * profile.cycleEstimate;
+	return stats;
+}
+
+u32 JitBlockCache::GetBlockStartAddress(int blockNum) const {
+	return blocks_[blockNum].originalAddress;
+}
+
+std::string GetHotBlockReport(const JitBlockCacheDebugInterface *cache, int maxBlocks) {
+	struct HotBlock {
+		int blockNum;
+		JitBlockProfileStats stats;
+	};
+
+	std::vector<HotBlock> hot;
+	u64 totalCycles = 0;
+	for (int i = 0; i < cache->GetNumBlocks(); ++i) {
+		JitBlockProfileStats stats = cache->GetBlockProfileStats(i);
+		if (stats.executions == 0)
+			continue;
+		hot.push_back(HotBlock{ i, stats });
+		totalCycles += stats.cycles;
+	}
+
+	std::sort(hot.begin(), hot.end(), [](const HotBlock &a, const HotBlock &b) {
+		if (a.stats.cycles != b.stats.cycles)
+			return a.stats.cycles > b.stats.cycles;
+		return a.stats.executions > b.stats.executions;
+	});
+	if ((int)hot.size() > maxBlocks)
+		hot.resize(maxBlocks);
+
+	std::string report = StringFromFormat("%-10s %12s %14s %7s  %s\n", "Address", "Runs", "Cycles", "%", "Function");
+	for (const HotBlock &block : hot) {
+		u32 addr = cache->GetBlockStartAddress(block.blockNum);
+		std::string name;
+		u32 funcStart = g_symbolMap ? g_symbolMap->GetFunctionStart(addr) : SymbolMap::INVALID_ADDRESS;
+		if (funcStart != SymbolMap::INVALID_ADDRESS) {
+			name = StringFromFormat("%s+0x%x", g_symbolMap->GetLabelString(funcStart).c_str(), addr - funcStart);
+		} else {
+			name = "?";
+		}
+		double percent = totalCycles == 0 ? 0.0 : (double)block.stats.cycles * 100.0 / (double)totalCycles;
+		report += StringFromFormat("%08x   %12llu %14llu %6.2f%%  %s\n", addr, (unsigned long long)block.stats.executions, (unsigned long long)block.stats.cycles, percent, name.c_str());
+	}
+	return report;
+}
@@ -41,6 +41,14 @@ struct BlockCacheStats {
 	float maxBloat;
 	u32 maxBloatBlock;
 	std::map<float, u32> bloatMap;
+	// Memory allocated for block storage, if tracked separately from code space.
+	size_t storageUsed = 0;
+	size_t storageReserved = 0;
+	// For backends that call back into an interpreter for unsupported ops.
+	int nativeOps = 0;
+	int fallbackOps = 0;
+	int interpretedBlocks = 0;
+	int interpretedOps = 0;
 };
 
 enum class DestroyType {
@@ -100,16 +108,28 @@ struct JitBlockDebugInfo {
 	std::vector<std::string> targetDisasm;
 };
 
+// Only collected when g_Config.bJitBlockProfiling was set as the block was compiled.
+struct JitBlockProfileStats {
+	u64 executions;
+	// Emulated cycles.  Measured where the backend can, otherwise estimated from the block's cycle count.
+	u64 cycles;
+};
+
 class JitBlockCacheDebugInterface {
 public:
 	virtual int GetNumBlocks() const = 0;
 	virtual int GetBlockNumberFromStartAddress(u32 em_address, bool realBlocksOnly = true) const = 0;
 	virtual JitBlockDebugInfo GetBlockDebugInfo(int blockNum) const = 0;
 	virtual void ComputeStats(BlockCacheStats &bcStats) const = 0;
+	virtual JitBlockProfileStats GetBlockProfileStats(int blockNum) const = 0;
+	virtual u32 GetBlockStartAddress(int blockNum) const = 0;
 
 	virtual ~JitBlockCacheDebugInterface() {}
 };
 
+// Hottest blocks first (by cycles), with function names from the symbol map.
+std::string GetHotBlockReport(const JitBlockCacheDebugInterface *cache, int maxBlocks);
+
 class JitBlockCache : public JitBlockCacheDebugInterface {
 public:
 	JitBlockCache(MIPSState *mips_, CodeBlockCommon *codeBlock);
@@ -163,6 +183,16 @@ class JitBlockCache : public JitBlockCacheDebugInterface {
 	static int GetBlockExitSize();
 
 	JitBlockDebugInfo GetBlockDebugInfo(int blockNum) const override;
+	JitBlockProfileStats GetBlockProfileStats(int blockNum) const override;
+	u32 GetBlockStartAddress(int blockNum) const override;
+
+	// For the backends to increment on block entry, when profiling.  Two u32s, low first, so 32-bit can carry.
+	u32 *GetBlockExecutionCounter(int block_num) {
+		return (u32 *)&profile_[block_num].executions;
+	}
+	void SetBlockCycleEstimate(int block_num, int cycles) {
+		profile_[block_num].cycleEstimate = cycles;
+	}
 
 	enum {
 		MAX_BLOCK_INSTRUCTIONS = 0x4000,
@@ -175,16 +205,37 @@ class JitBlockCache : public JitBlockCacheDebugInterface {
 
 	void AddBlockMap(int block_num);
 	void RemoveBlockMap(int block_num);
+	// Returns the range of pageBlocks_ indices covering a physical range, not including PAGE_OTHER.
+	static bool GetPageRange(u32 pStart, u32 pEnd, int &firstPage, int &lastPage);
+	static bool GetScratchPageRange(u32 pStart, u32 pEnd, int &firstPage, int &lastPage);
 
 	MIPSOpcode GetEmuHackOpForBlock(int block_num) const;
 
 	CodeBlockCommon *codeBlock_;
 	JitBlock *blocks_;
+
+	// Kept apart from the blocks, since the counters are written by the generated code.
+	struct JitBlockProfile {
+		u64 executions;
+		u32 cycleEstimate;
+	};
+	JitBlockProfile *profile_ = nullptr;
 	std::unordered_multimap<u32, int> proxyBlockMap_;
 
 	int num_blocks_;
 	std::unordered_multimap<u32, int> links_to_;
-	std::map<std::pair<u32,u32>, u32> block_map_; // (end_addr, start_addr) -> number
+
+	enum {
+		BLOCK_PAGE_SHIFT = 12,
+		// Scratchpad first, then all of RAM (up to 64MB), then everything else.
+		NUM_SCRATCH_PAGES = 0x4000 >> BLOCK_PAGE_SHIFT,
+		NUM_RAM_PAGES = 0x04000000 >> BLOCK_PAGE_SHIFT,
+		PAGE_OTHER = NUM_SCRATCH_PAGES + NUM_RAM_PAGES,
+		NUM_BLOCK_PAGES = PAGE_OTHER + 1,
+	};
+	// Block numbers by physical page, so invalidation only has to look at nearby blocks.
+	// Blocks are listed in every page they cover.
+	std::vector<std::vector<int>> pageBlocks_;
 
 	enum {
 		JITBLOCK_RANGE_SCRATCH = 0,
@@ -142,6 +142,10 @@ namespace MIPSComp {
 		// like that.
 		virtual void LinkBlock(u8 *exitPoint, const u8 *entryPoint) = 0;
 		virtual void UnlinkBlock(u8 *checkedEntry, u32 originalAddress) = 0;
+
+		// Called from the host fault handler when a memory access at codePtr faulted.
+		// Returns where to continue, or nullptr if it's not an access the jit can redirect.
+		virtual const u8 *HandleMemoryFault(const u8 *codePtr) { return nullptr; }
 	};
 
 	typedef void (MIPSFrontendInterface::*MIPSCompileFunc)(MIPSOpcode opcode);
@@ -16,6 +16,7 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include "Common/CPUDetect.h"
+#include "Core/Config.h"
 #include "Core/MIPS/JitCommon/JitState.h"
 #include "Common/MemoryUtil.h"
 
@@ -49,6 +50,7 @@ namespace MIPSComp {
 		continueBranches = false;
 		continueJumps = false;
 		continueMaxInstructions = 300;
+		enableBlockProfiling = g_Config.bJitBlockProfiling;
 
 		useStaticAlloc = false;
 		enablePointerify = false;
@@ -198,6 +198,7 @@ namespace MIPSComp {
 		bool continueBranches;
 		bool continueJumps;
 		int continueMaxInstructions;
+		bool enableBlockProfiling;
 	};
 
 }
@@ -211,6 +211,8 @@ void MIPSState::Init() {
 		MIPSComp::jit = MIPSComp::CreateNativeJit(this);
 	} else if (PSP_CoreParameter().cpuCore == CPUCore::IR_JIT) {
 		MIPSComp::jit = new MIPSComp::IRJit(this);
+	} else if (PSP_CoreParameter().cpuCore == CPUCore::IR_NATIVE) {
+		MIPSComp::jit = new MIPSComp::IRJit(this, true);
 	} else {
 		MIPSComp::jit = nullptr;
 	}
@@ -243,6 +245,14 @@ void MIPSState::UpdateCore(CPUCore desired) {
 		MIPSComp::jit = new MIPSComp::IRJit(this);
 		break;
 
+	case CPUCore::IR_NATIVE:
+		INFO_LOG(CPU, "Switching to IR native");
+		if (MIPSComp::jit) {
+			delete MIPSComp::jit;
+		}
+		MIPSComp::jit = new MIPSComp::IRJit(this, true);
+		break;
+
 	case CPUCore::INTERPRETER:
 		INFO_LOG(CPU, "Switching to interpreter");
 		delete MIPSComp::jit;
@@ -306,6 +316,7 @@ int MIPSState::RunLoopUntil(u64 globalTicks) {
 	switch (PSP_CoreParameter().cpuCore) {
 	case CPUCore::JIT:
 	case CPUCore::IR_JIT:
+	case CPUCore::IR_NATIVE:
 		MIPSComp::jit->RunLoopUntil(globalTicks);
 		break;
 
@@ -59,6 +59,7 @@ namespace MIPSComp {
 		gpr.MapReg(rt, rt == rs, true);
 
 		JitSafeMem safe(this, rs, offset);
+		safe.AllowBackpatch();
 		OpArg src;
 		if (safe.PrepareRead(src, bits / 8))
 			(this->*mov)(32, bits, gpr.RX(rt), src);
@@ -104,6 +105,8 @@ namespace MIPSComp {
 #endif
 
 		JitSafeMem safe(this, rs, offset);
+		if (!needSwap)
+			safe.AllowBackpatch();
 		OpArg dest;
 		if (safe.PrepareWrite(dest, bits / 8))
 		{
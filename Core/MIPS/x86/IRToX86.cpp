@@ -1,299 +1,796 @@
 #include "ppsspp_config.h"
-#if PPSSPP_ARCH(X86) || PPSSPP_ARCH(AMD64)
+#if PPSSPP_ARCH(AMD64)
 
+#include <cstddef>
+
+#include "Common/ABI.h"
+#include "Core/MemMap.h"
+#include "Core/MIPS/MIPS.h"
+#include "Core/MIPS/IR/IRInterpreter.h"
 #include "Core/MIPS/x86/IRToX86.h"
 
 namespace MIPSComp {
 
-// Initial attempt at converting IR directly to x86.
-// This is intended to be an easy way to benefit from the IR with the current infrastructure.
-// Later tries may go across multiple blocks and a different representation.
-
-struct GPRMapping {
-	Gen::OpArg dest;
-	Gen::OpArg src1;
-	Gen::OpArg src2;
+using namespace Gen;
+
+// Converts an IR block (after all the passes) into a function returning the next PC.
+// This way the IR passes benefit native code, without a separate dispatcher.
+// Integer ops, common scalar FPU ops, loads/stores, and exits are native.  Everything else
+// (VFPU, conversions, syscalls...) flushes the register caches and calls back into the
+// interpreter for that op.
+
+// Points at MIPSState, which starts with r[], so an IR register index is simply a u32 offset.
+static const X64Reg CTXREG = R15;
+static const X64Reg MEMBASEREG = R14;
+// Never allocated, used within a single op.  ECX for variable shifts, EDX for multiplies.
+static const X64Reg SCRATCH1 = EAX;
+static const X64Reg SCRATCH2 = ECX;
+static const X64Reg SCRATCH3 = EDX;
+static const X64Reg FSCRATCH = XMM0;
+
+static const X64Reg gprAllocOrder[] = {
+	EBX, EBP, ESI, EDI, R8, R9, R10, R11, R12, R13,
 };
-
-struct FPRMapping {
-	Gen::OpArg dest;
-	Gen::OpArg src1;
-	Gen::OpArg src2;
+// XMM6 and up are callee saved on Windows, so we'd have to save them in the prologue.
+static const X64Reg fprAllocOrder[] = {
+#ifdef _WIN32
+	XMM1, XMM2, XMM3, XMM4, XMM5,
+#else
+	XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7, XMM8, XMM9, XMM10, XMM11, XMM12, XMM13, XMM14, XMM15,
+#endif
 };
 
+alignas(16) static const u32 signBitMask[4] = { 0x80000000, 0x80000000, 0x80000000, 0x80000000 };
+alignas(16) static const u32 noSignMask[4] = { 0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF };
+
+static const int IRREG_COUNT = 256;
+static const int NUM_HOST_REGS = 16;
+
+static OpArg IRRegArg(int reg) {
+	return MDisp(CTXREG, reg * 4);
+}
+
+static OpArg IRFRegArg(int reg) {
+	return MDisp(CTXREG, (int)offsetof(MIPSState, f) + reg * 4);
+}
+
+static OpArg MIPSStateArg(size_t offset) {
+	return MDisp(CTXREG, (int)offset);
+}
 
-class GreedyRegallocGPR {
+// A simple greedy allocator.  IR regs are mapped on use, and evicted least recently used.
+// Everything is written back before exits and calls.  One handles GPRs, another FPRs in XMM regs.
+class GreedyRegalloc {
 public:
-	GPRMapping Map(IRInst inst, const IRMeta &meta);
+	template <size_t N>
+	GreedyRegalloc(XEmitter *emit, const X64Reg (&order)[N], bool fpr) : emit_(emit), order_(order), orderSize_(N), fpr_(fpr) {
+		for (int i = 0; i < IRREG_COUNT; ++i)
+			irToHost_[i] = INVALID_REG;
+		for (int i = 0; i < NUM_HOST_REGS; ++i) {
+			host_[i].irReg = -1;
+			host_[i].dirty = false;
+			host_[i].locked = false;
+			host_[i].lastUse = 0;
+		}
+	}
+
+	// Maps a register for reading (and optionally writing.)
+	X64Reg MapReg(int irReg, bool load, bool dirty) {
+		X64Reg reg = irToHost_[irReg];
+		if (reg == INVALID_REG) {
+			reg = AllocReg();
+			if (load) {
+				Load(reg, irReg);
+			}
+			host_[reg].irReg = irReg;
+			irToHost_[irReg] = reg;
+		}
+		host_[reg].dirty = host_[reg].dirty || dirty;
+		host_[reg].locked = true;
+		host_[reg].lastUse = ++useCounter_;
+		return reg;
+	}
+
+	X64Reg MapSrc(int irReg) {
+		return MapReg(irReg, true, false);
+	}
+
+	X64Reg MapDest(int irReg) {
+		return MapReg(irReg, false, true);
+	}
+
+	X64Reg MapDirtySrc(int irReg) {
+		return MapReg(irReg, true, true);
+	}
+
+	// Call after each op.
+	void UnlockAll() {
+		for (size_t i = 0; i < orderSize_; ++i)
+			host_[order_[i]].locked = false;
+	}
+
+	// Writes back dirty regs.  When release is false, the mapping (and dirty state) is kept,
+	// which is used for the taken side of conditional exits.
+	void FlushAll(bool release) {
+		for (size_t i = 0; i < orderSize_; ++i) {
+			X64Reg reg = order_[i];
+			HostReg &h = host_[reg];
+			if (h.irReg == -1)
+				continue;
+			if (h.dirty) {
+				Store(reg, h.irReg);
+			}
+			if (release) {
+				irToHost_[h.irReg] = INVALID_REG;
+				h.irReg = -1;
+				h.dirty = false;
+			}
+		}
+	}
 
 private:
-	
-};
+	void Load(X64Reg reg, int irReg) {
+		if (fpr_)
+			emit_->MOVSS(reg, IRFRegArg(irReg));
+		else
+			emit_->MOV(32, R(reg), IRRegArg(irReg));
+	}
 
+	void Store(X64Reg reg, int irReg) {
+		if (fpr_)
+			emit_->MOVSS(IRFRegArg(irReg), reg);
+		else
+			emit_->MOV(32, IRRegArg(irReg), R(reg));
+	}
 
-GPRMapping GreedyRegallocGPR::Map(IRInst inst, const IRMeta &meta) {
-	GPRMapping mapping;
-	if (meta.types[0] == 'G') {
+	X64Reg AllocReg() {
+		X64Reg best = INVALID_REG;
+		for (size_t i = 0; i < orderSize_; ++i) {
+			X64Reg reg = order_[i];
+			if (host_[reg].irReg == -1)
+				return reg;
+			if (!host_[reg].locked && (best == INVALID_REG || host_[reg].lastUse < host_[best].lastUse))
+				best = reg;
+		}
 
+		_assert_msg_(JIT, best != INVALID_REG, "IRToX86: all regs locked");
+		HostReg &h = host_[best];
+		if (h.dirty) {
+			Store(best, h.irReg);
+		}
+		irToHost_[h.irReg] = INVALID_REG;
+		h.irReg = -1;
+		h.dirty = false;
+		return best;
 	}
-	// etc..
-	return mapping;
-}
 
-// Every 4 registers can also be mapped into an SSE register.
-// When changing from single to vec4 mapping, we'll just flush, for now.
-class GreedyRegallocFPR {
-public:
-	FPRMapping Map(IRInst inst, const IRMeta &meta);
+	struct HostReg {
+		int irReg;
+		bool dirty;
+		bool locked;
+		int lastUse;
+	};
+
+	XEmitter *emit_;
+	const X64Reg *order_;
+	size_t orderSize_;
+	bool fpr_;
+	X64Reg irToHost_[IRREG_COUNT];
+	HostReg host_[NUM_HOST_REGS];
+	int useCounter_ = 0;
 };
 
-FPRMapping GreedyRegallocFPR::Map(IRInst inst, const IRMeta &meta) {
-	FPRMapping mapping;
+IRToX86::IRToX86(MIPSState *mips) : mips_(mips) {
+	code_.AllocCodeSpace(1024 * 1024 * 16);
+}
 
-	return mapping;
+IRToX86::~IRToX86() {
+	code_.FreeCodeSpace();
 }
 
+void IRToX86::ClearCode() {
+	code_.ClearCodeSpace(0);
+	fallbackOps_ = 0;
+	nativeOps_ = 0;
+	interpretedBlocks_ = 0;
+	interpretedOps_ = 0;
+}
 
-// This requires that ThreeOpToTwoOp has been run as the last pass.
-void IRToX86::ConvertIRToNative(const IRInst *instructions, int count, const u32 *constants) {
-	// Set up regcaches
-	using namespace Gen;
+static void EmitPrologue(XEmitter *emit) {
+	emit->PUSH(RBX);
+	emit->PUSH(RBP);
+	emit->PUSH(RSI);
+	emit->PUSH(RDI);
+	emit->PUSH(R12);
+	emit->PUSH(R13);
+	emit->PUSH(R14);
+	emit->PUSH(R15);
+	// 8 pushes and the return address leave us 8 bytes off alignment.  Windows also needs shadow space.
+#ifdef _WIN32
+	emit->SUB(64, R(RSP), Imm8(0x28));
+#else
+	emit->SUB(64, R(RSP), Imm8(0x08));
+#endif
+	emit->MOV(64, R(CTXREG), R(ABI_PARAM1));
+	emit->MOV(64, R(MEMBASEREG), ImmPtr(&Memory::base));
+	emit->MOV(64, R(MEMBASEREG), MatR(MEMBASEREG));
+}
 
-	GreedyRegallocGPR gprAlloc;
-	GreedyRegallocFPR fprAlloc;
+// Expects the new PC in EAX.
+static void EmitEpilogue(XEmitter *emit) {
+#ifdef _WIN32
+	emit->ADD(64, R(RSP), Imm8(0x28));
+#else
+	emit->ADD(64, R(RSP), Imm8(0x08));
+#endif
+	emit->POP(R15);
+	emit->POP(R14);
+	emit->POP(R13);
+	emit->POP(R12);
+	emit->POP(RDI);
+	emit->POP(RSI);
+	emit->POP(RBP);
+	emit->POP(RBX);
+	emit->RET();
+}
 
-	// Loop through all the instructions, emitting code as we go.
-	// Note that we do need to implement them all - fallbacks are not permitted.
-	for (int i = 0; i < count; i++) {
-		const IRInst *inst = &instructions[i];
-		const IRMeta &meta = *GetIRMeta(inst->op);
-		GPRMapping gpr = gprAlloc.Map(*inst, meta);
-		FPRMapping fpr = fprAlloc.Map(*inst, meta);
+static OpArg ComputeAddress(XEmitter *emit, X64Reg base, u32 offset) {
+	emit->LEA(32, SCRATCH1, MDisp(base, (int)offset));
+#ifdef MASKED_PSP_MEMORY
+	emit->AND(32, R(SCRATCH1), Imm32(Memory::MEMVIEW32_MASK));
+#endif
+	return MComplex(MEMBASEREG, SCRATCH1, SCALE_1, 0);
+}
 
-		bool symmetric = false;
-		switch (inst->op) {
-		case IROp::Nop:
-			_assert_(false);
-			break;
+static CCFlags ExitCondition(IROp op) {
+	switch (op) {
+	case IROp::ExitToConstIfEq: return CC_E;
+	case IROp::ExitToConstIfNeq: return CC_NE;
+	case IROp::ExitToConstIfGtZ: return CC_G;
+	case IROp::ExitToConstIfGeZ: return CC_GE;
+	case IROp::ExitToConstIfLtZ: return CC_L;
+	case IROp::ExitToConstIfLeZ: return CC_LE;
+	default:
+		_assert_(false);
+		return CC_E;
+	}
+}
 
-			// Output-only
+const u8 *IRToX86::ConvertIRToNative(const IRInst *instructions, int count) {
+	// Rough worst case, each op can take a flush plus a call.
+	if (code_.GetSpaceLeft() < (size_t)count * 256 + 1024) {
+		return nullptr;
+	}
+
+	code_.BeginWrite();
+	XEmitter *emit = &code_;
+	const u8 *start = code_.AlignCode16();
+	EmitPrologue(emit);
+
+	GreedyRegalloc gpr(emit, gprAllocOrder, false);
+	GreedyRegalloc fpr(emit, fprAllocOrder, true);
+	const size_t pcOffset = offsetof(MIPSState, pc);
+	const size_t downcountOffset = offsetof(MIPSState, downcount);
+
+	auto binaryOp = [&](const IRInst &inst, void (XEmitter::*op)(int, const OpArg &, const OpArg &), bool symmetric) {
+		X64Reg s1 = gpr.MapSrc(inst.src1);
+		X64Reg s2 = gpr.MapSrc(inst.src2);
+		X64Reg d = gpr.MapDest(inst.dest);
+		if (d == s1) {
+			(emit->*op)(32, R(d), R(s2));
+		} else if (d == s2 && symmetric) {
+			(emit->*op)(32, R(d), R(s1));
+		} else if (d != s2) {
+			emit->MOV(32, R(d), R(s1));
+			(emit->*op)(32, R(d), R(s2));
+		} else {
+			emit->MOV(32, R(SCRATCH1), R(s1));
+			(emit->*op)(32, R(SCRATCH1), R(s2));
+			emit->MOV(32, R(d), R(SCRATCH1));
+		}
+	};
+
+	auto constOp = [&](const IRInst &inst, void (XEmitter::*op)(int, const OpArg &, const OpArg &)) {
+		X64Reg s1 = gpr.MapSrc(inst.src1);
+		X64Reg d = gpr.MapDest(inst.dest);
+		if (d != s1)
+			emit->MOV(32, R(d), R(s1));
+		(emit->*op)(32, R(d), Imm32(inst.constant));
+	};
+
+	auto shiftImm = [&](const IRInst &inst, void (XEmitter::*op)(int, OpArg, OpArg)) {
+		X64Reg s1 = gpr.MapSrc(inst.src1);
+		X64Reg d = gpr.MapDest(inst.dest);
+		if (d != s1)
+			emit->MOV(32, R(d), R(s1));
+		(emit->*op)(32, R(d), Imm8(inst.src2));
+	};
+
+	auto shiftVar = [&](const IRInst &inst, void (XEmitter::*op)(int, OpArg, OpArg)) {
+		X64Reg s1 = gpr.MapSrc(inst.src1);
+		X64Reg s2 = gpr.MapSrc(inst.src2);
+		X64Reg d = gpr.MapDest(inst.dest);
+		// x86 masks the count to 5 bits for us, like the & 31.
+		emit->MOV(32, R(SCRATCH2), R(s2));
+		emit->MOV(32, R(SCRATCH1), R(s1));
+		(emit->*op)(32, R(SCRATCH1), R(CL));
+		emit->MOV(32, R(d), R(SCRATCH1));
+	};
+
+	auto compareOp = [&](const IRInst &inst, CCFlags cc, bool useConst) {
+		X64Reg s1 = gpr.MapSrc(inst.src1);
+		X64Reg s2 = useConst ? INVALID_REG : gpr.MapSrc(inst.src2);
+		X64Reg d = gpr.MapDest(inst.dest);
+		// Zero before the compare, XOR clobbers flags.
+		emit->XOR(32, R(SCRATCH1), R(SCRATCH1));
+		emit->CMP(32, R(s1), useConst ? Imm32(inst.constant) : R(s2));
+		emit->SETcc(cc, R(SCRATCH1));
+		emit->MOV(32, R(d), R(SCRATCH1));
+	};
+
+	// SSE ops only take two operands, so copy src1 first unless it's already in place.
+	auto fpBinaryOp = [&](const IRInst &inst, void (XEmitter::*op)(X64Reg, OpArg)) {
+		X64Reg s1 = fpr.MapSrc(inst.src1);
+		X64Reg s2 = fpr.MapSrc(inst.src2);
+		X64Reg d = fpr.MapDest(inst.dest);
+		if (d == s1) {
+			(emit->*op)(d, R(s2));
+		} else if (d != s2) {
+			emit->MOVAPS(d, R(s1));
+			(emit->*op)(d, R(s2));
+		} else {
+			emit->MOVAPS(FSCRATCH, R(s1));
+			(emit->*op)(FSCRATCH, R(s2));
+			emit->MOVAPS(d, R(FSCRATCH));
+		}
+	};
+
+	auto fpMaskOp = [&](const IRInst &inst, void (XEmitter::*op)(X64Reg, OpArg), const u32 *mask) {
+		X64Reg s1 = fpr.MapSrc(inst.src1);
+		X64Reg d = fpr.MapDest(inst.dest);
+		if (d != s1)
+			emit->MOVAPS(d, R(s1));
+		emit->MOV(64, R(SCRATCH2), ImmPtr(mask));
+		(emit->*op)(d, MatR(SCRATCH2));
+	};
+
+	auto flushAll = [&](bool release) {
+		gpr.FlushAll(release);
+		fpr.FlushAll(release);
+	};
+
+	auto exitToEAX = [&](bool release) {
+		flushAll(release);
+		EmitEpilogue(emit);
+	};
+
+	int blockFallbackOps = 0;
+	int blockNativeOps = 0;
+	bool ended = false;
+	for (int i = 0; i < count && !ended; i++) {
+		const IRInst &inst = instructions[i];
+		bool native = true;
+
+		switch (inst.op) {
 		case IROp::SetConst:
-			code_->MOV(32, gpr.dest, Imm32(constants[inst->src1]));
+		{
+			X64Reg d = gpr.MapDest(inst.dest);
+			if (inst.constant == 0)
+				emit->XOR(32, R(d), R(d));
+			else
+				emit->MOV(32, R(d), Imm32(inst.constant));
 			break;
-		case IROp::SetConstF:
-			code_->MOV(32, gpr.dest, Imm32(constants[inst->src1]));
+		}
+
+		case IROp::Mov:
+		{
+			X64Reg s1 = gpr.MapSrc(inst.src1);
+			X64Reg d = gpr.MapDest(inst.dest);
+			if (d != s1)
+				emit->MOV(32, R(d), R(s1));
 			break;
+		}
 
-			// Add gets to be special cased because we have LEA.
 		case IROp::Add:
-			if (gpr.dest.IsSimpleReg() && gpr.src1.IsSimpleReg() && gpr.src2.IsSimpleReg()) {
-				code_->LEA(32, gpr.dest.GetSimpleReg(), MRegSum(gpr.src1.GetSimpleReg(), gpr.src2.GetSimpleReg()));
-				break;
-			}
-			// Else fall through.
-			// 3-op arithmetic that directly corresponds to x86
-			// (often 2-op in practice if src1 == dst). x86 only does 2-op though so some of these will need splitting.
-		case IROp::Sub:
-		case IROp::And:
-		case IROp::Or:
-		case IROp::Xor:
-			if (inst->src1 != inst->dest) {
-				code_->MOV(32, gpr.dest, gpr.src1);
-			}
-			// Emit directly
-			switch (inst->op) {
-			case IROp::Add: code_->ADD(32, gpr.dest, gpr.src2); break;
-			case IROp::Sub: code_->SUB(32, gpr.dest, gpr.src2); break;
-			case IROp::And: code_->AND(32, gpr.dest, gpr.src2); break;
-			case IROp::Or: code_->OR(32, gpr.dest, gpr.src2); break;
-			case IROp::Xor: code_->XOR(32, gpr.dest, gpr.src2); break;
-			}
+		{
+			X64Reg s1 = gpr.MapSrc(inst.src1);
+			X64Reg s2 = gpr.MapSrc(inst.src2);
+			X64Reg d = gpr.MapDest(inst.dest);
+			emit->LEA(32, d, MComplex(s1, s2, SCALE_1, 0));
 			break;
+		}
+		case IROp::Sub: binaryOp(inst, &XEmitter::SUB, false); break;
+		case IROp::And: binaryOp(inst, &XEmitter::AND, true); break;
+		case IROp::Or: binaryOp(inst, &XEmitter::OR, true); break;
+		case IROp::Xor: binaryOp(inst, &XEmitter::XOR, true); break;
 
-			// Variable shifts.
-		case IROp::Shl:
-		case IROp::Shr:
-		case IROp::Sar:
-		case IROp::Ror:
+		case IROp::AddConst: constOp(inst, &XEmitter::ADD); break;
+		case IROp::SubConst: constOp(inst, &XEmitter::SUB); break;
+		case IROp::AndConst: constOp(inst, &XEmitter::AND); break;
+		case IROp::OrConst: constOp(inst, &XEmitter::OR); break;
+		case IROp::XorConst: constOp(inst, &XEmitter::XOR); break;
 
-		case IROp::Slt:
-		case IROp::SltU:
-		case IROp::MovZ:
-		case IROp::MovNZ:
-		case IROp::Max:
-		case IROp::Min:
+		case IROp::Neg:
+		case IROp::Not:
+		case IROp::BSwap32:
+		{
+			X64Reg s1 = gpr.MapSrc(inst.src1);
+			X64Reg d = gpr.MapDest(inst.dest);
+			if (d != s1)
+				emit->MOV(32, R(d), R(s1));
+			if (inst.op == IROp::Neg)
+				emit->NEG(32, R(d));
+			else if (inst.op == IROp::Not)
+				emit->NOT(32, R(d));
+			else
+				emit->BSWAP(32, d);
+			break;
+		}
+
+		case IROp::Ext8to32:
+		{
+			X64Reg s1 = gpr.MapSrc(inst.src1);
+			X64Reg d = gpr.MapDest(inst.dest);
+			// Avoid needing a REX prefix for the low byte of ESI/EDI/EBP.
+			emit->MOV(32, R(SCRATCH1), R(s1));
+			emit->MOVSX(32, 8, d, R(SCRATCH1));
+			break;
+		}
+		case IROp::Ext16to32:
+		{
+			X64Reg s1 = gpr.MapSrc(inst.src1);
+			X64Reg d = gpr.MapDest(inst.dest);
+			emit->MOVSX(32, 16, d, R(s1));
 			break;
+		}
 
-			// 2-op arithmetic with constant
-		case IROp::AddConst:
-		case IROp::SubConst:
-		case IROp::AndConst:
-		case IROp::OrConst:
-		case IROp::XorConst:
-		case IROp::SltConst:
-		case IROp::SltUConst:
+		case IROp::Clz:
+		{
+			X64Reg s1 = gpr.MapSrc(inst.src1);
+			X64Reg d = gpr.MapDest(inst.dest);
+			// BSR leaves the dest undefined on zero, so use 63 which becomes 32 after the XOR.
+			emit->MOV(32, R(SCRATCH2), Imm32(63));
+			emit->BSR(32, SCRATCH1, R(s1));
+			emit->CMOVcc(32, SCRATCH1, R(SCRATCH2), CC_Z);
+			emit->XOR(32, R(SCRATCH1), Imm32(31));
+			emit->MOV(32, R(d), R(SCRATCH1));
+			break;
+		}
 
-			// 2-op arithmetic with immediate
-		case IROp::ShlImm:
-		case IROp::ShrImm:
-		case IROp::SarImm:
-		case IROp::RorImm:
+		case IROp::ShlImm: shiftImm(inst, &XEmitter::SHL); break;
+		case IROp::ShrImm: shiftImm(inst, &XEmitter::SHR); break;
+		case IROp::SarImm: shiftImm(inst, &XEmitter::SAR); break;
+		case IROp::RorImm: shiftImm(inst, &XEmitter::ROR); break;
 
-			// 2-op arithmetic
-		case IROp::Mov:
-			code_->MOV(32, gpr.dest, gpr.src1);
+		case IROp::Shl: shiftVar(inst, &XEmitter::SHL); break;
+		case IROp::Shr: shiftVar(inst, &XEmitter::SHR); break;
+		case IROp::Sar: shiftVar(inst, &XEmitter::SAR); break;
+		case IROp::Ror: shiftVar(inst, &XEmitter::ROR); break;
+
+		case IROp::Slt: compareOp(inst, CC_L, false); break;
+		case IROp::SltU: compareOp(inst, CC_B, false); break;
+		case IROp::SltConst: compareOp(inst, CC_L, true); break;
+		case IROp::SltUConst: compareOp(inst, CC_B, true); break;
+
+		case IROp::MovZ:
+		case IROp::MovNZ:
+		{
+			X64Reg s1 = gpr.MapSrc(inst.src1);
+			X64Reg s2 = gpr.MapSrc(inst.src2);
+			// Only conditionally written, so we need the old value.
+			X64Reg d = gpr.MapDirtySrc(inst.dest);
+			emit->TEST(32, R(s1), R(s1));
+			emit->CMOVcc(32, d, R(s2), inst.op == IROp::MovZ ? CC_Z : CC_NZ);
 			break;
+		}
 
-		case IROp::Neg:
-		case IROp::Not:
-		case IROp::Ext8to32:
-		case IROp::Ext16to32:
-		case IROp::ReverseBits:
-		case IROp::BSwap16:
-		case IROp::BSwap32:
-		case IROp::Clz:
-			if (inst->dest != inst->src1) {
-				code_->NEG(32, gpr.dest); break;
-			}
+		case IROp::Max:
+		case IROp::Min:
+		{
+			X64Reg s1 = gpr.MapSrc(inst.src1);
+			X64Reg s2 = gpr.MapSrc(inst.src2);
+			X64Reg d = gpr.MapDest(inst.dest);
+			emit->MOV(32, R(SCRATCH1), R(s1));
+			emit->CMP(32, R(s1), R(s2));
+			emit->CMOVcc(32, SCRATCH1, R(s2), inst.op == IROp::Max ? CC_L : CC_G);
+			emit->MOV(32, R(d), R(SCRATCH1));
 			break;
-				// Multiplier control
+		}
+
 		case IROp::MtLo:
 		case IROp::MtHi:
 		case IROp::MfLo:
 		case IROp::MfHi:
+		{
+			int src = inst.src1;
+			int dest = inst.dest;
+			if (inst.op == IROp::MtLo || inst.op == IROp::MtHi) {
+				dest = inst.op == IROp::MtLo ? IRREG_LO : IRREG_HI;
+			} else {
+				src = inst.op == IROp::MfLo ? IRREG_LO : IRREG_HI;
+			}
+			X64Reg s = gpr.MapSrc(src);
+			X64Reg d = gpr.MapDest(dest);
+			if (d != s)
+				emit->MOV(32, R(d), R(s));
+			break;
+		}
+
 		case IROp::Mult:
 		case IROp::MultU:
-		case IROp::Madd:
-		case IROp::MaddU:
-		case IROp::Msub:
-		case IROp::MsubU:
-		case IROp::Div:
-		case IROp::DivU:
-
-			// Memory access
+		{
+			X64Reg s1 = gpr.MapSrc(inst.src1);
+			X64Reg s2 = gpr.MapSrc(inst.src2);
+			emit->MOV(32, R(SCRATCH1), R(s1));
+			if (inst.op == IROp::Mult)
+				emit->IMUL(32, R(s2));
+			else
+				emit->MUL(32, R(s2));
+			// Result is in EDX:EAX, which are never allocated.
+			X64Reg lo = gpr.MapDest(IRREG_LO);
+			X64Reg hi = gpr.MapDest(IRREG_HI);
+			emit->MOV(32, R(lo), R(SCRATCH1));
+			emit->MOV(32, R(hi), R(SCRATCH3));
+			break;
+		}
+
 		case IROp::Load8:
 		case IROp::Load8Ext:
 		case IROp::Load16:
 		case IROp::Load16Ext:
 		case IROp::Load32:
-		case IROp::LoadFloat:
+		{
+			X64Reg base = gpr.MapSrc(inst.src1);
+			OpArg mem = ComputeAddress(emit, base, inst.constant);
+			X64Reg d = gpr.MapDest(inst.dest);
+			switch (inst.op) {
+			case IROp::Load8: emit->MOVZX(32, 8, d, mem); break;
+			case IROp::Load8Ext: emit->MOVSX(32, 8, d, mem); break;
+			case IROp::Load16: emit->MOVZX(32, 16, d, mem); break;
+			case IROp::Load16Ext: emit->MOVSX(32, 16, d, mem); break;
+			default: emit->MOV(32, R(d), mem); break;
+			}
+			break;
+		}
+
 		case IROp::Store8:
 		case IROp::Store16:
 		case IROp::Store32:
-		case IROp::StoreFloat:
-		case IROp::LoadVec4:
-		case IROp::StoreVec4:
-
-			// Output-only SIMD functions
-		case IROp::Vec4Init:
-		case IROp::Vec4Shuffle:
-
-			// 2-op SIMD functions
-		case IROp::Vec4Mov:
-			code_->MOVAPS(fpr.dest.GetSimpleReg(), fpr.src1);
-			break;
-		case IROp::Vec4Neg:
-		case IROp::Vec4Abs:
-			break;
-		case IROp::Vec4ClampToZero:
-			code_->PXOR(XMM0, R(XMM0));
-			code_->PMAXSW(XMM0, fpr.src1);
-			code_->MOVAPD(fpr.dest, XMM0);
-			break;
-		case IROp::Vec4DuplicateUpperBitsAndShift1:
-		case IROp::Vec2ClampToZero:
-
-			// 3-op SIMD functions
-		case IROp::Vec4Add:
-		case IROp::Vec4Sub:
-		case IROp::Vec4Mul:
-		case IROp::Vec4Div:
-
-		case IROp::Vec4Scale:
-		case IROp::Vec4Dot:
-
-			// Pack-unpack
-		case IROp::Vec2Unpack16To31:
-		case IROp::Vec2Unpack16To32:
-		case IROp::Vec4Unpack8To32:
-		case IROp::Vec2Pack32To16:
-		case IROp::Vec2Pack31To16:
-		case IROp::Vec4Pack32To8:
-		case IROp::Vec4Pack31To8:
-
-		case IROp::FCmpVfpuBit:
-		case IROp::FCmpVfpuAggregate:
-		case IROp::FCmovVfpuCC:
-
-			// Trancendental functions (non-simd)
-		case IROp::FSin:
-		case IROp::FCos:
-		case IROp::FRSqrt:
-		case IROp::FRecip:
-		case IROp::FAsin:
-
-			// 3-Op FP
-		case IROp::FAdd:
-		case IROp::FSub:
-		case IROp::FMul:
-		case IROp::FDiv:
-		case IROp::FMin:
-		case IROp::FMax:
-
-			// 2-Op FP
+		{
+			X64Reg base = gpr.MapSrc(inst.src1);
+			X64Reg value = gpr.MapSrc(inst.src3);
+			OpArg mem = ComputeAddress(emit, base, inst.constant);
+			if (inst.op == IROp::Store8) {
+				emit->MOV(32, R(SCRATCH2), R(value));
+				emit->MOV(8, mem, R(SCRATCH2));
+			} else {
+				emit->MOV(inst.op == IROp::Store16 ? 16 : 32, mem, R(value));
+			}
+			break;
+		}
+
+		case IROp::SetConstF:
+		{
+			X64Reg d = fpr.MapDest(inst.dest);
+			if (inst.constant == 0) {
+				emit->XORPS(d, R(d));
+			} else {
+				emit->MOV(32, R(SCRATCH1), Imm32(inst.constant));
+				emit->MOVD_xmm(d, R(SCRATCH1));
+			}
+			break;
+		}
+
+		case IROp::FAdd: fpBinaryOp(inst, &XEmitter::ADDSS); break;
+		case IROp::FSub: fpBinaryOp(inst, &XEmitter::SUBSS); break;
+		case IROp::FMul: fpBinaryOp(inst, &XEmitter::MULSS); break;
+		case IROp::FDiv: fpBinaryOp(inst, &XEmitter::DIVSS); break;
+
 		case IROp::FMov:
-		case IROp::FAbs:
+		{
+			X64Reg s1 = fpr.MapSrc(inst.src1);
+			X64Reg d = fpr.MapDest(inst.dest);
+			if (d != s1)
+				emit->MOVAPS(d, R(s1));
+			break;
+		}
+		case IROp::FNeg: fpMaskOp(inst, &XEmitter::XORPS, signBitMask); break;
+		case IROp::FAbs: fpMaskOp(inst, &XEmitter::ANDPS, noSignMask); break;
 		case IROp::FSqrt:
-		case IROp::FNeg:
-		case IROp::FSat0_1:
-		case IROp::FSatMinus1_1:
-		case IROp::FSign:
-		case IROp::FCeil:
-		case IROp::FFloor:
-		case IROp::FCmp:
+		{
+			X64Reg s1 = fpr.MapSrc(inst.src1);
+			X64Reg d = fpr.MapDest(inst.dest);
+			emit->SQRTSS(d, R(s1));
+			break;
+		}
+
 		case IROp::FCvtSW:
-		case IROp::FCvtWS:
-		case IROp::FRound:
-		case IROp::FTrunc:
+		{
+			X64Reg s1 = fpr.MapSrc(inst.src1);
+			X64Reg d = fpr.MapDest(inst.dest);
+			emit->CVTDQ2PS(d, R(s1));
+			break;
+		}
 
-			// Cross moves
 		case IROp::FMovFromGPR:
+		{
+			X64Reg s1 = gpr.MapSrc(inst.src1);
+			X64Reg d = fpr.MapDest(inst.dest);
+			emit->MOVD_xmm(d, R(s1));
+			break;
+		}
 		case IROp::FMovToGPR:
-		case IROp::FpCondToReg:
-		case IROp::VfpuCtrlToReg:
+		{
+			X64Reg s1 = fpr.MapSrc(inst.src1);
+			X64Reg d = gpr.MapDest(inst.dest);
+			emit->MOVD_xmm(R(d), s1);
+			break;
+		}
+
+		case IROp::LoadFloat:
+		{
+			X64Reg base = gpr.MapSrc(inst.src1);
+			OpArg mem = ComputeAddress(emit, base, inst.constant);
+			X64Reg d = fpr.MapDest(inst.dest);
+			emit->MOVSS(d, mem);
+			break;
+		}
+		case IROp::StoreFloat:
+		{
+			X64Reg base = gpr.MapSrc(inst.src1);
+			X64Reg value = fpr.MapSrc(inst.src3);
+			OpArg mem = ComputeAddress(emit, base, inst.constant);
+			emit->MOVSS(mem, value);
+			break;
+		}
+
+		case IROp::FCmp:
+		{
+			X64Reg d = gpr.MapDest(IRREG_FPCOND);
+			if (inst.dest == IRFpCompareMode::False) {
+				emit->XOR(32, R(d), R(d));
+				break;
+			}
+			// CMPSS gives all ones when true.  Like the C compares, only unordered is true for NaNs.
+			u8 compare;
+			switch (inst.dest) {
+			case IRFpCompareMode::EitherUnordered: compare = CMP_UNORD; break;
+			case IRFpCompareMode::EqualOrdered:
+			case IRFpCompareMode::EqualUnordered: compare = CMP_EQ; break;
+			case IRFpCompareMode::LessOrdered:
+			case IRFpCompareMode::LessUnordered: compare = CMP_LT; break;
+			default: compare = CMP_LE; break;
+			}
+			X64Reg s1 = fpr.MapSrc(inst.src1);
+			X64Reg s2 = fpr.MapSrc(inst.src2);
+			emit->MOVAPS(FSCRATCH, R(s1));
+			emit->CMPSS(FSCRATCH, R(s2), compare);
+			emit->MOVD_xmm(R(d), FSCRATCH);
+			emit->AND(32, R(d), Imm32(1));
+			break;
+		}
 
-			// VFPU flag/control
-		case IROp::SetCtrlVFPU:
-		case IROp::SetCtrlVFPUReg:
-		case IROp::SetCtrlVFPUFReg:
 		case IROp::ZeroFpCond:
+		{
+			X64Reg d = gpr.MapDest(IRREG_FPCOND);
+			emit->XOR(32, R(d), R(d));
+			break;
+		}
+		case IROp::FpCondToReg:
+		{
+			X64Reg s = gpr.MapSrc(IRREG_FPCOND);
+			X64Reg d = gpr.MapDest(inst.dest);
+			if (d != s)
+				emit->MOV(32, R(d), R(s));
+			break;
+		}
+
+		case IROp::Downcount:
+			emit->SUB(32, MIPSStateArg(downcountOffset), Imm32(inst.constant));
+			break;
+
+		case IROp::SetPC:
+		{
+			X64Reg s1 = gpr.MapSrc(inst.src1);
+			emit->MOV(32, MIPSStateArg(pcOffset), R(s1));
+			break;
+		}
+		case IROp::SetPCConst:
+			emit->MOV(32, MIPSStateArg(pcOffset), Imm32(inst.constant));
+			break;
 
-			// Block Exits
 		case IROp::ExitToConst:
+			emit->MOV(32, R(EAX), Imm32(inst.constant));
+			exitToEAX(true);
+			ended = true;
+			break;
+
 		case IROp::ExitToReg:
+			emit->MOV(32, R(EAX), R(gpr.MapSrc(inst.src1)));
+			exitToEAX(true);
+			ended = true;
+			break;
+
+		case IROp::ExitToPC:
+			flushAll(true);
+			emit->MOV(32, R(EAX), MIPSStateArg(pcOffset));
+			EmitEpilogue(emit);
+			ended = true;
+			break;
+
 		case IROp::ExitToConstIfEq:
 		case IROp::ExitToConstIfNeq:
 		case IROp::ExitToConstIfGtZ:
 		case IROp::ExitToConstIfGeZ:
 		case IROp::ExitToConstIfLtZ:
 		case IROp::ExitToConstIfLeZ:
-		case IROp::ExitToPC:
+		{
+			X64Reg s1 = gpr.MapSrc(inst.src1);
+			if (inst.op == IROp::ExitToConstIfEq || inst.op == IROp::ExitToConstIfNeq) {
+				X64Reg s2 = gpr.MapSrc(inst.src2);
+				emit->CMP(32, R(s1), R(s2));
+			} else {
+				emit->CMP(32, R(s1), Imm32(0));
+			}
+			FixupBranch skip = emit->J_CC((CCFlags)(ExitCondition(inst.op) ^ 1), true);
+			// Keep the mapping, we continue on the other side.
+			emit->MOV(32, R(EAX), Imm32(inst.constant));
+			exitToEAX(false);
+			emit->SetJumpTarget(skip);
+			break;
+		}
 
-			// Utilities
-		case IROp::Downcount:
-		case IROp::SetPC:
-		case IROp::SetPCConst:
-		case IROp::Syscall:
-		case IROp::Interpret:  // SLOW fallback. Can be made faster.
-		case IROp::CallReplacement:
-		case IROp::Break:
 		default:
+			native = false;
 			break;
+		}
+
+		if (!native) {
+			// Everything lives in MIPSState while the interpreter runs the op.
+			flushAll(true);
+			emit->ABI_CallFunctionPPC((const void *)&IRInterpretPartial, mips_, (void *)&inst, 1);
+			const IRMeta *meta = GetIRMeta(inst.op);
+			bool mayExit = (meta && (meta->flags & IRFLAG_EXIT) != 0) || inst.op == IROp::Break || inst.op == IROp::Breakpoint || inst.op == IROp::MemoryCheck;
+			if (mayExit) {
+				// A non-zero return is the new PC.
+				emit->TEST(32, R(EAX), R(EAX));
+				FixupBranch skip = emit->J_CC(CC_Z, true);
+				EmitEpilogue(emit);
+				emit->SetJumpTarget(skip);
 			}
+			blockFallbackOps++;
+		} else {
+			blockNativeOps++;
 		}
+		gpr.UnlockAll();
+		fpr.UnlockAll();
 	}
 
+	if (!ended) {
+		// Shouldn't happen with a well formed block, but let's just return to the dispatcher.
+		flushAll(true);
+		emit->MOV(32, R(EAX), MIPSStateArg(pcOffset));
+		EmitEpilogue(emit);
+	}
+
+	if (blockFallbackOps > blockNativeOps) {
+		// Each of those flushes everything and calls out, so it's faster to just interpret the
+		// whole block.  Throw away what we generated and do that instead.
+		code_.SetCodePtr((u8 *)start);
+		EmitPrologue(emit);
+		emit->ABI_CallFunctionPPC((const void *)&IRInterpret, mips_, (void *)instructions, count);
+		EmitEpilogue(emit);
+		interpretedBlocks_++;
+		interpretedOps_ += count;
+	} else {
+		fallbackOps_ += blockFallbackOps;
+		nativeOps_ += blockNativeOps;
+	}
+
+	code_.EndWrite();
+	return start;
+}
 
-}  // namespace
+}  // namespace MIPSComp
 
-#endif // PPSSPP_ARCH(X86) || PPSSPP_ARCH(AMD64)
+#endif  // PPSSPP_ARCH(AMD64)
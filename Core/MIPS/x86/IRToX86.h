@@ -1,23 +1,66 @@
+#pragma once
+
+#include "ppsspp_config.h"
 #include "Core/MIPS/IR/IRInst.h"
+#if PPSSPP_ARCH(AMD64)
 #include "Common/x64Emitter.h"
+#endif
+
+class MIPSState;
 
 namespace MIPSComp {
 
+// Native code generated for an IR block.  Returns the new PC, like IRInterpret.
+typedef u32 (*IRNativeFunc)(MIPSState *mips);
+
 class IRToNativeInterface {
 public:
 	virtual ~IRToNativeInterface() {}
 
-	virtual void ConvertIRToNative(const IRInst *instructions, int count, const u32 *constants) = 0;
+	// Returns nullptr if there's not enough space left, the caller should clear and retry.
+	virtual const u8 *ConvertIRToNative(const IRInst *instructions, int count) = 0;
+	virtual void ClearCode() = 0;
+	virtual bool IsInSpace(const u8 *ptr) = 0;
+	virtual size_t GetSpaceLeft() const = 0;
+
+	// For statistics: ops called back into the interpreter one at a time, ops compiled, and
+	// blocks (and their ops) that were mostly unsupported, so they're just interpreted.
+	virtual int NumFallbackOps() const = 0;
+	virtual int NumNativeOps() const = 0;
+	virtual int NumInterpretedBlocks() const = 0;
+	virtual int NumInterpretedOps() const = 0;
 };
 
+#if PPSSPP_ARCH(AMD64)
 
 class IRToX86 : public IRToNativeInterface {
 public:
-	void SetCodeBlock(Gen::XCodeBlock *code) { code_ = code; }
-	virtual void ConvertIRToNative(const IRInst *instructions, int count, const u32 *constants) override;
+	IRToX86(MIPSState *mips);
+	~IRToX86();
+
+	const u8 *ConvertIRToNative(const IRInst *instructions, int count) override;
+	void ClearCode() override;
+	bool IsInSpace(const u8 *ptr) override {
+		return code_.IsInSpace(ptr);
+	}
+	size_t GetSpaceLeft() const override {
+		return code_.GetSpaceLeft();
+	}
+
+	int NumFallbackOps() const override { return fallbackOps_; }
+	int NumNativeOps() const override { return nativeOps_; }
+	int NumInterpretedBlocks() const override { return interpretedBlocks_; }
+	int NumInterpretedOps() const override { return interpretedOps_; }
 
 private:
-	Gen::XCodeBlock *code_;
+	Gen::XCodeBlock code_;
+	MIPSState *mips_;
+	int fallbackOps_ = 0;
+	int nativeOps_ = 0;
+	int interpretedBlocks_ = 0;
+	int interpretedOps_ = 0;
 };
 
+#endif
+
 }  // namespace
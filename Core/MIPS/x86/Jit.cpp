@@ -25,6 +25,8 @@
 #include "profiler/profiler.h"
 
 #include "Common/ChunkFile.h"
+#include "Common/ExceptionHandlerSetup.h"
+#include "Common/x64Analyzer.h"
 #include "Core/Core.h"
 #include "Core/MemMap.h"
 #include "Core/System.h"
@@ -47,6 +49,7 @@
 namespace MIPSComp
 {
 using namespace Gen;
+using namespace X64JitConstants;
 
 const bool USE_JIT_MISSMAP = false;
 static std::map<std::string, u32> notJitOps;
@@ -202,6 +205,8 @@ void Jit::UpdateRoundingMode() {
 void Jit::ClearCache()
 {
 	blocks.Clear();
+	backpatchSites_.clear();
+	safeMemFuncs.ClearTrampolines();
 	ClearCodeSpace(0);
 	GenerateFixedCode(jo);
 }
@@ -337,6 +342,13 @@ const u8 *Jit::DoJit(u32 em_address, JitBlock *b) {
 
 	b->normalEntry = GetCodePtr();
 
+	if (jo.enableBlockProfiling) {
+		// Nothing is mapped yet, so RAX is free.
+		MOV(PTRBITS, R(RAX), ImmPtr(blocks.GetBlockExecutionCounter(b->blockNum)));
+		ADD(32, MatR(RAX), Imm8(1));
+		ADC(32, MDisp(RAX, 4), Imm8(0));
+	}
+
 	MIPSAnalyst::AnalysisResults analysis = MIPSAnalyst::Analyze(em_address);
 
 	gpr.Start(mips_, &js, &jo, analysis);
@@ -391,6 +403,9 @@ const u8 *Jit::DoJit(u32 em_address, JitBlock *b) {
 	}
 
 	b->codeSize = (u32)(GetCodePtr() - b->normalEntry);
+	if (jo.enableBlockProfiling) {
+		blocks.SetBlockCycleEstimate(b->blockNum, js.downcountAmount);
+	}
 	NOP();
 	AlignCode4();
 	if (js.lastContinuedPC == 0) {
@@ -503,6 +518,76 @@ void Jit::UnlinkBlock(u8 *checkedEntry, u32 originalAddress) {
 	}
 }
 
+bool Jit::CanBackpatch() const {
+#if PPSSPP_ARCH(AMD64) && !defined(MASKED_PSP_MEMORY)
+	// The patched access can't stop the core right after itself, so only when bad accesses
+	// are ignored anyway.  Otherwise, the checked path has to flush state first.
+	return g_Config.bIgnoreBadMemAccess && IsExceptionHandlerInstalled();
+#else
+	return false;
+#endif
+}
+
+void Jit::RegisterBackpatchSite(const u8 *codePtr, int size, bool isWrite) {
+	BackpatchSite site;
+	site.codeOffset = (u32)GetOffset(codePtr);
+	site.size = (u8)size;
+	site.isWrite = isWrite;
+	backpatchSites_.push_back(site);
+}
+
+const u8 *Jit::HandleMemoryFault(const u8 *codePtr) {
+#if PPSSPP_ARCH(AMD64) && !defined(MASKED_PSP_MEMORY)
+	// We're inside the fault handler here, so no logging or allocating.
+	if (!IsInSpace(codePtr))
+		return nullptr;
+
+	const u32 offset = (u32)GetOffset(codePtr);
+	auto site = std::lower_bound(backpatchSites_.begin(), backpatchSites_.end(), offset, [](const BackpatchSite &site, u32 offset) {
+		return site.codeOffset < offset;
+	});
+	if (site == backpatchSites_.end() || site->codeOffset != offset)
+		return nullptr;
+
+	InstructionInfo info;
+	if (!DisassembleMov(codePtr, info, site->isWrite ? OP_ACCESS_WRITE : OP_ACCESS_READ))
+		return nullptr;
+	if (info.instructionSize > site->size || info.operandSize > 4 || info.scale != 1 || info.scaledReg == -1)
+		return nullptr;
+
+	// One side is always MEMBASEREG, the other the guest address.
+	X64Reg addrReg;
+	if (info.otherReg == MEMBASEREG)
+		addrReg = (X64Reg)info.scaledReg;
+	else if (info.scaledReg == MEMBASEREG)
+		addrReg = (X64Reg)info.otherReg;
+	else
+		return nullptr;
+
+	const u8 *returnPtr = codePtr + site->size;
+	const u8 *trampoline = safeMemFuncs.CreateBackpatchTrampoline(info, addrReg, site->isWrite, returnPtr);
+	if (!trampoline)
+		return nullptr;
+
+	// From now on this access always takes the slow path.
+	u8 *writable = (u8 *)codePtr;
+	if (PlatformIsWXExclusive()) {
+		ProtectMemoryPages(writable, site->size, MEM_PROT_READ | MEM_PROT_WRITE);
+	}
+	XEmitter emit(writable);
+	emit.JMP(trampoline, true);
+	if (site->size > 5)
+		emit.NOP(site->size - 5);
+	if (PlatformIsWXExclusive()) {
+		ProtectMemoryPages(writable, site->size, MEM_PROT_READ | MEM_PROT_EXEC);
+	}
+
+	return trampoline;
+#else
+	return nullptr;
+#endif
+}
+
 bool Jit::ReplaceJalTo(u32 dest) {
 	const ReplacementTableEntry *entry = nullptr;
 	u32 funcSize = 0;
@@ -179,7 +179,20 @@ class Jit : public Gen::XCodeBlock, public JitInterface, public MIPSFrontendInte
 	void LinkBlock(u8 *exitPoint, const u8 *checkedEntry) override;
 	void UnlinkBlock(u8 *checkedEntry, u32 originalAddress) override;
 
+	const u8 *HandleMemoryFault(const u8 *codePtr) override;
+
 private:
+	// A fast memory access that will be patched to call the slow path if it faults.
+	struct BackpatchSite {
+		u32 codeOffset;
+		// Includes padding, always enough for a JMP.
+		u8 size;
+		bool isWrite;
+	};
+
+	bool CanBackpatch() const;
+	void RegisterBackpatchSite(const u8 *codePtr, int size, bool isWrite);
+
 	void GenerateFixedCode(JitOptions &jo);
 	void GetStateAndFlushAll(RegCacheState &state);
 	void RestoreState(const RegCacheState& state);
@@ -307,6 +320,8 @@ class Jit : public Gen::XCodeBlock, public JitInterface, public MIPSFrontendInte
 
 	ThunkManager thunks;
 	JitSafeMemFuncs safeMemFuncs;
+	// Sorted, since code is only ever appended until the cache is cleared.
+	std::vector<BackpatchSite> backpatchSites_;
 
 	MIPSState *mips_;
 
@@ -51,7 +51,7 @@ void JitMemCheckCleanup()
 }
 
 JitSafeMem::JitSafeMem(Jit *jit, MIPSGPReg raddr, s32 offset, u32 alignMask)
-	: jit_(jit), raddr_(raddr), offset_(offset), needsCheck_(false), needsSkip_(false), alignMask_(alignMask)
+	: jit_(jit), raddr_(raddr), offset_(offset), needsCheck_(false), needsSkip_(false), backpatch_(false), backpatchStart_(nullptr), alignMask_(alignMask)
 {
 	// Mask out the kernel RAM bit, because we'll end up with a negative offset to MEMBASEREG.
 	if (jit_->gpr.IsImm(raddr_))
@@ -68,6 +68,16 @@ JitSafeMem::JitSafeMem(Jit *jit, MIPSGPReg raddr, s32 offset, u32 alignMask)
 		jit_->gpr.MapReg(raddr_, true, false);
 }
 
+void JitSafeMem::AllowBackpatch()
+{
+	// Immediate addresses are already checked while compiling.
+	if (iaddr_ == (u32) -1 && jit_->CanBackpatch())
+	{
+		backpatch_ = true;
+		fast_ = true;
+	}
+}
+
 bool JitSafeMem::PrepareWrite(OpArg &dest, int size)
 {
 	size_ = size;
@@ -204,6 +214,9 @@ OpArg JitSafeMem::PrepareMemoryOpArg(MemoryOpType type)
 		jit_->SUB(32, R(xaddr_), Imm32(offset_));
 	}
 
+	// The caller's MOV comes next.
+	backpatchStart_ = jit_->GetCodePtr();
+
 #if PPSSPP_ARCH(32BIT)
 	return MDisp(xaddr_, (u32) Memory::base + offset_);
 #else
@@ -229,6 +242,12 @@ void JitSafeMem::PrepareSlowAccess()
 
 bool JitSafeMem::PrepareSlowWrite()
 {
+	if (backpatch_)
+	{
+		RegisterBackpatch(MEM_WRITE);
+		return false;
+	}
+
 	// If it's immediate, we only need a slow write on invalid.
 	if (iaddr_ != (u32) -1)
 		return !fast_ && !ImmValid();
@@ -272,6 +291,12 @@ void JitSafeMem::DoSlowWrite(const void *safeFunc, const OpArg& src, int suboffs
 
 bool JitSafeMem::PrepareSlowRead(const void *safeFunc)
 {
+	if (backpatch_)
+	{
+		RegisterBackpatch(MEM_READ);
+		return false;
+	}
+
 	if (!fast_)
 	{
 		if (iaddr_ != (u32) -1)
@@ -335,6 +360,18 @@ bool JitSafeMem::ImmValid()
 	return iaddr_ != (u32) -1 && Memory::IsValidAddress(iaddr_) && Memory::IsValidAddress(iaddr_ + size_ - 1);
 }
 
+void JitSafeMem::RegisterBackpatch(MemoryOpType type)
+{
+	// Leave room to patch in a JMP to the trampoline.
+	int size = (int)(jit_->GetCodePtr() - backpatchStart_);
+	if (size < 5)
+	{
+		jit_->NOP(5 - size);
+		size = 5;
+	}
+	jit_->RegisterBackpatchSite(backpatchStart_, size, type == MEM_WRITE);
+}
+
 void JitSafeMem::Finish()
 {
 	// Memory::Read_U32/etc. may have tripped coreState.
@@ -454,6 +491,8 @@ void JitSafeMemFuncs::Init(ThunkManager *thunks) {
 	CreateWriteFunc(16, (const void *)&Memory::Write_U16);
 	writeU8 = GetCodePtr();
 	CreateWriteFunc(8, (const void *)&Memory::Write_U8);
+
+	trampolinesStart_ = AlignCode16();
 	EndWrite();
 }
 
@@ -462,6 +501,77 @@ void JitSafeMemFuncs::Shutdown() {
 	FreeCodeSpace();
 }
 
+void JitSafeMemFuncs::ClearTrampolines() {
+	ClearCodeSpace((int)GetOffset(trampolinesStart_));
+}
+
+const u8 *JitSafeMemFuncs::CreateBackpatchTrampoline(const InstructionInfo &info, X64Reg addrReg, bool isWrite, const u8 *returnPtr) {
+#if PPSSPP_ARCH(AMD64)
+	// Plenty for the longest one.
+	if (GetSpaceLeft() < 128)
+		return nullptr;
+
+	const u8 *funcs[] = { nullptr, readU8, readU16, nullptr, readU32 };
+	if (isWrite) {
+		funcs[1] = writeU8;
+		funcs[2] = writeU16;
+		funcs[4] = writeU32;
+	}
+	const int bits = info.operandSize * 8;
+	const X64Reg reg = (X64Reg)info.regOperandReg;
+
+	BeginWrite();
+	const u8 *start = GetCodePtr();
+
+	// The funcs below take the address in EAX and data in EDX.  Two pushes keep the stack aligned.
+	PUSH(RAX);
+	PUSH(RDX);
+	if (isWrite && !info.hasImmediate && reg == RAX) {
+		if (addrReg == RDX) {
+			XCHG(64, R(RAX), R(RDX));
+			addrReg = RAX;
+		} else {
+			MOV(32, R(EDX), R(EAX));
+		}
+		LEA(32, EAX, MDisp(addrReg, info.displacement));
+	} else {
+		LEA(32, EAX, MDisp(addrReg, info.displacement));
+		if (isWrite && info.hasImmediate)
+			MOV(32, R(EDX), Imm32((u32)info.immediate));
+		else if (isWrite && reg != RDX)
+			MOV(32, R(EDX), R(reg));
+	}
+
+	// Sites only exist when bad accesses are ignored, so this can just continue.
+	CALL(funcs[info.operandSize]);
+
+	if (isWrite) {
+		POP(RDX);
+		POP(RAX);
+	} else {
+		if (info.signExtend)
+			MOVSX(32, bits, reg, R(EAX));
+		else
+			MOVZX(32, bits, reg, R(EAX));
+		// Don't restore the register we just loaded.
+		if (reg == RDX)
+			ADD(64, R(RSP), Imm8(8));
+		else
+			POP(RDX);
+		if (reg == RAX)
+			ADD(64, R(RSP), Imm8(8));
+		else
+			POP(RAX);
+	}
+	JMP(returnPtr, true);
+
+	EndWrite();
+	return start;
+#else
+	return nullptr;
+#endif
+}
+
 // Mini ABI:
 //   Read funcs take address in EAX, return in RAX.
 //   Write funcs take address in EAX, data in RDX.
@@ -19,6 +19,8 @@
 
 #include <vector>
 
+#include "Common/x64Analyzer.h"
+
 class ThunkManager;
 
 namespace MIPSComp {
@@ -29,6 +31,11 @@ class JitSafeMem {
 public:
 	JitSafeMem(Jit *jit, MIPSGPReg raddr, s32 offset, u32 alignMask = 0xFFFFFFFF);
 
+	// Call before Prepare*(), only when the fast path is a single MOV to or from a GPR.
+	// If the host fault handler is available and bad accesses are ignored, that MOV is
+	// unchecked, and gets patched to call the slow path the first time it faults.
+	void AllowBackpatch();
+
 	// Emit code necessary for a memory write, returns true if MOV to dest is needed.
 	bool PrepareWrite(Gen::OpArg &dest, int size);
 	// Emit code proceeding a slow write call, returns true if slow write is needed.
@@ -72,6 +79,7 @@ class JitSafeMem {
 	void MemCheckImm(MemoryOpType type);
 	void MemCheckAsm(MemoryOpType type);
 	bool ImmValid();
+	void RegisterBackpatch(MemoryOpType type);
 
 	Jit *jit_;
 	MIPSGPReg raddr_;
@@ -80,6 +88,8 @@ class JitSafeMem {
 	bool needsCheck_;
 	bool needsSkip_;
 	bool fast_;
+	bool backpatch_;
+	const u8 *backpatchStart_;
 	u32 alignMask_;
 	u32 iaddr_;
 	Gen::X64Reg xaddr_;
@@ -101,6 +111,11 @@ class JitSafeMemFuncs : public Gen::XCodeBlock
 	void Init(ThunkManager *thunks);
 	void Shutdown();
 
+	// Does the faulted MOV described by info through the slow path, then jumps to returnPtr.
+	// Returns nullptr if out of space.
+	const u8 *CreateBackpatchTrampoline(const InstructionInfo &info, Gen::X64Reg addrReg, bool isWrite, const u8 *returnPtr);
+	void ClearTrampolines();
+
 	const u8 *readU32;
 	const u8 *readU16;
 	const u8 *readU8;
@@ -117,6 +132,7 @@ class JitSafeMemFuncs : public Gen::XCodeBlock
 
 	std::vector<Gen::FixupBranch> skips_;
 	ThunkManager *thunks_;
+	const u8 *trampolinesStart_;
 };
 
 };
@@ -0,0 +1,49 @@
+// Copyright (c) 2017- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include "ppsspp_config.h"
+
+#include "Core/MemFault.h"
+#include "Core/MemMap.h"
+#include "Core/MIPS/JitCommon/JitCommon.h"
+
+namespace Memory {
+
+bool HandleFault(uintptr_t hostAddress, uintptr_t *pc) {
+#if PPSSPP_ARCH(64BIT) && !defined(MASKED_PSP_MEMORY)
+	if (!MIPSComp::jit || !base) {
+		return false;
+	}
+
+	// The jit adds a signed 16-bit offset to the 32-bit guest address, so allow for that.
+	const uintptr_t baseAddress = (uintptr_t)base;
+	if (hostAddress < baseAddress - 0x8000 || hostAddress >= baseAddress + 0x100000000ULL + 0x8000) {
+		return false;
+	}
+
+	const u8 *resume = MIPSComp::jit->HandleMemoryFault((const u8 *)*pc);
+	if (!resume) {
+		return false;
+	}
+	*pc = (uintptr_t)resume;
+	return true;
+#else
+	return false;
+#endif
+}
+
+}
@@ -325,10 +325,10 @@ void DoState(PointerWrap &p) {
 		}
 	}
 
-	p.DoArray(GetPointer(PSP_GetKernelMemoryBase()), g_MemorySize);
+	p.DoBulk(GetPointer(PSP_GetKernelMemoryBase()), g_MemorySize);
 	p.DoMarker("RAM");
 
-	p.DoArray(m_pPhysicalVRAM1, VRAM_SIZE);
+	p.DoBulk(m_pPhysicalVRAM1, VRAM_SIZE);
 	p.DoMarker("VRAM");
 	p.DoArray(m_pPhysicalScratchPad, SCRATCHPAD_SIZE);
 	p.DoMarker("ScratchPad");
@@ -16,9 +16,15 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <snappy-c.h>
 
 #include "base/timeutil.h"
 #include "i18n/i18n.h"
@@ -26,6 +32,7 @@
 
 #include "Common/FileUtil.h"
 #include "Common/ChunkFile.h"
+#include "Common/ThreadPools.h"
 
 #include "Core/SaveState.h"
 #include "Core/Config.h"
@@ -93,147 +100,290 @@ namespace SaveState
 		return CChunkFileReader::LoadPtr(&data[0], state);
 	}
 
-	struct StateRingbuffer
+	// Where Memory::DoState started writing during the last rewind capture, so rewind snapshots
+	// can line up RAM between states even if the sections before it change size.
+	static size_t saveMemoryOffset = 0;
+
+	// Rewind snapshots, stored as snappy-compressed blocks.  Blocks that didn't change since the
+	// previous snapshot are shared with it, so each snapshot mostly costs the RAM pages that were
+	// written.  The CPU thread only serializes, in one pass; diffing and compression happen on a
+	// private worker thread, so they never hold up the global thread pool (audio, texture scaling.)
+	// Old snapshots are dropped to stay within a byte budget.
+	class RewindSnapshots
 	{
-		StateRingbuffer(int size) : first_(0), next_(0), size_(size), base_(-1)
+	public:
+		~RewindSnapshots()
 		{
-			states_.resize(size);
-			baseMapping_.resize(size);
+			StopWorker();
 		}
 
-		CChunkFileReader::Error Save()
+		// Returns false if the last snapshot is still being compressed.  Nothing is taken then,
+		// rather than stalling the CPU thread.
+		bool Save()
 		{
-			std::lock_guard<std::mutex> guard(lock_);
-
-			int n = next_++ % size_;
-			if ((next_ % size_) == first_)
-				++first_;
-
-			static std::vector<u8> buffer;
-			std::vector<u8> *compressBuffer = &buffer;
-			CChunkFileReader::Error err;
+			{
+				std::lock_guard<std::mutex> guard(lock_);
+				if (busy_)
+				{
+					++skipped_;
+					// Powers of two, so a slow worker doesn't flood the log.
+					if ((skipped_ & (skipped_ - 1)) == 0)
+						WARN_LOG(SAVESTATE, "Rewind snapshot still compressing, skipped %d so far", skipped_);
+					return false;
+				}
+			}
 
-			if (base_ == -1 || ++baseUsage_ > BASE_USAGE_INTERVAL)
+			SaveStart state;
+			saveMemoryOffset = 0;
+			CChunkFileReader::Error err = CChunkFileReader::SaveVector(captureBuffer_, state);
+			if (err != CChunkFileReader::ERROR_NONE)
 			{
-				base_ = (base_ + 1) % ARRAY_SIZE(bases_);
-				baseUsage_ = 0;
-				err = SaveToRam(bases_[base_]);
-				// Let's not bother savestating twice.
-				compressBuffer = &bases_[base_];
+				ERROR_LOG(SAVESTATE, "Failed to capture rewind state");
+				return true;
 			}
-			else
-				err = SaveToRam(buffer);
-
-			if (err == CChunkFileReader::ERROR_NONE)
-				ScheduleCompress(&states_[n], compressBuffer, &bases_[base_]);
-			else
-				states_[n].clear();
-			baseMapping_[n] = base_;
-			return err;
+
+			size_t memOffset = saveMemoryOffset < captureBuffer_.size() ? saveMemoryOffset : 0;
+
+			std::lock_guard<std::mutex> guard(lock_);
+			if (!worker_)
+				worker_ = new std::thread(std::bind(&RewindSnapshots::WorkerLoop, this));
+			pending_.swap(captureBuffer_);
+			pendingMemOffset_ = memOffset;
+			busy_ = true;
+			++saved_;
+			workCond_.notify_one();
+			return true;
 		}
 
 		CChunkFileReader::Error Restore()
 		{
-			std::lock_guard<std::mutex> guard(lock_);
+			std::unique_lock<std::mutex> guard(lock_);
+			WaitIdle(guard);
 
 			// No valid states left.
-			if (Empty())
+			if (snapshots_.empty())
 				return CChunkFileReader::ERROR_BAD_FILE;
 
-			int n = (--next_ + size_) % size_;
-			if (states_[n].empty())
-				return CChunkFileReader::ERROR_BAD_FILE;
+			Snapshot snapshot = snapshots_.back();
+			snapshots_.pop_back();
+			guard.unlock();
 
 			static std::vector<u8> buffer;
-			LockedDecompress(buffer, states_[n], bases_[baseMapping_[n]]);
+			Decompress(buffer, snapshot);
 			return LoadFromRam(buffer);
 		}
 
-		void ScheduleCompress(std::vector<u8> *result, const std::vector<u8> *state, const std::vector<u8> *base)
+		void Clear()
+		{
+			// This lock is mainly for shutdown.
+			std::unique_lock<std::mutex> guard(lock_);
+			WaitIdle(guard);
+			snapshots_.clear();
+			last_ = Snapshot();
+			lastRaw_.clear();
+		}
+
+		bool Empty()
 		{
-			auto th = new std::thread([=]{
-				setCurrentThreadName("SaveStateCompress");
-				Compress(*result, *state, *base);
-			});
-			th->detach();
+			std::unique_lock<std::mutex> guard(lock_);
+			return snapshots_.empty() && !busy_;
 		}
 
-		void Compress(std::vector<u8> &result, const std::vector<u8> &state, const std::vector<u8> &base)
+		void SetBudget(size_t bytes)
 		{
 			std::lock_guard<std::mutex> guard(lock_);
-			// Bail if we were cleared before locking.
-			if (first_ == 0 && next_ == 0)
+			budget_ = bytes;
+		}
+
+		RewindStats GetStats()
+		{
+			std::lock_guard<std::mutex> guard(lock_);
+			RewindStats stats;
+			stats.snapshots = (int)snapshots_.size();
+			stats.saved = saved_;
+			stats.skipped = skipped_;
+			stats.bytes = totalBytes_;
+			stats.budget = budget_;
+			return stats;
+		}
+
+		void StopWorker()
+		{
+			std::unique_lock<std::mutex> guard(lock_);
+			if (!worker_)
 				return;
+			WaitIdle(guard);
+			stop_ = true;
+			workCond_.notify_one();
+			guard.unlock();
+
+			worker_->join();
+			delete worker_;
+			worker_ = nullptr;
+			stop_ = false;
+		}
 
-			result.clear();
-			for (size_t i = 0; i < state.size(); i += BLOCK_SIZE)
+	private:
+		static const size_t BLOCK_SIZE;
+		static const int DECOMPRESS_CHUNK;
+
+		struct Block
+		{
+			Block(std::atomic<size_t> &total) : totalBytes(total), rawSize(0) {}
+			~Block()
 			{
-				int blockSize = std::min(BLOCK_SIZE, (int)(state.size() - i));
-				if (i + blockSize > base.size() || memcmp(&state[i], &base[i], blockSize) != 0)
-				{
-					result.push_back(1);
-					result.insert(result.end(), state.begin() + i, state.begin() +i + blockSize);
-				}
-				else
-					result.push_back(0);
+				totalBytes -= data.size();
 			}
+
+			std::atomic<size_t> &totalBytes;
+			std::vector<u8> data;
+			size_t rawSize;
+		};
+		typedef std::shared_ptr<Block> BlockPtr;
+
+		struct Snapshot
+		{
+			// The sections before Memory::DoState, then everything from RAM on.
+			std::vector<BlockPtr> header;
+			std::vector<BlockPtr> memory;
+			size_t memOffset = 0;
+			size_t size = 0;
+		};
+
+		void WaitIdle(std::unique_lock<std::mutex> &guard)
+		{
+			while (busy_)
+				doneCond_.wait(guard);
 		}
 
-		void LockedDecompress(std::vector<u8> &result, const std::vector<u8> &compressed, const std::vector<u8> &base)
+		void WorkerLoop()
 		{
-			result.clear();
-			result.reserve(base.size());
-			auto basePos = base.begin();
-			for (size_t i = 0; i < compressed.size(); )
+			setCurrentThreadName("RewindCompress");
+
+			std::vector<u8> work;
+			std::unique_lock<std::mutex> guard(lock_);
+			while (true)
 			{
-				if (compressed[i] == 0)
-				{
-					++i;
-					int blockSize = std::min(BLOCK_SIZE, (int)(base.size() - result.size()));
-					result.insert(result.end(), basePos, basePos + blockSize);
-					basePos += blockSize;
-				}
-				else
-				{
-					++i;
-					int blockSize = std::min(BLOCK_SIZE, (int)(compressed.size() - i));
-					result.insert(result.end(), compressed.begin() + i, compressed.begin() + i + blockSize);
-					i += blockSize;
-					basePos += blockSize;
-				}
+				while (!busy_ && !stop_)
+					workCond_.wait(guard);
+				if (stop_)
+					break;
+
+				work.swap(pending_);
+				size_t memOffset = pendingMemOffset_;
+				guard.unlock();
+
+				Snapshot snapshot = BuildSnapshot(work, memOffset);
+
+				guard.lock();
+				snapshots_.push_back(snapshot);
+				// Always keep at least the newest, even if it alone is over budget.
+				while (snapshots_.size() > 1 && totalBytes_ > budget_)
+					snapshots_.pop_front();
+				last_ = snapshot;
+				lastRaw_.swap(work);
+				busy_ = false;
+				doneCond_.notify_all();
 			}
 		}
 
-		void Clear()
+		Snapshot BuildSnapshot(const std::vector<u8> &state, size_t memOffset)
 		{
-			// This lock is mainly for shutdown.
-			std::lock_guard<std::mutex> guard(lock_);
-			first_ = 0;
-			next_ = 0;
-		}
+			Snapshot snapshot;
+			snapshot.memOffset = memOffset;
+			snapshot.size = state.size();
+
+			// Find which blocks changed since the last snapshot, and reuse the rest.
+			std::vector<std::pair<Block *, const u8 *>> changed;
+			auto diffSegment = [&](std::vector<BlockPtr> &blocks, const std::vector<BlockPtr> &lastBlocks, size_t start, size_t end, size_t lastStart, size_t lastEnd) {
+				blocks.resize((end - start + BLOCK_SIZE - 1) / BLOCK_SIZE);
+				for (size_t i = 0; i < blocks.size(); ++i)
+				{
+					size_t pos = start + i * BLOCK_SIZE;
+					size_t lastPos = lastStart + i * BLOCK_SIZE;
+					size_t sz = std::min(BLOCK_SIZE, end - pos);
+					bool sameSize = i < lastBlocks.size() && lastPos + sz <= lastEnd && lastBlocks[i]->rawSize == sz;
+					if (sameSize && memcmp(&state[pos], &lastRaw_[lastPos], sz) == 0)
+					{
+						blocks[i] = lastBlocks[i];
+					}
+					else
+					{
+						blocks[i] = std::make_shared<Block>(totalBytes_);
+						blocks[i]->rawSize = sz;
+						changed.push_back(std::make_pair(blocks[i].get(), &state[pos]));
+					}
+				}
+			};
+			diffSegment(snapshot.header, last_.header, 0, memOffset, 0, last_.memOffset);
+			diffSegment(snapshot.memory, last_.memory, memOffset, state.size(), last_.memOffset, last_.size);
 
-		bool Empty() const
-		{
-			return next_ == first_;
-		}
+			for (auto &change : changed)
+			{
+				Block *block = change.first;
+				block->data.resize(snappy_max_compressed_length(block->rawSize));
+				size_t compressedSize = block->data.size();
+				snappy_compress((const char *)change.second, block->rawSize, (char *)&block->data[0], &compressedSize);
+				block->data.resize(compressedSize);
+				block->data.shrink_to_fit();
+				block->totalBytes += compressedSize;
+			}
 
-		static const int BLOCK_SIZE;
-		// TODO: Instead, based on size of compressed state?
-		static const int BASE_USAGE_INTERVAL;
+			return snapshot;
+		}
 
-		typedef std::vector<u8> StateBuffer;
+		void Decompress(std::vector<u8> &result, const Snapshot &snapshot)
+		{
+			std::vector<std::pair<const Block *, size_t>> blocks;
+			size_t pos = 0;
+			for (const BlockPtr &block : snapshot.header)
+			{
+				blocks.push_back(std::make_pair(block.get(), pos));
+				pos += block->rawSize;
+			}
+			for (const BlockPtr &block : snapshot.memory)
+			{
+				blocks.push_back(std::make_pair(block.get(), pos));
+				pos += block->rawSize;
+			}
 
-		int first_;
-		int next_;
-		int size_;
+			result.resize(pos);
+			// The CPU thread is waiting on this, so use the pool, but in bounded chunks so others
+			// can get a turn in between.
+			for (int start = 0; start < (int)blocks.size(); start += DECOMPRESS_CHUNK)
+			{
+				GlobalThreadPool::Loop([&](int lower, int upper) {
+					for (int i = lower; i < upper; ++i)
+					{
+						const Block *block = blocks[i].first;
+						size_t sz = block->rawSize;
+						snappy_uncompress((const char *)&block->data[0], block->data.size(), (char *)&result[blocks[i].second], &sz);
+					}
+				}, start, std::min(start + DECOMPRESS_CHUNK, (int)blocks.size()));
+			}
+		}
 
-		std::vector<StateBuffer> states_;
-		StateBuffer bases_[2];
-		std::vector<int> baseMapping_;
 		std::mutex lock_;
-
-		int base_;
-		int baseUsage_;
+		std::condition_variable workCond_;
+		std::condition_variable doneCond_;
+		std::thread *worker_ = nullptr;
+		bool busy_ = false;
+		bool stop_ = false;
+
+		// Only used on the CPU thread.
+		std::vector<u8> captureBuffer_;
+		// Handed to the worker.
+		std::vector<u8> pending_;
+		size_t pendingMemOffset_ = 0;
+		// The last snapshot, and its raw data to diff against.  Only used by the worker while busy_.
+		Snapshot last_;
+		std::vector<u8> lastRaw_;
+
+		std::deque<Snapshot> snapshots_;
+		std::atomic<size_t> totalBytes_{ 0 };
+		size_t budget_ = 128 * 1024 * 1024;
+		int saved_ = 0;
+		int skipped_ = 0;
 	};
 
 	static bool needsProcess = false;
@@ -241,14 +391,14 @@ namespace SaveState
 	static std::mutex mutex;
 	static bool hasLoadedState = false;
 
-	// TODO: Should this be configurable?
-	static const int REWIND_NUM_STATES = 20;
-	static StateRingbuffer rewindStates(REWIND_NUM_STATES);
-	// TODO: Any reason for this to be configurable?
-	const static float rewindMaxWallFrequency = 1.0f;
+	static RewindSnapshots rewindStates;
 	static float rewindLastTime = 0.0f;
-	const int StateRingbuffer::BLOCK_SIZE = 8192;
-	const int StateRingbuffer::BASE_USAGE_INTERVAL = 15;
+	// Set when a snapshot was skipped, to take it at the next flip instead of waiting a full interval.
+	static bool rewindRetry = false;
+	// Small enough that a few writes don't dirty much, big enough for snappy to work with.
+	const size_t RewindSnapshots::BLOCK_SIZE = 16384;
+	// 1MB of blocks at a time.
+	const int RewindSnapshots::DECOMPRESS_CHUNK = 64;
 
 	void SaveStart::DoState(PointerWrap &p)
 	{
@@ -259,6 +409,10 @@ namespace SaveState
 		// Gotta do CoreTiming first since we'll restore into it.
 		CoreTiming::DoState(p);
 
+		// Only an offset when streaming, like the rewind capture.
+		if (p.mode == p.MODE_WRITE)
+			saveMemoryOffset = (size_t)*p.GetPPtr();
+
 		// Memory is a bit tricky when jit is enabled, since there's emuhacks in it.
 		auto savedReplacements = SaveAndClearReplacements();
 		if (MIPSComp::jit && p.mode == p.MODE_WRITE)
@@ -321,6 +475,11 @@ namespace SaveState
 		return !rewindStates.Empty();
 	}
 
+	RewindStats GetRewindStats()
+	{
+		return rewindStates.GetStats();
+	}
+
 	// Slot utilities
 
 	std::string AppendSlotTitle(const std::string &filename, const std::string &title) {
@@ -532,18 +691,22 @@ namespace SaveState
 #ifndef MOBILE_DEVICE
 	static inline void CheckRewindState()
 	{
-		if (gpuStats.numFlips % g_Config.iRewindFlipFrequency != 0)
-			return;
-
-		// For fast-forwarding, otherwise they may be useless and too close.
 		time_update();
-		float diff = time_now() - rewindLastTime;
-		if (diff < rewindMaxWallFrequency)
-			return;
+		if (!rewindRetry)
+		{
+			if (gpuStats.numFlips % g_Config.iRewindFlipFrequency != 0)
+				return;
+
+			// For fast-forwarding, otherwise they may be useless and too close.
+			float diff = time_now() - rewindLastTime;
+			if (diff < g_Config.iRewindFlipFrequency / 60.0f)
+				return;
+		}
 
 		rewindLastTime = time_now();
 		DEBUG_LOG(BOOT, "saving rewind state");
-		rewindStates.Save();
+		rewindStates.SetBudget((size_t)g_Config.iRewindBudgetMB * 1024 * 1024);
+		rewindRetry = !rewindStates.Save();
 	}
 #endif
 
@@ -580,6 +743,7 @@ namespace SaveState
 			std::string callbackMessage;
 			std::string reason;
 			std::string title;
+			double loadStart;
 
 			I18NCategory *sc = GetI18NCategory("Screen");
 			const char *i18nLoadFailure = sc->T("Load savestate failed", "");
@@ -593,8 +757,10 @@ namespace SaveState
 			{
 			case SAVESTATE_LOAD:
 				INFO_LOG(SAVESTATE, "Loading state from %s", op.filename.c_str());
+				loadStart = real_time_now();
 				result = CChunkFileReader::Load(op.filename, PPSSPP_GIT_VERSION, state, &reason);
 				if (result == CChunkFileReader::ERROR_NONE) {
+					INFO_LOG(SAVESTATE, "Loaded state in %0.1f ms", (real_time_now() - loadStart) * 1000.0);
 					callbackMessage = sc->T("Loaded State");
 					callbackResult = true;
 					hasLoadedState = true;
@@ -717,6 +883,7 @@ namespace SaveState
 
 		std::lock_guard<std::mutex> guard(mutex);
 		rewindStates.Clear();
+		rewindRetry = false;
 
 		hasLoadedState = false;
 	}
@@ -725,5 +892,7 @@ namespace SaveState
 	{
 		std::lock_guard<std::mutex> guard(mutex);
 		rewindStates.Clear();
+		rewindStates.StopWorker();
+		ChunkedSaveBuffer::StopWorkers();
 	}
 }
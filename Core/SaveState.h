@@ -72,6 +72,18 @@ namespace SaveState
 	// Returns true if there are rewind snapshots available.
 	bool CanRewind();
 
+	struct RewindStats
+	{
+		int snapshots;
+		// Since the emulator started.
+		int saved;
+		// Not taken because the previous one was still being compressed.  Retried next frame.
+		int skipped;
+		size_t bytes;
+		size_t budget;
+	};
+	RewindStats GetRewindStats();
+
 	// Returns true if a savestate has been used during this session.
 	bool HasLoadedState();
 
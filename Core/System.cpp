@@ -34,6 +34,8 @@
 #include "thread/threadutil.h"
 #include "util/text/utf8.h"
 
+#include "Common/ExceptionHandlerSetup.h"
+#include "Core/MemFault.h"
 #include "Core/MemMap.h"
 #include "Core/HDRemaster.h"
 
@@ -209,6 +211,8 @@ void CPU_Init() {
 	coreParameter.compat.Load(discID);
 
 	Memory::Init();
+	// Lets the jit skip address checks and catch bad accesses as they fault instead.
+	InstallExceptionHandler(&Memory::HandleFault);
 	mipsr4k.Reset();
 
 	host->AttemptLoadSymbolMap();
@@ -253,6 +257,7 @@ void CPU_Shutdown() {
 	}
 	pspFileSystem.Shutdown();
 	mipsr4k.Shutdown();
+	UninstallExceptionHandler();
 	Memory::Shutdown();
 
 	delete loadedFile;
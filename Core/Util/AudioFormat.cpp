@@ -22,6 +22,8 @@
 
 #ifdef _M_SSE
 #include <emmintrin.h>
+#elif PPSSPP_ARCH(ARM_NEON)
+#include <arm_neon.h>
 #endif
 
 void AdjustVolumeBlockStandard(s16 *out, s16 *in, size_t size, int leftVol, int rightVol) {
@@ -110,6 +112,31 @@ void ConvertS16ToF32(float *out, const s16 *in, size_t size) {
 	}
 }
 
+void ClampBufferToS16(s16 *out, const s32 *in, size_t size) {
+#ifdef _M_SSE
+	while (size >= 8) {
+		__m128i in1 = _mm_loadu_si128((const __m128i *)in + 0);
+		__m128i in2 = _mm_loadu_si128((const __m128i *)in + 1);
+		_mm_storeu_si128((__m128i *)out, _mm_packs_epi32(in1, in2));
+		in += 8;
+		out += 8;
+		size -= 8;
+	}
+#elif PPSSPP_ARCH(ARM_NEON)
+	while (size >= 8) {
+		int32x4_t in1 = vld1q_s32(in);
+		int32x4_t in2 = vld1q_s32(in + 4);
+		vst1q_s16(out, vcombine_s16(vqmovn_s32(in1), vqmovn_s32(in2)));
+		in += 8;
+		out += 8;
+		size -= 8;
+	}
+#endif
+	for (size_t i = 0; i < size; i++) {
+		out[i] = clamp_s16(in[i]);
+	}
+}
+
 #ifndef _M_SSE
 AdjustVolumeBlockFunc AdjustVolumeBlock = &AdjustVolumeBlockStandard;
 
@@ -68,6 +68,8 @@ static inline s16 ApplySampleVolume20Bit(s16 sample, int vol20) {
 void SetupAudioFormats();
 void AdjustVolumeBlockStandard(s16 *out, s16 *in, size_t size, int leftVol, int rightVol);
 void ConvertS16ToF32(float *ou, const s16 *in, size_t size);
+// Saturates 32-bit mix buffer samples to 16 bits.
+void ClampBufferToS16(s16 *out, const s32 *in, size_t size);
 
 #ifdef _M_SSE
 #define AdjustVolumeBlock AdjustVolumeBlockStandard
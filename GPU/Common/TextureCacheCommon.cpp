@@ -16,7 +16,10 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <algorithm>
+#include <functional>
+#include "base/timeutil.h"
 #include "profiler/profiler.h"
+#include "thread/threadutil.h"
 #include "Common/ColorConv.h"
 #include "Common/MemoryUtil.h"
 #include "Core/Config.h"
@@ -26,6 +29,7 @@
 #include "GPU/Common/FramebufferCommon.h"
 #include "GPU/Common/TextureCacheCommon.h"
 #include "GPU/Common/TextureDecoder.h"
+#include "GPU/Common/TextureScalerCommon.h"
 #include "GPU/Common/ShaderId.h"
 #include "GPU/Common/GPUStateUtils.h"
 #include "GPU/GPUState.h"
@@ -116,6 +120,7 @@ TextureCacheCommon::TextureCacheCommon(Draw::DrawContext *draw)
 }
 
 TextureCacheCommon::~TextureCacheCommon() {
+	StopAsyncScaling();
 	FreeAlignedMemory(clutBufConverted_);
 	FreeAlignedMemory(clutBufRaw_);
 }
@@ -331,8 +336,7 @@ void TextureCacheCommon::SetTexture(bool force) {
 
 	u32 texhash = MiniHash((const u32 *)Memory::GetPointerUnchecked(texaddr));
 
-	TexCache::iterator iter = cache_.find(cachekey);
-	TexCacheEntry *entry = nullptr;
+	TexCacheEntry *entry = cache_.Get(cachekey);
 
 	// Note: It's necessary to reset needshadertexclamp, for otherwise DIRTY_TEXCLAMP won't get set later.
 	// Should probably revisit how this works..
@@ -343,8 +347,7 @@ void TextureCacheCommon::SetTexture(bool force) {
 	}
 	gstate_c.bgraTexture = isBgraBackend_;
 
-	if (iter != cache_.end()) {
-		entry = iter->second.get();
+	if (entry) {
 		// Validate the texture still matches the cache entry.
 		bool match = entry->Matches(dim, format, maxLevel);
 		const char *reason = "different params";
@@ -410,7 +413,8 @@ void TextureCacheCommon::SetTexture(bool force) {
 			}
 		}
 
-		if (match && (entry->status & TexCacheEntry::STATUS_TO_SCALE) && standardScaleFactor_ != 1 && texelsScaledThisFrame_ < TEXCACHE_MAX_TEXELS_SCALED) {
+		bool scalePending = (entry->status & (TexCacheEntry::STATUS_TO_SCALE | TexCacheEntry::STATUS_SCALE_QUEUED)) == TexCacheEntry::STATUS_TO_SCALE;
+		if (match && scalePending && standardScaleFactor_ != 1 && texelsScaledThisFrame_ < TEXCACHE_MAX_TEXELS_SCALED) {
 			if ((entry->status & TexCacheEntry::STATUS_CHANGE_FREQUENT) == 0) {
 				// INFO_LOG(G3D, "Reloading texture to do the scaling we skipped..");
 				match = false;
@@ -445,7 +449,7 @@ void TextureCacheCommon::SetTexture(bool force) {
 	} else {
 		VERBOSE_LOG(G3D, "No texture in cache, decoding...");
 		TexCacheEntry *entryNew = new TexCacheEntry{};
-		cache_[cachekey].reset(entryNew);
+		cache_.Set(cachekey, entryNew);
 
 		if (hasClut && clutRenderAddress_ != 0xFFFFFFFF) {
 			WARN_LOG_REPORT_ONCE(clutUseRender, G3D, "Using texture with rendered CLUT: texfmt=%d, clutfmt=%d", gstate.getTextureFormat(), gstate.getClutPaletteFormat());
@@ -574,6 +578,124 @@ void TextureCacheCommon::DecimateVideos() {
 	}
 }
 
+bool TextureCacheCommon::CanScaleAsync() const {
+	return asyncScaler_ != nullptr && g_Config.bTexAsyncScaling && asyncScaleCount_ < TEXCACHE_MAX_ASYNC_SCALES;
+}
+
+void TextureCacheCommon::QueueAsyncScale(TexCacheEntry *entry, const void *data, size_t size, u32 dstFmt, int w, int h, int factor) {
+	AsyncScaleJob job;
+	job.cachekey = entry->CacheKey();
+	job.entry = entry;
+	job.fullhash = entry->fullhash;
+	job.dstFmt = dstFmt;
+	job.w = w;
+	job.h = h;
+	job.factor = factor;
+	// The caller uploads (and may free) its copy right away.
+	job.data = (u32 *)AllocateAlignedMemory(size, 16);
+	job.seconds = 0.0;
+	memcpy(job.data, data, size);
+
+	std::lock_guard<std::mutex> guard(asyncScaleLock_);
+	if (!asyncScaleThread_) {
+		asyncScaleStop_ = false;
+		asyncScaleThread_ = new std::thread(std::bind(&TextureCacheCommon::AsyncScaleThreadFunc, this));
+	}
+	asyncScalePending_.push_back(job);
+	asyncScaleCount_++;
+	asyncScaleCond_.notify_one();
+}
+
+void TextureCacheCommon::AsyncScaleThreadFunc() {
+	setCurrentThreadName("TextureScale");
+
+	std::unique_lock<std::mutex> guard(asyncScaleLock_);
+	while (!asyncScaleStop_) {
+		if (asyncScalePending_.empty()) {
+			asyncScaleCond_.wait(guard);
+			continue;
+		}
+
+		AsyncScaleJob job = asyncScalePending_.front();
+		asyncScalePending_.pop_front();
+		guard.unlock();
+
+		double st = real_time_now();
+		u32 *scaled = (u32 *)AllocateAlignedMemory(job.w * job.factor * job.h * job.factor * sizeof(u32), 16);
+		asyncScaler_->ScaleAlways(scaled, job.data, job.dstFmt, job.w, job.h, job.factor);
+		FreeAlignedMemory(job.data);
+		job.data = scaled;
+		job.seconds = real_time_now() - st;
+
+		guard.lock();
+		asyncScaleDone_.push_back(job);
+	}
+}
+
+void TextureCacheCommon::ProcessAsyncScales() {
+	std::vector<AsyncScaleJob> ready;
+	{
+		std::lock_guard<std::mutex> guard(asyncScaleLock_);
+		size_t bytes = 0;
+		while (!asyncScaleDone_.empty() && bytes < TEXCACHE_MAX_ASYNC_UPLOAD_BYTES) {
+			const AsyncScaleJob &job = asyncScaleDone_.front();
+			bytes += job.w * job.h * sizeof(u32);
+			ready.push_back(job);
+			asyncScaleDone_.pop_front();
+		}
+	}
+
+	for (AsyncScaleJob &job : ready) {
+		asyncScaleCount_--;
+
+		// The texture may have changed or been dropped while it was being scaled.
+		TexCacheEntry *entry = cache_.Get(job.cachekey);
+		bool valid = entry == job.entry && entry->fullhash == job.fullhash && !entry->framebuffer;
+		if (!valid || (entry->status & TexCacheEntry::STATUS_SCALE_QUEUED) == 0) {
+			FreeAlignedMemory(job.data);
+			continue;
+		}
+
+		entry->status &= ~TexCacheEntry::STATUS_SCALE_QUEUED;
+		if (UploadScaledTexture(entry, job.data, job.dstFmt, job.w, job.h, job.factor)) {
+			entry->status &= ~TexCacheEntry::STATUS_TO_SCALE;
+			entry->status |= TexCacheEntry::STATUS_IS_SCALED;
+			gpuStats.numTexturesScaledAsync++;
+			gpuStats.msTextureScalingAsync += job.seconds * 1000.0;
+		}
+	}
+}
+
+void TextureCacheCommon::ClearAsyncScales() {
+	std::lock_guard<std::mutex> guard(asyncScaleLock_);
+	// A job in progress will still show up in done later, and be dropped then.
+	for (const AsyncScaleJob &job : asyncScalePending_) {
+		FreeAlignedMemory(job.data);
+	}
+	for (const AsyncScaleJob &job : asyncScaleDone_) {
+		FreeAlignedMemory(job.data);
+	}
+	asyncScaleCount_ -= (int)(asyncScalePending_.size() + asyncScaleDone_.size());
+	asyncScalePending_.clear();
+	asyncScaleDone_.clear();
+}
+
+void TextureCacheCommon::StopAsyncScaling() {
+	{
+		std::lock_guard<std::mutex> guard(asyncScaleLock_);
+		if (!asyncScaleThread_)
+			return;
+		asyncScaleStop_ = true;
+		asyncScaleCond_.notify_one();
+	}
+	asyncScaleThread_->join();
+	delete asyncScaleThread_;
+	asyncScaleThread_ = nullptr;
+
+	ClearAsyncScales();
+	asyncScaleCount_ = 0;
+}
+
 bool TextureCacheCommon::HandleTextureChange(TexCacheEntry *const entry, const char *reason, bool initialMatch, bool doDelete) {
 	bool replaceImages = false;
 
@@ -665,7 +787,7 @@ void TextureCacheCommon::NotifyFramebuffer(u32 address, VirtualFramebuffer *fram
 			// We might erase, so move to the next one already (which won't become invalid.)
 			++it;
 
-			DetachFramebuffer(cache_[cachekey].get(), addr, framebuffer);
+			DetachFramebuffer(cache_.Get(cachekey), addr, framebuffer);
 		}
 		break;
 	}
@@ -893,11 +1015,10 @@ bool TextureCacheCommon::SetOffsetTexture(u32 offset) {
 
 	const u16 dim = gstate.getTextureDimension(0);
 	u64 cachekey = TexCacheEntry::CacheKey(texaddr, gstate.getTextureFormat(), dim, 0);
-	TexCache::iterator iter = cache_.find(cachekey);
-	if (iter == cache_.end()) {
+	TexCacheEntry *entry = cache_.Get(cachekey);
+	if (!entry) {
 		return false;
 	}
-	TexCacheEntry *entry = iter->second.get();
 
 	bool success = false;
 	for (size_t i = 0, n = fbCache_.size(); i < n; ++i) {
@@ -1528,6 +1649,8 @@ void TextureCacheCommon::ApplyTexture() {
 
 	// Okay, now actually rebuild the texture if needed.
 	if (nextNeedsRebuild_) {
+		// Any scale in flight is for the old contents, this will queue a new one if needed.
+		entry->status &= ~TexCacheEntry::STATUS_SCALE_QUEUED;
 		BuildTexture(entry, replaceImages);
 	}
 
@@ -1549,6 +1672,7 @@ void TextureCacheCommon::Clear(bool delete_them) {
 	for (TexCache::iterator iter = secondCache_.begin(); iter != secondCache_.end(); ++iter) {
 		ReleaseTexture(iter->second.get(), delete_them);
 	}
+	ClearAsyncScales();
 	if (cache_.size() + secondCache_.size()) {
 		INFO_LOG(G3D, "Texture cached cleared from %i textures", (int)(cache_.size() + secondCache_.size()));
 		cache_.clear();
@@ -1603,10 +1727,9 @@ bool TextureCacheCommon::CheckFullHash(TexCacheEntry *entry, bool &doDelete) {
 		if (entry->numInvalidated > 2 && entry->numInvalidated < 128 && !lowMemoryMode_) {
 			// We have a new hash: look for that hash in the secondary cache.
 			u64 secondKey = fullhash | (u64)entry->cluthash << 32;
-			TexCache::iterator secondIter = secondCache_.find(secondKey);
-			if (secondIter != secondCache_.end()) {
+			TexCacheEntry *secondEntry = secondCache_.Get(secondKey);
+			if (secondEntry) {
 				// Found it, but does it match our current params?  If not, abort.
-				TexCacheEntry *secondEntry = secondIter->second.get();
 				if (secondEntry->Matches(entry->dim, entry->format, entry->maxLevel)) {
 					// Reset the numInvalidated value lower, we got a match.
 					if (entry->numInvalidated > 8) {
@@ -1624,14 +1747,16 @@ bool TextureCacheCommon::CheckFullHash(TexCacheEntry *entry, bool &doDelete) {
 				secondCacheSizeEstimate_ += EstimateTexMemoryUsage(entry);
 
 				// If the entry already exists in the secondary texture cache, drop it nicely.
-				auto oldIter = secondCache_.find(secondKey);
-				if (oldIter != secondCache_.end()) {
-					ReleaseTexture(oldIter->second.get(), true);
+				TexCacheEntry *oldEntry = secondCache_.Get(secondKey);
+				if (oldEntry) {
+					ReleaseTexture(oldEntry, true);
 				}
 
 				// Archive the entire texture entry as is, since we'll use its params if it is seen again.
 				// We keep parameters on the current entry, since we are STILL building a new texture here.
-				secondCache_[secondKey].reset(new TexCacheEntry(*entry));
+				TexCacheEntry *archived = new TexCacheEntry(*entry);
+				archived->status &= ~TexCacheEntry::STATUS_SCALE_QUEUED;
+				secondCache_.Set(secondKey, archived);
 
 				// Make sure we don't delete the texture we just archived.
 				entry->texturePtr = nullptr;
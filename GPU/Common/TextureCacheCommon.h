@@ -17,11 +17,17 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
 #include <map>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <memory>
 
 #include "Common/CommonTypes.h"
+#include "Common/Hashmaps.h"
 #include "Common/MemoryUtil.h"
 #include "Core/TextureReplacer.h"
 #include "Core/System.h"
@@ -47,10 +53,13 @@ enum FramebufferNotification {
 #define TEXCACHE_FRAME_CHANGE_FREQUENT_REGAIN_TRUST 33
 
 #define TEXCACHE_MAX_TEXELS_SCALED (256*256)  // Per frame
+#define TEXCACHE_MAX_ASYNC_SCALES 8  // Queued or in progress at once
+#define TEXCACHE_MAX_ASYNC_UPLOAD_BYTES (8 * 1024 * 1024)  // Per frame
 
 struct VirtualFramebuffer;
 
 class CachedTextureVulkan;
+class TextureScalerCommon;
 
 namespace Draw {
 class DrawContext;
@@ -120,34 +129,38 @@ struct TexCacheEntry {
 		STATUS_FREE_CHANGE = 0x200,    // Allow one change before marking "frequent".
 
 		STATUS_BAD_MIPS = 0x400,       // Has bad or unusable mipmap levels.
+		STATUS_SCALE_QUEUED = 0x800,   // Being scaled on the worker thread, uploaded in a later frame.
 	};
 
+	// Fields checked on every bind (SetTexture) come first, so they share a cache line.
 	// Status, but int so we can zero initialize.
 	int status;
 	u32 addr;
 	u32 hash;
+	u32 cluthash;
 	VirtualFramebuffer *framebuffer;  // if null, not sourced from an FBO. TODO: Collapse into texturePtr
-	u32 sizeInRAM;  // Could be computed
-	u8 format;
-	u8 maxLevel;
-	u16 dim;
-	u16 bufw;
 	union {
 		GLRTexture *textureName;
 		void *texturePtr;
 		CachedTextureVulkan *vkTex;
 	};
-#ifdef _WIN32
-	void *textureView;  // Used by D3D11 only for the shader resource view.
-#endif
+	u8 format;
+	u8 maxLevel;
+	u16 dim;
+	u16 bufw;
+	u16 maxSeenV;
 	int invalidHint;
 	int lastFrame;
 	int numFrames;
-	int numInvalidated;
 	u32 framesUntilNextFullHash;
+
+	// Only used when rebuilding or rehashing.
 	u32 fullhash;
-	u32 cluthash;
-	u16 maxSeenV;
+	int numInvalidated;
+	u32 sizeInRAM;  // Could be computed
+#ifdef _WIN32
+	void *textureView;  // Used by D3D11 only for the shader resource view.
+#endif
 
 	TexStatus GetHashStatus() {
 		return TexStatus(status & STATUS_MASK);
@@ -173,10 +186,57 @@ struct TexCacheEntry {
 	static u64 CacheKey(u32 addr, u8 format, u16 dim, u32 cluthash);
 };
 
+static_assert(offsetof(TexCacheEntry, fullhash) <= 64, "Keep the bind-time fields of TexCacheEntry within a cache line");
+
 class FramebufferManagerCommon;
-// Can't be unordered_map, we use lower_bound ... although for some reason that compiles on MSVC.
-// Would really like to replace this with DenseHashMap but can't as long as we need lower_bound.
-typedef std::map<u64, std::unique_ptr<TexCacheEntry>> TexCache;
+
+// The texture cache needs two kinds of lookups: exact ones by key on every texture bind, and
+// range queries by address (the key is addr << 32 | ...) on invalidation and CLUT variant checks.
+// The sorted map owns the entries and serves the range queries, the hash index serves binds.
+class TexCache {
+public:
+	typedef std::map<u64, std::unique_ptr<TexCacheEntry>> Map;
+	typedef Map::iterator iterator;
+
+	TexCache() : index_(1024) {}
+
+	// Fast exact lookup, returns nullptr if not found.
+	TexCacheEntry *Get(u64 key) {
+		return index_.Get(key);
+	}
+	// Inserts or replaces (deleting the old entry, not releasing its texture.)
+	void Set(u64 key, TexCacheEntry *entry) {
+		std::unique_ptr<TexCacheEntry> &slot = map_[key];
+		if (slot) {
+			index_.Remove(key);
+		}
+		slot.reset(entry);
+		index_.Insert(key, entry);
+	}
+
+	iterator find(u64 key) {
+		return index_.Get(key) ? map_.find(key) : map_.end();
+	}
+	iterator erase(iterator it) {
+		index_.Remove(it->first);
+		index_.Maintain();
+		return map_.erase(it);
+	}
+	void clear() {
+		map_.clear();
+		index_.Clear();
+	}
+
+	iterator begin() { return map_.begin(); }
+	iterator end() { return map_.end(); }
+	iterator lower_bound(u64 key) { return map_.lower_bound(key); }
+	iterator upper_bound(u64 key) { return map_.upper_bound(key); }
+	size_t size() const { return map_.size(); }
+
+private:
+	Map map_;
+	DenseHashMap<u64, TexCacheEntry *, nullptr> index_;
+};
 
 class TextureCacheCommon {
 public:
@@ -258,6 +318,18 @@ class TextureCacheCommon {
 
 	void DecimateVideos();
 
+	// Background upscaling.  The backend builds the texture unscaled as usual, which is what
+	// draws use in the meantime, and queues the decoded level for scaling on a worker thread.
+	// Results are uploaded at the start of later frames, within TEXCACHE_MAX_ASYNC_UPLOAD_BYTES.
+	bool CanScaleAsync() const;
+	void QueueAsyncScale(TexCacheEntry *entry, const void *data, size_t size, u32 dstFmt, int w, int h, int factor);
+	void ProcessAsyncScales();
+	void ClearAsyncScales();
+	// Must be called by the backend before its scaler is destroyed.
+	void StopAsyncScaling();
+	// Takes ownership of data (allocated with AllocateAlignedMemory.)  Returns false if not uploaded.
+	virtual bool UploadScaledTexture(TexCacheEntry *entry, u32 *data, u32 dstFmt, int w, int h, int factor) { return false; }
+
 	inline u32 QuickTexHash(TextureReplacer &replacer, u32 addr, int bufw, int w, int h, GETextureFormat format, TexCacheEntry *entry) const {
 		if (replacer.Enabled()) {
 			return replacer.ComputeHash(addr, bufw, w, h, format, entry->maxSeenV);
@@ -335,6 +407,34 @@ class TextureCacheCommon {
 	bool isBgraBackend_;
 
 	u32 expandClut_[256];
+
+	// Set by backends that support background upscaling.  Only used on the worker thread.
+	TextureScalerCommon *asyncScaler_ = nullptr;
+
+private:
+	struct AsyncScaleJob {
+		u64 cachekey;
+		TexCacheEntry *entry;
+		u32 fullhash;
+		u32 dstFmt;
+		int w;
+		int h;
+		int factor;
+		// Decoded input, replaced by the scaled output when done.
+		u32 *data;
+		double seconds;
+	};
+
+	void AsyncScaleThreadFunc();
+
+	std::thread *asyncScaleThread_ = nullptr;
+	std::mutex asyncScaleLock_;
+	std::condition_variable asyncScaleCond_;
+	std::deque<AsyncScaleJob> asyncScalePending_;
+	std::deque<AsyncScaleJob> asyncScaleDone_;
+	bool asyncScaleStop_ = false;
+	// Pending, in progress, or done but not yet uploaded.  Only used on the GPU thread.
+	int asyncScaleCount_ = 0;
 };
 
 inline bool TexCacheEntry::Matches(u16 dim2, u8 format2, u8 maxLevel2) const {
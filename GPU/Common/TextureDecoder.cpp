@@ -32,6 +32,16 @@
 #if _M_SSE >= 0x401
 #include <smmintrin.h>
 #endif
+// SSSE3 and AVX2 are used after a runtime check, so with GCC/Clang those functions are
+// compiled for that target without requiring it for the whole file.
+#include <immintrin.h>
+#if defined(__GNUC__)
+#define SSSE3_FUNC __attribute__((target("ssse3")))
+#define AVX2_FUNC __attribute__((target("avx2")))
+#else
+#define SSSE3_FUNC
+#define AVX2_FUNC
+#endif
 
 u32 QuickTexHashSSE2(const void *checkp, u32 size) {
 	u32 check = 0;
@@ -312,6 +322,170 @@ ReliableHash32Func DoReliableHash32 = &XXH32;
 ReliableHash64Func DoReliableHash64 = &XXH64;
 #endif
 
+void DeIndexTexture4To16Basic(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	for (int i = 0; i < length; i += 2) {
+		u8 index = *indexed++;
+		dest[i + 0] = clut[(index >> 0) & 0xf];
+		dest[i + 1] = clut[(index >> 4) & 0xf];
+	}
+}
+
+void DeIndexTexture4To32Basic(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	for (int i = 0; i < length; i += 2) {
+		u8 index = *indexed++;
+		dest[i + 0] = clut[(index >> 0) & 0xf];
+		dest[i + 1] = clut[(index >> 4) & 0xf];
+	}
+}
+
+void DeIndexTexture8To16Basic(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	for (int i = 0; i < length; ++i) {
+		dest[i] = clut[indexed[i]];
+	}
+}
+
+void DeIndexTexture8To32Basic(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	for (int i = 0; i < length; ++i) {
+		dest[i] = clut[indexed[i]];
+	}
+}
+
+#ifdef _M_SSE
+// Splits 16 bytes of indices into 32 indices of 4 bits, in pixel order.
+SSSE3_FUNC
+static inline void SplitIndices4SSSE3(const u8 *indexed, __m128i &first, __m128i &second) {
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	const __m128i in = _mm_loadu_si128((const __m128i *)indexed);
+	const __m128i lo = _mm_and_si128(in, mask);
+	const __m128i hi = _mm_and_si128(_mm_srli_epi16(in, 4), mask);
+	first = _mm_unpacklo_epi8(lo, hi);
+	second = _mm_unpackhi_epi8(lo, hi);
+}
+
+// With only 16 entries, the CLUT fits in registers as byte planes, and pshufb does the lookups.
+SSSE3_FUNC
+static void DeIndexTexture4To16SSSE3(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	const __m128i lowMask = _mm_set1_epi16(0x00FF);
+	const __m128i c0 = _mm_loadu_si128((const __m128i *)clut);
+	const __m128i c1 = _mm_loadu_si128((const __m128i *)(clut + 8));
+	const __m128i planeLo = _mm_packus_epi16(_mm_and_si128(c0, lowMask), _mm_and_si128(c1, lowMask));
+	const __m128i planeHi = _mm_packus_epi16(_mm_srli_epi16(c0, 8), _mm_srli_epi16(c1, 8));
+
+	int i = 0;
+	for (; i + 32 <= length; i += 32) {
+		__m128i idx[2];
+		SplitIndices4SSSE3(indexed + i / 2, idx[0], idx[1]);
+		for (int j = 0; j < 2; ++j) {
+			const __m128i lo = _mm_shuffle_epi8(planeLo, idx[j]);
+			const __m128i hi = _mm_shuffle_epi8(planeHi, idx[j]);
+			_mm_storeu_si128((__m128i *)(dest + i + j * 16), _mm_unpacklo_epi8(lo, hi));
+			_mm_storeu_si128((__m128i *)(dest + i + j * 16 + 8), _mm_unpackhi_epi8(lo, hi));
+		}
+	}
+	if (i < length) {
+		DeIndexTexture4To16Basic(dest + i, indexed + i / 2, length - i, clut);
+	}
+}
+
+SSSE3_FUNC
+static void DeIndexTexture4To32SSSE3(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	// Gather byte N of each entry into plane N.
+	const __m128i byteOrder = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	__m128i r0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)clut), byteOrder);
+	__m128i r1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(clut + 4)), byteOrder);
+	__m128i r2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(clut + 8)), byteOrder);
+	__m128i r3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(clut + 12)), byteOrder);
+	const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+	const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+	const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+	const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+	const __m128i plane0 = _mm_unpacklo_epi64(t0, t1);
+	const __m128i plane1 = _mm_unpackhi_epi64(t0, t1);
+	const __m128i plane2 = _mm_unpacklo_epi64(t2, t3);
+	const __m128i plane3 = _mm_unpackhi_epi64(t2, t3);
+
+	int i = 0;
+	for (; i + 32 <= length; i += 32) {
+		__m128i idx[2];
+		SplitIndices4SSSE3(indexed + i / 2, idx[0], idx[1]);
+		for (int j = 0; j < 2; ++j) {
+			const __m128i b0 = _mm_shuffle_epi8(plane0, idx[j]);
+			const __m128i b1 = _mm_shuffle_epi8(plane1, idx[j]);
+			const __m128i b2 = _mm_shuffle_epi8(plane2, idx[j]);
+			const __m128i b3 = _mm_shuffle_epi8(plane3, idx[j]);
+			const __m128i b01lo = _mm_unpacklo_epi8(b0, b1);
+			const __m128i b01hi = _mm_unpackhi_epi8(b0, b1);
+			const __m128i b23lo = _mm_unpacklo_epi8(b2, b3);
+			const __m128i b23hi = _mm_unpackhi_epi8(b2, b3);
+			u32 *d = dest + i + j * 16;
+			_mm_storeu_si128((__m128i *)(d + 0), _mm_unpacklo_epi16(b01lo, b23lo));
+			_mm_storeu_si128((__m128i *)(d + 4), _mm_unpackhi_epi16(b01lo, b23lo));
+			_mm_storeu_si128((__m128i *)(d + 8), _mm_unpacklo_epi16(b01hi, b23hi));
+			_mm_storeu_si128((__m128i *)(d + 12), _mm_unpackhi_epi16(b01hi, b23hi));
+		}
+	}
+	if (i < length) {
+		DeIndexTexture4To32Basic(dest + i, indexed + i / 2, length - i, clut);
+	}
+}
+
+AVX2_FUNC
+static void DeIndexTexture8To16AVX2(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	const __m256i lowMask = _mm256_set1_epi32(0x0000FFFF);
+	int i = 0;
+	for (; i + 16 <= length; i += 16) {
+		// Gathers 32 bits at clut + index, we only keep the low half.
+		const __m256i idx0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(indexed + i)));
+		const __m256i idx1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(indexed + i + 8)));
+		const __m256i v0 = _mm256_and_si256(_mm256_i32gather_epi32((const int *)clut, idx0, 2), lowMask);
+		const __m256i v1 = _mm256_and_si256(_mm256_i32gather_epi32((const int *)clut, idx1, 2), lowMask);
+		// Packing works per 128-bit lane, so put the halves back in order afterward.
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(v0, v1), _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i *)(dest + i), packed);
+	}
+	if (i < length) {
+		DeIndexTexture8To16Basic(dest + i, indexed + i, length - i, clut);
+	}
+}
+
+AVX2_FUNC
+static void DeIndexTexture8To32AVX2(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	int i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const __m256i idx0 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(indexed + i)));
+		const __m256i idx1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(indexed + i + 8)));
+		_mm256_storeu_si256((__m256i *)(dest + i), _mm256_i32gather_epi32((const int *)clut, idx0, 4));
+		_mm256_storeu_si256((__m256i *)(dest + i + 8), _mm256_i32gather_epi32((const int *)clut, idx1, 4));
+	}
+	if (i < length) {
+		DeIndexTexture8To32Basic(dest + i, indexed + i, length - i, clut);
+	}
+}
+#endif
+
+DeIndexTexture4To16Func DoDeIndexTexture4To16 = &DeIndexTexture4To16Basic;
+DeIndexTexture4To32Func DoDeIndexTexture4To32 = &DeIndexTexture4To32Basic;
+DeIndexTexture8To16Func DoDeIndexTexture8To16 = &DeIndexTexture8To16Basic;
+DeIndexTexture8To32Func DoDeIndexTexture8To32 = &DeIndexTexture8To32Basic;
+
+#ifdef _M_SSE
+// For each possible line byte, the pshufb control that picks the 4 colors of that line.
+alignas(16) static u8 dxtLineShuffle[256][16];
+
+static void InitDXTLineShuffle() {
+	for (int line = 0; line < 256; ++line) {
+		for (int x = 0; x < 4; ++x) {
+			int index = (line >> (x * 2)) & 3;
+			for (int b = 0; b < 4; ++b) {
+				dxtLineShuffle[line][x * 4 + b] = (u8)(index * 4 + b);
+			}
+		}
+	}
+}
+#endif
+
+static bool useDXTSSSE3 = false;
+
 // This has to be done after CPUDetect has done its magic.
 void SetupTextureDecoder() {
 #if PPSSPP_ARCH(ARM_NEON) && !PPSSPP_ARCH(ARM64)
@@ -325,16 +499,38 @@ void SetupTextureDecoder() {
 #endif
 	}
 #endif
+
+	// Reset first, so this can be called again after changing cpu_info (for tests.)
+	DoDeIndexTexture4To16 = &DeIndexTexture4To16Basic;
+	DoDeIndexTexture4To32 = &DeIndexTexture4To32Basic;
+	DoDeIndexTexture8To16 = &DeIndexTexture8To16Basic;
+	DoDeIndexTexture8To32 = &DeIndexTexture8To32Basic;
+	useDXTSSSE3 = false;
+
+#ifdef _M_SSE
+	if (cpu_info.bSSSE3) {
+		DoDeIndexTexture4To16 = &DeIndexTexture4To16SSSE3;
+		DoDeIndexTexture4To32 = &DeIndexTexture4To32SSSE3;
+		InitDXTLineShuffle();
+		useDXTSSSE3 = true;
+	}
+	if (cpu_info.bAVX2) {
+		DoDeIndexTexture8To16 = &DeIndexTexture8To16AVX2;
+		DoDeIndexTexture8To32 = &DeIndexTexture8To32AVX2;
+	}
+#elif PPSSPP_ARCH(ARM64)
+	if (cpu_info.bNEON) {
+		DoDeIndexTexture4To16 = &DeIndexTexture4To16NEON;
+		DoDeIndexTexture4To32 = &DeIndexTexture4To32NEON;
+	}
+#endif
 }
 
 static inline u32 makecol(int r, int g, int b, int a) {
 	return (a << 24) | (r << 16) | (g << 8) | b;
 }
 
-// This could probably be done faster by decoding two or four blocks at a time with SSE/NEON.
-void DecodeDXT1Block(u32 *dst, const DXT1Block *src, int pitch, int height, bool ignore1bitAlpha) {
-	// S3TC Decoder
-	// Needs more speed and debugging.
+static inline void DXT1Colors(u32 colors[4], const DXT1Block *src, bool ignore1bitAlpha) {
 	u16 c1 = (src->color1);
 	u16 c2 = (src->color2);
 	int red1 = Convert5To8(c1 & 0x1F);
@@ -344,7 +540,6 @@ void DecodeDXT1Block(u32 *dst, const DXT1Block *src, int pitch, int height, bool
 	int blue1 = Convert5To8((c1 >> 11) & 0x1F);
 	int blue2 = Convert5To8((c2 >> 11) & 0x1F);
 
-	u32 colors[4];
 	colors[0] = makecol(red1, green1, blue1, 255);
 	colors[1] = makecol(red2, green2, blue2, 255);
 	if (c1 > c2 || ignore1bitAlpha) {
@@ -359,30 +554,6 @@ void DecodeDXT1Block(u32 *dst, const DXT1Block *src, int pitch, int height, bool
 			(blue1 + blue2 + 1) / 2, 255);
 		colors[3] = makecol(red2, green2, blue2, 0);	// Color2 but transparent
 	}
-
-	for (int y = 0; y < height; y++) {
-		int val = src->lines[y];
-		for (int x = 0; x < 4; x++) {
-			dst[x] = colors[val & 3];
-			val >>= 2;
-		}
-		dst += pitch;
-	}
-}
-
-void DecodeDXT3Block(u32 *dst, const DXT3Block *src, int pitch, int height)
-{
-	DecodeDXT1Block(dst, &src->color, pitch, height, true);
-
-	for (int y = 0; y < height; y++) {
-		u32 line = src->alphaLines[y];
-		for (int x = 0; x < 4; x++) {
-			const u8 a4 = line & 0xF;
-			dst[x] = (dst[x] & 0xFFFFFF) | (a4 << 24) | (a4 << 28);
-			line >>= 4;
-		}
-		dst += pitch;
-	}
 }
 
 static inline u8 lerp8(const DXT5Block *src, int n) {
@@ -395,11 +566,7 @@ static inline u8 lerp6(const DXT5Block *src, int n) {
 	return (u8)(src->alpha1 + (src->alpha2 - src->alpha1) * d);
 }
 
-// The alpha channel is not 100% correct 
-void DecodeDXT5Block(u32 *dst, const DXT5Block *src, int pitch, int height) {
-	DecodeDXT1Block(dst, &src->color, pitch, height, true);
-	u8 alpha[8];
-
+static inline void DXT5Alphas(u8 alpha[8], const DXT5Block *src) {
 	alpha[0] = src->alpha1;
 	alpha[1] = src->alpha2;
 	if (alpha[0] > alpha[1]) {
@@ -417,6 +584,114 @@ void DecodeDXT5Block(u32 *dst, const DXT5Block *src, int pitch, int height) {
 		alpha[6] = 0;
 		alpha[7] = 255;
 	}
+}
+
+#ifdef _M_SSE
+SSSE3_FUNC
+static inline void DecodeDXT1ColorsSSSE3(u32 *dst, const DXT1Block *src, int pitch, int height, bool ignore1bitAlpha) {
+	alignas(16) u32 colors[4];
+	DXT1Colors(colors, src, ignore1bitAlpha);
+	const __m128i palette = _mm_load_si128((const __m128i *)colors);
+	for (int y = 0; y < height; y++) {
+		const __m128i control = _mm_load_si128((const __m128i *)dxtLineShuffle[src->lines[y]]);
+		_mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi8(palette, control));
+		dst += pitch;
+	}
+}
+
+SSSE3_FUNC
+static void DecodeDXT3BlockSSSE3(u32 *dst, const DXT3Block *src, int pitch, int height) {
+	DecodeDXT1ColorsSSSE3(dst, &src->color, pitch, height, true);
+
+	const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+	for (int y = 0; y < height; y++) {
+		u32 line = src->alphaLines[y];
+		const __m128i a4 = _mm_setr_epi32(line & 0xF, (line >> 4) & 0xF, (line >> 8) & 0xF, (line >> 12) & 0xF);
+		const __m128i alpha = _mm_or_si128(_mm_slli_epi32(a4, 24), _mm_slli_epi32(a4, 28));
+		const __m128i colors = _mm_and_si128(_mm_loadu_si128((const __m128i *)dst), colorMask);
+		_mm_storeu_si128((__m128i *)dst, _mm_or_si128(colors, alpha));
+		dst += pitch;
+	}
+}
+
+SSSE3_FUNC
+static void DecodeDXT5BlockSSSE3(u32 *dst, const DXT5Block *src, int pitch, int height) {
+	DecodeDXT1ColorsSSSE3(dst, &src->color, pitch, height, true);
+
+	u8 alpha[8];
+	DXT5Alphas(alpha, src);
+	const __m128i palette = _mm_loadl_epi64((const __m128i *)alpha);
+	// The alpha index goes in the top byte, 0x80 zeroes the others.
+	const __m128i zeroColor = _mm_set1_epi32(0x00808080);
+	const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+
+	u64 data = ((u64)(u16)src->alphadata1 << 32) | (u32)src->alphadata2;
+	for (int y = 0; y < height; y++) {
+		const u32 line = (u32)data;
+		const __m128i index = _mm_setr_epi32(line & 7, (line >> 3) & 7, (line >> 6) & 7, (line >> 9) & 7);
+		const __m128i control = _mm_or_si128(_mm_slli_epi32(index, 24), zeroColor);
+		const __m128i colors = _mm_and_si128(_mm_loadu_si128((const __m128i *)dst), colorMask);
+		_mm_storeu_si128((__m128i *)dst, _mm_or_si128(colors, _mm_shuffle_epi8(palette, control)));
+		data >>= 12;
+		dst += pitch;
+	}
+}
+#endif
+
+void DecodeDXT1Block(u32 *dst, const DXT1Block *src, int pitch, int height, bool ignore1bitAlpha) {
+#ifdef _M_SSE
+	if (useDXTSSSE3) {
+		DecodeDXT1ColorsSSSE3(dst, src, pitch, height, ignore1bitAlpha);
+		return;
+	}
+#endif
+
+	u32 colors[4];
+	DXT1Colors(colors, src, ignore1bitAlpha);
+
+	for (int y = 0; y < height; y++) {
+		int val = src->lines[y];
+		for (int x = 0; x < 4; x++) {
+			dst[x] = colors[val & 3];
+			val >>= 2;
+		}
+		dst += pitch;
+	}
+}
+
+void DecodeDXT3Block(u32 *dst, const DXT3Block *src, int pitch, int height) {
+#ifdef _M_SSE
+	if (useDXTSSSE3) {
+		DecodeDXT3BlockSSSE3(dst, src, pitch, height);
+		return;
+	}
+#endif
+
+	DecodeDXT1Block(dst, &src->color, pitch, height, true);
+
+	for (int y = 0; y < height; y++) {
+		u32 line = src->alphaLines[y];
+		for (int x = 0; x < 4; x++) {
+			const u8 a4 = line & 0xF;
+			dst[x] = (dst[x] & 0xFFFFFF) | (a4 << 24) | (a4 << 28);
+			line >>= 4;
+		}
+		dst += pitch;
+	}
+}
+
+// The alpha channel is not 100% correct 
+void DecodeDXT5Block(u32 *dst, const DXT5Block *src, int pitch, int height) {
+#ifdef _M_SSE
+	if (useDXTSSSE3) {
+		DecodeDXT5BlockSSSE3(dst, src, pitch, height);
+		return;
+	}
+#endif
+
+	DecodeDXT1Block(dst, &src->color, pitch, height, true);
+	u8 alpha[8];
+	DXT5Alphas(alpha, src);
 
 	u64 data = ((u64)(u16)src->alphadata1 << 32) | (u32)src->alphadata2;
 
@@ -88,6 +88,24 @@ extern ReliableHash64Func DoReliableHash64;
 typedef u32 ReliableHashType;
 #endif
 
+// Deindexing for the usual case, where the CLUT index needs no shift, mask, or offset.
+// SetupTextureDecoder() picks vectorized versions if the CPU has them.  Lengths are in pixels,
+// and the 4-bit versions always write an even number.  The 8-bit to 16-bit version may read
+// one entry past clut[255], so the CLUT buffer needs to be a bit larger.
+typedef void (*DeIndexTexture4To16Func)(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+typedef void (*DeIndexTexture4To32Func)(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+typedef void (*DeIndexTexture8To16Func)(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+typedef void (*DeIndexTexture8To32Func)(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+extern DeIndexTexture4To16Func DoDeIndexTexture4To16;
+extern DeIndexTexture4To32Func DoDeIndexTexture4To32;
+extern DeIndexTexture8To16Func DoDeIndexTexture8To16;
+extern DeIndexTexture8To32Func DoDeIndexTexture8To32;
+
+void DeIndexTexture4To16Basic(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+void DeIndexTexture4To32Basic(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+void DeIndexTexture8To16Basic(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+void DeIndexTexture8To32Basic(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+
 CheckAlphaResult CheckAlphaRGBA8888Basic(const u32 *pixelData, int stride, int w, int h);
 CheckAlphaResult CheckAlphaABGR4444Basic(const u32 *pixelData, int stride, int w, int h);
 CheckAlphaResult CheckAlphaRGBA4444Basic(const u32 *pixelData, int stride, int w, int h);
@@ -115,6 +133,7 @@ struct DXT5Block {
 	u8 alpha1; u8 alpha2;
 };
 
+// These use SSSE3 when available (after SetupTextureDecoder().)
 void DecodeDXT1Block(u32 *dst, const DXT1Block *src, int pitch, int height, bool ignore1bitAlpha);
 void DecodeDXT3Block(u32 *dst, const DXT3Block *src, int pitch, int height);
 void DecodeDXT5Block(u32 *dst, const DXT5Block *src, int pitch, int height);
@@ -146,10 +165,10 @@ inline void DeIndexTexture(ClutT *dest, const IndexT *indexed, int length, const
 	const bool nakedIndex = gstate.isClutIndexSimple();
 
 	if (nakedIndex) {
-		if (sizeof(IndexT) == 1) {
-			for (int i = 0; i < length; ++i) {
-				*dest++ = clut[*indexed++];
-			}
+		if (sizeof(IndexT) == 1 && sizeof(ClutT) == 2) {
+			DoDeIndexTexture8To16((u16 *)dest, (const u8 *)indexed, length, (const u16 *)clut);
+		} else if (sizeof(IndexT) == 1) {
+			DoDeIndexTexture8To32((u32 *)dest, (const u8 *)indexed, length, (const u32 *)clut);
 		} else {
 			for (int i = 0; i < length; ++i) {
 				*dest++ = clut[(*indexed++) & 0xFF];
@@ -174,10 +193,10 @@ inline void DeIndexTexture4(ClutT *dest, const u8 *indexed, int length, const Cl
 	const bool nakedIndex = gstate.isClutIndexSimple();
 
 	if (nakedIndex) {
-		for (int i = 0; i < length; i += 2) {
-			u8 index = *indexed++;
-			dest[i + 0] = clut[(index >> 0) & 0xf];
-			dest[i + 1] = clut[(index >> 4) & 0xf];
+		if (sizeof(ClutT) == 2) {
+			DoDeIndexTexture4To16((u16 *)dest, indexed, length, (const u16 *)clut);
+		} else {
+			DoDeIndexTexture4To32((u32 *)dest, indexed, length, (const u32 *)clut);
 		}
 	} else {
 		for (int i = 0; i < length; i += 2) {
@@ -386,4 +386,55 @@ CheckAlphaResult CheckAlphaRGBA5551NEON(const u32 *pixelData, int stride, int w,
 	return CHECKALPHA_FULL;
 }
 
+#if PPSSPP_ARCH(ARM64)
+// Table lookups need ARM64's TBL on full 16-byte registers.  Each CLUT byte is its own table.
+void DeIndexTexture4To16NEON(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	const uint8x16x2_t table = vld2q_u8((const u8 *)clut);
+	const uint8x16_t lowMask = vdupq_n_u8(0x0F);
+	int i = 0;
+	for (; i + 32 <= length; i += 32) {
+		const uint8x16_t bytes = vld1q_u8(indexed + i / 2);
+		const uint8x16_t lo = vandq_u8(bytes, lowMask);
+		const uint8x16_t hi = vshrq_n_u8(bytes, 4);
+		const uint8x16_t idx0 = vzip1q_u8(lo, hi);
+		const uint8x16_t idx1 = vzip2q_u8(lo, hi);
+
+		uint8x16x2_t out0, out1;
+		out0.val[0] = vqtbl1q_u8(table.val[0], idx0);
+		out0.val[1] = vqtbl1q_u8(table.val[1], idx0);
+		out1.val[0] = vqtbl1q_u8(table.val[0], idx1);
+		out1.val[1] = vqtbl1q_u8(table.val[1], idx1);
+		vst2q_u8((u8 *)(dest + i), out0);
+		vst2q_u8((u8 *)(dest + i + 16), out1);
+	}
+	if (i < length) {
+		DeIndexTexture4To16Basic(dest + i, indexed + i / 2, length - i, clut);
+	}
+}
+
+void DeIndexTexture4To32NEON(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	const uint8x16x4_t table = vld4q_u8((const u8 *)clut);
+	const uint8x16_t lowMask = vdupq_n_u8(0x0F);
+	int i = 0;
+	for (; i + 32 <= length; i += 32) {
+		const uint8x16_t bytes = vld1q_u8(indexed + i / 2);
+		const uint8x16_t lo = vandq_u8(bytes, lowMask);
+		const uint8x16_t hi = vshrq_n_u8(bytes, 4);
+		const uint8x16_t idx[2] = { vzip1q_u8(lo, hi), vzip2q_u8(lo, hi) };
+
+		for (int half = 0; half < 2; ++half) {
+			uint8x16x4_t out;
+			out.val[0] = vqtbl1q_u8(table.val[0], idx[half]);
+			out.val[1] = vqtbl1q_u8(table.val[1], idx[half]);
+			out.val[2] = vqtbl1q_u8(table.val[2], idx[half]);
+			out.val[3] = vqtbl1q_u8(table.val[3], idx[half]);
+			vst4q_u8((u8 *)(dest + i + half * 16), out);
+		}
+	}
+	if (i < length) {
+		DeIndexTexture4To32Basic(dest + i, indexed + i / 2, length - i, clut);
+	}
+}
+#endif
+
 #endif
@@ -15,6 +15,7 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include "ppsspp_config.h"
 #include "GPU/Common/TextureDecoder.h"
 
 u32 QuickTexHashNEON(const void *checkp, u32 size);
@@ -26,3 +27,8 @@ CheckAlphaResult CheckAlphaABGR4444NEON(const u32 *pixelData, int stride, int w,
 CheckAlphaResult CheckAlphaABGR1555NEON(const u32 *pixelData, int stride, int w, int h);
 CheckAlphaResult CheckAlphaRGBA4444NEON(const u32 *pixelData, int stride, int w, int h);
 CheckAlphaResult CheckAlphaRGBA5551NEON(const u32 *pixelData, int stride, int w, int h);
+
+#if PPSSPP_ARCH(ARM64)
+void DeIndexTexture4To16NEON(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+void DeIndexTexture4To32NEON(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+#endif
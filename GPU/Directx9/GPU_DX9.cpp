@@ -280,6 +280,7 @@ void GPU_DX9::GetStats(char *buffer, size_t bufsize) {
 	float vertexAverageCycles = gpuStats.numVertsSubmitted > 0 ? (float)gpuStats.vertexGPUCycles / (float)gpuStats.numVertsSubmitted : 0.0f;
 	snprintf(buffer, bufsize - 1,
 		"DL processing time: %0.2f ms\n"
+		"Replayed state runs: %i (%i commands, ~%0.3f ms saved)\n"
 		"Draw calls: %i, flushes %i, clears %i\n"
 		"Cached Draw calls: %i\n"
 		"Num Tracked Vertex Arrays: %i\n"
@@ -292,6 +293,9 @@ void GPU_DX9::GetStats(char *buffer, size_t bufsize) {
 		"Readbacks: %d, uploads: %d\n"
 		"Vertex, Fragment shaders loaded: %i, %i\n",
 		gpuStats.msProcessingDisplayLists * 1000.0f,
+		gpuStats.numReplayedCommandRuns,
+		gpuStats.numReplayedCommands,
+		gpuStats.msSavedByCommandReplay,
 		gpuStats.numDrawCalls,
 		gpuStats.numFlushes,
 		gpuStats.numClears,
@@ -494,6 +494,7 @@ void GPU_GLES::GetStats(char *buffer, size_t bufsize) {
 	float vertexAverageCycles = gpuStats.numVertsSubmitted > 0 ? (float)gpuStats.vertexGPUCycles / (float)gpuStats.numVertsSubmitted : 0.0f;
 	snprintf(buffer, bufsize - 1,
 		"DL processing time: %0.2f ms\n"
+		"Replayed state runs: %i (%i commands, ~%0.3f ms saved)\n"
 		"Draw calls: %i, flushes %i, clears %i\n"
 		"Cached Draw calls: %i\n"
 		"Num Tracked Vertex Arrays: %i\n"
@@ -503,9 +504,13 @@ void GPU_GLES::GetStats(char *buffer, size_t bufsize) {
 		"Cached, Uncached Vertices Drawn: %i, %i\n"
 		"FBOs active: %i\n"
 		"Textures active: %i, decoded: %i  invalidated: %i\n"
+		"Textures upscaled in background: %i (%0.2f ms off this thread)\n"
 		"Readbacks: %d, uploads: %d\n"
 		"Vertex, Fragment, Programs loaded: %i, %i, %i\n",
 		gpuStats.msProcessingDisplayLists * 1000.0f,
+		gpuStats.numReplayedCommandRuns,
+		gpuStats.numReplayedCommands,
+		gpuStats.msSavedByCommandReplay,
 		gpuStats.numDrawCalls,
 		gpuStats.numFlushes,
 		gpuStats.numClears,
@@ -521,6 +526,8 @@ void GPU_GLES::GetStats(char *buffer, size_t bufsize) {
 		(int)textureCacheGL_->NumLoadedTextures(),
 		gpuStats.numTexturesDecoded,
 		gpuStats.numTextureInvalidations,
+		gpuStats.numTexturesScaledAsync,
+		gpuStats.msTextureScalingAsync,
 		gpuStats.numReadbacks,
 		gpuStats.numUploads,
 		shaderManagerGL_->GetNumVertexShaders(),
@@ -49,6 +49,7 @@ TextureCacheGLES::TextureCacheGLES(Draw::DrawContext *draw)
 	timesInvalidatedAllThisFrame_ = 0;
 	lastBoundTexture = nullptr;
 	render_ = (GLRenderManager *)draw_->GetNativeObject(Draw::NativeObject::RENDER_MANAGER);
+	asyncScaler_ = &asyncScaler;
 
 	SetupTextureDecoder();
 
@@ -60,6 +61,7 @@ TextureCacheGLES::TextureCacheGLES(Draw::DrawContext *draw)
 }
 
 TextureCacheGLES::~TextureCacheGLES() {
+	StopAsyncScaling();
 	render_->DeleteInputLayout(shadeInputLayout_);
 	Clear(true);
 }
@@ -230,6 +232,7 @@ void TextureCacheGLES::StartFrame() {
 	} else {
 		Decimate();
 	}
+	ProcessAsyncScales();
 }
 
 void TextureCacheGLES::UpdateCurrentClut(GEPaletteFormat clutFormat, u32 clutBase, bool clutIndexIsSimple) {
@@ -564,6 +567,7 @@ void TextureCacheGLES::BuildTexture(TexCacheEntry *const entry, bool replaceImag
 	GLenum dstFmt = GetDestFormat(GETextureFormat(entry->format), gstate.getClutPaletteFormat());
 
 	int scaleFactor = standardScaleFactor_;
+	int asyncScaleFactor = 1;
 
 	// Rachet down scale factor in low-memory mode.
 	if (lowMemoryMode_) {
@@ -601,7 +605,12 @@ void TextureCacheGLES::BuildTexture(TexCacheEntry *const entry, bool replaceImag
 	}
 
 	if (scaleFactor != 1) {
-		if (texelsScaledThisFrame_ >= TEXCACHE_MAX_TEXELS_SCALED) {
+		if (CanScaleAsync()) {
+			// Build it unscaled for now, LoadTextureLevel() queues the scale.
+			entry->status |= TexCacheEntry::STATUS_TO_SCALE | TexCacheEntry::STATUS_SCALE_QUEUED;
+			asyncScaleFactor = scaleFactor;
+			scaleFactor = 1;
+		} else if (texelsScaledThisFrame_ >= TEXCACHE_MAX_TEXELS_SCALED) {
 			entry->status |= TexCacheEntry::STATUS_TO_SCALE;
 			scaleFactor = 1;
 		} else {
@@ -623,9 +632,9 @@ void TextureCacheGLES::BuildTexture(TexCacheEntry *const entry, bool replaceImag
 	if (IsFakeMipmapChange()) {
 		// NOTE: Since the level is not part of the cache key, we assume it never changes.
 		u8 level = std::max(0, gstate.getTexLevelOffset16() / 16);
-		LoadTextureLevel(*entry, replaced, level, replaceImages, scaleFactor, dstFmt);
+		LoadTextureLevel(*entry, replaced, level, replaceImages, scaleFactor, dstFmt, asyncScaleFactor);
 	} else
-		LoadTextureLevel(*entry, replaced, 0, replaceImages, scaleFactor, dstFmt);
+		LoadTextureLevel(*entry, replaced, 0, replaceImages, scaleFactor, dstFmt, asyncScaleFactor);
 
 	// Mipmapping only enable when texture scaling disable
 	int texMaxLevel = 0;
@@ -676,6 +685,31 @@ void TextureCacheGLES::BuildTexture(TexCacheEntry *const entry, bool replaceImag
 	UpdateSamplingParams(*entry, true);
 }
 
+bool TextureCacheGLES::UploadScaledTexture(TexCacheEntry *entry, u32 *data, u32 dstFmt, int w, int h, int factor) {
+	if (replacer_.Enabled()) {
+		ReplacedTextureDecodeInfo replacedInfo;
+		replacedInfo.cachekey = entry->CacheKey();
+		replacedInfo.hash = entry->fullhash;
+		replacedInfo.addr = entry->addr;
+		replacedInfo.isVideo = videos_.find(entry->addr & 0x3FFFFFFF) != videos_.end();
+		replacedInfo.isFinal = true;
+		replacedInfo.scaleFactor = factor;
+		replacedInfo.fmt = FromGLESFormat(dstFmt);
+		replacer_.NotifyTextureDecoded(replacedInfo, data, w * sizeof(u32), 0, w, h);
+	}
+
+	// Draws already queued still reference the unscaled texture, so swap in a new one.
+	InvalidateLastTexture(entry);
+	if (entry->textureName) {
+		render_->DeleteTexture(entry->textureName);
+	}
+	entry->textureName = render_->CreateTexture(GL_TEXTURE_2D);
+	render_->TextureImage(entry->textureName, 0, w, h, GL_RGBA, GL_RGBA, dstFmt, (uint8_t *)data, GLRAllocType::ALIGNED);
+	// Like other scaled textures, no mips.
+	render_->FinalizeTexture(entry->textureName, 0, false);
+	return true;
+}
+
 GLenum TextureCacheGLES::GetDestFormat(GETextureFormat format, GEPaletteFormat clutFormat) const {
 	switch (format) {
 	case GE_TFMT_CLUT4:
@@ -719,7 +753,7 @@ TexCacheEntry::TexStatus TextureCacheGLES::CheckAlpha(const uint8_t *pixelData,
 	return (TexCacheEntry::TexStatus)res;
 }
 
-void TextureCacheGLES::LoadTextureLevel(TexCacheEntry &entry, ReplacedTexture &replaced, int level, bool replaceImages, int scaleFactor, GLenum dstFmt) {
+void TextureCacheGLES::LoadTextureLevel(TexCacheEntry &entry, ReplacedTexture &replaced, int level, bool replaceImages, int scaleFactor, GLenum dstFmt, int asyncScaleFactor) {
 	int w = gstate.getTextureWidth(level);
 	int h = gstate.getTextureHeight(level);
 	bool useUnpack = false;
@@ -762,6 +796,10 @@ void TextureCacheGLES::LoadTextureLevel(TexCacheEntry &entry, ReplacedTexture &r
 			entry.SetAlphaStatus(TexCacheEntry::STATUS_ALPHA_UNKNOWN);
 		}
 
+		if (asyncScaleFactor > 1) {
+			QueueAsyncScale(&entry, pixelData, decPitch * h, dstFmt, w, h, asyncScaleFactor);
+		}
+
 		if (scaleFactor > 1) {
 			uint8_t *rearrange = (uint8_t *)AllocateAlignedMemory(w * scaleFactor * h * scaleFactor * 4, 16);
 			scaler.ScaleAlways((u32 *)rearrange, (u32 *)pixelData, dstFmt, w, h, scaleFactor);
@@ -72,10 +72,11 @@ class TextureCacheGLES : public TextureCacheCommon {
 	void BindTexture(TexCacheEntry *entry) override;
 	void Unbind() override;
 	void ReleaseTexture(TexCacheEntry *entry, bool delete_them) override;
+	bool UploadScaledTexture(TexCacheEntry *entry, u32 *data, u32 dstFmt, int w, int h, int factor) override;
 
 private:
 	void UpdateSamplingParams(TexCacheEntry &entry, bool force);
-	void LoadTextureLevel(TexCacheEntry &entry, ReplacedTexture &replaced, int level, bool replaceImages, int scaleFactor, GLenum dstFmt);
+	void LoadTextureLevel(TexCacheEntry &entry, ReplacedTexture &replaced, int level, bool replaceImages, int scaleFactor, GLenum dstFmt, int asyncScaleFactor = 1);
 	GLenum GetDestFormat(GETextureFormat format, GEPaletteFormat clutFormat) const;
 
 	TexCacheEntry::TexStatus CheckAlpha(const uint8_t *pixelData, GLenum dstFmt, int stride, int w, int h);
@@ -87,6 +88,8 @@ class TextureCacheGLES : public TextureCacheCommon {
 	GLRenderManager *render_;
 
 	TextureScalerGLES scaler;
+	// Used by the background scaling thread.
+	TextureScalerGLES asyncScaler;
 
 	GLRTexture *lastBoundTexture;
 
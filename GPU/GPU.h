@@ -71,6 +71,11 @@ struct GPUStatistics {
 		numUploads = 0;
 		numClears = 0;
 		msProcessingDisplayLists = 0;
+		numReplayedCommandRuns = 0;
+		numReplayedCommands = 0;
+		msSavedByCommandReplay = 0;
+		numTexturesScaledAsync = 0;
+		msTextureScalingAsync = 0;
 		vertexGPUCycles = 0;
 		otherGPUCycles = 0;
 		memset(gpuCommandsAtCallLevel, 0, sizeof(gpuCommandsAtCallLevel));
@@ -92,6 +97,14 @@ struct GPUStatistics {
 	int numUploads;
 	int numClears;
 	double msProcessingDisplayLists;
+	// Runs of state commands applied from the cache, and roughly how much time that saved.
+	// The estimate is only collected along with the other debug stats.
+	int numReplayedCommandRuns;
+	int numReplayedCommands;
+	double msSavedByCommandReplay;
+	// Upscaled textures uploaded from the worker thread, and the scaling time that took off this thread.
+	int numTexturesScaledAsync;
+	double msTextureScalingAsync;
 	int vertexGPUCycles;
 	int otherGPUCycles;
 	int gpuCommandsAtCallLevel[4];
@@ -1,9 +1,11 @@
 #include <algorithm>
+#include <chrono>
 #include <type_traits>
 #include <mutex>
 
 #include "base/timeutil.h"
 #include "profiler/profiler.h"
+#include "thread/threadutil.h"
 
 #include "Common/ColorConv.h"
 #include "Core/Reporting.h"
@@ -29,6 +31,9 @@
 #include "GPU/Common/DrawEngineCommon.h"
 #include "GPU/Debugger/Record.h"
 
+// Commands with none of these only write cmdmem and dirty state, so a run of them can be collapsed.
+static const uint64_t FLAG_NOT_PLAIN_STATE = FLAG_FLUSHBEFORE | FLAG_EXECUTE | FLAG_EXECUTEONCHANGE | FLAG_READS_PC | FLAG_WRITES_PC;
+
 const CommonCommandTableEntry commonCommandTable[] = {
 	// From Common. No flushing but definitely need execute.
 	{ GE_CMD_OFFSETADDR, FLAG_EXECUTE, 0, &GPUCommon::Execute_OffsetAddr },
@@ -406,6 +411,7 @@ GPUCommon::GPUCommon(GraphicsContext *gfxCtx, Draw::DrawContext *draw) :
 }
 
 GPUCommon::~GPUCommon() {
+	StopListThread();
 }
 
 void GPUCommon::BeginHostFrame() {
@@ -420,6 +426,8 @@ void GPUCommon::EndHostFrame() {
 }
 
 void GPUCommon::Reinitialize() {
+	SyncListThread();
+	InvalidateStateRuns(0, -1);
 	memset(dls, 0, sizeof(dls));
 	for (int i = 0; i < DisplayListMaxCount; ++i) {
 		dls[i].state = PSP_GE_DL_STATE_NONE;
@@ -497,6 +505,7 @@ void GPUCommon::DumpNextFrame() {
 }
 
 u32 GPUCommon::DrawSync(int mode) {
+	SyncListThread();
 	if (mode < 0 || mode > 1)
 		return SCE_KERNEL_ERROR_INVALID_MODE;
 
@@ -545,6 +554,7 @@ void GPUCommon::CheckDrawSync() {
 }
 
 int GPUCommon::ListSync(int listid, int mode) {
+	SyncListThread();
 	if (listid < 0 || listid >= DisplayListMaxCount)
 		return SCE_KERNEL_ERROR_INVALID_ID;
 
@@ -589,6 +599,7 @@ int GPUCommon::ListSync(int listid, int mode) {
 }
 
 int GPUCommon::GetStack(int index, u32 stackPtr) {
+	SyncListThread();
 	if (!currentList) {
 		// Seems like it doesn't return an error code?
 		return 0;
@@ -614,6 +625,7 @@ int GPUCommon::GetStack(int index, u32 stackPtr) {
 }
 
 u32 GPUCommon::EnqueueList(u32 listpc, u32 stall, int subIntrBase, PSPPointer<PspGeListArgs> args, bool head) {
+	SyncListThread();
 	// TODO Check the stack values in missing arg and ajust the stack depth
 
 	// Check alignment
@@ -719,6 +731,7 @@ u32 GPUCommon::EnqueueList(u32 listpc, u32 stall, int subIntrBase, PSPPointer<Ps
 }
 
 u32 GPUCommon::DequeueList(int listid) {
+	SyncListThread();
 	if (listid < 0 || listid >= DisplayListMaxCount || dls[listid].state == PSP_GE_DL_STATE_NONE)
 		return SCE_KERNEL_ERROR_INVALID_ID;
 
@@ -742,6 +755,7 @@ u32 GPUCommon::DequeueList(int listid) {
 }
 
 u32 GPUCommon::UpdateStall(int listid, u32 newstall) {
+	SyncListThread();
 	if (listid < 0 || listid >= DisplayListMaxCount || dls[listid].state == PSP_GE_DL_STATE_NONE)
 		return SCE_KERNEL_ERROR_INVALID_ID;
 	auto &dl = dls[listid];
@@ -756,6 +770,7 @@ u32 GPUCommon::UpdateStall(int listid, u32 newstall) {
 }
 
 u32 GPUCommon::Continue() {
+	SyncListThread();
 	if (!currentList)
 		return 0;
 
@@ -796,6 +811,7 @@ u32 GPUCommon::Continue() {
 }
 
 u32 GPUCommon::Break(int mode) {
+	SyncListThread();
 	if (mode < 0 || mode > 1)
 		return SCE_KERNEL_ERROR_INVALID_MODE;
 
@@ -947,7 +963,8 @@ bool GPUCommon::InterpretList(DisplayList &list) {
 	if (coreCollectDebugStats) {
 		time_update();
 		double total = time_now_d() - start - timeSpentStepping_;
-		hleSetSteppingTime(timeSpentStepping_);
+		if (!onListThread_)
+			hleSetSteppingTime(timeSpentStepping_);
 		timeSpentStepping_ = 0.0;
 		gpuStats.msProcessingDisplayLists += total;
 	}
@@ -959,11 +976,27 @@ void GPUCommon::FastRunLoop(DisplayList &list) {
 	PROFILE_THIS_SCOPE("gpuloop");
 	const CommandInfo *cmdInfo = cmdInfo_;
 	int dc = downcount;
+	bool runStart = true;
 	for (; dc > 0; --dc) {
 		// We know that display list PCs have the upper nibble == 0 - no need to mask the pointer
 		const u32 op = *(const u32 *)(Memory::base + list.pc);
 		const u32 cmd = op >> 24;
 		const CommandInfo &info = cmdInfo[cmd];
+		if ((info.flags & FLAG_NOT_PLAIN_STATE) == 0) {
+			if (runStart) {
+				runStart = false;
+				int count = ReplayStateRun(list.pc, dc);
+				if (count != 0) {
+					list.pc += count * 4;
+					dc -= count - 1;
+					continue;
+				}
+			}
+		} else {
+			// Long state runs are mostly setup at the start of (sub)lists, don't bother between prims.
+			runStart = (info.flags & FLAG_WRITES_PC) != 0;
+		}
+
 		const u32 diff = op ^ gstate.cmdmem[cmd];
 		if (diff == 0) {
 			if (info.flags & FLAG_EXECUTE) {
@@ -994,7 +1027,166 @@ void GPUCommon::FastRunLoop(DisplayList &list) {
 	downcount = 0;
 }
 
+// Shorter runs aren't worth a lookup.
+static const int STATE_RUN_MIN = 8;
+static const int STATE_RUN_MAX = 256;
+static const size_t STATE_RUNS_MAX_ENTRIES = 4096;
+// Runs that keep changing (rebuilt lists) stop being recorded after this many misses in a row.
+static const int STATE_RUN_MAX_MISSES = 4;
+// With stats on, one in this many hits runs normally, to measure what the cache saves.
+static const int STATE_RUN_SAMPLE_RATE = 32;
+
+int GPUCommon::ReplayStateRun(u32 pc, int maxCount) {
+	if (maxCount < STATE_RUN_MIN)
+		return 0;
+
+	// Check a few first, so short runs don't pay for a lookup.
+	const u32 *src = (const u32 *)(Memory::base + pc);
+	for (int i = 1; i < STATE_RUN_MIN; ++i) {
+		if (cmdInfo_[src[i] >> 24].flags & FLAG_NOT_PLAIN_STATE)
+			return 0;
+	}
+
+	auto it = stateRuns_.find(pc);
+	if (it != stateRuns_.end()) {
+		StateRun &run = it->second;
+		if (run.misses >= STATE_RUN_MAX_MISSES)
+			return 0;
+		const int count = (int)run.ops.size();
+		if (count <= maxCount && memcmp(src, &run.ops[0], count * sizeof(u32)) == 0) {
+			run.misses = 0;
+			if (!coreCollectDebugStats) {
+				ApplyStateRun(run);
+				return count;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			if ((++stateRunHits_ % STATE_RUN_SAMPLE_RATE) == 0) {
+				ExecuteStateRun(src, count);
+				stateRunNormalNs_ += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+				stateRunNormalCmds_ += count;
+				return count;
+			}
+
+			ApplyStateRun(run);
+			double replayNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+			gpuStats.numReplayedCommandRuns++;
+			gpuStats.numReplayedCommands += count;
+			if (stateRunNormalCmds_ != 0) {
+				double normalNs = count * stateRunNormalNs_ / (double)stateRunNormalCmds_;
+				gpuStats.msSavedByCommandReplay += (normalNs - replayNs) * 0.000001;
+			}
+			return count;
+		}
+	}
+
+	// New or changed, so record it.
+	int count = STATE_RUN_MIN;
+	const int limit = std::min(maxCount, STATE_RUN_MAX);
+	if (!Memory::IsValidRange(pc, limit * sizeof(u32)))
+		return 0;
+	while (count < limit && (cmdInfo_[src[count] >> 24].flags & FLAG_NOT_PLAIN_STATE) == 0)
+		count++;
+
+	if (stateRuns_.size() >= STATE_RUNS_MAX_ENTRIES) {
+		InvalidateStateRuns(0, -1);
+	}
+
+	StateRun &run = stateRuns_[pc];
+	if (!run.ops.empty())
+		run.misses++;
+	run.ops.assign(src, src + count);
+	run.finalOps.clear();
+
+	// Anything that flushes on change goes first, so pending draws are flushed before we change anything.
+	bool seen[256]{};
+	for (int pass = 0; pass < 2; ++pass) {
+		const bool wantFlush = pass == 0;
+		for (int i = count - 1; i >= 0; --i) {
+			const u32 cmd = src[i] >> 24;
+			const bool flushes = (cmdInfo_[cmd].flags & FLAG_FLUSHBEFOREONCHANGE) != 0;
+			if (flushes == wantFlush && !seen[cmd]) {
+				seen[cmd] = true;
+				run.finalOps.push_back(src[i]);
+			}
+		}
+	}
+
+	stateRunsStart_ = std::min(stateRunsStart_, pc);
+	stateRunsEnd_ = std::max(stateRunsEnd_, pc + count * 4);
+
+	ExecuteStateRun(src, count);
+	return count;
+}
+
+// Exactly what FastRunLoop() does for plain state commands.
+void GPUCommon::ExecuteStateRun(const u32 *ops, int count) {
+	for (int i = 0; i < count; ++i) {
+		const u32 op = ops[i];
+		const u32 cmd = op >> 24;
+		const u32 diff = op ^ gstate.cmdmem[cmd];
+		if (diff != 0) {
+			const uint64_t flags = cmdInfo_[cmd].flags;
+			if (flags & FLAG_FLUSHBEFOREONCHANGE) {
+				if (drawEngineCommon_->GetNumDrawCalls()) {
+					drawEngineCommon_->DispatchFlush();
+				}
+			}
+			gstate.cmdmem[cmd] = op;
+			uint64_t dirty = flags >> 8;
+			if (dirty)
+				gstate_c.Dirty(dirty);
+		}
+	}
+}
+
+// Same end result as ExecuteStateRun(), but only touches each register once.
+void GPUCommon::ApplyStateRun(const StateRun &run) {
+	bool flushed = false;
+	for (const u32 op : run.finalOps) {
+		const u32 cmd = op >> 24;
+		const u32 diff = op ^ gstate.cmdmem[cmd];
+		if (diff != 0) {
+			const uint64_t flags = cmdInfo_[cmd].flags;
+			if ((flags & FLAG_FLUSHBEFOREONCHANGE) && !flushed) {
+				if (drawEngineCommon_->GetNumDrawCalls()) {
+					drawEngineCommon_->DispatchFlush();
+				}
+				flushed = true;
+			}
+			gstate.cmdmem[cmd] = op;
+			uint64_t dirty = flags >> 8;
+			if (dirty)
+				gstate_c.Dirty(dirty);
+		}
+	}
+}
+
+void GPUCommon::InvalidateStateRuns(u32 addr, int size) {
+	if (size <= 0) {
+		stateRuns_.clear();
+		stateRunsStart_ = 0xFFFFFFFF;
+		stateRunsEnd_ = 0;
+		return;
+	}
+
+	// Every replay checks the words anyway, this just drops runs we know are stale.
+	addr &= 0x0FFFFFFF;
+	const u32 end = addr + size;
+	if (end <= stateRunsStart_ || addr >= stateRunsEnd_)
+		return;
+	for (auto it = stateRuns_.begin(); it != stateRuns_.end(); ) {
+		const u32 runEnd = it->first + (u32)it->second.ops.size() * 4;
+		if (it->first < end && runEnd > addr) {
+			it = stateRuns_.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
 void GPUCommon::BeginFrame() {
+	SyncListThread();
 	immCount_ = 0;
 	if (dumpNextFrame_) {
 		NOTICE_LOG(G3D, "DUMPING THIS FRAME");
@@ -1098,9 +1290,26 @@ int GPUCommon::GetNextListIndex() {
 }
 
 void GPUCommon::ProcessDLQueue() {
+	SyncListThread();
 	startingTicks = CoreTiming::GetTicks();
 	cyclesExecuted = 0;
 
+	if (UseListThread()) {
+		if (!listThread_) {
+			listThreadState_ = ListThreadState::READY;
+			listThread_ = new std::thread([this] { ListThreadFunc(); });
+		}
+
+		// Everything the CPU can observe goes through SyncListThread() first, so we can just go.
+		std::lock_guard<std::mutex> guard(listThreadMutex_);
+		listThreadState_ = ListThreadState::QUEUED;
+		listWake_.notify_one();
+	} else {
+		ProcessDLQueueInternal();
+	}
+}
+
+void GPUCommon::ProcessDLQueueInternal() {
 	// Seems to be correct behaviour to process the list anyway?
 	if (startingTicks < busyTicks) {
 		DEBUG_LOG(G3D, "Can't execute a list yet, still busy for %lld ticks", busyTicks - startingTicks);
@@ -1125,10 +1334,95 @@ void GPUCommon::ProcessDLQueue() {
 
 	drawCompleteTicks = startingTicks + cyclesExecuted;
 	busyTicks = std::max(busyTicks, drawCompleteTicks);
-	__GeTriggerSync(GPU_SYNC_DRAW, 1, drawCompleteTicks);
+	TriggerSync(GPU_SYNC_DRAW, 1, drawCompleteTicks);
 	// Since the event is in CoreTiming, we're in sync.  Just set 0 now.
 }
 
+bool GPUCommon::UseListThread() {
+	if (!g_Config.bDisplayListThread || !SupportsListThread())
+		return false;
+	// Stepping, recording, and memchecks all need to happen on the emulation thread.
+	return !host->GPUDebuggingActive() && !GPURecord::IsActive() && !CBreakPoints::HasMemChecks();
+}
+
+void GPUCommon::ListThreadFunc() {
+	setCurrentThreadName("GPUList");
+
+	std::unique_lock<std::mutex> guard(listThreadMutex_);
+	while (true) {
+		listWake_.wait(guard, [this] { return listThreadState_ != ListThreadState::READY; });
+		if (listThreadState_ == ListThreadState::DISABLED)
+			break;
+
+		guard.unlock();
+		onListThread_ = true;
+		ProcessDLQueueInternal();
+		onListThread_ = false;
+		bool notify = !pendingNotify_.empty();
+		guard.lock();
+
+		listThreadState_ = ListThreadState::READY;
+		listDone_.notify_all();
+		if (notify) {
+			// Make sure interrupts get delivered even if the game doesn't call into sceGe again.
+			__GeNotifyListThreadDone();
+		}
+	}
+}
+
+void GPUCommon::SyncListThread() {
+	if (!listThread_ || std::this_thread::get_id() == listThread_->get_id())
+		return;
+
+	{
+		std::unique_lock<std::mutex> guard(listThreadMutex_);
+		listDone_.wait(guard, [this] { return listThreadState_ != ListThreadState::QUEUED; });
+	}
+
+	// Now deliver what happened, in order.  They'll be late if the CPU has already passed their ticks.
+	for (const PendingNotify &notify : pendingNotify_) {
+		if (notify.interrupt)
+			__GeTriggerInterrupt(notify.listid, notify.pc, notify.ticks);
+		else
+			__GeTriggerSync(notify.type, notify.listid, notify.ticks);
+	}
+	pendingNotify_.clear();
+}
+
+void GPUCommon::StopListThread() {
+	if (!listThread_)
+		return;
+
+	{
+		std::unique_lock<std::mutex> guard(listThreadMutex_);
+		listDone_.wait(guard, [this] { return listThreadState_ != ListThreadState::QUEUED; });
+		listThreadState_ = ListThreadState::DISABLED;
+		listWake_.notify_one();
+	}
+	listThread_->join();
+	delete listThread_;
+	listThread_ = nullptr;
+	// We're shutting down, too late to deliver these.
+	pendingNotify_.clear();
+}
+
+bool GPUCommon::TriggerInterrupt(int listid, u32 pc, u64 atTicks) {
+	if (onListThread_) {
+		// __GeTriggerInterrupt() always accepts, so we can act as if it already did.
+		pendingNotify_.push_back({ true, GPU_SYNC_DRAW, listid, pc, atTicks });
+		return true;
+	}
+	return __GeTriggerInterrupt(listid, pc, atTicks);
+}
+
+void GPUCommon::TriggerSync(GPUSyncType type, int listid, u64 atTicks) {
+	if (onListThread_) {
+		pendingNotify_.push_back({ false, type, listid, 0, atTicks });
+		return;
+	}
+	__GeTriggerSync(type, listid, atTicks);
+}
+
 void GPUCommon::PreExecuteOp(u32 op, u32 diff) {
 	// Nothing to do
 }
@@ -1342,7 +1636,7 @@ void GPUCommon::Execute_End(u32 op, u32 diff) {
 			}
 			// TODO: Technically, jump/call/ret should generate an interrupt, but before the pc change maybe?
 			if (currentList->interruptsEnabled && trigger) {
-				if (__GeTriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
+				if (TriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
 					currentList->pendingInterrupt = true;
 					UpdateState(GPUSTATE_INTERRUPT);
 				}
@@ -1354,7 +1648,7 @@ void GPUCommon::Execute_End(u32 op, u32 diff) {
 		case PSP_GE_SIGNAL_HANDLER_PAUSE:
 			currentList->state = PSP_GE_DL_STATE_PAUSED;
 			if (currentList->interruptsEnabled) {
-				if (__GeTriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
+				if (TriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
 					currentList->pendingInterrupt = true;
 					UpdateState(GPUSTATE_INTERRUPT);
 				}
@@ -1369,13 +1663,13 @@ void GPUCommon::Execute_End(u32 op, u32 diff) {
 		default:
 			currentList->subIntrToken = prev & 0xFFFF;
 			UpdateState(GPUSTATE_DONE);
-			if (currentList->interruptsEnabled && __GeTriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
+			if (currentList->interruptsEnabled && TriggerInterrupt(currentList->id, currentList->pc, startingTicks + cyclesExecuted)) {
 				currentList->pendingInterrupt = true;
 			} else {
 				currentList->state = PSP_GE_DL_STATE_COMPLETED;
 				currentList->waitTicks = startingTicks + cyclesExecuted;
 				busyTicks = std::max(busyTicks, currentList->waitTicks);
-				__GeTriggerSync(GPU_SYNC_LIST, currentList->id, currentList->waitTicks);
+				TriggerSync(GPU_SYNC_LIST, currentList->id, currentList->waitTicks);
 				if (currentList->started && currentList->context.IsValid()) {
 					gstate.Restore(currentList->context);
 					ReapplyGfxState();
@@ -2197,10 +2491,16 @@ struct DisplayList_v2 {
 };
 
 void GPUCommon::DoState(PointerWrap &p) {
+	SyncListThread();
 	auto s = p.Section("GPUCommon", 1, 4);
 	if (!s)
 		return;
 
+	if (p.mode == PointerWrap::MODE_READ) {
+		// RAM is about to change under us, these would just miss.
+		InvalidateStateRuns(0, -1);
+	}
+
 	p.Do<int>(dlQueue);
 	if (s >= 4) {
 		p.DoArray(dls, ARRAY_SIZE(dls));
@@ -2272,9 +2572,11 @@ void GPUCommon::DoState(PointerWrap &p) {
 }
 
 void GPUCommon::InterruptStart(int listid) {
+	SyncListThread();
 	interruptRunning = true;
 }
 void GPUCommon::InterruptEnd(int listid) {
+	SyncListThread();
 	interruptRunning = false;
 	isbreak = false;
 
@@ -2295,6 +2597,7 @@ void GPUCommon::InterruptEnd(int listid) {
 
 // TODO: Maybe cleaner to keep this in GE and trigger the clear directly?
 void GPUCommon::SyncEnd(GPUSyncType waitType, int listid, bool wokeThreads) {
+	SyncListThread();
 	if (waitType == GPU_SYNC_DRAW && wokeThreads)
 	{
 		for (int i = 0; i < DisplayListMaxCount; ++i) {
@@ -2306,6 +2609,7 @@ void GPUCommon::SyncEnd(GPUSyncType waitType, int listid, bool wokeThreads) {
 }
 
 bool GPUCommon::GetCurrentDisplayList(DisplayList &list) {
+	SyncListThread();
 	if (!currentList) {
 		return false;
 	}
@@ -2314,6 +2618,7 @@ bool GPUCommon::GetCurrentDisplayList(DisplayList &list) {
 }
 
 std::vector<DisplayList> GPUCommon::ActiveDisplayLists() {
+	SyncListThread();
 	std::vector<DisplayList> result;
 
 	for (auto it = dlQueue.begin(), end = dlQueue.end(); it != end; ++it) {
@@ -2324,6 +2629,7 @@ std::vector<DisplayList> GPUCommon::ActiveDisplayLists() {
 }
 
 void GPUCommon::ResetListPC(int listID, u32 pc) {
+	SyncListThread();
 	if (listID < 0 || listID >= DisplayListMaxCount) {
 		_dbg_assert_msg_(G3D, false, "listID out of range: %d", listID);
 		return;
@@ -2333,6 +2639,7 @@ void GPUCommon::ResetListPC(int listID, u32 pc) {
 }
 
 void GPUCommon::ResetListStall(int listID, u32 stall) {
+	SyncListThread();
 	if (listID < 0 || listID >= DisplayListMaxCount) {
 		_dbg_assert_msg_(G3D, false, "listID out of range: %d", listID);
 		return;
@@ -2342,6 +2649,7 @@ void GPUCommon::ResetListStall(int listID, u32 stall) {
 }
 
 void GPUCommon::ResetListState(int listID, DisplayListState state) {
+	SyncListThread();
 	if (listID < 0 || listID >= DisplayListMaxCount) {
 		_dbg_assert_msg_(G3D, false, "listID out of range: %d", listID);
 		return;
@@ -2388,18 +2696,22 @@ u32 GPUCommon::GetRelativeAddress(u32 data) {
 }
 
 u32 GPUCommon::GetVertexAddress() {
+	SyncListThread();
 	return gstate_c.vertexAddr;
 }
 
 u32 GPUCommon::GetIndexAddress() {
+	SyncListThread();
 	return gstate_c.indexAddr;
 }
 
 GPUgstate GPUCommon::GetGState() {
+	SyncListThread();
 	return gstate;
 }
 
 void GPUCommon::SetCmdValue(u32 op) {
+	SyncListThread();
 	u32 cmd = op >> 24;
 	u32 diff = op ^ gstate.cmdmem[cmd];
 
@@ -2499,6 +2811,7 @@ void GPUCommon::DoBlockTransfer(u32 skipDrawReason) {
 }
 
 bool GPUCommon::PerformMemoryCopy(u32 dest, u32 src, int size) {
+	SyncListThread();
 	// Track stray copies of a framebuffer in RAM. MotoGP does this.
 	if (framebufferManager_->MayIntersectFramebuffer(src) || framebufferManager_->MayIntersectFramebuffer(dest)) {
 		if (!framebufferManager_->NotifyFramebufferCopy(src, dest, size, false, gstate_c.skipDrawReason)) {
@@ -2518,6 +2831,7 @@ bool GPUCommon::PerformMemoryCopy(u32 dest, u32 src, int size) {
 }
 
 bool GPUCommon::PerformMemorySet(u32 dest, u8 v, int size) {
+	SyncListThread();
 	// This may indicate a memset, usually to 0, of a framebuffer.
 	if (framebufferManager_->MayIntersectFramebuffer(dest)) {
 		Memory::Memset(dest, v, size);
@@ -2553,6 +2867,8 @@ bool GPUCommon::PerformMemoryUpload(u32 dest, int size) {
 }
 
 void GPUCommon::InvalidateCache(u32 addr, int size, GPUInvalidationType type) {
+	SyncListThread();
+	InvalidateStateRuns(addr, size);
 	if (size > 0)
 		textureCache_->Invalidate(addr, size, type);
 	else
@@ -2568,6 +2884,7 @@ void GPUCommon::InvalidateCache(u32 addr, int size, GPUInvalidationType type) {
 }
 
 void GPUCommon::NotifyVideoUpload(u32 addr, int size, int width, int format) {
+	SyncListThread();
 	if (Memory::IsVRAMAddress(addr)) {
 		framebufferManager_->NotifyVideoUpload(addr, size, width, (GEBufferFormat)format);
 	}
@@ -2576,6 +2893,7 @@ void GPUCommon::NotifyVideoUpload(u32 addr, int size, int width, int format) {
 }
 
 bool GPUCommon::PerformStencilUpload(u32 dest, int size) {
+	SyncListThread();
 	if (framebufferManager_->MayIntersectFramebuffer(dest)) {
 		framebufferManager_->NotifyStencilUpload(dest, size);
 		return true;
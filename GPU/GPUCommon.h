@@ -1,5 +1,11 @@
 #pragma once
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 #include "Common/Common.h"
 #include "Common/MemoryUtil.h"
 #include "GPU/GPUInterface.h"
@@ -83,6 +89,7 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 	void InterruptStart(int listid) override;
 	void InterruptEnd(int listid) override;
 	void SyncEnd(GPUSyncType waitType, int listid, bool wokeThreads) override;
+	void SyncListThread() override;
 	void EnableInterrupts(bool enable) override {
 		interruptsEnabled_ = enable;
 	}
@@ -225,10 +232,12 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 	}
 
 	DisplayList* getList(int listid) override {
+		SyncListThread();
 		return &dls[listid];
 	}
 
 	const std::list<int>& GetDisplayLists() override {
+		SyncListThread();
 		return dlQueue;
 	}
 	std::vector<FramebufferInfo> GetFramebufferList() override;
@@ -236,6 +245,7 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 	void CleanupBeforeUI() override {}
 
 	s64 GetListTicks(int listid) override {
+		SyncListThread();
 		if (listid >= 0 && listid < DisplayListMaxCount) {
 			return dls[listid].waitTicks;
 		}
@@ -283,8 +293,18 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 	// TODO: Unify this.
 	virtual void FinishDeferred() {}
 
+	// Backends that never touch the graphics context while executing commands can
+	// run display lists on a separate thread (see g_Config.bDisplayListThread.)
+	virtual bool SupportsListThread() const { return false; }
+	// Must be called before destroying anything the list thread might use.
+	void StopListThread();
+
 	void DoBlockTransfer(u32 skipDrawReason);
 
+	// Returns how many commands at pc were applied from the state run cache, or 0 to run them normally.
+	int ReplayStateRun(u32 pc, int maxCount);
+	void InvalidateStateRuns(u32 addr, int size);
+
 	void AdvanceVerts(u32 vertType, int count, int bytesRead) {
 		if ((vertType & GE_VTYPE_IDX_MASK) != GE_VTYPE_IDX_NONE) {
 			int indexShift = ((vertType & GE_VTYPE_IDX_MASK) >> GE_VTYPE_IDX_SHIFT) - 1;
@@ -351,6 +371,56 @@ class GPUCommon : public GPUInterface, public GPUDebugInterface {
 
 private:
 	void FlushImm();
+
+	void ProcessDLQueueInternal();
+	bool UseListThread();
+	void ListThreadFunc();
+	// These queue the notification when on the list thread, see SyncListThread().
+	bool TriggerInterrupt(int listid, u32 pc, u64 atTicks);
+	void TriggerSync(GPUSyncType type, int listid, u64 atTicks);
+
+	enum class ListThreadState {
+		DISABLED,
+		READY,
+		QUEUED,
+	};
+	struct PendingNotify {
+		bool interrupt;
+		GPUSyncType type;
+		int listid;
+		u32 pc;
+		u64 ticks;
+	};
+
+	std::thread *listThread_ = nullptr;
+	std::mutex listThreadMutex_;
+	std::condition_variable listWake_;
+	std::condition_variable listDone_;
+	ListThreadState listThreadState_ = ListThreadState::DISABLED;
+	// Only touched by whichever thread is processing lists.
+	bool onListThread_ = false;
+	std::vector<PendingNotify> pendingNotify_;
+
+	// A run of plain state commands, as last seen at some address.
+	struct StateRun {
+		// The original words, compared on every replay.
+		std::vector<u32> ops;
+		// The last write to each register in the run.  Ones that flush on change go first.
+		std::vector<u32> finalOps;
+		// Times in a row the words had changed.
+		int misses = 0;
+	};
+	void ExecuteStateRun(const u32 *ops, int count);
+	void ApplyStateRun(const StateRun &run);
+
+	std::unordered_map<u32, StateRun> stateRuns_;
+	u32 stateRunsStart_ = 0xFFFFFFFF;
+	u32 stateRunsEnd_ = 0;
+	// For the stats: how long plain commands take without the cache.
+	int stateRunHits_ = 0;
+	double stateRunNormalNs_ = 0.0;
+	s64 stateRunNormalCmds_ = 0;
+
 	// Debug stats.
 	double timeSteppingStarted_;
 	double timeSpentStepping_;
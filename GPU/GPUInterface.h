@@ -191,6 +191,9 @@ class GPUInterface {
 	virtual void InterruptStart(int listid) = 0;
 	virtual void InterruptEnd(int listid) = 0;
 	virtual void SyncEnd(GPUSyncType waitType, int listid, bool wokeThreads) = 0;
+	// Waits for any display list processing on the list thread, and delivers its interrupts/syncs.
+	// Must be called on the emulation thread.
+	virtual void SyncListThread() = 0;
 
 	virtual void PreExecuteOp(u32 op, u32 diff) = 0;
 	virtual void ExecuteOp(u32 op, u32 diff) = 0;
@@ -0,0 +1,108 @@
+// Copyright (c) 2013- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <atomic>
+
+#include "Common/ThreadPools.h"
+#include "Core/Config.h"
+#include "GPU/GPUState.h"
+#include "GPU/Software/BinManager.h"
+#include "GPU/Software/Rasterizer.h"
+
+namespace Rasterizer {
+
+bool BinManager::IsEnabled() const {
+	return g_Config.iNumWorkerThreads > 1;
+}
+
+void BinManager::AddTriangle(const VertexData &v0, const VertexData &v1, const VertexData &v2, int minX, int minY, int maxX, int maxY) {
+	if ((int)triangles_.size() >= MAX_TRIANGLES) {
+		Flush();
+	}
+
+	const int index = (int)triangles_.size();
+	triangles_.push_back({ v0, v1, v2, minX, minY, maxX, maxY });
+
+	const DrawingCoords tl = TransformUnit::ScreenToDrawing(ScreenCoords(minX, minY, 0));
+	const DrawingCoords br = TransformUnit::ScreenToDrawing(ScreenCoords(maxX, maxY, 0));
+	const int bx1 = std::max(0, (int)tl.x / BIN_SIZE);
+	const int by1 = std::max(0, (int)tl.y / BIN_SIZE);
+	const int bx2 = std::min(BIN_COUNT_X - 1, (int)br.x / BIN_SIZE);
+	const int by2 = std::min(BIN_COUNT_Y - 1, (int)br.y / BIN_SIZE);
+	for (int by = by1; by <= by2; ++by) {
+		for (int bx = bx1; bx <= bx2; ++bx) {
+			const int bin = by * BIN_COUNT_X + bx;
+			if (bins_[bin].empty()) {
+				usedBins_.push_back(bin);
+			}
+			bins_[bin].push_back(index);
+		}
+	}
+
+	pixels_ += ((maxX - minX) / 16 + 1) * ((maxY - minY) / 16 + 1);
+}
+
+void BinManager::DrawBin(int bin) {
+	const int bx = (bin % BIN_COUNT_X) * BIN_SIZE;
+	const int by = (bin / BIN_COUNT_X) * BIN_SIZE;
+	// The offset may not be whole pixels, so the bin ends right before the next one starts.
+	const ScreenCoords tl = TransformUnit::DrawingToScreen(DrawingCoords(bx, by, 0));
+	const ScreenCoords next = TransformUnit::DrawingToScreen(DrawingCoords(bx + BIN_SIZE, by + BIN_SIZE, 0));
+
+	for (int index : bins_[bin]) {
+		const BinnedTriangle &tri = triangles_[index];
+		const int x1 = std::max(tri.minX, tl.x);
+		const int y1 = std::max(tri.minY, tl.y);
+		const int x2 = std::min(tri.maxX, next.x - 1);
+		const int y2 = std::min(tri.maxY, next.y - 1);
+		DrawTriangleInRect(tri.v0, tri.v1, tri.v2, tri.minX, tri.minY, x1, y1, x2, y2);
+	}
+}
+
+void BinManager::Flush() {
+	if (triangles_.empty()) {
+		return;
+	}
+
+	const int numBins = (int)usedBins_.size();
+	if (numBins == 1 || pixels_ < MIN_PARALLEL_PIXELS) {
+		for (int bin : usedBins_) {
+			DrawBin(bin);
+		}
+	} else {
+		// Bins vary a lot in cost, so each slice keeps taking the next one until none are left.
+		std::atomic<int> next(0);
+		auto drawBins = [&](int, int) {
+			int i;
+			while ((i = next++) < numBins) {
+				DrawBin(usedBins_[i]);
+			}
+		};
+		const int slices = g_Config.iNumWorkerThreads;
+		GlobalThreadPool::Loop(drawBins, 0, slices * 2);
+	}
+
+	for (int bin : usedBins_) {
+		bins_[bin].clear();
+	}
+	usedBins_.clear();
+	triangles_.clear();
+	pixels_ = 0;
+}
+
+}  // namespace Rasterizer
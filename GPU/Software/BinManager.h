@@ -0,0 +1,72 @@
+// Copyright (c) 2013- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <vector>
+
+#include "GPU/Software/TransformUnit.h"
+
+namespace Rasterizer {
+
+// Sorts triangles into screen tiles, so that a whole batch can be drawn in parallel:
+// each tile is drawn by one thread, in submission order, and tiles never overlap.
+//
+// The rasterizer reads gstate directly, so everything binned is drawn with the state
+// at Flush() time.  SoftGPU flushes before any command that changes drawing state.
+class BinManager {
+public:
+	// Bounds are screen coordinates, already clipped to the scissor (inclusive.)
+	void AddTriangle(const VertexData &v0, const VertexData &v1, const VertexData &v2, int minX, int minY, int maxX, int maxY);
+	void Flush();
+
+	// Only worth it with worker threads to spread the tiles over.
+	bool IsEnabled() const;
+
+private:
+	enum {
+		// In pixels.
+		BIN_SIZE = 32,
+		// Drawing coordinates are 10 bits.
+		BIN_COUNT_X = 1024 / BIN_SIZE,
+		BIN_COUNT_Y = 1024 / BIN_SIZE,
+		// Flush when this many are queued, to keep memory use down.
+		MAX_TRIANGLES = 1024,
+		// Below this many pixels (roughly), waking the workers costs more than it saves.
+		MIN_PARALLEL_PIXELS = 64 * 64,
+	};
+
+	struct BinnedTriangle {
+		VertexData v0;
+		VertexData v1;
+		VertexData v2;
+		int minX;
+		int minY;
+		int maxX;
+		int maxY;
+	};
+
+	void DrawBin(int bin);
+
+	std::vector<BinnedTriangle> triangles_;
+	// Indexes into triangles_, in submission order.
+	std::vector<int> bins_[BIN_COUNT_X * BIN_COUNT_Y];
+	std::vector<int> usedBins_;
+	int pixels_ = 0;
+};
+
+}  // namespace Rasterizer
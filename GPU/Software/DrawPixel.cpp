@@ -0,0 +1,724 @@
+// Copyright (c) 2017- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <mutex>
+#include <cstdlib>
+
+#include "Common/StringUtils.h"
+#include "Core/Config.h"
+#include "Core/Reporting.h"
+#include "GPU/GPUState.h"
+#include "GPU/Software/DrawPixel.h"
+
+#if defined(_M_SSE)
+#include <emmintrin.h>
+#endif
+
+using namespace Math3D;
+
+namespace Rasterizer {
+
+static std::mutex jitCacheLock;
+static PixelJitCache *jitCache = nullptr;
+
+void Init() {
+	jitCache = new PixelJitCache();
+}
+
+void Shutdown() {
+	delete jitCache;
+	jitCache = nullptr;
+}
+
+bool DescribeCodePtr(const u8 *ptr, std::string &name) {
+	if (!jitCache || !jitCache->IsInSpace(ptr)) {
+		return false;
+	}
+
+	name = jitCache->DescribeCodePtr(ptr);
+	return true;
+}
+
+void ComputePixelFuncID(PixelFuncID *id_out) {
+	PixelFuncID id;
+
+	id.clearMode = gstate.isModeClear();
+	id.fbFormat = gstate.FrameBufFormat();
+	// TODO: Clear mode?
+	id.applyDepthRange = !gstate.isModeThrough();
+	id.alphaTestFunc = GE_COMP_ALWAYS;
+	id.depthTestFunc = GE_COMP_ALWAYS;
+
+	if (id.clearMode) {
+		id.colorTest = gstate.isClearModeColorMask();
+		id.stencilTest = gstate.isClearModeAlphaMask();
+		id.depthWrite = gstate.isClearModeDepthMask();
+		id.applyColorWriteMask = gstate.getClearModeColorMask() != 0;
+	} else {
+		id.colorTest = gstate.isColorTestEnabled();
+		if (gstate.isAlphaTestEnabled())
+			id.alphaTestFunc = gstate.getAlphaTestFunction();
+		if (gstate.isDepthTestEnabled()) {
+			id.depthTestFunc = gstate.getDepthTestFunction();
+			id.depthWrite = gstate.isDepthWriteEnabled();
+		}
+
+		id.stencilTest = gstate.isStencilTestEnabled();
+		if (id.stencilTest) {
+			id.stencilTestFunc = gstate.getStencilTestFunction();
+			id.sFail = gstate.getStencilOpSFail();
+			id.zFail = gstate.isDepthTestEnabled() ? gstate.getStencilOpZFail() : GE_STENCILOP_KEEP;
+			id.zPass = gstate.getStencilOpZPass();
+		}
+
+		// Doubling happens only when texturing is enabled, and after tests.
+		id.doubleColor = gstate.isTextureMapEnabled() && gstate.isColorDoublingEnabled();
+		id.applyFog = gstate.isFogEnabled() && !gstate.isModeThrough();
+
+		id.alphaBlend = gstate.isAlphaBlendEnabled();
+		if (id.alphaBlend) {
+			id.alphaBlendEq = gstate.getBlendEq();
+			id.alphaBlendSrc = gstate.getBlendFuncA();
+			id.alphaBlendDst = gstate.getBlendFuncB();
+		}
+
+		// Copy doesn't change anything, since logic ops never affect stencil.
+		id.applyLogicOp = gstate.isLogicOpEnabled() && gstate.getLogicOp() != GE_LOGIC_COPY;
+		if (id.applyLogicOp)
+			id.logicOp = gstate.getLogicOp();
+		id.applyColorWriteMask = gstate.getColorMask() != 0;
+	}
+
+	*id_out = id;
+}
+
+static inline bool DepthTestPassed(GEComparison func, int x, int y, u16 z) {
+	u16 reference_z = GetPixelDepth(x, y);
+
+	switch (func) {
+	case GE_COMP_NEVER:
+		return false;
+
+	case GE_COMP_ALWAYS:
+		return true;
+
+	case GE_COMP_EQUAL:
+		return (z == reference_z);
+
+	case GE_COMP_NOTEQUAL:
+		return (z != reference_z);
+
+	case GE_COMP_LESS:
+		return (z < reference_z);
+
+	case GE_COMP_LEQUAL:
+		return (z <= reference_z);
+
+	case GE_COMP_GREATER:
+		return (z > reference_z);
+
+	case GE_COMP_GEQUAL:
+		return (z >= reference_z);
+
+	default:
+		return 0;
+	}
+}
+
+static inline bool StencilTestPassed(const PixelFuncID &pixelID, u8 stencil) {
+	// TODO: Does the masking logic make any sense?
+	stencil &= gstate.getStencilTestMask();
+	u8 ref = gstate.getStencilTestRef() & gstate.getStencilTestMask();
+	switch (GEComparison(pixelID.stencilTestFunc)) {
+		case GE_COMP_NEVER:
+			return false;
+
+		case GE_COMP_ALWAYS:
+			return true;
+
+		case GE_COMP_EQUAL:
+			return ref == stencil;
+
+		case GE_COMP_NOTEQUAL:
+			return ref != stencil;
+
+		case GE_COMP_LESS:
+			return ref < stencil;
+
+		case GE_COMP_LEQUAL:
+			return ref <= stencil;
+
+		case GE_COMP_GREATER:
+			return ref > stencil;
+
+		case GE_COMP_GEQUAL:
+			return ref >= stencil;
+	}
+	return true;
+}
+
+static inline u8 ApplyStencilOp(GEBufferFormat fmt, GEStencilOp op, int x, int y) {
+	u8 old_stencil = GetPixelStencil(fmt, x, y); // TODO: Apply mask?
+	u8 reference_stencil = gstate.getStencilTestRef(); // TODO: Apply mask?
+
+	switch (op) {
+		case GE_STENCILOP_KEEP:
+			return old_stencil;
+
+		case GE_STENCILOP_ZERO:
+			return 0;
+
+		case GE_STENCILOP_REPLACE:
+			return reference_stencil;
+
+		case GE_STENCILOP_INVERT:
+			return ~old_stencil;
+
+		case GE_STENCILOP_INCR:
+			switch (fmt) {
+			case GE_FORMAT_8888:
+				if (old_stencil != 0xFF) {
+					return old_stencil + 1;
+				}
+				return old_stencil;
+			case GE_FORMAT_5551:
+				return 0xFF;
+			case GE_FORMAT_4444:
+				if (old_stencil < 0xF0) {
+					return old_stencil + 0x10;
+				}
+				return old_stencil;
+			default:
+				return old_stencil;
+			}
+			break;
+
+		case GE_STENCILOP_DECR:
+			switch (fmt) {
+			case GE_FORMAT_4444:
+				if (old_stencil >= 0x10)
+					return old_stencil - 0x10;
+				break;
+			default:
+				if (old_stencil != 0)
+					return old_stencil - 1;
+				return old_stencil;
+			}
+			break;
+	}
+
+	return old_stencil;
+}
+
+static inline u32 ApplyLogicOp(GELogicOp op, u32 old_color, u32 new_color) {
+	switch (op) {
+	case GE_LOGIC_CLEAR:
+		new_color = 0;
+		break;
+
+	case GE_LOGIC_AND:
+		new_color = new_color & old_color;
+		break;
+
+	case GE_LOGIC_AND_REVERSE:
+		new_color = new_color & ~old_color;
+		break;
+
+	case GE_LOGIC_COPY:
+		//new_color = new_color;
+		break;
+
+	case GE_LOGIC_AND_INVERTED:
+		new_color = ~new_color & old_color;
+		break;
+
+	case GE_LOGIC_NOOP:
+		new_color = old_color;
+		break;
+
+	case GE_LOGIC_XOR:
+		new_color = new_color ^ old_color;
+		break;
+
+	case GE_LOGIC_OR:
+		new_color = new_color | old_color;
+		break;
+
+	case GE_LOGIC_NOR:
+		new_color = ~(new_color | old_color);
+		break;
+
+	case GE_LOGIC_EQUIV:
+		new_color = ~(new_color ^ old_color);
+		break;
+
+	case GE_LOGIC_INVERTED:
+		new_color = ~old_color;
+		break;
+
+	case GE_LOGIC_OR_REVERSE:
+		new_color = new_color | ~old_color;
+		break;
+
+	case GE_LOGIC_COPY_INVERTED:
+		new_color = ~new_color;
+		break;
+
+	case GE_LOGIC_OR_INVERTED:
+		new_color = ~new_color | old_color;
+		break;
+
+	case GE_LOGIC_NAND:
+		new_color = ~(new_color & old_color);
+		break;
+
+	case GE_LOGIC_SET:
+		new_color = 0xFFFFFFFF;
+		break;
+	}
+
+	return new_color;
+}
+
+static inline bool ColorTestPassed(const Vec3<int> &color) {
+	const u32 mask = gstate.getColorTestMask();
+	const u32 c = color.ToRGB() & mask;
+	const u32 ref = gstate.getColorTestRef() & mask;
+	switch (gstate.getColorTestFunction()) {
+		case GE_COMP_NEVER:
+			return false;
+
+		case GE_COMP_ALWAYS:
+			return true;
+
+		case GE_COMP_EQUAL:
+			return c == ref;
+
+		case GE_COMP_NOTEQUAL:
+			return c != ref;
+
+		default:
+			ERROR_LOG_REPORT(G3D, "Software: Invalid colortest function: %d", gstate.getColorTestFunction());
+			break;
+	}
+	return true;
+}
+
+static inline bool AlphaTestPassed(const PixelFuncID &pixelID, int alpha) {
+	const u8 mask = gstate.getAlphaTestMask() & 0xFF;
+	const u8 ref = gstate.getAlphaTestRef() & mask;
+	alpha &= mask;
+
+	switch (GEComparison(pixelID.alphaTestFunc)) {
+		case GE_COMP_NEVER:
+			return false;
+
+		case GE_COMP_ALWAYS:
+			return true;
+
+		case GE_COMP_EQUAL:
+			return (alpha == ref);
+
+		case GE_COMP_NOTEQUAL:
+			return (alpha != ref);
+
+		case GE_COMP_LESS:
+			return (alpha < ref);
+
+		case GE_COMP_LEQUAL:
+			return (alpha <= ref);
+
+		case GE_COMP_GREATER:
+			return (alpha > ref);
+
+		case GE_COMP_GEQUAL:
+			return (alpha >= ref);
+	}
+	return true;
+}
+
+static inline Vec3<int> GetSourceFactor(GEBlendSrcFactor factor, const Vec4<int> &source, const Vec4<int> &dst) {
+	switch (factor) {
+	case GE_SRCBLEND_DSTCOLOR:
+		return dst.rgb();
+
+	case GE_SRCBLEND_INVDSTCOLOR:
+		return Vec3<int>::AssignToAll(255) - dst.rgb();
+
+	case GE_SRCBLEND_SRCALPHA:
+#if defined(_M_SSE)
+		return Vec3<int>(_mm_shuffle_epi32(source.ivec, _MM_SHUFFLE(3, 3, 3, 3)));
+#else
+		return Vec3<int>::AssignToAll(source.a());
+#endif
+
+	case GE_SRCBLEND_INVSRCALPHA:
+#if defined(_M_SSE)
+		return Vec3<int>(_mm_sub_epi32(_mm_set1_epi32(255), _mm_shuffle_epi32(source.ivec, _MM_SHUFFLE(3, 3, 3, 3))));
+#else
+		return Vec3<int>::AssignToAll(255 - source.a());
+#endif
+
+	case GE_SRCBLEND_DSTALPHA:
+		return Vec3<int>::AssignToAll(dst.a());
+
+	case GE_SRCBLEND_INVDSTALPHA:
+		return Vec3<int>::AssignToAll(255 - dst.a());
+
+	case GE_SRCBLEND_DOUBLESRCALPHA:
+		return Vec3<int>::AssignToAll(2 * source.a());
+
+	case GE_SRCBLEND_DOUBLEINVSRCALPHA:
+		return Vec3<int>::AssignToAll(255 - std::min(2 * source.a(), 255));
+
+	case GE_SRCBLEND_DOUBLEDSTALPHA:
+		return Vec3<int>::AssignToAll(2 * dst.a());
+
+	case GE_SRCBLEND_DOUBLEINVDSTALPHA:
+		return Vec3<int>::AssignToAll(255 - std::min(2 * dst.a(), 255));
+
+	case GE_SRCBLEND_FIXA:
+	default:
+		// All other dest factors (> 10) are treated as FIXA.
+		return Vec3<int>::FromRGB(gstate.getFixA());
+	}
+}
+
+static inline Vec3<int> GetDestFactor(GEBlendDstFactor factor, const Vec4<int> &source, const Vec4<int> &dst) {
+	switch (factor) {
+	case GE_DSTBLEND_SRCCOLOR:
+		return source.rgb();
+
+	case GE_DSTBLEND_INVSRCCOLOR:
+		return Vec3<int>::AssignToAll(255) - source.rgb();
+
+	case GE_DSTBLEND_SRCALPHA:
+#if defined(_M_SSE)
+		return Vec3<int>(_mm_shuffle_epi32(source.ivec, _MM_SHUFFLE(3, 3, 3, 3)));
+#else
+		return Vec3<int>::AssignToAll(source.a());
+#endif
+
+	case GE_DSTBLEND_INVSRCALPHA:
+#if defined(_M_SSE)
+		return Vec3<int>(_mm_sub_epi32(_mm_set1_epi32(255), _mm_shuffle_epi32(source.ivec, _MM_SHUFFLE(3, 3, 3, 3))));
+#else
+		return Vec3<int>::AssignToAll(255 - source.a());
+#endif
+
+	case GE_DSTBLEND_DSTALPHA:
+		return Vec3<int>::AssignToAll(dst.a());
+
+	case GE_DSTBLEND_INVDSTALPHA:
+		return Vec3<int>::AssignToAll(255 - dst.a());
+
+	case GE_DSTBLEND_DOUBLESRCALPHA:
+		return Vec3<int>::AssignToAll(2 * source.a());
+
+	case GE_DSTBLEND_DOUBLEINVSRCALPHA:
+		return Vec3<int>::AssignToAll(255 - std::min(2 * source.a(), 255));
+
+	case GE_DSTBLEND_DOUBLEDSTALPHA:
+		return Vec3<int>::AssignToAll(2 * dst.a());
+
+	case GE_DSTBLEND_DOUBLEINVDSTALPHA:
+		return Vec3<int>::AssignToAll(255 - std::min(2 * dst.a(), 255));
+
+	case GE_DSTBLEND_FIXB:
+	default:
+		// All other dest factors (> 10) are treated as FIXB.
+		return Vec3<int>::FromRGB(gstate.getFixB());
+	}
+}
+
+static inline Vec3<int> AlphaBlendingResult(const PixelFuncID &pixelID, const Vec4<int> &source, const Vec4<int> &dst) {
+	// Note: These factors cannot go below 0, but they can go above 255 when doubling.
+	Vec3<int> srcfactor = GetSourceFactor(GEBlendSrcFactor(pixelID.alphaBlendSrc), source, dst);
+	Vec3<int> dstfactor = GetDestFactor(GEBlendDstFactor(pixelID.alphaBlendDst), source, dst);
+
+	switch (GEBlendMode(pixelID.alphaBlendEq)) {
+	case GE_BLENDMODE_MUL_AND_ADD:
+	{
+#if defined(_M_SSE)
+		const __m128 s = _mm_mul_ps(_mm_cvtepi32_ps(source.ivec), _mm_cvtepi32_ps(srcfactor.ivec));
+		const __m128 d = _mm_mul_ps(_mm_cvtepi32_ps(dst.ivec), _mm_cvtepi32_ps(dstfactor.ivec));
+		return Vec3<int>(_mm_cvtps_epi32(_mm_mul_ps(_mm_add_ps(s, d), _mm_set_ps1(1.0f / 255.0f))));
+#else
+		return (source.rgb() * srcfactor + dst.rgb() * dstfactor) / 255;
+#endif
+	}
+
+	case GE_BLENDMODE_MUL_AND_SUBTRACT:
+	{
+#if defined(_M_SSE)
+		const __m128 s = _mm_mul_ps(_mm_cvtepi32_ps(source.ivec), _mm_cvtepi32_ps(srcfactor.ivec));
+		const __m128 d = _mm_mul_ps(_mm_cvtepi32_ps(dst.ivec), _mm_cvtepi32_ps(dstfactor.ivec));
+		return Vec3<int>(_mm_cvtps_epi32(_mm_mul_ps(_mm_sub_ps(s, d), _mm_set_ps1(1.0f / 255.0f))));
+#else
+		return (source.rgb() * srcfactor - dst.rgb() * dstfactor) / 255;
+#endif
+	}
+
+	case GE_BLENDMODE_MUL_AND_SUBTRACT_REVERSE:
+	{
+#if defined(_M_SSE)
+		const __m128 s = _mm_mul_ps(_mm_cvtepi32_ps(source.ivec), _mm_cvtepi32_ps(srcfactor.ivec));
+		const __m128 d = _mm_mul_ps(_mm_cvtepi32_ps(dst.ivec), _mm_cvtepi32_ps(dstfactor.ivec));
+		return Vec3<int>(_mm_cvtps_epi32(_mm_mul_ps(_mm_sub_ps(d, s), _mm_set_ps1(1.0f / 255.0f))));
+#else
+		return (dst.rgb() * dstfactor - source.rgb() * srcfactor) / 255;
+#endif
+	}
+
+	case GE_BLENDMODE_MIN:
+		return Vec3<int>(std::min(source.r(), dst.r()),
+						std::min(source.g(), dst.g()),
+						std::min(source.b(), dst.b()));
+
+	case GE_BLENDMODE_MAX:
+		return Vec3<int>(std::max(source.r(), dst.r()),
+						std::max(source.g(), dst.g()),
+						std::max(source.b(), dst.b()));
+
+	case GE_BLENDMODE_ABSDIFF:
+		return Vec3<int>(::abs(source.r() - dst.r()),
+						::abs(source.g() - dst.g()),
+						::abs(source.b() - dst.b()));
+
+	default:
+		ERROR_LOG_REPORT(G3D, "Software: Unknown blend function %x", pixelID.alphaBlendEq);
+		return Vec3<int>();
+	}
+}
+
+template <bool clearMode, GEBufferFormat fbFormat>
+void DrawSinglePixel(int x, int y, int z, int fog, const Vec4<int> &color_in, const PixelFuncID &pixelID) {
+	Vec4<int> prim_color = color_in;
+	// Depth range test
+	if (pixelID.applyDepthRange)
+		if (z < gstate.getDepthRangeMin() || z > gstate.getDepthRangeMax())
+			return;
+
+	if (pixelID.colorTest && !clearMode)
+		if (!ColorTestPassed(prim_color.rgb()))
+			return;
+
+	// TODO: Does a need to be clamped?
+	if (pixelID.alphaTestFunc != GE_COMP_ALWAYS && !clearMode)
+		if (!AlphaTestPassed(pixelID, prim_color.a()))
+			return;
+
+	// In clear mode, it uses the alpha color as stencil.
+	u8 stencil = clearMode ? prim_color.a() : GetPixelStencil(fbFormat, x, y);
+	// TODO: Is it safe to ignore gstate.isDepthTestEnabled() when clear mode is enabled? Probably yes
+	if (!clearMode && (pixelID.stencilTest || pixelID.depthTestFunc != GE_COMP_ALWAYS)) {
+		if (pixelID.stencilTest && !StencilTestPassed(pixelID, stencil)) {
+			stencil = ApplyStencilOp(fbFormat, GEStencilOp(pixelID.sFail), x, y);
+			SetPixelStencil(fbFormat, x, y, stencil);
+			return;
+		}
+
+		// Also apply depth at the same time.  If disabled, same as passing.
+		if (pixelID.depthTestFunc != GE_COMP_ALWAYS && !DepthTestPassed(GEComparison(pixelID.depthTestFunc), x, y, z)) {
+			if (pixelID.stencilTest) {
+				stencil = ApplyStencilOp(fbFormat, GEStencilOp(pixelID.zFail), x, y);
+				SetPixelStencil(fbFormat, x, y, stencil);
+			}
+			return;
+		} else if (pixelID.stencilTest) {
+			stencil = ApplyStencilOp(fbFormat, GEStencilOp(pixelID.zPass), x, y);
+		}
+	}
+
+	if (pixelID.depthWrite) {
+		SetPixelDepth(x, y, z);
+	}
+
+	if (pixelID.doubleColor && !clearMode) {
+		// TODO: Does this need to be clamped before blending?
+		prim_color.r() <<= 1;
+		prim_color.g() <<= 1;
+		prim_color.b() <<= 1;
+	}
+
+	if (pixelID.applyFog && !clearMode) {
+		Vec3<int> fogColor = Vec3<int>::FromRGB(gstate.fogcolor);
+		fogColor = (prim_color.rgb() * fog + fogColor * (255 - fog)) / 255;
+		prim_color.r() = fogColor.r();
+		prim_color.g() = fogColor.g();
+		prim_color.b() = fogColor.b();
+	}
+
+	const u32 old_color = GetPixelColor(fbFormat, x, y);
+	u32 new_color;
+
+	if (pixelID.alphaBlend && !clearMode) {
+		const Vec4<int> dst = Vec4<int>::FromRGBA(old_color);
+		// ToRGBA() always automatically clamps.
+		new_color = AlphaBlendingResult(pixelID, prim_color, dst).ToRGB();
+		new_color |= stencil << 24;
+	} else {
+#if defined(_M_SSE)
+		new_color = Vec3<int>(prim_color.ivec).ToRGB();
+		new_color |= stencil << 24;
+#else
+		new_color = Vec4<int>(prim_color.r(), prim_color.g(), prim_color.b(), stencil).ToRGBA();
+#endif
+	}
+
+	// TODO: Is alpha blending still performed if logic ops are enabled?
+	if (pixelID.applyLogicOp && !clearMode) {
+		// Logic ops don't affect stencil.
+		new_color = (stencil << 24) | (ApplyLogicOp(GELogicOp(pixelID.logicOp), old_color, new_color) & 0x00FFFFFF);
+	}
+
+	if (pixelID.applyColorWriteMask) {
+		const u32 mask = clearMode ? gstate.getClearModeColorMask() : gstate.getColorMask();
+		new_color = (new_color & ~mask) | (old_color & mask);
+	}
+
+	// TODO: Dither before or inside SetPixelColor
+	SetPixelColor(fbFormat, x, y, new_color);
+}
+
+SingleFunc GetSingleFunc(const PixelFuncID &id) {
+	if (jitCache && g_Config.bSoftwareRenderingJit) {
+		SingleFunc jitted = jitCache->GetSingle(id);
+		if (jitted) {
+			return jitted;
+		}
+	}
+
+	// Picking the framebuffer format up front saves a few switches per pixel.
+	switch (GEBufferFormat(id.fbFormat)) {
+	case GE_FORMAT_565:
+		return id.clearMode ? &DrawSinglePixel<true, GE_FORMAT_565> : &DrawSinglePixel<false, GE_FORMAT_565>;
+	case GE_FORMAT_5551:
+		return id.clearMode ? &DrawSinglePixel<true, GE_FORMAT_5551> : &DrawSinglePixel<false, GE_FORMAT_5551>;
+	case GE_FORMAT_4444:
+		return id.clearMode ? &DrawSinglePixel<true, GE_FORMAT_4444> : &DrawSinglePixel<false, GE_FORMAT_4444>;
+	case GE_FORMAT_8888:
+	default:
+		return id.clearMode ? &DrawSinglePixel<true, GE_FORMAT_8888> : &DrawSinglePixel<false, GE_FORMAT_8888>;
+	}
+}
+
+PixelJitCache::PixelJitCache() {
+	// 256k should be plenty, there aren't usually many render states per frame.
+	AllocCodeSpace(1024 * 64 * 4);
+
+	// Add some random code to "help" MSVC's buggy disassembler :(
+#if defined(_WIN32) && (defined(_M_IX86) || defined(_M_X64))
+	using namespace Gen;
+	for (int i = 0; i < 100; i++) {
+		MOV(32, R(EAX), R(EBX));
+		RET();
+	}
+#elif defined(ARM)
+	BKPT(0);
+	BKPT(0);
+#endif
+}
+
+void PixelJitCache::Clear() {
+	ClearCodeSpace(0);
+	cache_.clear();
+	addresses_.clear();
+}
+
+std::string PixelJitCache::DescribePixelFuncID(const PixelFuncID &id) {
+	static const char *const compNames[] = { "NEVER", "ALWAYS", "EQ", "NE", "LT", "LE", "GT", "GE" };
+	static const char *const fbNames[] = { "565", "5551", "4444", "8888" };
+
+	std::string name = fbNames[id.fbFormat];
+	if (id.clearMode) {
+		name += ":Clear";
+		if (id.ColorClear())
+			name += "C";
+		if (id.StencilClear())
+			name += "S";
+		if (id.depthWrite)
+			name += "D";
+		return name;
+	}
+
+	if (id.applyDepthRange)
+		name += ":DepthRange";
+	if (id.colorTest)
+		name += ":ColorTest";
+	if (id.alphaTestFunc != GE_COMP_ALWAYS)
+		name += std::string(":Alpha") + compNames[id.alphaTestFunc];
+	if (id.stencilTest) {
+		name += std::string(":Stencil") + compNames[id.stencilTestFunc];
+		name += StringFromFormat("%d%d%d", id.sFail, id.zFail, id.zPass);
+	}
+	if (id.depthTestFunc != GE_COMP_ALWAYS)
+		name += std::string(":Depth") + compNames[id.depthTestFunc];
+	if (id.depthWrite)
+		name += ":DepthWrite";
+	if (id.doubleColor)
+		name += ":Double";
+	if (id.applyFog)
+		name += ":Fog";
+	if (id.alphaBlend)
+		name += StringFromFormat(":Blend%d_%d_%d", id.alphaBlendEq, id.alphaBlendSrc, id.alphaBlendDst);
+	if (id.applyLogicOp)
+		name += StringFromFormat(":Logic%d", id.logicOp);
+	if (id.applyColorWriteMask)
+		name += ":Mask";
+	return name;
+}
+
+std::string PixelJitCache::DescribeCodePtr(const u8 *ptr) {
+	ptrdiff_t dist = 0x7FFFFFFF;
+	PixelFuncID found{};
+	for (const auto &it : addresses_) {
+		ptrdiff_t it_dist = ptr - it.second;
+		if (it_dist >= 0 && it_dist < dist) {
+			found = it.first;
+			dist = it_dist;
+		}
+	}
+
+	return DescribePixelFuncID(found);
+}
+
+SingleFunc PixelJitCache::GetSingle(const PixelFuncID &id) {
+	std::lock_guard<std::mutex> guard(jitCacheLock);
+
+	auto it = cache_.find(id);
+	if (it != cache_.end()) {
+		return it->second;
+	}
+
+	// Each function is at most a few hundred bytes.
+	if (GetSpaceLeft() < 16384) {
+		Clear();
+	}
+
+#ifdef _M_X64
+	addresses_[id] = GetCodePointer();
+	SingleFunc func = CompileSingle(id);
+	cache_[id] = func;
+	return func;
+#else
+	return nullptr;
+#endif
+}
+
+};
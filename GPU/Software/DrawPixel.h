@@ -0,0 +1,241 @@
+// Copyright (c) 2017- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include "ppsspp_config.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#if PPSSPP_ARCH(ARM)
+#include "Common/ArmEmitter.h"
+#elif PPSSPP_ARCH(ARM64)
+#include "Common/Arm64Emitter.h"
+#elif PPSSPP_ARCH(X86) || PPSSPP_ARCH(AMD64)
+#include "Common/x64Emitter.h"
+#elif PPSSPP_ARCH(MIPS)
+#include "Common/MipsEmitter.h"
+#else
+#include "Common/FakeEmitter.h"
+#endif
+#include "Common/ColorConv.h"
+#include "GPU/GPUState.h"
+#include "GPU/Math3D.h"
+#include "GPU/Software/SoftGpu.h"
+
+// Everything that decides which path a pixel takes after rasterization.
+// Values like test references, masks, and the fixed blend colors are read from gstate.
+struct PixelFuncID {
+	PixelFuncID() : fullKey(0) {
+	}
+
+	union {
+		u64 fullKey;
+		struct {
+			bool clearMode : 1;
+			// Reused as the clear mode color/alpha flags.
+			bool colorTest : 1;
+			bool stencilTest : 1;
+			bool depthWrite : 1;
+			bool applyDepthRange : 1;
+			bool applyColorWriteMask : 1;
+			bool applyLogicOp : 1;
+			bool applyFog : 1;
+			uint8_t alphaTestFunc : 3;
+			uint8_t depthTestFunc : 3;
+			uint8_t fbFormat : 2;
+			uint8_t stencilTestFunc : 3;
+			uint8_t sFail : 3;
+			bool doubleColor : 1;
+			bool alphaBlend : 1;
+			uint8_t zFail : 3;
+			uint8_t zPass : 3;
+			uint8_t alphaBlendEq : 3;
+			uint8_t alphaBlendSrc : 4;
+			uint8_t alphaBlendDst : 4;
+			uint8_t logicOp : 4;
+		};
+	};
+
+	bool ColorClear() const {
+		return colorTest;
+	}
+	bool StencilClear() const {
+		return stencilTest;
+	}
+
+	bool operator == (const PixelFuncID &other) const {
+		return fullKey == other.fullKey;
+	}
+};
+
+namespace std {
+
+template <>
+struct hash<PixelFuncID> {
+	std::size_t operator()(const PixelFuncID &k) const {
+		return hash<u64>()(k.fullKey);
+	}
+};
+
+};
+
+namespace Rasterizer {
+
+// z is 16 bit and fog 8 bit, the color components are in the 0-255 range (but may be above after doubling.)
+typedef void (*SingleFunc)(int x, int y, int z, int fog, const Math3D::Vec4<int> &color_in, const PixelFuncID &pixelID);
+
+void ComputePixelFuncID(PixelFuncID *id);
+// Returns the JIT compiled function for this state, or the interpreter if that's disabled or unsupported.
+SingleFunc GetSingleFunc(const PixelFuncID &id);
+
+void Init();
+void Shutdown();
+
+bool DescribeCodePtr(const u8 *ptr, std::string &name);
+
+// NOTE: These likely aren't endian safe
+static inline u32 GetPixelColor(GEBufferFormat fmt, int x, int y) {
+	switch (fmt) {
+	case GE_FORMAT_565:
+		return RGB565ToRGBA8888(fb.Get16(x, y, gstate.FrameBufStride()));
+
+	case GE_FORMAT_5551:
+		return RGBA5551ToRGBA8888(fb.Get16(x, y, gstate.FrameBufStride()));
+
+	case GE_FORMAT_4444:
+		return RGBA4444ToRGBA8888(fb.Get16(x, y, gstate.FrameBufStride()));
+
+	case GE_FORMAT_8888:
+		return fb.Get32(x, y, gstate.FrameBufStride());
+
+	case GE_FORMAT_INVALID:
+		_dbg_assert_msg_(G3D, false, "Software: invalid framebuf format.");
+	}
+	return 0;
+}
+
+static inline void SetPixelColor(GEBufferFormat fmt, int x, int y, u32 value) {
+	switch (fmt) {
+	case GE_FORMAT_565:
+		fb.Set16(x, y, gstate.FrameBufStride(), RGBA8888ToRGB565(value));
+		break;
+
+	case GE_FORMAT_5551:
+		fb.Set16(x, y, gstate.FrameBufStride(), RGBA8888ToRGBA5551(value));
+		break;
+
+	case GE_FORMAT_4444:
+		fb.Set16(x, y, gstate.FrameBufStride(), RGBA8888ToRGBA4444(value));
+		break;
+
+	case GE_FORMAT_8888:
+		fb.Set32(x, y, gstate.FrameBufStride(), value);
+		break;
+
+	case GE_FORMAT_INVALID:
+		_dbg_assert_msg_(G3D, false, "Software: invalid framebuf format.");
+	}
+}
+
+static inline u16 GetPixelDepth(int x, int y) {
+	return depthbuf.Get16(x, y, gstate.DepthBufStride());
+}
+
+static inline void SetPixelDepth(int x, int y, u16 value) {
+	depthbuf.Set16(x, y, gstate.DepthBufStride(), value);
+}
+
+static inline u8 GetPixelStencil(GEBufferFormat fmt, int x, int y) {
+	if (fmt == GE_FORMAT_565) {
+		// Always treated as 0 for comparison purposes.
+		return 0;
+	} else if (fmt == GE_FORMAT_5551) {
+		return ((fb.Get16(x, y, gstate.FrameBufStride()) & 0x8000) != 0) ? 0xFF : 0;
+	} else if (fmt == GE_FORMAT_4444) {
+		return Convert4To8(fb.Get16(x, y, gstate.FrameBufStride()) >> 12);
+	} else {
+		return fb.Get32(x, y, gstate.FrameBufStride()) >> 24;
+	}
+}
+
+static inline void SetPixelStencil(GEBufferFormat fmt, int x, int y, u8 value) {
+	// TODO: This seems like it maybe respects the alpha mask (at least in some scenarios?)
+
+	if (fmt == GE_FORMAT_565) {
+		// Do nothing
+	} else if (fmt == GE_FORMAT_5551) {
+		u16 pixel = fb.Get16(x, y, gstate.FrameBufStride()) & ~0x8000;
+		pixel |= value != 0 ? 0x8000 : 0;
+		fb.Set16(x, y, gstate.FrameBufStride(), pixel);
+	} else if (fmt == GE_FORMAT_4444) {
+		u16 pixel = fb.Get16(x, y, gstate.FrameBufStride()) & ~0xF000;
+		pixel |= (u16)value << 12;
+		fb.Set16(x, y, gstate.FrameBufStride(), pixel);
+	} else {
+		u32 pixel = fb.Get32(x, y, gstate.FrameBufStride()) & ~0xFF000000;
+		pixel |= (u32)value << 24;
+		fb.Set32(x, y, gstate.FrameBufStride(), pixel);
+	}
+}
+
+#if PPSSPP_ARCH(ARM)
+class PixelJitCache : public ArmGen::ARMXCodeBlock {
+#elif PPSSPP_ARCH(ARM64)
+class PixelJitCache : public Arm64Gen::ARM64CodeBlock {
+#elif PPSSPP_ARCH(X86) || PPSSPP_ARCH(AMD64)
+class PixelJitCache : public Gen::XCodeBlock {
+#elif PPSSPP_ARCH(MIPS)
+class PixelJitCache : public MIPSGen::MIPSCodeBlock {
+#else
+class PixelJitCache : public FakeGen::FakeXCodeBlock {
+#endif
+public:
+	PixelJitCache();
+
+	// Returns a pointer to the code to run, or nullptr if this state isn't supported.
+	SingleFunc GetSingle(const PixelFuncID &id);
+	void Clear();
+
+	std::string DescribeCodePtr(const u8 *ptr);
+	std::string DescribePixelFuncID(const PixelFuncID &id);
+
+private:
+	SingleFunc CompileSingle(const PixelFuncID &id);
+
+#if PPSSPP_ARCH(X86) || PPSSPP_ARCH(AMD64)
+	void Jit_LoadGState(Gen::X64Reg dest, const void *ptr);
+	void Jit_Discard(Gen::CCFlags cc);
+	bool Jit_DepthRange(const PixelFuncID &id);
+	bool Jit_AlphaTest(const PixelFuncID &id);
+	bool Jit_DepthTest(const PixelFuncID &id);
+	bool Jit_ApplyFog(const PixelFuncID &id);
+	bool Jit_ReadColor(const PixelFuncID &id);
+	bool Jit_AlphaBlend(const PixelFuncID &id);
+	bool Jit_BlendFactor(const PixelFuncID &id, Gen::X64Reg dest, int factor, bool isDst);
+	bool Jit_LogicOp(const PixelFuncID &id);
+	bool Jit_WriteColor(const PixelFuncID &id);
+
+	std::vector<Gen::FixupBranch> discards_;
+#endif
+
+	std::unordered_map<PixelFuncID, SingleFunc> cache_;
+	std::unordered_map<PixelFuncID, const u8 *> addresses_;
+};
+
+};
@@ -0,0 +1,611 @@
+// Copyright (c) 2017- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include "ppsspp_config.h"
+#if PPSSPP_ARCH(X86) || PPSSPP_ARCH(AMD64)
+
+#include <cstring>
+#include <emmintrin.h>
+#include "Common/x64Emitter.h"
+#include "GPU/GPUState.h"
+#include "GPU/Software/DrawPixel.h"
+#include "GPU/Software/SoftGpu.h"
+#include "GPU/ge_constants.h"
+
+using namespace Gen;
+
+namespace Rasterizer {
+
+#ifdef _WIN32
+static const X64Reg xReg = RCX;
+static const X64Reg yReg = RDX;
+static const X64Reg zReg = R8;
+static const X64Reg fogReg = R9;
+// The color pointer is passed on the stack, we load it into this.
+static const X64Reg colorPtrReg = R10;
+#else
+static const X64Reg xReg = RDI;
+static const X64Reg yReg = RSI;
+static const X64Reg zReg = RDX;
+static const X64Reg fogReg = RCX;
+static const X64Reg colorPtrReg = R8;
+#endif
+
+static const X64Reg tempReg1 = RAX;
+static const X64Reg tempReg2 = R11;
+
+// Once an argument has been used, its register gets reused.
+// The color pointer is only needed until the alpha test.
+static const X64Reg depthPtrReg = colorPtrReg;
+static const X64Reg fbPtrReg = colorPtrReg;
+static const X64Reg oldColorReg = xReg;
+static const X64Reg newColorReg = yReg;
+// Holds the stencil value already shifted into the top 8 bits.
+static const X64Reg stencilReg = zReg;
+static const X64Reg maskReg = fogReg;
+
+static const X64Reg primColorReg = XMM0;
+static const X64Reg dstColorReg = XMM1;
+static const X64Reg fpScratchReg1 = XMM2;
+static const X64Reg fpScratchReg2 = XMM3;
+static const X64Reg fpScratchReg3 = XMM4;
+static const X64Reg fpScratchReg4 = XMM5;
+
+static u32 FloatBits(float f) {
+	u32 bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+SingleFunc PixelJitCache::CompileSingle(const PixelFuncID &id) {
+	// Stencil testing, color testing, and the 16-bit formats with stencil use the interpreter.
+	if ((id.stencilTest || id.colorTest) && !id.clearMode)
+		return nullptr;
+	if (id.fbFormat != GE_FORMAT_8888 && id.fbFormat != GE_FORMAT_565)
+		return nullptr;
+
+	BeginWrite();
+	const u8 *start = AlignCode16();
+	discards_.clear();
+
+#ifdef _WIN32
+	// Past the return address and the shadow space.
+	MOV(64, R(colorPtrReg), MDisp(RSP, 8 + 32));
+#endif
+
+	bool success = true;
+	success = success && Jit_DepthRange(id);
+	if (success) {
+		MOVDQU(primColorReg, MatR(colorPtrReg));
+	}
+	success = success && Jit_AlphaTest(id);
+	success = success && Jit_DepthTest(id);
+
+	if (success && id.doubleColor && !id.clearMode) {
+		// Only RGB are doubled, this leaves -1 in the first three lanes.
+		PCMPEQD(fpScratchReg1, R(fpScratchReg1));
+		PSRLDQ(fpScratchReg1, 4);
+		PAND(fpScratchReg1, R(primColorReg));
+		PADDD(primColorReg, R(fpScratchReg1));
+	}
+
+	success = success && Jit_ApplyFog(id);
+	success = success && Jit_ReadColor(id);
+	success = success && Jit_AlphaBlend(id);
+	success = success && Jit_LogicOp(id);
+	success = success && Jit_WriteColor(id);
+
+	for (FixupBranch &fixup : discards_) {
+		SetJumpTarget(fixup);
+	}
+	discards_.clear();
+	RET();
+
+	EndWrite();
+	if (!success) {
+		SetCodePtr(const_cast<u8 *>(start));
+		return nullptr;
+	}
+	return (SingleFunc)start;
+}
+
+void PixelJitCache::Jit_LoadGState(X64Reg dest, const void *ptr) {
+	MOV(PTRBITS, R(dest), ImmPtr(ptr));
+	MOV(32, R(dest), MatR(dest));
+}
+
+void PixelJitCache::Jit_Discard(CCFlags cc) {
+	discards_.push_back(J_CC(cc, true));
+}
+
+// Returns the condition for failing a test that compares a (the register) with b.
+static bool ComparisonFailCC(GEComparison func, CCFlags &cc) {
+	switch (func) {
+	case GE_COMP_EQUAL: cc = CC_NE; return true;
+	case GE_COMP_NOTEQUAL: cc = CC_E; return true;
+	case GE_COMP_LESS: cc = CC_GE; return true;
+	case GE_COMP_LEQUAL: cc = CC_G; return true;
+	case GE_COMP_GREATER: cc = CC_LE; return true;
+	case GE_COMP_GEQUAL: cc = CC_L; return true;
+	default:
+		return false;
+	}
+}
+
+bool PixelJitCache::Jit_DepthRange(const PixelFuncID &id) {
+	if (!id.applyDepthRange)
+		return true;
+
+	// z is already 16 bit, only the low 16 bits of the range matter.
+	MOV(PTRBITS, R(tempReg1), ImmPtr(&gstate.minz));
+	MOVZX(32, 16, tempReg2, MatR(tempReg1));
+	CMP(32, R(zReg), R(tempReg2));
+	Jit_Discard(CC_L);
+
+	MOV(PTRBITS, R(tempReg1), ImmPtr(&gstate.maxz));
+	MOVZX(32, 16, tempReg2, MatR(tempReg1));
+	CMP(32, R(zReg), R(tempReg2));
+	Jit_Discard(CC_G);
+	return true;
+}
+
+bool PixelJitCache::Jit_AlphaTest(const PixelFuncID &id) {
+	if (id.clearMode || id.alphaTestFunc == GE_COMP_ALWAYS)
+		return true;
+	if (id.alphaTestFunc == GE_COMP_NEVER) {
+		discards_.push_back(J(true));
+		return true;
+	}
+
+	CCFlags failCC;
+	if (!ComparisonFailCC(GEComparison(id.alphaTestFunc), failCC))
+		return false;
+
+	// The color pointer isn't needed after this, so it's safe to use as the mask.
+	MOV(32, R(tempReg1), MDisp(colorPtrReg, 12));
+	Jit_LoadGState(tempReg2, &gstate.alphatest);
+	MOV(32, R(colorPtrReg), R(tempReg2));
+	SHR(32, R(colorPtrReg), Imm8(16));
+	AND(32, R(colorPtrReg), Imm32(0xFF));
+	AND(32, R(tempReg1), R(colorPtrReg));
+	SHR(32, R(tempReg2), Imm8(8));
+	AND(32, R(tempReg2), R(colorPtrReg));
+
+	CMP(32, R(tempReg1), R(tempReg2));
+	Jit_Discard(failCC);
+	return true;
+}
+
+bool PixelJitCache::Jit_DepthTest(const PixelFuncID &id) {
+	if (id.depthTestFunc == GE_COMP_ALWAYS && !id.depthWrite)
+		return true;
+	if (id.depthTestFunc == GE_COMP_NEVER) {
+		discards_.push_back(J(true));
+		return true;
+	}
+
+	// depthbuf.data + (y * stride + x) * 2.
+	Jit_LoadGState(tempReg1, &gstate.zbwidth);
+	AND(32, R(tempReg1), Imm32(0x7FC));
+	IMUL(32, tempReg1, R(yReg));
+	ADD(32, R(tempReg1), R(xReg));
+	MOV(PTRBITS, R(tempReg2), ImmPtr(&depthbuf.data));
+	MOV(PTRBITS, R(tempReg2), MatR(tempReg2));
+	LEA(PTRBITS, depthPtrReg, MComplex(tempReg2, tempReg1, SCALE_2, 0));
+
+	if (id.depthTestFunc != GE_COMP_ALWAYS) {
+		CCFlags failCC;
+		if (!ComparisonFailCC(GEComparison(id.depthTestFunc), failCC))
+			return false;
+
+		MOVZX(32, 16, tempReg1, MatR(depthPtrReg));
+		CMP(32, R(zReg), R(tempReg1));
+		Jit_Discard(failCC);
+	}
+
+	if (id.depthWrite) {
+		MOV(16, MatR(depthPtrReg), R(zReg));
+	}
+	return true;
+}
+
+bool PixelJitCache::Jit_ApplyFog(const PixelFuncID &id) {
+	if (!id.applyFog || id.clearMode)
+		return true;
+
+	// prim * fog + fogcolor * (255 - fog), all exact in floats.
+	CVTDQ2PS(fpScratchReg1, R(primColorReg));
+	MOVD_xmm(fpScratchReg2, R(fogReg));
+	CVTDQ2PS(fpScratchReg2, R(fpScratchReg2));
+	SHUFPS(fpScratchReg2, R(fpScratchReg2), _MM_SHUFFLE(0, 0, 0, 0));
+	MULPS(fpScratchReg1, R(fpScratchReg2));
+
+	MOV(32, R(tempReg1), Imm32(255));
+	SUB(32, R(tempReg1), R(fogReg));
+	MOVD_xmm(fpScratchReg2, R(tempReg1));
+	CVTDQ2PS(fpScratchReg2, R(fpScratchReg2));
+	SHUFPS(fpScratchReg2, R(fpScratchReg2), _MM_SHUFFLE(0, 0, 0, 0));
+
+	Jit_LoadGState(tempReg1, &gstate.fogcolor);
+	MOVD_xmm(fpScratchReg3, R(tempReg1));
+	PXOR(fpScratchReg4, R(fpScratchReg4));
+	PUNPCKLBW(fpScratchReg3, R(fpScratchReg4));
+	PUNPCKLWD(fpScratchReg3, R(fpScratchReg4));
+	CVTDQ2PS(fpScratchReg3, R(fpScratchReg3));
+	MULPS(fpScratchReg3, R(fpScratchReg2));
+	ADDPS(fpScratchReg1, R(fpScratchReg3));
+
+	// The quotient is never close enough to the next integer to round up, so this truncates like an int divide.
+	MOV(32, R(tempReg1), Imm32(FloatBits(255.0f)));
+	MOVD_xmm(fpScratchReg2, R(tempReg1));
+	SHUFPS(fpScratchReg2, R(fpScratchReg2), _MM_SHUFFLE(0, 0, 0, 0));
+	DIVPS(fpScratchReg1, R(fpScratchReg2));
+	CVTTPS2DQ(fpScratchReg1, R(fpScratchReg1));
+
+	// Keep the original alpha.
+	PCMPEQD(fpScratchReg2, R(fpScratchReg2));
+	PSRLDQ(fpScratchReg2, 4);
+	PAND(fpScratchReg1, R(fpScratchReg2));
+	PANDN(fpScratchReg2, R(primColorReg));
+	POR(fpScratchReg1, R(fpScratchReg2));
+	MOVDQA(primColorReg, R(fpScratchReg1));
+	return true;
+}
+
+bool PixelJitCache::Jit_ReadColor(const PixelFuncID &id) {
+	const bool is565 = id.fbFormat == GE_FORMAT_565;
+	bool needOld = id.applyColorWriteMask;
+	if (!id.clearMode) {
+		needOld = needOld || id.alphaBlend || id.applyLogicOp;
+		// The stencil comes from the old alpha.
+		if (!is565)
+			needOld = true;
+	}
+
+	// fb.data + (y * stride + x) * bpp.
+	Jit_LoadGState(tempReg1, &gstate.fbwidth);
+	AND(32, R(tempReg1), Imm32(0x7FC));
+	IMUL(32, tempReg1, R(yReg));
+	ADD(32, R(tempReg1), R(xReg));
+	MOV(PTRBITS, R(tempReg2), ImmPtr(&fb.data));
+	MOV(PTRBITS, R(tempReg2), MatR(tempReg2));
+	LEA(PTRBITS, fbPtrReg, MComplex(tempReg2, tempReg1, is565 ? SCALE_2 : SCALE_4, 0));
+
+	if (is565) {
+		if (needOld) {
+			// Expand to 8888 the same way as RGB565ToRGBA8888().
+			MOVZX(32, 16, oldColorReg, MatR(fbPtrReg));
+			auto addBits = [&](u32 mask, int shift) {
+				MOV(32, R(tempReg2), R(oldColorReg));
+				AND(32, R(tempReg2), Imm32(mask));
+				if (shift > 0)
+					SHL(32, R(tempReg2), Imm8(shift));
+				else
+					SHR(32, R(tempReg2), Imm8(-shift));
+				OR(32, R(tempReg1), R(tempReg2));
+			};
+			MOV(32, R(tempReg1), Imm32(0xFF000000));
+			addBits(0x001F, 3);
+			addBits(0x001C, -2);
+			addBits(0x07E0, 5);
+			addBits(0x0600, -1);
+			addBits(0xF800, 8);
+			addBits(0xE000, 3);
+			MOV(32, R(oldColorReg), R(tempReg1));
+		}
+		// There's no stencil to keep.
+		return true;
+	}
+
+	if (needOld) {
+		MOV(32, R(oldColorReg), MatR(fbPtrReg));
+	}
+	if (id.clearMode) {
+		// In clear mode, it uses the alpha color as stencil.
+		PSHUFD(fpScratchReg1, R(primColorReg), _MM_SHUFFLE(3, 3, 3, 3));
+		MOVD_xmm(R(stencilReg), fpScratchReg1);
+		SHL(32, R(stencilReg), Imm8(24));
+	} else {
+		MOV(32, R(stencilReg), R(oldColorReg));
+		AND(32, R(stencilReg), Imm32(0xFF000000));
+	}
+	return true;
+}
+
+bool PixelJitCache::Jit_BlendFactor(const PixelFuncID &id, X64Reg dest, int factor, bool isDst) {
+	// Factors 0 and 1 use the other color, the rest are the same for both sides.
+	const X64Reg otherColorReg = isDst ? primColorReg : dstColorReg;
+
+	auto load255 = [&](X64Reg reg) {
+		PCMPEQD(reg, R(reg));
+		PSRLD(reg, 24);
+	};
+
+	switch (factor) {
+	case GE_SRCBLEND_DSTCOLOR:
+		MOVDQA(dest, R(otherColorReg));
+		break;
+
+	case GE_SRCBLEND_INVDSTCOLOR:
+		load255(dest);
+		PSUBD(dest, R(otherColorReg));
+		break;
+
+	case GE_SRCBLEND_SRCALPHA:
+		PSHUFD(dest, R(primColorReg), _MM_SHUFFLE(3, 3, 3, 3));
+		break;
+
+	case GE_SRCBLEND_INVSRCALPHA:
+		PSHUFD(fpScratchReg3, R(primColorReg), _MM_SHUFFLE(3, 3, 3, 3));
+		load255(dest);
+		PSUBD(dest, R(fpScratchReg3));
+		break;
+
+	case GE_SRCBLEND_DSTALPHA:
+		PSHUFD(dest, R(dstColorReg), _MM_SHUFFLE(3, 3, 3, 3));
+		break;
+
+	case GE_SRCBLEND_INVDSTALPHA:
+		PSHUFD(fpScratchReg3, R(dstColorReg), _MM_SHUFFLE(3, 3, 3, 3));
+		load255(dest);
+		PSUBD(dest, R(fpScratchReg3));
+		break;
+
+	case GE_SRCBLEND_DOUBLESRCALPHA:
+	case GE_SRCBLEND_DOUBLEDSTALPHA:
+		PSHUFD(dest, R(factor == GE_SRCBLEND_DOUBLESRCALPHA ? primColorReg : dstColorReg), _MM_SHUFFLE(3, 3, 3, 3));
+		PADDD(dest, R(dest));
+		break;
+
+	case GE_SRCBLEND_DOUBLEINVSRCALPHA:
+	case GE_SRCBLEND_DOUBLEINVDSTALPHA:
+		// 255 - min(2 * a, 255) is the same as max(255 - 2 * a, 0).
+		PSHUFD(fpScratchReg3, R(factor == GE_SRCBLEND_DOUBLEINVSRCALPHA ? primColorReg : dstColorReg), _MM_SHUFFLE(3, 3, 3, 3));
+		PADDD(fpScratchReg3, R(fpScratchReg3));
+		load255(dest);
+		PSUBD(dest, R(fpScratchReg3));
+		PXOR(fpScratchReg3, R(fpScratchReg3));
+		PCMPGTD(fpScratchReg3, R(dest));
+		PANDN(fpScratchReg3, R(dest));
+		MOVDQA(dest, R(fpScratchReg3));
+		break;
+
+	case GE_SRCBLEND_FIXA:
+	default:
+		// All other factors (> 10) are treated as the fixed color.
+		Jit_LoadGState(tempReg1, isDst ? &gstate.blendfixb : &gstate.blendfixa);
+		AND(32, R(tempReg1), Imm32(0x00FFFFFF));
+		MOVD_xmm(dest, R(tempReg1));
+		PXOR(fpScratchReg3, R(fpScratchReg3));
+		PUNPCKLBW(dest, R(fpScratchReg3));
+		PUNPCKLWD(dest, R(fpScratchReg3));
+		break;
+	}
+	return true;
+}
+
+bool PixelJitCache::Jit_AlphaBlend(const PixelFuncID &id) {
+	if (!id.alphaBlend || id.clearMode) {
+		// Just clamp the color.
+		MOVDQA(fpScratchReg1, R(primColorReg));
+		PACKSSDW(fpScratchReg1, R(fpScratchReg1));
+		PACKUSWB(fpScratchReg1, R(fpScratchReg1));
+		MOVD_xmm(R(newColorReg), fpScratchReg1);
+	} else {
+		// dst = Vec4<int>::FromRGBA(old_color)
+		MOVD_xmm(dstColorReg, R(oldColorReg));
+		PXOR(fpScratchReg4, R(fpScratchReg4));
+		PUNPCKLBW(dstColorReg, R(fpScratchReg4));
+		PUNPCKLWD(dstColorReg, R(fpScratchReg4));
+
+		switch (GEBlendMode(id.alphaBlendEq)) {
+		case GE_BLENDMODE_MUL_AND_ADD:
+		case GE_BLENDMODE_MUL_AND_SUBTRACT:
+		case GE_BLENDMODE_MUL_AND_SUBTRACT_REVERSE:
+			if (!Jit_BlendFactor(id, fpScratchReg1, id.alphaBlendSrc, false))
+				return false;
+			if (!Jit_BlendFactor(id, fpScratchReg2, id.alphaBlendDst, true))
+				return false;
+
+			// Same float math as the interpreter, so the rounding matches.
+			CVTDQ2PS(fpScratchReg1, R(fpScratchReg1));
+			CVTDQ2PS(fpScratchReg3, R(primColorReg));
+			MULPS(fpScratchReg1, R(fpScratchReg3));
+			CVTDQ2PS(fpScratchReg2, R(fpScratchReg2));
+			CVTDQ2PS(fpScratchReg3, R(dstColorReg));
+			MULPS(fpScratchReg2, R(fpScratchReg3));
+
+			if (id.alphaBlendEq == GE_BLENDMODE_MUL_AND_ADD) {
+				ADDPS(fpScratchReg1, R(fpScratchReg2));
+			} else if (id.alphaBlendEq == GE_BLENDMODE_MUL_AND_SUBTRACT) {
+				SUBPS(fpScratchReg1, R(fpScratchReg2));
+			} else {
+				SUBPS(fpScratchReg2, R(fpScratchReg1));
+				MOVAPS(fpScratchReg1, R(fpScratchReg2));
+			}
+
+			MOV(32, R(tempReg1), Imm32(FloatBits(1.0f / 255.0f)));
+			MOVD_xmm(fpScratchReg2, R(tempReg1));
+			SHUFPS(fpScratchReg2, R(fpScratchReg2), _MM_SHUFFLE(0, 0, 0, 0));
+			MULPS(fpScratchReg1, R(fpScratchReg2));
+			CVTPS2DQ(fpScratchReg1, R(fpScratchReg1));
+			PACKSSDW(fpScratchReg1, R(fpScratchReg1));
+			break;
+
+		case GE_BLENDMODE_MIN:
+		case GE_BLENDMODE_MAX:
+		case GE_BLENDMODE_ABSDIFF:
+			// Everything fits in 16 bits, and SSE2 has the 16-bit min/max.
+			MOVDQA(fpScratchReg1, R(primColorReg));
+			PACKSSDW(fpScratchReg1, R(fpScratchReg1));
+			MOVDQA(fpScratchReg2, R(dstColorReg));
+			PACKSSDW(fpScratchReg2, R(fpScratchReg2));
+			if (id.alphaBlendEq == GE_BLENDMODE_MIN) {
+				PMINSW(fpScratchReg1, R(fpScratchReg2));
+			} else if (id.alphaBlendEq == GE_BLENDMODE_MAX) {
+				PMAXSW(fpScratchReg1, R(fpScratchReg2));
+			} else {
+				MOVDQA(fpScratchReg3, R(fpScratchReg1));
+				PSUBW(fpScratchReg1, R(fpScratchReg2));
+				PSUBW(fpScratchReg2, R(fpScratchReg3));
+				PMAXSW(fpScratchReg1, R(fpScratchReg2));
+			}
+			break;
+
+		default:
+			// Invalid, let the interpreter report it.
+			return false;
+		}
+
+		PACKUSWB(fpScratchReg1, R(fpScratchReg1));
+		MOVD_xmm(R(newColorReg), fpScratchReg1);
+	}
+
+	AND(32, R(newColorReg), Imm32(0x00FFFFFF));
+	if (id.fbFormat != GE_FORMAT_565)
+		OR(32, R(newColorReg), R(stencilReg));
+	return true;
+}
+
+bool PixelJitCache::Jit_LogicOp(const PixelFuncID &id) {
+	if (!id.applyLogicOp || id.clearMode)
+		return true;
+
+	switch (GELogicOp(id.logicOp)) {
+	case GE_LOGIC_CLEAR:
+		XOR(32, R(newColorReg), R(newColorReg));
+		break;
+
+	case GE_LOGIC_AND:
+		AND(32, R(newColorReg), R(oldColorReg));
+		break;
+
+	case GE_LOGIC_AND_REVERSE:
+		MOV(32, R(tempReg1), R(oldColorReg));
+		NOT(32, R(tempReg1));
+		AND(32, R(newColorReg), R(tempReg1));
+		break;
+
+	case GE_LOGIC_COPY:
+		break;
+
+	case GE_LOGIC_AND_INVERTED:
+		NOT(32, R(newColorReg));
+		AND(32, R(newColorReg), R(oldColorReg));
+		break;
+
+	case GE_LOGIC_NOOP:
+		MOV(32, R(newColorReg), R(oldColorReg));
+		break;
+
+	case GE_LOGIC_XOR:
+		XOR(32, R(newColorReg), R(oldColorReg));
+		break;
+
+	case GE_LOGIC_OR:
+		OR(32, R(newColorReg), R(oldColorReg));
+		break;
+
+	case GE_LOGIC_NOR:
+		OR(32, R(newColorReg), R(oldColorReg));
+		NOT(32, R(newColorReg));
+		break;
+
+	case GE_LOGIC_EQUIV:
+		XOR(32, R(newColorReg), R(oldColorReg));
+		NOT(32, R(newColorReg));
+		break;
+
+	case GE_LOGIC_INVERTED:
+		MOV(32, R(newColorReg), R(oldColorReg));
+		NOT(32, R(newColorReg));
+		break;
+
+	case GE_LOGIC_OR_REVERSE:
+		MOV(32, R(tempReg1), R(oldColorReg));
+		NOT(32, R(tempReg1));
+		OR(32, R(newColorReg), R(tempReg1));
+		break;
+
+	case GE_LOGIC_COPY_INVERTED:
+		NOT(32, R(newColorReg));
+		break;
+
+	case GE_LOGIC_OR_INVERTED:
+		NOT(32, R(newColorReg));
+		OR(32, R(newColorReg), R(oldColorReg));
+		break;
+
+	case GE_LOGIC_NAND:
+		AND(32, R(newColorReg), R(oldColorReg));
+		NOT(32, R(newColorReg));
+		break;
+
+	case GE_LOGIC_SET:
+		MOV(32, R(newColorReg), Imm32(0xFFFFFFFF));
+		break;
+	}
+
+	// Logic ops don't affect stencil.
+	AND(32, R(newColorReg), Imm32(0x00FFFFFF));
+	if (id.fbFormat != GE_FORMAT_565)
+		OR(32, R(newColorReg), R(stencilReg));
+	return true;
+}
+
+bool PixelJitCache::Jit_WriteColor(const PixelFuncID &id) {
+	if (id.applyColorWriteMask) {
+		if (id.clearMode) {
+			u32 mask = (id.ColorClear() ? 0 : 0x00FFFFFF) | (id.StencilClear() ? 0 : 0xFF000000);
+			MOV(32, R(maskReg), Imm32(mask));
+		} else {
+			Jit_LoadGState(maskReg, &gstate.pmskc);
+			AND(32, R(maskReg), Imm32(0x00FFFFFF));
+			Jit_LoadGState(tempReg1, &gstate.pmska);
+			SHL(32, R(tempReg1), Imm8(24));
+			OR(32, R(maskReg), R(tempReg1));
+		}
+
+		// new = (new & ~mask) | (old & mask)
+		MOV(32, R(tempReg1), R(newColorReg));
+		XOR(32, R(tempReg1), R(oldColorReg));
+		AND(32, R(tempReg1), R(maskReg));
+		XOR(32, R(newColorReg), R(tempReg1));
+	}
+
+	if (id.fbFormat == GE_FORMAT_565) {
+		// Same as RGBA8888ToRGB565().
+		auto addBits = [&](int shift, u32 mask) {
+			MOV(32, R(tempReg2), R(newColorReg));
+			SHR(32, R(tempReg2), Imm8(shift));
+			AND(32, R(tempReg2), Imm32(mask));
+			OR(32, R(tempReg1), R(tempReg2));
+		};
+		XOR(32, R(tempReg1), R(tempReg1));
+		addBits(3, 0x001F);
+		addBits(5, 0x07E0);
+		addBits(8, 0xF800);
+		MOV(16, MatR(fbPtrReg), R(tempReg1));
+	} else {
+		MOV(32, MatR(fbPtrReg), R(newColorReg));
+	}
+	return true;
+}
+
+};
+
+#endif
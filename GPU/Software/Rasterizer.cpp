@@ -29,6 +29,8 @@
 #include "GPU/GPUState.h"
 
 #include "GPU/Common/TextureDecoder.h"
+#include "GPU/Software/BinManager.h"
+#include "GPU/Software/DrawPixel.h"
 #include "GPU/Software/SoftGpu.h"
 #include "GPU/Software/Rasterizer.h"
 #include "GPU/Software/Sampler.h"
@@ -39,6 +41,8 @@
 
 namespace Rasterizer {
 
+static BinManager binner;
+
 // Only OK on x64 where our stack is aligned
 #if defined(_M_SSE) && !defined(_M_IX86)
 static inline __m128 Interpolate(const __m128 &c0, const __m128 &c1, const __m128 &c2, int w0, int w1, int w2, float wsum) {
@@ -314,131 +318,6 @@ static inline void GetTextureCoordinates(const VertexData& v0, const VertexData&
 	}
 }
 
-// NOTE: These likely aren't endian safe
-static inline u32 GetPixelColor(int x, int y)
-{
-	switch (gstate.FrameBufFormat()) {
-	case GE_FORMAT_565:
-		return RGB565ToRGBA8888(fb.Get16(x, y, gstate.FrameBufStride()));
-
-	case GE_FORMAT_5551:
-		return RGBA5551ToRGBA8888(fb.Get16(x, y, gstate.FrameBufStride()));
-
-	case GE_FORMAT_4444:
-		return RGBA4444ToRGBA8888(fb.Get16(x, y, gstate.FrameBufStride()));
-
-	case GE_FORMAT_8888:
-		return fb.Get32(x, y, gstate.FrameBufStride());
-
-	case GE_FORMAT_INVALID:
-		_dbg_assert_msg_(G3D, false, "Software: invalid framebuf format.");
-	}
-	return 0;
-}
-
-static inline void SetPixelColor(int x, int y, u32 value)
-{
-	switch (gstate.FrameBufFormat()) {
-	case GE_FORMAT_565:
-		fb.Set16(x, y, gstate.FrameBufStride(), RGBA8888ToRGB565(value));
-		break;
-
-	case GE_FORMAT_5551:
-		fb.Set16(x, y, gstate.FrameBufStride(), RGBA8888ToRGBA5551(value));
-		break;
-
-	case GE_FORMAT_4444:
-		fb.Set16(x, y, gstate.FrameBufStride(), RGBA8888ToRGBA4444(value));
-		break;
-
-	case GE_FORMAT_8888:
-		fb.Set32(x, y, gstate.FrameBufStride(), value);
-		break;
-
-	case GE_FORMAT_INVALID:
-		_dbg_assert_msg_(G3D, false, "Software: invalid framebuf format.");
-	}
-}
-
-static inline u16 GetPixelDepth(int x, int y)
-{
-	return depthbuf.Get16(x, y, gstate.DepthBufStride());
-}
-
-static inline void SetPixelDepth(int x, int y, u16 value)
-{
-	depthbuf.Set16(x, y, gstate.DepthBufStride(), value);
-}
-
-static inline u8 GetPixelStencil(int x, int y)
-{
-	if (gstate.FrameBufFormat() == GE_FORMAT_565) {
-		// Always treated as 0 for comparison purposes.
-		return 0;
-	} else if (gstate.FrameBufFormat() == GE_FORMAT_5551) {
-		return ((fb.Get16(x, y, gstate.FrameBufStride()) & 0x8000) != 0) ? 0xFF : 0;
-	} else if (gstate.FrameBufFormat() == GE_FORMAT_4444) {
-		return Convert4To8(fb.Get16(x, y, gstate.FrameBufStride()) >> 12);
-	} else {
-		return fb.Get32(x, y, gstate.FrameBufStride()) >> 24;
-	}
-}
-
-static inline void SetPixelStencil(int x, int y, u8 value)
-{
-	// TODO: This seems like it maybe respects the alpha mask (at least in some scenarios?)
-
-	if (gstate.FrameBufFormat() == GE_FORMAT_565) {
-		// Do nothing
-	} else if (gstate.FrameBufFormat() == GE_FORMAT_5551) {
-		u16 pixel = fb.Get16(x, y, gstate.FrameBufStride()) & ~0x8000;
-		pixel |= value != 0 ? 0x8000 : 0;
-		fb.Set16(x, y, gstate.FrameBufStride(), pixel);
-	} else if (gstate.FrameBufFormat() == GE_FORMAT_4444) {
-		u16 pixel = fb.Get16(x, y, gstate.FrameBufStride()) & ~0xF000;
-		pixel |= (u16)value << 12;
-		fb.Set16(x, y, gstate.FrameBufStride(), pixel);
-	} else {
-		u32 pixel = fb.Get32(x, y, gstate.FrameBufStride()) & ~0xFF000000;
-		pixel |= (u32)value << 24;
-		fb.Set32(x, y, gstate.FrameBufStride(), pixel);
-	}
-}
-
-static inline bool DepthTestPassed(int x, int y, u16 z)
-{
-	u16 reference_z = GetPixelDepth(x, y);
-
-	switch (gstate.getDepthTestFunction()) {
-	case GE_COMP_NEVER:
-		return false;
-
-	case GE_COMP_ALWAYS:
-		return true;
-
-	case GE_COMP_EQUAL:
-		return (z == reference_z);
-
-	case GE_COMP_NOTEQUAL:
-		return (z != reference_z);
-
-	case GE_COMP_LESS:
-		return (z < reference_z);
-
-	case GE_COMP_LEQUAL:
-		return (z <= reference_z);
-
-	case GE_COMP_GREATER:
-		return (z > reference_z);
-
-	case GE_COMP_GEQUAL:
-		return (z >= reference_z);
-
-	default:
-		return 0;
-	}
-}
-
 static inline bool IsRightSideOrFlatBottomLine(const Vec2<int>& vertex, const Vec2<int>& line1, const Vec2<int>& line2)
 {
 	if (line1.y == line2.y) {
@@ -450,164 +329,6 @@ static inline bool IsRightSideOrFlatBottomLine(const Vec2<int>& vertex, const Ve
 	}
 }
 
-static inline bool StencilTestPassed(u8 stencil)
-{
-	// TODO: Does the masking logic make any sense?
-	stencil &= gstate.getStencilTestMask();
-	u8 ref = gstate.getStencilTestRef() & gstate.getStencilTestMask();
-	switch (gstate.getStencilTestFunction()) {
-		case GE_COMP_NEVER:
-			return false;
-
-		case GE_COMP_ALWAYS:
-			return true;
-
-		case GE_COMP_EQUAL:
-			return ref == stencil;
-
-		case GE_COMP_NOTEQUAL:
-			return ref != stencil;
-
-		case GE_COMP_LESS:
-			return ref < stencil;
-
-		case GE_COMP_LEQUAL:
-			return ref <= stencil;
-
-		case GE_COMP_GREATER:
-			return ref > stencil;
-
-		case GE_COMP_GEQUAL:
-			return ref >= stencil;
-	}
-	return true;
-}
-
-static inline u8 ApplyStencilOp(int op, int x, int y)
-{
-	u8 old_stencil = GetPixelStencil(x, y); // TODO: Apply mask?
-	u8 reference_stencil = gstate.getStencilTestRef(); // TODO: Apply mask?
-
-	switch (op) {
-		case GE_STENCILOP_KEEP:
-			return old_stencil;
-
-		case GE_STENCILOP_ZERO:
-			return 0;
-
-		case GE_STENCILOP_REPLACE:
-			return reference_stencil;
-
-		case GE_STENCILOP_INVERT:
-			return ~old_stencil;
-
-		case GE_STENCILOP_INCR:
-			switch (gstate.FrameBufFormat()) {
-			case GE_FORMAT_8888:
-				if (old_stencil != 0xFF) {
-					return old_stencil + 1;
-				}
-				return old_stencil;
-			case GE_FORMAT_5551:
-				return 0xFF;
-			case GE_FORMAT_4444:
-				if (old_stencil < 0xF0) {
-					return old_stencil + 0x10;
-				}
-				return old_stencil;
-			default:
-				return old_stencil;
-			}
-			break;
-
-		case GE_STENCILOP_DECR:
-			switch (gstate.FrameBufFormat()) {
-			case GE_FORMAT_4444:
-				if (old_stencil >= 0x10)
-					return old_stencil - 0x10;
-				break;
-			default:
-				if (old_stencil != 0)
-					return old_stencil - 1;
-				return old_stencil;
-			}
-			break;
-	}
-
-	return old_stencil;
-}
-
-static inline u32 ApplyLogicOp(GELogicOp op, u32 old_color, u32 new_color)
-{
-	switch (op) {
-	case GE_LOGIC_CLEAR:
-		new_color = 0;
-		break;
-
-	case GE_LOGIC_AND:
-		new_color = new_color & old_color;
-		break;
-
-	case GE_LOGIC_AND_REVERSE:
-		new_color = new_color & ~old_color;
-		break;
-
-	case GE_LOGIC_COPY:
-		//new_color = new_color;
-		break;
-
-	case GE_LOGIC_AND_INVERTED:
-		new_color = ~new_color & old_color;
-		break;
-
-	case GE_LOGIC_NOOP:
-		new_color = old_color;
-		break;
-
-	case GE_LOGIC_XOR:
-		new_color = new_color ^ old_color;
-		break;
-
-	case GE_LOGIC_OR:
-		new_color = new_color | old_color;
-		break;
-
-	case GE_LOGIC_NOR:
-		new_color = ~(new_color | old_color);
-		break;
-
-	case GE_LOGIC_EQUIV:
-		new_color = ~(new_color ^ old_color);
-		break;
-
-	case GE_LOGIC_INVERTED:
-		new_color = ~old_color;
-		break;
-
-	case GE_LOGIC_OR_REVERSE:
-		new_color = new_color | ~old_color;
-		break;
-
-	case GE_LOGIC_COPY_INVERTED:
-		new_color = ~new_color;
-		break;
-
-	case GE_LOGIC_OR_INVERTED:
-		new_color = ~new_color | old_color;
-		break;
-
-	case GE_LOGIC_NAND:
-		new_color = ~(new_color & old_color);
-		break;
-
-	case GE_LOGIC_SET:
-		new_color = 0xFFFFFFFF;
-		break;
-	}
-
-	return new_color;
-}
-
 static inline Vec4<int> GetTextureFunctionOutput(const Vec4<int>& prim_color, const Vec4<int>& texcolor)
 {
 	Vec3<int> out_rgb;
@@ -676,317 +397,6 @@ static inline Vec4<int> GetTextureFunctionOutput(const Vec4<int>& prim_color, co
 	return Vec4<int>(out_rgb.r(), out_rgb.g(), out_rgb.b(), out_a);
 }
 
-static inline bool ColorTestPassed(const Vec3<int> &color)
-{
-	const u32 mask = gstate.getColorTestMask();
-	const u32 c = color.ToRGB() & mask;
-	const u32 ref = gstate.getColorTestRef() & mask;
-	switch (gstate.getColorTestFunction()) {
-		case GE_COMP_NEVER:
-			return false;
-
-		case GE_COMP_ALWAYS:
-			return true;
-
-		case GE_COMP_EQUAL:
-			return c == ref;
-
-		case GE_COMP_NOTEQUAL:
-			return c != ref;
-
-		default:
-			ERROR_LOG_REPORT(G3D, "Software: Invalid colortest function: %d", gstate.getColorTestFunction());
-			break;
-	}
-	return true;
-}
-
-static inline bool AlphaTestPassed(int alpha)
-{
-	const u8 mask = gstate.getAlphaTestMask() & 0xFF;
-	const u8 ref = gstate.getAlphaTestRef() & mask;
-	alpha &= mask;
-
-	switch (gstate.getAlphaTestFunction()) {
-		case GE_COMP_NEVER:
-			return false;
-
-		case GE_COMP_ALWAYS:
-			return true;
-
-		case GE_COMP_EQUAL:
-			return (alpha == ref);
-
-		case GE_COMP_NOTEQUAL:
-			return (alpha != ref);
-
-		case GE_COMP_LESS:
-			return (alpha < ref);
-
-		case GE_COMP_LEQUAL:
-			return (alpha <= ref);
-
-		case GE_COMP_GREATER:
-			return (alpha > ref);
-
-		case GE_COMP_GEQUAL:
-			return (alpha >= ref);
-	}
-	return true;
-}
-
-static inline Vec3<int> GetSourceFactor(const Vec4<int>& source, const Vec4<int>& dst)
-{
-	switch (gstate.getBlendFuncA()) {
-	case GE_SRCBLEND_DSTCOLOR:
-		return dst.rgb();
-
-	case GE_SRCBLEND_INVDSTCOLOR:
-		return Vec3<int>::AssignToAll(255) - dst.rgb();
-
-	case GE_SRCBLEND_SRCALPHA:
-#if defined(_M_SSE)
-		return Vec3<int>(_mm_shuffle_epi32(source.ivec, _MM_SHUFFLE(3, 3, 3, 3)));
-#else
-		return Vec3<int>::AssignToAll(source.a());
-#endif
-
-	case GE_SRCBLEND_INVSRCALPHA:
-#if defined(_M_SSE)
-		return Vec3<int>(_mm_sub_epi32(_mm_set1_epi32(255), _mm_shuffle_epi32(source.ivec, _MM_SHUFFLE(3, 3, 3, 3))));
-#else
-		return Vec3<int>::AssignToAll(255 - source.a());
-#endif
-
-	case GE_SRCBLEND_DSTALPHA:
-		return Vec3<int>::AssignToAll(dst.a());
-
-	case GE_SRCBLEND_INVDSTALPHA:
-		return Vec3<int>::AssignToAll(255 - dst.a());
-
-	case GE_SRCBLEND_DOUBLESRCALPHA:
-		return Vec3<int>::AssignToAll(2 * source.a());
-
-	case GE_SRCBLEND_DOUBLEINVSRCALPHA:
-		return Vec3<int>::AssignToAll(255 - std::min(2 * source.a(), 255));
-
-	case GE_SRCBLEND_DOUBLEDSTALPHA:
-		return Vec3<int>::AssignToAll(2 * dst.a());
-
-	case GE_SRCBLEND_DOUBLEINVDSTALPHA:
-		return Vec3<int>::AssignToAll(255 - std::min(2 * dst.a(), 255));
-
-	case GE_SRCBLEND_FIXA:
-	default:
-		// All other dest factors (> 10) are treated as FIXA.
-		return Vec3<int>::FromRGB(gstate.getFixA());
-	}
-}
-
-static inline Vec3<int> GetDestFactor(const Vec4<int>& source, const Vec4<int>& dst)
-{
-	switch (gstate.getBlendFuncB()) {
-	case GE_DSTBLEND_SRCCOLOR:
-		return source.rgb();
-
-	case GE_DSTBLEND_INVSRCCOLOR:
-		return Vec3<int>::AssignToAll(255) - source.rgb();
-
-	case GE_DSTBLEND_SRCALPHA:
-#if defined(_M_SSE)
-		return Vec3<int>(_mm_shuffle_epi32(source.ivec, _MM_SHUFFLE(3, 3, 3, 3)));
-#else
-		return Vec3<int>::AssignToAll(source.a());
-#endif
-
-	case GE_DSTBLEND_INVSRCALPHA:
-#if defined(_M_SSE)
-		return Vec3<int>(_mm_sub_epi32(_mm_set1_epi32(255), _mm_shuffle_epi32(source.ivec, _MM_SHUFFLE(3, 3, 3, 3))));
-#else
-		return Vec3<int>::AssignToAll(255 - source.a());
-#endif
-
-	case GE_DSTBLEND_DSTALPHA:
-		return Vec3<int>::AssignToAll(dst.a());
-
-	case GE_DSTBLEND_INVDSTALPHA:
-		return Vec3<int>::AssignToAll(255 - dst.a());
-
-	case GE_DSTBLEND_DOUBLESRCALPHA:
-		return Vec3<int>::AssignToAll(2 * source.a());
-
-	case GE_DSTBLEND_DOUBLEINVSRCALPHA:
-		return Vec3<int>::AssignToAll(255 - std::min(2 * source.a(), 255));
-
-	case GE_DSTBLEND_DOUBLEDSTALPHA:
-		return Vec3<int>::AssignToAll(2 * dst.a());
-
-	case GE_DSTBLEND_DOUBLEINVDSTALPHA:
-		return Vec3<int>::AssignToAll(255 - std::min(2 * dst.a(), 255));
-
-	case GE_DSTBLEND_FIXB:
-	default:
-		// All other dest factors (> 10) are treated as FIXB.
-		return Vec3<int>::FromRGB(gstate.getFixB());
-	}
-}
-
-static inline Vec3<int> AlphaBlendingResult(const Vec4<int> &source, const Vec4<int> &dst)
-{
-	// Note: These factors cannot go below 0, but they can go above 255 when doubling.
-	Vec3<int> srcfactor = GetSourceFactor(source, dst);
-	Vec3<int> dstfactor = GetDestFactor(source, dst);
-
-	switch (gstate.getBlendEq()) {
-	case GE_BLENDMODE_MUL_AND_ADD:
-	{
-#if defined(_M_SSE)
-		const __m128 s = _mm_mul_ps(_mm_cvtepi32_ps(source.ivec), _mm_cvtepi32_ps(srcfactor.ivec));
-		const __m128 d = _mm_mul_ps(_mm_cvtepi32_ps(dst.ivec), _mm_cvtepi32_ps(dstfactor.ivec));
-		return Vec3<int>(_mm_cvtps_epi32(_mm_mul_ps(_mm_add_ps(s, d), _mm_set_ps1(1.0f / 255.0f))));
-#else
-		return (source.rgb() * srcfactor + dst.rgb() * dstfactor) / 255;
-#endif
-	}
-
-	case GE_BLENDMODE_MUL_AND_SUBTRACT:
-	{
-#if defined(_M_SSE)
-		const __m128 s = _mm_mul_ps(_mm_cvtepi32_ps(source.ivec), _mm_cvtepi32_ps(srcfactor.ivec));
-		const __m128 d = _mm_mul_ps(_mm_cvtepi32_ps(dst.ivec), _mm_cvtepi32_ps(dstfactor.ivec));
-		return Vec3<int>(_mm_cvtps_epi32(_mm_mul_ps(_mm_sub_ps(s, d), _mm_set_ps1(1.0f / 255.0f))));
-#else
-		return (source.rgb() * srcfactor - dst.rgb() * dstfactor) / 255;
-#endif
-	}
-
-	case GE_BLENDMODE_MUL_AND_SUBTRACT_REVERSE:
-	{
-#if defined(_M_SSE)
-		const __m128 s = _mm_mul_ps(_mm_cvtepi32_ps(source.ivec), _mm_cvtepi32_ps(srcfactor.ivec));
-		const __m128 d = _mm_mul_ps(_mm_cvtepi32_ps(dst.ivec), _mm_cvtepi32_ps(dstfactor.ivec));
-		return Vec3<int>(_mm_cvtps_epi32(_mm_mul_ps(_mm_sub_ps(d, s), _mm_set_ps1(1.0f / 255.0f))));
-#else
-		return (dst.rgb() * dstfactor - source.rgb() * srcfactor) / 255;
-#endif
-	}
-
-	case GE_BLENDMODE_MIN:
-		return Vec3<int>(std::min(source.r(), dst.r()),
-						std::min(source.g(), dst.g()),
-						std::min(source.b(), dst.b()));
-
-	case GE_BLENDMODE_MAX:
-		return Vec3<int>(std::max(source.r(), dst.r()),
-						std::max(source.g(), dst.g()),
-						std::max(source.b(), dst.b()));
-
-	case GE_BLENDMODE_ABSDIFF:
-		return Vec3<int>(::abs(source.r() - dst.r()),
-						::abs(source.g() - dst.g()),
-						::abs(source.b() - dst.b()));
-
-	default:
-		ERROR_LOG_REPORT(G3D, "Software: Unknown blend function %x", gstate.getBlendEq());
-		return Vec3<int>();
-	}
-}
-
-template <bool clearMode>
-inline void DrawSinglePixel(const DrawingCoords &p, u16 z, u8 fog, const Vec4<int> &color_in) {
-	Vec4<int> prim_color = color_in;
-	// Depth range test
-	// TODO: Clear mode?
-	if (!gstate.isModeThrough())
-		if (z < gstate.getDepthRangeMin() || z > gstate.getDepthRangeMax())
-			return;
-
-	if (gstate.isColorTestEnabled() && !clearMode)
-		if (!ColorTestPassed(prim_color.rgb()))
-			return;
-
-	// TODO: Does a need to be clamped?
-	if (gstate.isAlphaTestEnabled() && !clearMode)
-		if (!AlphaTestPassed(prim_color.a()))
-			return;
-
-	// In clear mode, it uses the alpha color as stencil.
-	u8 stencil = clearMode ? prim_color.a() : GetPixelStencil(p.x, p.y);
-	// TODO: Is it safe to ignore gstate.isDepthTestEnabled() when clear mode is enabled? Probably yes
-	if (!clearMode && (gstate.isStencilTestEnabled() || gstate.isDepthTestEnabled())) {
-		if (gstate.isStencilTestEnabled() && !StencilTestPassed(stencil)) {
-			stencil = ApplyStencilOp(gstate.getStencilOpSFail(), p.x, p.y);
-			SetPixelStencil(p.x, p.y, stencil);
-			return;
-		}
-
-		// Also apply depth at the same time.  If disabled, same as passing.
-		if (gstate.isDepthTestEnabled() && !DepthTestPassed(p.x, p.y, z)) {
-			if (gstate.isStencilTestEnabled()) {
-				stencil = ApplyStencilOp(gstate.getStencilOpZFail(), p.x, p.y);
-				SetPixelStencil(p.x, p.y, stencil);
-			}
-			return;
-		} else if (gstate.isStencilTestEnabled()) {
-			stencil = ApplyStencilOp(gstate.getStencilOpZPass(), p.x, p.y);
-		}
-
-		if (gstate.isDepthTestEnabled() && gstate.isDepthWriteEnabled()) {
-			SetPixelDepth(p.x, p.y, z);
-		}
-	} else if (clearMode && gstate.isClearModeDepthMask()) {
-		SetPixelDepth(p.x, p.y, z);
-	}
-
-	// Doubling happens only when texturing is enabled, and after tests.
-	if (gstate.isTextureMapEnabled() && gstate.isColorDoublingEnabled() && !clearMode) {
-		// TODO: Does this need to be clamped before blending?
-		prim_color.r() <<= 1;
-		prim_color.g() <<= 1;
-		prim_color.b() <<= 1;
-	}
-
-	if (gstate.isFogEnabled() && !gstate.isModeThrough() && !clearMode) {
-		Vec3<int> fogColor = Vec3<int>::FromRGB(gstate.fogcolor);
-		fogColor = (prim_color.rgb() * (int)fog + fogColor * (255 - (int)fog)) / 255;
-		prim_color.r() = fogColor.r();
-		prim_color.g() = fogColor.g();
-		prim_color.b() = fogColor.b();
-	}
-
-	const u32 old_color = GetPixelColor(p.x, p.y);
-	u32 new_color;
-
-	if (gstate.isAlphaBlendEnabled() && !clearMode) {
-		const Vec4<int> dst = Vec4<int>::FromRGBA(old_color);
-		// ToRGBA() always automatically clamps.
-		new_color = AlphaBlendingResult(prim_color, dst).ToRGB();
-		new_color |= stencil << 24;
-	} else {
-#if defined(_M_SSE)
-		new_color = Vec3<int>(prim_color.ivec).ToRGB();
-		new_color |= stencil << 24;
-#else
-		new_color = Vec4<int>(prim_color.r(), prim_color.g(), prim_color.b(), stencil).ToRGBA();
-#endif
-	}
-
-	// TODO: Is alpha blending still performed if logic ops are enabled?
-	if (gstate.isLogicOpEnabled() && !clearMode) {
-		// Logic ops don't affect stencil.
-		new_color = (stencil << 24) | (ApplyLogicOp(gstate.getLogicOp(), old_color, new_color) & 0x00FFFFFF);
-	}
-
-	if (clearMode) {
-		new_color = (new_color & ~gstate.getClearModeColorMask()) | (old_color & gstate.getClearModeColorMask());
-	} else {
-		new_color = (new_color & ~gstate.getColorMask()) | (old_color & gstate.getColorMask());
-	}
-
-	// TODO: Dither before or inside SetPixelColor
-	SetPixelColor(p.x, p.y, new_color);
-}
-
 static inline void ApplyTexturing(Sampler::Funcs sampler, Vec4<int> &prim_color, float s, float t, int texlevel, int frac_texlevel, bool bilinear, u8 *texptr[], int texbufw[]) {
 	int u[8] = {0}, v[8] = {0};   // 1.23.8 fixed point
 	int frac_u[2], frac_v[2];
@@ -1157,6 +567,23 @@ static inline Vec4<int> MakeMask(const Vec4<int> &w0, const Vec4<int> &w1, const
 #endif
 }
 
+// Vec4<int>'s operators aren't vectorized.
+static inline Vec4<int> AddInts(const Vec4<int> &a, const Vec4<int> &b) {
+#if defined(_M_SSE) && !defined(_M_IX86)
+	return _mm_add_epi32(a.ivec, b.ivec);
+#else
+	return a + b;
+#endif
+}
+
+static inline Vec4<int> OrInts(const Vec4<int> &a, const Vec4<int> &b, const Vec4<int> &c) {
+#if defined(_M_SSE) && !defined(_M_IX86)
+	return _mm_or_si128(_mm_or_si128(a.ivec, b.ivec), c.ivec);
+#else
+	return a | b | c;
+#endif
+}
+
 static inline bool AnyMask(const Vec4<int> &mask) {
 #if defined(_M_SSE) && !defined(_M_IX86)
 	// In other words: !(mask.x < 0 && mask.y < 0 && mask.z < 0 && mask.w < 0)
@@ -1179,11 +606,13 @@ static inline Vec4<float> EdgeRecip(const Vec4<int> &w0, const Vec4<int> &w1, co
 #endif
 }
 
+// Draws the part of the triangle within x1-x2, y1-y2 (inclusive, screen coordinates.)
+// Pixels are still visited in 2x2 quads aligned to minX/minY, the corner of the whole
+// triangle's bounding box, so the result doesn't depend on how it's split up.
 template <bool clearMode>
 void DrawTriangleSlice(
 	const VertexData& v0, const VertexData& v1, const VertexData& v2,
-	int minX, int minY, int maxX, int maxY,
-	bool byY, int h1, int h2)
+	int minX, int minY, int x1, int y1, int x2, int y2)
 {
 	Vec4<int> bias0 = Vec4<int>::AssignToAll(IsRightSideOrFlatBottomLine(v0.screenpos.xy(), v1.screenpos.xy(), v2.screenpos.xy()) ? -1 : 0);
 	Vec4<int> bias1 = Vec4<int>::AssignToAll(IsRightSideOrFlatBottomLine(v1.screenpos.xy(), v2.screenpos.xy(), v0.screenpos.xy()) ? -1 : 0);
@@ -1215,15 +644,11 @@ void DrawTriangleSlice(
 	TriangleEdge e1;
 	TriangleEdge e2;
 
-	if (byY) {
-		maxY = std::min(maxY, minY + h2 * 16 * 2);
-		minY += h1 * 16 * 2;
-	} else {
-		maxX = std::min(maxX, minX + h2 * 16 * 2);
-		minX += h1 * 16 * 2;
-	}
+	// 32 because we do two pixels at once.
+	const int startX = minX + ((x1 - minX) & ~31);
+	const int startY = minY + ((y1 - minY) & ~31);
 
-	ScreenCoords pprime(minX, minY, 0);
+	ScreenCoords pprime(startX, startY, 0);
 	Vec4<int> w0_base = e0.Start(v1.screenpos, v2.screenpos, pprime);
 	Vec4<int> w1_base = e1.Start(v2.screenpos, v0.screenpos, pprime);
 	Vec4<int> w2_base = e2.Start(v0.screenpos, v1.screenpos, pprime);
@@ -1233,8 +658,18 @@ void DrawTriangleSlice(
 	const bool flatZ = v0.screenpos.z == v1.screenpos.z && v0.screenpos.z == v2.screenpos.z;
 
 	Sampler::Funcs sampler = Sampler::GetFuncs();
-
-	for (pprime.y = minY; pprime.y < maxY; pprime.y += 32,
+	PixelFuncID pixelID;
+	ComputePixelFuncID(&pixelID);
+	SingleFunc drawPixel = GetSingleFunc(pixelID);
+
+	// These are negative for pixels outside the slice.
+	const Vec4<int> laneStartX = Vec4<int>::AssignToAll(startX) + Vec4<int>(0, 16, 0, 16);
+	const Vec4<int> scissorLeftStart = laneStartX - Vec4<int>::AssignToAll(x1);
+	const Vec4<int> scissorRightStart = Vec4<int>::AssignToAll(x2) - laneStartX;
+	const Vec4<int> scissorLeftStep = Vec4<int>::AssignToAll(32);
+	const Vec4<int> scissorRightStep = Vec4<int>::AssignToAll(-32);
+
+	for (pprime.y = startY; pprime.y <= y2; pprime.y += 32,
 										w0_base = e0.StepY(w0_base),
 										w1_base = e1.StepY(w1_base),
 										w2_base = e2.StepY(w2_base)) {
@@ -1243,21 +678,24 @@ void DrawTriangleSlice(
 		Vec4<int> w2 = w2_base;
 
 		// TODO: Maybe we can clip the edges instead?
-		int scissorYPlus1 = pprime.y + 16 > maxY ? -1 : 0;
-		Vec4<int> scissor_mask = Vec4<int>(0, maxX - minX - 1, scissorYPlus1, (maxX - minX - 1) | scissorYPlus1);
-		Vec4<int> scissor_step = Vec4<int>(0, -32, 0, -32);
+		const Vec4<int> laneY = Vec4<int>::AssignToAll(pprime.y) + Vec4<int>(0, 0, 16, 16);
+		const Vec4<int> scissorY = (laneY - Vec4<int>::AssignToAll(y1)) | (Vec4<int>::AssignToAll(y2) - laneY);
+		Vec4<int> scissorLeft = scissorLeftStart;
+		Vec4<int> scissorRight = scissorRightStart;
 
-		pprime.x = minX;
+		pprime.x = startX;
 		DrawingCoords p = TransformUnit::ScreenToDrawing(pprime);
 
-		for (; pprime.x <= maxX; pprime.x += 32,
+		for (; pprime.x <= x2; pprime.x += 32,
 			w0 = e0.StepX(w0),
 			w1 = e1.StepX(w1),
 			w2 = e2.StepX(w2),
-			scissor_mask = scissor_mask + scissor_step,
+			scissorLeft = AddInts(scissorLeft, scissorLeftStep),
+			scissorRight = AddInts(scissorRight, scissorRightStep),
 			p.x = (p.x + 2) & 0x3FF) {
 
 			// If p is on or inside all edges, render pixel
+			const Vec4<int> scissor_mask = OrInts(scissorY, scissorLeft, scissorRight);
 			Vec4<int> mask = MakeMask(w0, w1, w2, bias0, bias1, bias2, scissor_mask);
 			if (AnyMask(mask)) {
 				Vec4<float> wsum_recip = EdgeRecip(w0, w1, w2);
@@ -1324,21 +762,25 @@ void DrawTriangleSlice(
 					z = (zfloats * wsum_recip).Cast<int>();
 				}
 
-				DrawingCoords subp = p;
 				for (int i = 0; i < 4; ++i) {
 					if (mask[i] < 0) {
 						continue;
 					}
-					subp.x = p.x + (i & 1);
-					subp.y = p.y + (i / 2);
-
-					DrawSinglePixel<clearMode>(subp, (u16)z[i], fog[i], prim_color[i]);
+					drawPixel(p.x + (i & 1), p.y + (i / 2), (u16)z[i], fog[i], prim_color[i], pixelID);
 				}
 			}
 		}
 	}
 }
 
+void DrawTriangleInRect(const VertexData &v0, const VertexData &v1, const VertexData &v2, int minX, int minY, int x1, int y1, int x2, int y2) {
+	if (gstate.isModeClear()) {
+		DrawTriangleSlice<true>(v0, v1, v2, minX, minY, x1, y1, x2, y2);
+	} else {
+		DrawTriangleSlice<false>(v0, v1, v2, minX, minY, x1, y1, x2, y2);
+	}
+}
+
 // Draws triangle, vertices specified in counter-clockwise direction
 void DrawTriangle(const VertexData& v0, const VertexData& v1, const VertexData& v2)
 {
@@ -1358,50 +800,31 @@ void DrawTriangle(const VertexData& v0, const VertexData& v1, const VertexData&
 	int maxY = (std::max(std::max(v0.screenpos.y, v1.screenpos.y), v2.screenpos.y) + 0xF) & ~0xF;
 
 	DrawingCoords scissorTL(gstate.getScissorX1(), gstate.getScissorY1(), 0);
-	DrawingCoords scissorBR(gstate.getScissorX2(), gstate.getScissorY2(), 0);
+	// The scissor is inclusive, and the offset may not be whole pixels, so go up to the next pixel.
+	DrawingCoords scissorEnd(gstate.getScissorX2() + 1, gstate.getScissorY2() + 1, 0);
 	minX = std::max(minX, (int)TransformUnit::DrawingToScreen(scissorTL).x);
-	maxX = std::min(maxX, (int)TransformUnit::DrawingToScreen(scissorBR).x);
+	maxX = std::min(maxX, (int)TransformUnit::DrawingToScreen(scissorEnd).x - 1);
 	minY = std::max(minY, (int)TransformUnit::DrawingToScreen(scissorTL).y);
-	maxY = std::min(maxY, (int)TransformUnit::DrawingToScreen(scissorBR).y);
-
-	// 32 because we do two pixels at once, and we don't want overlap.
-	int rangeY = (maxY - minY) / 32 + 1;
-	int rangeX = (maxX - minX) / 32 + 1;
-	if (rangeY >= 12 && rangeX >= rangeY * 4) {
-		if (gstate.isModeClear()) {
-			auto bound = [&](int a, int b) -> void {
-				DrawTriangleSlice<true>(v0, v1, v2, minX, minY, maxX, maxY, false, a, b);
-			};
-			GlobalThreadPool::Loop(bound, 0, rangeX);
-		} else {
-			auto bound = [&](int a, int b) -> void {
-				DrawTriangleSlice<false>(v0, v1, v2, minX, minY, maxX, maxY, false, a, b);
-			};
-			GlobalThreadPool::Loop(bound, 0, rangeX);
-		}
-	} else if (rangeY >= 12 && rangeX >= 12) {
-		if (gstate.isModeClear()) {
-			auto bound = [&](int a, int b) -> void {
-				DrawTriangleSlice<true>(v0, v1, v2, minX, minY, maxX, maxY, true, a, b);
-			};
-			GlobalThreadPool::Loop(bound, 0, rangeY);
-		} else {
-			auto bound = [&](int a, int b) -> void {
-				DrawTriangleSlice<false>(v0, v1, v2, minX, minY, maxX, maxY, true, a, b);
-			};
-			GlobalThreadPool::Loop(bound, 0, rangeY);
-		}
+	maxY = std::min(maxY, (int)TransformUnit::DrawingToScreen(scissorEnd).y - 1);
+	if (maxX < minX || maxY < minY)
+		return;
+
+	if (binner.IsEnabled()) {
+		binner.AddTriangle(v0, v1, v2, minX, minY, maxX, maxY);
 	} else {
-		if (gstate.isModeClear()) {
-			DrawTriangleSlice<true>(v0, v1, v2, minX, minY, maxX, maxY, true, 0, rangeY);
-		} else {
-			DrawTriangleSlice<false>(v0, v1, v2, minX, minY, maxX, maxY, true, 0, rangeY);
-		}
+		DrawTriangleInRect(v0, v1, v2, minX, minY, minX, minY, maxX, maxY);
 	}
 }
 
+void Flush() {
+	binner.Flush();
+}
+
 void DrawPoint(const VertexData &v0)
 {
+	// Not binned, so anything before has to be drawn first.
+	binner.Flush();
+
 	ScreenCoords pos = v0.screenpos;
 	Vec4<int> prim_color = v0.color0;
 	Vec3<int> sec_color = v0.color1;
@@ -1469,15 +892,16 @@ void DrawPoint(const VertexData &v0)
 		fog = ClampFogDepth(v0.fogdepth);
 	}
 
-	if (clearMode) {
-		DrawSinglePixel<true>(p, z, fog, prim_color);
-	} else {
-		DrawSinglePixel<false>(p, z, fog, prim_color);
-	}
+	PixelFuncID pixelID;
+	ComputePixelFuncID(&pixelID);
+	SingleFunc drawPixel = GetSingleFunc(pixelID);
+	drawPixel(p.x, p.y, z, fog, prim_color, pixelID);
 }
 
 void ClearRectangle(const VertexData &v0, const VertexData &v1)
 {
+	binner.Flush();
+
 	int minX = std::min(v0.screenpos.x, v1.screenpos.x) & ~0xF;
 	int minY = std::min(v0.screenpos.y, v1.screenpos.y) & ~0xF;
 	int maxX = (std::max(v0.screenpos.x, v1.screenpos.x) + 0xF) & ~0xF;
@@ -1610,6 +1034,8 @@ void ClearRectangle(const VertexData &v0, const VertexData &v1)
 
 void DrawLine(const VertexData &v0, const VertexData &v1)
 {
+	binner.Flush();
+
 	// TODO: Use a proper line drawing algorithm that handles fractional endpoints correctly.
 	Vec3<int> a(v0.screenpos.x, v0.screenpos.y, v0.screenpos.z);
 	Vec3<int> b(v1.screenpos.x, v1.screenpos.y, v0.screenpos.z);
@@ -1652,6 +1078,9 @@ void DrawLine(const VertexData &v0, const VertexData &v1)
 	}
 
 	Sampler::Funcs sampler = Sampler::GetFuncs();
+	PixelFuncID pixelID;
+	ComputePixelFuncID(&pixelID);
+	SingleFunc drawPixel = GetSingleFunc(pixelID);
 
 	float x = a.x > b.x ? a.x - 1 : a.x;
 	float y = a.y > b.y ? a.y - 1 : a.y;
@@ -1726,11 +1155,7 @@ void DrawLine(const VertexData &v0, const VertexData &v1)
 			ScreenCoords pprime = ScreenCoords((int)x, (int)y, (int)z);
 
 			DrawingCoords p = TransformUnit::ScreenToDrawing(pprime);
-			if (clearMode) {
-				DrawSinglePixel<true>(p, z, fog, prim_color);
-			} else {
-				DrawSinglePixel<false>(p, z, fog, prim_color);
-			}
+			drawPixel(p.x, p.y, (u16)z, fog, prim_color, pixelID);
 		}
 
 		x += xinc;
@@ -1748,7 +1173,7 @@ bool GetCurrentStencilbuffer(GPUDebugBuffer &buffer)
 	u8 *row = buffer.GetData();
 	for (int y = gstate.getRegionY1(); y <= gstate.getRegionY2(); ++y) {
 		for (int x = gstate.getRegionX1(); x <= gstate.getRegionX2(); ++x) {
-			row[x - gstate.getRegionX1()] = GetPixelStencil(x, y);
+			row[x - gstate.getRegionX1()] = GetPixelStencil(gstate.FrameBufFormat(), x, y);
 		}
 		row += w;
 	}
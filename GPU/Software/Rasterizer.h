@@ -29,6 +29,14 @@ void DrawPoint(const VertexData &v0);
 void DrawLine(const VertexData &v0, const VertexData &v1);
 void ClearRectangle(const VertexData &v0, const VertexData &v1);
 
+// Draws the part of a triangle within x1-x2, y1-y2 (inclusive, screen coordinates.)
+// minX/minY is the top left of its bounding box, which 2x2 quads are aligned to.
+void DrawTriangleInRect(const VertexData &v0, const VertexData &v1, const VertexData &v2, int minX, int minY, int x1, int y1, int x2, int y2);
+
+// Draws any binned triangles.  Must be called before changing state that affects
+// drawing, and before anything reads or writes the framebuffer, textures, or CLUT.
+void Flush();
+
 bool GetCurrentStencilbuffer(GPUDebugBuffer &buffer);
 bool GetCurrentTexture(GPUDebugBuffer &buffer, int level);
 
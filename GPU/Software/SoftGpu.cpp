@@ -32,6 +32,7 @@
 #include "profiler/profiler.h"
 #include "thin3d/thin3d.h"
 
+#include "GPU/Software/DrawPixel.h"
 #include "GPU/Software/Rasterizer.h"
 #include "GPU/Software/Sampler.h"
 #include "GPU/Software/SoftGpu.h"
@@ -103,6 +104,7 @@ SoftGPU::SoftGPU(GraphicsContext *gfxCtx, Draw::DrawContext *draw)
 	displayFormat_ = GE_FORMAT_8888;
 
 	Sampler::Init();
+	Rasterizer::Init();
 	drawEngine_ = new SoftwareDrawEngine();
 	drawEngineCommon_ = drawEngine_;
 }
@@ -116,6 +118,9 @@ void SoftGPU::DeviceRestore() {
 }
 
 SoftGPU::~SoftGPU() {
+	// The list thread may still be using everything below.
+	StopListThread();
+
 	texColor->Release();
 	texColor = nullptr;
 
@@ -133,6 +138,7 @@ SoftGPU::~SoftGPU() {
 	samplerLinear = nullptr;
 
 	Sampler::Shutdown();
+	Rasterizer::Shutdown();
 }
 
 void SoftGPU::SetDisplayFramebuffer(u32 framebuf, u32 stride, GEBufferFormat format) {
@@ -291,6 +297,8 @@ void SoftGPU::CopyToCurrentFboFromDisplayRam(int srcwidth, int srcheight) {
 }
 
 void SoftGPU::CopyDisplayToOutput() {
+	SyncListThread();
+
 	// The display always shows 480x272.
 	CopyToCurrentFboFromDisplayRam(FB_WIDTH, FB_HEIGHT);
 	framebufferDirty_ = false;
@@ -305,6 +313,116 @@ void SoftGPU::CopyDisplayToOutput() {
 	}
 }
 
+// Binned triangles are drawn with the state at flush time (see BinManager), so this
+// says whether a command has to flush them before it runs.
+static bool FlushesBinnedDraws(u32 cmd, u32 diff) {
+	switch (cmd) {
+	// These write the CLUT, the tgen matrix, or memory we may draw to or sample from.
+	case GE_CMD_LOADCLUT:
+	case GE_CMD_TGENMATRIXDATA:
+	case GE_CMD_TRANSFERSTART:
+	// The list may end or pause, and its context may be restored.
+	case GE_CMD_END:
+	case GE_CMD_SIGNAL:
+	case GE_CMD_FINISH:
+		return true;
+
+	// Control flow, and state only used before vertices reach the rasterizer.
+	case GE_CMD_NOP:
+	case GE_CMD_BASE:
+	case GE_CMD_VADDR:
+	case GE_CMD_IADDR:
+	case GE_CMD_OFFSETADDR:
+	case GE_CMD_ORIGIN:
+	case GE_CMD_JUMP:
+	case GE_CMD_BJUMP:
+	case GE_CMD_CALL:
+	case GE_CMD_RET:
+	case GE_CMD_PRIM:
+	case GE_CMD_BEZIER:
+	case GE_CMD_SPLINE:
+	case GE_CMD_BOUNDINGBOX:
+	case GE_CMD_VERTEXTYPE:
+	case GE_CMD_CLIPENABLE:
+	case GE_CMD_CULLFACEENABLE:
+	case GE_CMD_CULL:
+	case GE_CMD_PATCHDIVISION:
+	case GE_CMD_PATCHPRIMITIVE:
+	case GE_CMD_PATCHFACING:
+	case GE_CMD_PATCHCULLENABLE:
+	case GE_CMD_MORPHWEIGHT0: case GE_CMD_MORPHWEIGHT1: case GE_CMD_MORPHWEIGHT2: case GE_CMD_MORPHWEIGHT3:
+	case GE_CMD_MORPHWEIGHT4: case GE_CMD_MORPHWEIGHT5: case GE_CMD_MORPHWEIGHT6: case GE_CMD_MORPHWEIGHT7:
+	case GE_CMD_WORLDMATRIXNUMBER: case GE_CMD_WORLDMATRIXDATA:
+	case GE_CMD_VIEWMATRIXNUMBER: case GE_CMD_VIEWMATRIXDATA:
+	case GE_CMD_PROJMATRIXNUMBER: case GE_CMD_PROJMATRIXDATA:
+	case GE_CMD_BONEMATRIXNUMBER: case GE_CMD_BONEMATRIXDATA:
+	case GE_CMD_TGENMATRIXNUMBER:
+	case GE_CMD_VIEWPORTXSCALE: case GE_CMD_VIEWPORTYSCALE: case GE_CMD_VIEWPORTZSCALE:
+	case GE_CMD_VIEWPORTXCENTER: case GE_CMD_VIEWPORTYCENTER: case GE_CMD_VIEWPORTZCENTER:
+	case GE_CMD_TEXSCALEU: case GE_CMD_TEXSCALEV:
+	case GE_CMD_TEXOFFSETU: case GE_CMD_TEXOFFSETV:
+	case GE_CMD_LIGHTINGENABLE:
+	case GE_CMD_LIGHTENABLE0: case GE_CMD_LIGHTENABLE1: case GE_CMD_LIGHTENABLE2: case GE_CMD_LIGHTENABLE3:
+	case GE_CMD_LIGHTTYPE0: case GE_CMD_LIGHTTYPE1: case GE_CMD_LIGHTTYPE2: case GE_CMD_LIGHTTYPE3:
+	case GE_CMD_LIGHTMODE:
+	case GE_CMD_REVERSENORMAL:
+	case GE_CMD_MATERIALUPDATE:
+	case GE_CMD_MATERIALEMISSIVE:
+	case GE_CMD_MATERIALAMBIENT:
+	case GE_CMD_MATERIALDIFFUSE:
+	case GE_CMD_MATERIALSPECULAR:
+	case GE_CMD_MATERIALALPHA:
+	case GE_CMD_MATERIALSPECULARCOEF:
+	case GE_CMD_AMBIENTCOLOR:
+	case GE_CMD_AMBIENTALPHA:
+	case GE_CMD_LX0: case GE_CMD_LY0: case GE_CMD_LZ0:
+	case GE_CMD_LX1: case GE_CMD_LY1: case GE_CMD_LZ1:
+	case GE_CMD_LX2: case GE_CMD_LY2: case GE_CMD_LZ2:
+	case GE_CMD_LX3: case GE_CMD_LY3: case GE_CMD_LZ3:
+	case GE_CMD_LDX0: case GE_CMD_LDY0: case GE_CMD_LDZ0:
+	case GE_CMD_LDX1: case GE_CMD_LDY1: case GE_CMD_LDZ1:
+	case GE_CMD_LDX2: case GE_CMD_LDY2: case GE_CMD_LDZ2:
+	case GE_CMD_LDX3: case GE_CMD_LDY3: case GE_CMD_LDZ3:
+	case GE_CMD_LKA0: case GE_CMD_LKB0: case GE_CMD_LKC0:
+	case GE_CMD_LKA1: case GE_CMD_LKB1: case GE_CMD_LKC1:
+	case GE_CMD_LKA2: case GE_CMD_LKB2: case GE_CMD_LKC2:
+	case GE_CMD_LKA3: case GE_CMD_LKB3: case GE_CMD_LKC3:
+	case GE_CMD_LKS0: case GE_CMD_LKS1: case GE_CMD_LKS2: case GE_CMD_LKS3:
+	case GE_CMD_LKO0: case GE_CMD_LKO1: case GE_CMD_LKO2: case GE_CMD_LKO3:
+	case GE_CMD_LAC0: case GE_CMD_LDC0: case GE_CMD_LSC0:
+	case GE_CMD_LAC1: case GE_CMD_LDC1: case GE_CMD_LSC1:
+	case GE_CMD_LAC2: case GE_CMD_LDC2: case GE_CMD_LSC2:
+	case GE_CMD_LAC3: case GE_CMD_LDC3: case GE_CMD_LSC3:
+	// The CLUT itself is only read on LOADCLUT.
+	case GE_CMD_CLUTADDR:
+	case GE_CMD_CLUTADDRUPPER:
+	case GE_CMD_TRANSFERSRC:
+	case GE_CMD_TRANSFERSRCW:
+	case GE_CMD_TRANSFERDST:
+	case GE_CMD_TRANSFERDSTW:
+	case GE_CMD_TRANSFERSRCPOS:
+	case GE_CMD_TRANSFERDSTPOS:
+	case GE_CMD_TRANSFERSIZE:
+	case GE_CMD_TEXFLUSH:
+	case GE_CMD_TEXSYNC:
+		return false;
+
+	default:
+		return diff != 0;
+	}
+}
+
+void SoftGPU::PreExecuteOp(u32 op, u32 diff) {
+	if (FlushesBinnedDraws(op >> 24, diff)) {
+		Rasterizer::Flush();
+	}
+}
+
+void SoftGPU::FinishDeferred() {
+	// The CPU may look at the framebuffer or change textures once the list stops.
+	Rasterizer::Flush();
+}
+
 void SoftGPU::FastRunLoop(DisplayList &list) {
 	PROFILE_THIS_SCOPE("soft_runloop");
 	for (; downcount > 0; --downcount) {
@@ -312,6 +430,9 @@ void SoftGPU::FastRunLoop(DisplayList &list) {
 		u32 cmd = op >> 24;
 
 		u32 diff = op ^ gstate.cmdmem[cmd];
+		if (FlushesBinnedDraws(cmd, diff)) {
+			Rasterizer::Flush();
+		}
 		gstate.cmdmem[cmd] = op;
 		ExecuteOp(op, diff);
 
@@ -866,12 +987,13 @@ void SoftGPU::GetStats(char *buffer, size_t bufsize) {
 
 void SoftGPU::InvalidateCache(u32 addr, int size, GPUInvalidationType type)
 {
-	// Nothing to invalidate.
+	// Nothing to invalidate, but the CPU is about to touch this memory.
+	SyncListThread();
 }
 
 void SoftGPU::NotifyVideoUpload(u32 addr, int size, int width, int format)
 {
-	// Ignore.
+	SyncListThread();
 }
 
 bool SoftGPU::PerformMemoryCopy(u32 dest, u32 src, int size)
@@ -911,10 +1033,12 @@ bool SoftGPU::PerformMemoryUpload(u32 dest, int size)
 
 bool SoftGPU::PerformStencilUpload(u32 dest, int size)
 {
+	SyncListThread();
 	return false;
 }
 
 bool SoftGPU::FramebufferDirty() {
+	SyncListThread();
 	if (g_Config.iFrameSkip != 0) {
 		bool dirty = framebufferDirty_;
 		framebufferDirty_ = false;
@@ -924,6 +1048,9 @@ bool SoftGPU::FramebufferDirty() {
 }
 
 bool SoftGPU::GetCurrentFramebuffer(GPUDebugBuffer &buffer, GPUDebugFramebufferType type, int maxRes) {
+	SyncListThread();
+	// When stepping in the debugger, draws may still be binned.
+	Rasterizer::Flush();
 	int x1 = gstate.getRegionX1();
 	int y1 = gstate.getRegionY1();
 	int x2 = gstate.getRegionX2() + 1;
@@ -960,6 +1087,8 @@ bool SoftGPU::GetOutputFramebuffer(GPUDebugBuffer &buffer) {
 
 bool SoftGPU::GetCurrentDepthbuffer(GPUDebugBuffer &buffer)
 {
+	SyncListThread();
+	Rasterizer::Flush();
 	const int w = gstate.getRegionX2() - gstate.getRegionX1() + 1;
 	const int h = gstate.getRegionY2() - gstate.getRegionY1() + 1;
 	buffer.Allocate(w, h, GPU_DBG_FORMAT_16BIT);
@@ -977,16 +1106,20 @@ bool SoftGPU::GetCurrentDepthbuffer(GPUDebugBuffer &buffer)
 
 bool SoftGPU::GetCurrentStencilbuffer(GPUDebugBuffer &buffer)
 {
+	SyncListThread();
+	Rasterizer::Flush();
 	return Rasterizer::GetCurrentStencilbuffer(buffer);
 }
 
 bool SoftGPU::GetCurrentTexture(GPUDebugBuffer &buffer, int level)
 {
+	SyncListThread();
 	return Rasterizer::GetCurrentTexture(buffer, level);
 }
 
 bool SoftGPU::GetCurrentClut(GPUDebugBuffer &buffer)
 {
+	SyncListThread();
 	const u32 bpp = gstate.getClutPaletteFormat() == GE_CMODE_32BIT_ABGR8888 ? 4 : 2;
 	const u32 pixels = 1024 / bpp;
 
@@ -997,6 +1130,7 @@ bool SoftGPU::GetCurrentClut(GPUDebugBuffer &buffer)
 
 bool SoftGPU::GetCurrentSimpleVertices(int count, std::vector<GPUDebugVertex> &vertices, std::vector<u16> &indices)
 {
+	SyncListThread();
 	return drawEngine_->transformUnit.GetCurrentSimpleVertices(count, vertices, indices);
 }
 
@@ -1006,5 +1140,9 @@ bool SoftGPU::DescribeCodePtr(const u8 *ptr, std::string &name) {
 		name = "SamplerJit:" + subname;
 		return true;
 	}
+	if (Rasterizer::DescribeCodePtr(ptr, subname)) {
+		name = "PixelJit:" + subname;
+		return true;
+	}
 	return false;
 }
@@ -55,6 +55,7 @@ class SoftGPU : public GPUCommon {
 
 	void CheckGPUFeatures() override {}
 	void InitClear() override {}
+	void PreExecuteOp(u32 op, u32 diff) override;
 	void ExecuteOp(u32 op, u32 diff) override;
 
 	void SetDisplayFramebuffer(u32 framebuf, u32 stride, GEBufferFormat format) override;
@@ -81,6 +82,7 @@ class SoftGPU : public GPUCommon {
 	bool FramebufferDirty() override;
 
 	bool FramebufferReallyDirty() override {
+		SyncListThread();
 		return !(gstate_c.skipDrawReason & SKIPDRAW_SKIPFRAME);
 	}
 
@@ -96,6 +98,8 @@ class SoftGPU : public GPUCommon {
 
 protected:
 	void FastRunLoop(DisplayList &list) override;
+	void FinishDeferred() override;
+	bool SupportsListThread() const override { return true; }
 	void CopyToCurrentFboFromDisplayRam(int srcwidth, int srcheight);
 
 private:
@@ -503,6 +503,7 @@ void GPU_Vulkan::GetStats(char *buffer, size_t bufsize) {
 	float vertexAverageCycles = gpuStats.numVertsSubmitted > 0 ? (float)gpuStats.vertexGPUCycles / (float)gpuStats.numVertsSubmitted : 0.0f;
 	snprintf(buffer, bufsize - 1,
 		"DL processing time: %0.2f ms\n"
+		"Replayed state runs: %i (%i commands, ~%0.3f ms saved)\n"
 		"Draw calls: %i, flushes %i, clears %i\n"
 		"Cached Draw calls: %i\n"
 		"Num Tracked Vertex Arrays: %i\n"
@@ -517,6 +518,9 @@ void GPU_Vulkan::GetStats(char *buffer, size_t bufsize) {
 		"Pushbuffer space used: UBO %d, Vtx %d, Idx %d\n"
 		"%s\n",
 		gpuStats.msProcessingDisplayLists * 1000.0f,
+		gpuStats.numReplayedCommandRuns,
+		gpuStats.numReplayedCommands,
+		gpuStats.msSavedByCommandReplay,
 		gpuStats.numDrawCalls,
 		gpuStats.numFlushes,
 		gpuStats.numClears,
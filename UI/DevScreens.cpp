@@ -781,6 +781,13 @@ UI::EventReturn JitCompareScreen::OnShowStats(UI::EventParams &e) {
 	NOTICE_LOG(JIT, "Average Bloat: %0.2f%%", 100 * bcStats.avgBloat);
 	NOTICE_LOG(JIT, "Min Bloat: %0.2f%%  (%08x)", 100 * bcStats.minBloat, bcStats.minBloatBlock);
 	NOTICE_LOG(JIT, "Max Bloat: %0.2f%%  (%08x)", 100 * bcStats.maxBloat, bcStats.maxBloatBlock);
+	if (bcStats.storageReserved != 0) {
+		NOTICE_LOG(JIT, "Block storage: %d KB used of %d KB", (int)(bcStats.storageUsed / 1024), (int)(bcStats.storageReserved / 1024));
+	}
+	int nativeTotal = bcStats.nativeOps + bcStats.fallbackOps + bcStats.interpretedOps;
+	if (nativeTotal != 0) {
+		NOTICE_LOG(JIT, "Native ops: %d, interpreter fallback ops: %d (%0.1f%%), interpreted blocks: %d (%d ops, %0.1f%%)", bcStats.nativeOps, bcStats.fallbackOps, 100.0 * bcStats.fallbackOps / nativeTotal, bcStats.interpretedBlocks, bcStats.interpretedOps, 100.0 * bcStats.interpretedOps / nativeTotal);
+	}
 
 	int ctr = 0, sz = (int)bcStats.bloatMap.size();
 	for (auto iter : bcStats.bloatMap) {
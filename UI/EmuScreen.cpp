@@ -1016,6 +1016,12 @@ static void DrawDebugStats(DrawBuffer *draw2d) {
 	draw2d->DrawText(UBUNTU24, statbuf, 10, 30, 0xFFFFFFFF, FLAG_DYNAMIC_ASCII);
 
 	__SasGetDebugStats(statbuf, sizeof(statbuf));
+	if (g_Config.iRewindFlipFrequency != 0) {
+		SaveState::RewindStats rewind = SaveState::GetRewindStats();
+		size_t len = strlen(statbuf);
+		snprintf(statbuf + len, sizeof(statbuf) - len, "%sRewind: %d snapshots, %d taken, %d skipped, %d/%d MB\n",
+			len != 0 && statbuf[len - 1] != '\n' ? "\n" : "", rewind.snapshots, rewind.saved, rewind.skipped, (int)(rewind.bytes >> 20), (int)(rewind.budget >> 20));
+	}
 	draw2d->DrawText(UBUNTU24, statbuf, PSP_CoreParameter().pixelWidth / 2 + 11, 31, 0xc0000000, FLAG_DYNAMIC_ASCII);
 	draw2d->DrawText(UBUNTU24, statbuf, PSP_CoreParameter().pixelWidth / 2 + 10, 30, 0xFFFFFFFF, FLAG_DYNAMIC_ASCII);
 	draw2d->SetFontScale(1.0f, 1.0f);
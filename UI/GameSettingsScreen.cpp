@@ -227,6 +227,8 @@ void GameSettingsScreen::CreateViews() {
 		softwareGPU->OnClick.Handle(this, &GameSettingsScreen::OnSoftwareRendering);
 		if (PSP_IsInited())
 			softwareGPU->SetEnabled(false);
+		CheckBox *listThread = graphicsSettings->Add(new CheckBox(&g_Config.bDisplayListThread, gr->T("Display list thread", "Process display lists on a separate thread")));
+		listThread->SetEnabledPtr(&g_Config.bSoftwareRendering);
 	}
 
 	graphicsSettings->Add(new ItemHeader(gr->T("Frame Rate Control")));
@@ -382,6 +384,18 @@ void GameSettingsScreen::CreateViews() {
 	});
 	deposterize->SetDisabledPtr(&g_Config.bSoftwareRendering);
 
+	// Only the OpenGL backend can upscale in the background so far.
+	if (GetGPUBackend() == GPUBackend::OPENGL) {
+		CheckBox *asyncScaling = graphicsSettings->Add(new CheckBox(&g_Config.bTexAsyncScaling, gr->T("Upscale in background")));
+		asyncScaling->OnClick.Add([=](EventParams &e) {
+			if (g_Config.bTexAsyncScaling == true) {
+				settingInfo_->Show(gr->T("Upscale in background Tip", "Less stutter, new textures show unscaled for a few frames"), e.v);
+			}
+			return UI::EVENT_CONTINUE;
+		});
+		asyncScaling->SetDisabledPtr(&g_Config.bSoftwareRendering);
+	}
+
 	graphicsSettings->Add(new ItemHeader(gr->T("Texture Filtering")));
 	static const char *anisoLevels[] = { "Off", "2x", "4x", "8x", "16x" };
 	PopupMultiChoice *anisoFiltering = graphicsSettings->Add(new PopupMultiChoice(&g_Config.iAnisotropyLevel, gr->T("Anisotropic Filtering"), anisoLevels, 0, ARRAY_SIZE(anisoLevels), gr->GetName(), screenManager()));
@@ -468,6 +482,9 @@ void GameSettingsScreen::CreateViews() {
 		CheckBox *resampling = audioSettings->Add(new CheckBox(&g_Config.bAudioResampler, a->T("Audio sync", "Audio sync (resampling)")));
 		resampling->SetEnabledPtr(&g_Config.bEnableSound);
 	}
+	static const char *resamplerTypes[] = { "Linear", "Sinc (higher quality)" };
+	PopupMultiChoice *resamplerType = audioSettings->Add(new PopupMultiChoice(&g_Config.iAudioResamplerType, a->T("Resampling"), resamplerTypes, 0, ARRAY_SIZE(resamplerTypes), a->GetName(), screenManager()));
+	resamplerType->SetEnabledPtr(&g_Config.bEnableSound);
 
 	audioSettings->Add(new ItemHeader(a->T("Audio hacks")));
 	audioSettings->Add(new CheckBox(&g_Config.bSoundSpeedHack, a->T("Sound speed hack (DOA etc.)")));
@@ -649,6 +666,7 @@ void GameSettingsScreen::CreateViews() {
 	lockedMhz->SetZeroLabel(sy->T("Auto"));
 	PopupSliderChoice *rewindFreq = systemSettings->Add(new PopupSliderChoice(&g_Config.iRewindFlipFrequency, 0, 1800, sy->T("Rewind Snapshot Frequency", "Rewind Snapshot Frequency (mem hog)"), screenManager(), sy->T("frames, 0:off")));
 	rewindFreq->SetZeroLabel(sy->T("Off"));
+	systemSettings->Add(new PopupSliderChoice(&g_Config.iRewindBudgetMB, 16, 2048, sy->T("Rewind Memory Budget"), 16, screenManager(), sy->T("MB")));
 
 	systemSettings->Add(new CheckBox(&g_Config.bMemStickInserted, sy->T("Memory Stick inserted")));
 
@@ -1197,7 +1215,7 @@ void DeveloperToolsScreen::CreateViews() {
 	// iOS can now use JIT on all modes, apparently.
 	// The bool may come in handy for future non-jit platforms though (UWP XB1?)
 
-	static const char *cpuCores[] = { "Interpreter", "Dynarec (JIT)", "IR Interpreter" };
+	static const char *cpuCores[] = { "Interpreter", "Dynarec (JIT)", "IR Interpreter", "IR Native" };
 	PopupMultiChoice *core = list->Add(new PopupMultiChoice(&g_Config.iCpuCore, gr->T("CPU Core"), cpuCores, 0, ARRAY_SIZE(cpuCores), sy->GetName(), screenManager()));
 	core->OnChoice.Handle(this, &DeveloperToolsScreen::OnJitAffectingSetting);
 	if (!canUseJit) {
@@ -62,6 +62,8 @@ class ThreadPool {
 	// leading to the stopping and joining of all worker threads (RAII and all that)
 
 	void ParallelLoop(const std::function<void(int,int)> &loop, int lower, int upper);
+	// Same, but if another loop is running, returns false right away without doing anything.
+	bool TryParallelLoop(const std::function<void(int,int)> &loop, int lower, int upper);
 
 private:
 	int numThreads_;
@@ -70,6 +72,8 @@ class ThreadPool {
 
 	bool workersStarted;
 	void StartWorkers();
+	// Must hold mutex.
+	void RunLoop(const std::function<void(int,int)> &loop, int lower, int upper);
 	
 	ThreadPool(const ThreadPool& other); // prevent copies
 	void operator =(const ThreadPool &other);
@@ -17,6 +17,8 @@
 #include "Core/HLE/sceUtility.h"
 #include "Core/Host.h"
 #include "Core/SaveState.h"
+#include "Core/MIPS/JitCommon/JitCommon.h"
+#include "Core/MIPS/JitCommon/JitBlockCache.h"
 #include "Log.h"
 #include "LogManager.h"
 #include "base/NativeApp.h"
@@ -97,6 +99,7 @@ int printUsage(const char *progname, const char *reason)
 		fprintf(stderr, "  --graphics=BACKEND    use the full gpu backend (slower)\n");
 		fprintf(stderr, "                        options: gles, software, directx9, etc.\n");
 		fprintf(stderr, "  --screenshot=FILE     compare against a screenshot\n");
+		fprintf(stderr, "  --list-thread         run display lists on a separate thread (software only)\n");
 	}
 #endif
 	fprintf(stderr, "  --timeout=SECONDS     abort test it if takes longer than SECONDS\n");
@@ -104,13 +107,18 @@ int printUsage(const char *progname, const char *reason)
 	fprintf(stderr, "  -v, --verbose         show the full passed/failed result\n");
 	fprintf(stderr, "  -i                    use the interpreter\n");
 	fprintf(stderr, "  --ir                  use ir interpreter\n");
+	fprintf(stderr, "  --irnative            use ir compiled to native code\n");
 	fprintf(stderr, "  -j                    use jit (default)\n");
 	fprintf(stderr, "  -c, --compare         compare with output in file.expected\n");
+	fprintf(stderr, "  --profile-blocks[=N]  list the N hottest jit blocks at exit (default 50)\n");
 	fprintf(stderr, "\nSee headless.txt for details.\n");
 
 	return 1;
 }
 
+// How many blocks to list in the hot block report, or 0 for none.
+static int hotBlockReportSize = 0;
+
 static HeadlessHost *getHost(GPUCore gpuCore) {
 	switch (gpuCore) {
 	case GPUCORE_NULL:
@@ -191,6 +199,10 @@ bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, bool
 	if (coreParameter.thin3d)
 		coreParameter.thin3d->EndFrame();
 
+	if (hotBlockReportSize > 0 && MIPSComp::jit) {
+		printf("Hot blocks:\n%s", GetHotBlockReport(MIPSComp::jit->GetBlockCacheDebugInterface(), hotBlockReportSize).c_str());
+	}
+
 	PSP_Shutdown();
 
 	headlessHost->FlushDebugOutput();
@@ -220,6 +232,7 @@ int main(int argc, const char* argv[])
 	bool fullLog = false;
 	bool autoCompare = false;
 	bool verbose = false;
+	bool listThread = false;
 	const char *stateToLoad = 0;
 	GPUCore gpuCore = GPUCORE_NULL;
 	CPUCore cpuCore = CPUCore::JIT;
@@ -252,6 +265,8 @@ int main(int argc, const char* argv[])
 			cpuCore = CPUCore::JIT;
 		else if (!strcmp(argv[i], "--ir"))
 			cpuCore = CPUCore::IR_JIT;
+		else if (!strcmp(argv[i], "--irnative"))
+			cpuCore = CPUCore::IR_NATIVE;
 		else if (!strcmp(argv[i], "-c") || !strcmp(argv[i], "--compare"))
 			autoCompare = true;
 		else if (!strcmp(argv[i], "-v") || !strcmp(argv[i], "--verbose"))
@@ -281,8 +296,14 @@ int main(int argc, const char* argv[])
 			screenshotFilename = argv[i] + strlen("--screenshot=");
 		else if (!strncmp(argv[i], "--timeout=", strlen("--timeout=")) && strlen(argv[i]) > strlen("--timeout="))
 			timeout = strtod(argv[i] + strlen("--timeout="), NULL);
+		else if (!strcmp(argv[i], "--list-thread"))
+			listThread = true;
 		else if (!strcmp(argv[i], "--teamcity"))
 			teamCityMode = true;
+		else if (!strcmp(argv[i], "--profile-blocks"))
+			hotBlockReportSize = 50;
+		else if (!strncmp(argv[i], "--profile-blocks=", strlen("--profile-blocks=")) && strlen(argv[i]) > strlen("--profile-blocks="))
+			hotBlockReportSize = atoi(argv[i] + strlen("--profile-blocks="));
 		else if (!strncmp(argv[i], "--state=", strlen("--state=")) && strlen(argv[i]) > strlen("--state="))
 			stateToLoad = argv[i] + strlen("--state=");
 		else if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h"))
@@ -371,8 +392,10 @@ int main(int argc, const char* argv[])
 	g_Config.iNumWorkerThreads = 1;
 	g_Config.bVertexDecoderJit = true;
 	g_Config.bBlockTransferGPU = true;
+	g_Config.bDisplayListThread = listThread;
 	g_Config.iSplineBezierQuality = 2;
 	g_Config.bHighQualityDepth = true;
+	g_Config.bJitBlockProfiling = hotBlockReportSize > 0;
 
 #ifdef _WIN32
 	InitSysDirectories();
@@ -19,12 +19,17 @@
 
 #include "base/timeutil.h"
 #include "base/NativeApp.h"
+#include "Common/ExceptionHandlerSetup.h"
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "Core/MIPS/JitCommon/JitBlockCache.h"
 #include "Core/MIPS/MIPSCodeUtils.h"
 #include "Core/MIPS/MIPSDebugInterface.h"
 #include "Core/MIPS/MIPSAsm.h"
 #include "Core/MIPS/MIPSTables.h"
+#include "Core/MIPS/IR/IRInst.h"
+#include "Core/MIPS/IR/IRInterpreter.h"
+#include "Core/Config.h"
+#include "Core/MemFault.h"
 #include "Core/MemMap.h"
 #include "Core/Core.h"
 #include "Core/CoreTiming.h"
@@ -83,6 +88,7 @@ static void SetupJitHarness() {
 	PSP_CoreParameter().unthrottle = true;
 
 	Memory::Init();
+	InstallExceptionHandler(&Memory::HandleFault);
 	mipsr4k.Reset();
 	CoreTiming::Init();
 }
@@ -92,6 +98,7 @@ static void DestroyJitHarness() {
 	HLEShutdown();
 	CoreTiming::Shutdown();
 	mipsr4k.Shutdown();
+	UninstallExceptionHandler();
 	Memory::Shutdown();
 	coreState = CORE_POWERDOWN;
 	currentMIPS = nullptr;
@@ -194,3 +201,481 @@ bool TestJit() {
 
 	return jit_speed >= interp_speed;
 }
+
+typedef u32 (*IRInterpretFunc)(MIPSState *mips, const IRInst *inst, int count);
+
+static double ExecIRTest(IRInterpretFunc func, const std::vector<IRInst> &insts) {
+	int total = 0;
+	double st = real_time_now();
+	do {
+		for (int j = 0; j < 10000; ++j) {
+			currentMIPS->r[MIPS_REG_A0] = j;
+			func(currentMIPS, &insts[0], (int)insts.size());
+			++total;
+		}
+	} while (real_time_now() - st < 0.5);
+	double elapsed = real_time_now() - st;
+
+	return total / elapsed;
+}
+
+bool TestIRDispatch() {
+	SetupJitHarness();
+
+	// A typical mix of integer ops, as the frontend would generate them.
+	std::vector<IRInst> insts;
+	auto add = [&](IROp op, u8 dest, u8 src1, u8 src2, u32 constant) {
+		IRInst inst;
+		inst.op = op;
+		inst.dest = dest;
+		inst.src1 = src1;
+		inst.src2 = src2;
+		inst.constant = constant;
+		insts.push_back(inst);
+	};
+	for (int i = 0; i < 20; ++i) {
+		add(IROp::AddConst, MIPS_REG_T0, MIPS_REG_A0, 0, 0x1234 + i);
+		add(IROp::Xor, MIPS_REG_T1, MIPS_REG_T0, MIPS_REG_T1, 0);
+		add(IROp::ShlImm, MIPS_REG_T2, MIPS_REG_T1, 3, 0);
+		add(IROp::Sub, MIPS_REG_T3, MIPS_REG_T2, MIPS_REG_T0, 0);
+		add(IROp::SltU, MIPS_REG_T4, MIPS_REG_T3, MIPS_REG_T1, 0);
+		add(IROp::MovZ, MIPS_REG_T5, MIPS_REG_T4, MIPS_REG_T3, 0);
+		add(IROp::Mov, MIPS_REG_T6, MIPS_REG_T5, 0, 0);
+		add(IROp::OrConst, MIPS_REG_T7, MIPS_REG_T6, 0, 0x8000);
+	}
+	add(IROp::Downcount, 0, 0, 0, 100);
+	add(IROp::ExitToConstIfEq, MIPS_REG_ZERO, MIPS_REG_T7, MIPS_REG_ZERO, 0x08804000);
+	add(IROp::ExitToConst, 0, 0, 0, 0x08804100);
+
+	// First make sure both produce the same results.
+	u32 switchRegs[32];
+	memset(currentMIPS->r, 0, sizeof(currentMIPS->r));
+	currentMIPS->r[MIPS_REG_A0] = 0x1337;
+	u32 switchPC = IRInterpretSwitch(currentMIPS, &insts[0], (int)insts.size());
+	memcpy(switchRegs, currentMIPS->r, sizeof(switchRegs));
+
+	memset(currentMIPS->r, 0, sizeof(currentMIPS->r));
+	currentMIPS->r[MIPS_REG_A0] = 0x1337;
+	u32 threadedPC = IRInterpret(currentMIPS, &insts[0], (int)insts.size());
+
+	bool success = switchPC == threadedPC;
+	for (int i = 0; i < 32; ++i) {
+		if (switchRegs[i] != currentMIPS->r[i]) {
+			printf("Mismatch in r%d: %08x vs %08x\n", i, switchRegs[i], currentMIPS->r[i]);
+			success = false;
+		}
+	}
+
+	if (success) {
+		double switchSpeed = ExecIRTest(&IRInterpretSwitch, insts);
+		double threadedSpeed = ExecIRTest(&IRInterpret, insts);
+		printf("IR switch dispatch: %0.0f blocks/s, threaded: %0.0f blocks/s (%0.2fx)\n", switchSpeed, threadedSpeed, threadedSpeed / switchSpeed);
+	}
+
+	DestroyJitHarness();
+	return success;
+}
+
+static void RunCPUTestOnce(u32 *regs) {
+	memset(currentMIPS->r, 0, sizeof(currentMIPS->r));
+	currentMIPS->r[MIPS_REG_A0] = 0x1337;
+	currentMIPS->lo = 0;
+	currentMIPS->hi = 0;
+	currentMIPS->pc = PSP_GetUserMemoryBase();
+	coreState = CORE_RUNNING;
+	while (coreState == CORE_RUNNING) {
+		mipsr4k.RunLoopUntil(1000000);
+	}
+	memcpy(regs, currentMIPS->r, sizeof(currentMIPS->r));
+	regs[32] = currentMIPS->lo;
+	regs[33] = currentMIPS->hi;
+}
+
+bool TestIRNative() {
+	SetupJitHarness();
+
+	currentMIPS->pc = PSP_GetUserMemoryBase();
+	u32 *p = (u32 *)Memory::GetPointer(currentMIPS->pc);
+
+	// Integer and scalar FPU ops, which the native IR backend handles without the interpreter.
+	static const char *lines[] = {
+		"lui r9, 0x0890",
+		"addiu r5, r4, 0x1234",
+		"xor r6, r5, r6",
+		"sll r7, r6, 3",
+		"subu r8, r7, r5",
+		"sltu r10, r8, r6",
+		"or r11, r10, r8",
+		"sw r11, 0(r9)",
+		"lbu r12, 1(r9)",
+		"mult r12, r11",
+		"mflo r13",
+		"addu r4, r4, r13",
+		// Only from GPRs, the FPRs aren't reset between runs.
+		"mtc1 r5, f1",
+		"cvt.s.w f2, f1",
+		"add.s f3, f2, f2",
+		"mul.s f4, f3, f2",
+		"neg.s f5, f4",
+		"swc1 f5, 4(r9)",
+		"lwc1 f6, 4(r9)",
+		"mfc1 r14, f6",
+		"addu r4, r4, r14",
+	};
+
+	bool success = true;
+	u32 addr = currentMIPS->pc;
+	for (int i = 0; i < 50; ++i) {
+		for (size_t j = 0; j < ARRAY_SIZE(lines); ++j) {
+			p++;
+			if (!MIPSAsm::MipsAssembleOpcode(lines[j], currentDebugMIPS, addr)) {
+				printf("ERROR: %ls\n", MIPSAsm::GetAssembleError().c_str());
+				success = false;
+			}
+			addr += 4;
+		}
+	}
+
+	*p++ = MIPS_MAKE_SYSCALL("UnitTestFakeSyscalls", "UnitTestTerminator");
+	*p++ = MIPS_MAKE_BREAK(1);
+
+	if (success) {
+		u32 jitRegs[34], nativeRegs[34];
+		mipsr4k.UpdateCore(CPUCore::JIT);
+		RunCPUTestOnce(jitRegs);
+		mipsr4k.UpdateCore(CPUCore::IR_NATIVE);
+		RunCPUTestOnce(nativeRegs);
+
+		for (int i = 0; i < 34; ++i) {
+			if (jitRegs[i] != nativeRegs[i]) {
+				printf("Mismatch in reg %d: jit %08x vs IR native %08x\n", i, jitRegs[i], nativeRegs[i]);
+				success = false;
+			}
+		}
+	}
+
+	if (success) {
+		mipsr4k.UpdateCore(CPUCore::IR_JIT);
+		double irSpeed = ExecCPUTest();
+		mipsr4k.UpdateCore(CPUCore::IR_NATIVE);
+		double nativeSpeed = ExecCPUTest();
+		mipsr4k.UpdateCore(CPUCore::JIT);
+		double jitSpeed = ExecCPUTest();
+		printf("IR native was %0.2fx the speed of the IR interpreter, %0.2fx the speed of the jit.\n", nativeSpeed / irSpeed, nativeSpeed / jitSpeed);
+	}
+
+	DestroyJitHarness();
+	return success;
+}
+
+bool TestIRTrace() {
+	SetupJitHarness();
+
+	u32 base = PSP_GetUserMemoryBase();
+	u32 *p = (u32 *)Memory::GetPointer(base);
+
+	// A chain of small blocks, each jumping over a word to the next one.
+	const int numBlocks = 6;
+	for (int i = 0; i < numBlocks; ++i) {
+		u32 next = base + (i + 1) * 20;
+		*p++ = MIPS_MAKE_ADDIU(MIPS_REG_T0 + i, MIPS_REG_A0, i * 3);
+		*p++ = MIPS_MAKE_ADDIU(MIPS_REG_A0, MIPS_REG_A0, 1);
+		*p++ = MIPS_MAKE_J(next);
+		*p++ = MIPS_MAKE_NOP();
+		*p++ = MIPS_MAKE_BREAK(1);
+	}
+	*p++ = MIPS_MAKE_SYSCALL("UnitTestFakeSyscalls", "UnitTestTerminator");
+	*p++ = MIPS_MAKE_BREAK(1);
+
+	mipsr4k.UpdateCore(CPUCore::IR_JIT);
+	u32 beforeRegs[34], afterRegs[34];
+	RunCPUTestOnce(beforeRegs);
+
+	JitBlockCacheDebugInterface *blocks = MIPSComp::jit->GetBlockCacheDebugInterface();
+	int blockNum = blocks->GetBlockNumberFromStartAddress(base);
+	size_t beforeSize = blockNum >= 0 ? blocks->GetBlockDebugInfo(blockNum).origDisasm.size() : 0;
+
+	// Run enough to make the chain hot.
+	double speed = ExecCPUTest();
+	RunCPUTestOnce(afterRegs);
+
+	blockNum = blocks->GetBlockNumberFromStartAddress(base);
+	JitBlockDebugInfo info = blocks->GetBlockDebugInfo(blockNum);
+	bool success = info.origDisasm.size() > beforeSize;
+	if (!success) {
+		printf("Trace was not formed at %08x (%d MIPS instructions)\n", base, (int)info.origDisasm.size());
+	}
+	for (int i = 0; i < 34; ++i) {
+		if (beforeRegs[i] != afterRegs[i]) {
+			printf("Mismatch in reg %d: block %08x vs trace %08x\n", i, beforeRegs[i], afterRegs[i]);
+			success = false;
+		}
+	}
+	printf("Trace at %08x covers %d MIPS instructions in %d IR instructions, %0.0f runs/s\n", base, (int)info.origDisasm.size(), (int)info.irDisasm.size(), speed);
+
+	// Now a loop entered in the middle, so the hot block jumps backward to the rest of it.
+	MIPSComp::jit->ClearCache();
+	const u32 low = base + 0x10;
+	const u32 high = base + 0x40;
+	p = (u32 *)Memory::GetPointer(base);
+	*p++ = MIPS_MAKE_ADDIU(MIPS_REG_T0, MIPS_REG_ZERO, 50);
+	*p++ = MIPS_MAKE_J(high);
+	*p++ = MIPS_MAKE_NOP();
+	*p++ = MIPS_MAKE_BREAK(1);
+	// low:
+	*p++ = MIPS_MAKE_ADDIU(MIPS_REG_T1, MIPS_REG_T1, 3);
+	*p++ = MIPS_MAKE_ADDIU(MIPS_REG_T0, MIPS_REG_T0, 0xFFFF);
+	// bgtz t0, high
+	*p++ = 0x1C000000 | (MIPS_REG_T0 << 21) | (((high - (low + 12)) >> 2) & 0xFFFF);
+	*p++ = MIPS_MAKE_NOP();
+	*p++ = MIPS_MAKE_SYSCALL("UnitTestFakeSyscalls", "UnitTestTerminator");
+	*p++ = MIPS_MAKE_BREAK(1);
+	while (p < (u32 *)Memory::GetPointer(high))
+		*p++ = MIPS_MAKE_BREAK(1);
+	// high:
+	*p++ = MIPS_MAKE_ADDIU(MIPS_REG_A0, MIPS_REG_A0, 1);
+	*p++ = MIPS_MAKE_ADDIU(MIPS_REG_T2, MIPS_REG_A0, 5);
+	*p++ = MIPS_MAKE_J(low);
+	*p++ = MIPS_MAKE_NOP();
+
+	RunCPUTestOnce(beforeRegs);
+	blockNum = blocks->GetBlockNumberFromStartAddress(high);
+	beforeSize = blockNum >= 0 ? blocks->GetBlockDebugInfo(blockNum).irDisasm.size() : 0;
+	speed = ExecCPUTest();
+	RunCPUTestOnce(afterRegs);
+
+	blockNum = blocks->GetBlockNumberFromStartAddress(high);
+	size_t afterSize = blockNum >= 0 ? blocks->GetBlockDebugInfo(blockNum).irDisasm.size() : 0;
+	if (afterSize <= beforeSize) {
+		printf("Backward trace was not formed at %08x (%d IR instructions)\n", high, (int)afterSize);
+		success = false;
+	}
+	for (int i = 0; i < 34; ++i) {
+		if (beforeRegs[i] != afterRegs[i]) {
+			printf("Mismatch in reg %d: block %08x vs backward trace %08x\n", i, beforeRegs[i], afterRegs[i]);
+			success = false;
+		}
+	}
+	// The trace covers the code before its entry, so changing that has to drop it.
+	MIPSComp::jit->InvalidateCacheAt(low + 4, 4);
+	if (blocks->GetBlockNumberFromStartAddress(high) >= 0) {
+		printf("Backward trace at %08x survived invalidating %08x\n", high, low + 4);
+		success = false;
+	}
+	printf("Backward trace at %08x has %d IR instructions, %0.0f runs/s\n", high, (int)afterSize, speed);
+
+	DestroyJitHarness();
+	return success;
+}
+
+bool TestIRChaining() {
+	SetupJitHarness();
+
+	u32 base = PSP_GetUserMemoryBase();
+	u32 *p = (u32 *)Memory::GetPointer(base);
+
+	// A loop over two blocks, so their exits get linked to each other.
+	*p++ = MIPS_MAKE_ADDIU(MIPS_REG_T2, MIPS_REG_ZERO, 100);
+	*p++ = MIPS_MAKE_J(base + 0x10);
+	*p++ = MIPS_MAKE_NOP();
+	*p++ = MIPS_MAKE_BREAK(1);
+	// base + 0x10:
+	*p++ = MIPS_MAKE_ADDIU(MIPS_REG_T0, MIPS_REG_T0, 1);
+	*p++ = MIPS_MAKE_J(base + 0x20);
+	*p++ = MIPS_MAKE_NOP();
+	*p++ = MIPS_MAKE_BREAK(1);
+	// base + 0x20:
+	u32 *second = p;
+	*p++ = MIPS_MAKE_ADDIU(MIPS_REG_T1, MIPS_REG_T1, 2);
+	*p++ = MIPS_MAKE_ADDIU(MIPS_REG_T2, MIPS_REG_T2, 0xFFFF);
+	// bgtz t2, base + 0x10
+	*p++ = 0x1C000000 | (MIPS_REG_T2 << 21) | 0xFFF9;
+	*p++ = MIPS_MAKE_NOP();
+	*p++ = MIPS_MAKE_SYSCALL("UnitTestFakeSyscalls", "UnitTestTerminator");
+	*p++ = MIPS_MAKE_BREAK(1);
+
+	mipsr4k.UpdateCore(CPUCore::IR_JIT);
+	u32 regs[34];
+	RunCPUTestOnce(regs);
+	bool success = true;
+	if (regs[MIPS_REG_T0] != 100 || regs[MIPS_REG_T1] != 200) {
+		printf("Linked loop gave t0=%d t1=%d, expected 100 and 200\n", regs[MIPS_REG_T0], regs[MIPS_REG_T1]);
+		success = false;
+	}
+
+	// The first block is linked to the second, so invalidating it must undo that.
+	*second = MIPS_MAKE_ADDIU(MIPS_REG_T1, MIPS_REG_T1, 3);
+	MIPSComp::jit->InvalidateCacheAt(base + 0x20, 4);
+	RunCPUTestOnce(regs);
+	if (regs[MIPS_REG_T0] != 100 || regs[MIPS_REG_T1] != 300) {
+		printf("After invalidating, loop gave t0=%d t1=%d, expected 100 and 300\n", regs[MIPS_REG_T0], regs[MIPS_REG_T1]);
+		success = false;
+	}
+
+	DestroyJitHarness();
+	return success;
+}
+
+bool TestJitInvalidate() {
+	SetupJitHarness();
+
+	u32 base = PSP_GetUserMemoryBase();
+	u32 *p = (u32 *)Memory::GetPointer(base);
+
+	// Lots of small blocks, spanning several pages, like a loaded overlay.
+	const int numBlocks = 2048;
+	for (int i = 0; i < numBlocks; ++i) {
+		u32 next = base + (i + 1) * 20;
+		*p++ = MIPS_MAKE_ADDIU(MIPS_REG_T0 + (i & 7), MIPS_REG_A0, i);
+		*p++ = MIPS_MAKE_ADDIU(MIPS_REG_A0, MIPS_REG_A0, 1);
+		*p++ = MIPS_MAKE_J(next);
+		*p++ = MIPS_MAKE_NOP();
+		*p++ = MIPS_MAKE_BREAK(1);
+	}
+	*p++ = MIPS_MAKE_SYSCALL("UnitTestFakeSyscalls", "UnitTestTerminator");
+	*p++ = MIPS_MAKE_BREAK(1);
+
+	mipsr4k.UpdateCore(CPUCore::JIT);
+	u32 beforeRegs[34], afterRegs[34];
+	RunCPUTestOnce(beforeRegs);
+
+	JitBlockCacheDebugInterface *blocks = MIPSComp::jit->GetBlockCacheDebugInterface();
+	bool success = true;
+	for (int i = 0; i < numBlocks; ++i) {
+		if (blocks->GetBlockNumberFromStartAddress(base + i * 20) < 0) {
+			printf("Block %d at %08x was not compiled\n", i, base + i * 20);
+			success = false;
+			break;
+		}
+	}
+
+	// Most invalidations (DMA, file reads into memory) hit data, not code.
+	const u32 dataBase = base + 0x00100000;
+	const int numDataInvalidations = 200000;
+	double st = real_time_now();
+	for (int i = 0; i < numDataInvalidations; ++i) {
+		MIPSComp::jit->InvalidateCacheAt(dataBase + ((i * 256) & 0x003FFFFF), 256);
+	}
+	double dataTime = real_time_now() - st;
+
+	// Now hit every fourth block, by its second instruction.
+	st = real_time_now();
+	for (int i = 0; i < numBlocks; i += 4) {
+		MIPSComp::jit->InvalidateCacheAt(base + i * 20 + 4, 4);
+	}
+	double codeTime = real_time_now() - st;
+
+	for (int i = 0; i < numBlocks; ++i) {
+		bool valid = blocks->GetBlockNumberFromStartAddress(base + i * 20) >= 0;
+		if (valid != ((i & 3) != 0)) {
+			printf("Block %d at %08x should %s\n", i, base + i * 20, valid ? "be invalid" : "still be valid");
+			success = false;
+			break;
+		}
+	}
+
+	// Recompiling must give the same results.
+	RunCPUTestOnce(afterRegs);
+	for (int i = 0; i < 34; ++i) {
+		if (beforeRegs[i] != afterRegs[i]) {
+			printf("Mismatch in reg %d: %08x vs %08x after invalidation\n", i, beforeRegs[i], afterRegs[i]);
+			success = false;
+		}
+	}
+
+	printf("Invalidation: %0.0f data ranges/s, %0.0f code ranges/s\n", numDataInvalidations / dataTime, (numBlocks / 4) / codeTime);
+
+	DestroyJitHarness();
+	return success;
+}
+
+bool TestJitFastmem() {
+	SetupJitHarness();
+
+	// Otherwise the interpreter would stop at the first bad access.
+	bool oldIgnoreBadMemAccess = g_Config.bIgnoreBadMemAccess;
+	g_Config.bIgnoreBadMemAccess = true;
+
+	u32 base = PSP_GetUserMemoryBase();
+	u32 *p = (u32 *)Memory::GetPointer(base);
+
+	// r9 is valid RAM, r10 and r11 point at unmapped memory.
+	static const char *lines[] = {
+		"lui r9, 0x0890",
+		"lui r10, 0x1234",
+		"addiu r11, r0, 0x100",
+		"addiu r4, r4, 0x1111",
+		"sw r4, 0(r9)",
+		"sw r4, 4(r10)",
+		"sh r4, 8(r11)",
+		"sb r4, 12(r10)",
+		"sw r0, 16(r10)",
+		"lw r12, 0(r9)",
+		"lw r13, 4(r10)",
+		"lh r14, 0(r9)",
+		"lh r15, 8(r11)",
+		"lb r16, 1(r9)",
+		"lbu r17, 12(r10)",
+		"lbu r18, 0(r9)",
+		// The same accesses alternate between valid and invalid, so they fault after running fast.
+		"addiu r19, r0, 8",
+		"or r21, r9, r0",
+		"xor r22, r9, r10",
+		"lw r23, 0(r21)",
+		"addu r24, r24, r23",
+		"sh r24, 2(r21)",
+		"lb r25, 3(r21)",
+		"addu r24, r24, r25",
+		"xor r21, r21, r22",
+		"addiu r19, r19, -1",
+	};
+	const u32 loopStart = base + 19 * 4;
+
+	bool success = true;
+	u32 addr = base;
+	for (size_t j = 0; j < ARRAY_SIZE(lines); ++j) {
+		p++;
+		if (!MIPSAsm::MipsAssembleOpcode(lines[j], currentDebugMIPS, addr)) {
+			printf("ERROR: %ls\n", MIPSAsm::GetAssembleError().c_str());
+			success = false;
+		}
+		addr += 4;
+	}
+	char branch[64];
+	snprintf(branch, sizeof(branch), "bne r19, r0, 0x%08x", loopStart);
+	p++;
+	if (!MIPSAsm::MipsAssembleOpcode(branch, currentDebugMIPS, addr)) {
+		printf("ERROR: %ls\n", MIPSAsm::GetAssembleError().c_str());
+		success = false;
+	}
+	*p++ = MIPS_MAKE_NOP();
+	*p++ = MIPS_MAKE_SYSCALL("UnitTestFakeSyscalls", "UnitTestTerminator");
+	*p++ = MIPS_MAKE_BREAK(1);
+
+	if (success) {
+		u32 interpRegs[34], jitRegs[34];
+		u8 *data = Memory::GetPointer(0x08900000);
+
+		memset(data, 0, 16);
+		mipsr4k.UpdateCore(CPUCore::INTERPRETER);
+		RunCPUTestOnce(interpRegs);
+
+		// Twice, the second time through the already patched accesses.
+		mipsr4k.UpdateCore(CPUCore::JIT);
+		for (int run = 0; run < 2; ++run) {
+			memset(data, 0, 16);
+			RunCPUTestOnce(jitRegs);
+
+			for (int i = 0; i < 34; ++i) {
+				if (interpRegs[i] != jitRegs[i]) {
+					printf("Mismatch in reg %d (run %d): interp %08x vs jit %08x\n", i, run, interpRegs[i], jitRegs[i]);
+					success = false;
+				}
+			}
+		}
+	}
+
+	g_Config.bIgnoreBadMemAccess = oldIgnoreBadMemAccess;
+	DestroyJitHarness();
+	return success;
+}
@@ -18,3 +18,9 @@
 #pragma once
 
 bool TestJit();
+bool TestIRDispatch();
+bool TestIRNative();
+bool TestIRTrace();
+bool TestIRChaining();
+bool TestJitInvalidate();
+bool TestJitFastmem();
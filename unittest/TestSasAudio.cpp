@@ -0,0 +1,227 @@
+// Copyright (c) 2017- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Common/ThreadPools.h"
+#include "Core/Config.h"
+#include "Core/HW/SasAudio.h"
+#include "Core/MemMap.h"
+#include "Core/Util/AudioFormat.h"
+#include "unittest/TestSasAudio.h"
+#include "unittest/UnitTest.h"
+
+static const u32 VAG_ADDR = 0x08900000;
+static const u32 OUT_ADDR = 0x08A00000;
+
+// Random blocks, looping from the first block back from the last.
+static void WriteSyntheticVag(u32 addr, int numBlocks, bool allFilters) {
+	u8 *p = Memory::GetPointer(addr);
+	for (int b = 0; b < numBlocks; ++b) {
+		int filter = allFilters ? rand() & 15 : rand() % 5;
+		int shift = rand() % 13;
+		p[0] = (filter << 4) | shift;
+		p[1] = b == 0 ? 6 : (b == numBlocks - 1 ? 3 : 0);
+		for (int i = 2; i < 16; ++i) {
+			p[i] = rand() & 0xFF;
+		}
+		p += 16;
+	}
+}
+
+// The straightforward decoder, to check the real one against.
+static void ReferenceDecodeVag(const u8 *p, int numBlocks, std::vector<s16> &out) {
+	static const int coefs[16][2] = {
+		{ 0, 0 }, { 60, 0 }, { 115, 52 }, { 98, 55 }, { 122, 60 }, { 0, 0 }, { 0, 0 }, { 52, 0 },
+		{ 55, 2 }, { 60, 125 }, { 0, 0 }, { 0, 91 }, { 0, 0 }, { 2, 216 }, { 125, 6 }, { 0, 151 },
+	};
+	int s1 = 0, s2 = 0;
+	for (int b = 0; b < numBlocks; ++b, p += 16) {
+		int filter = p[0] >> 4;
+		int shift = p[0] & 15;
+		for (int i = 0; i < 28; ++i) {
+			int nibble = (p[2 + i / 2] >> ((i & 1) * 4)) & 15;
+			int sample = (short)(nibble << 12) >> shift;
+			int s = clamp_s16(sample + ((s1 * coefs[filter][0] - s2 * coefs[filter][1]) >> 6));
+			s2 = s1;
+			s1 = s;
+			out.push_back(s);
+		}
+	}
+}
+
+static bool TestVagDecode() {
+	const int numBlocks = 2000;
+	WriteSyntheticVag(VAG_ADDR, numBlocks, true);
+
+	std::vector<s16> expected;
+	ReferenceDecodeVag(Memory::GetPointer(VAG_ADDR), numBlocks, expected);
+
+	VagDecoder vag;
+	// Not looping, so the loop flags don't matter.
+	vag.Start(VAG_ADDR, numBlocks * 16, false);
+	std::vector<s16> decoded(expected.size());
+	// Odd sizes, so reads don't line up with blocks.
+	for (size_t pos = 0; pos < decoded.size(); ) {
+		int count = std::min((int)(decoded.size() - pos), 1 + rand() % 97);
+		vag.GetSamples(&decoded[pos], count);
+		pos += count;
+	}
+
+	for (size_t i = 0; i < expected.size(); ++i) {
+		if (decoded[i] != expected[i]) {
+			printf("VAG sample %d (block %d): %d, expected %d\n", (int)i, (int)i / 28, decoded[i], expected[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+static void SetupVoices(SasInstance *sas, int numBlocks) {
+	for (int v = 0; v < PSP_SAS_VOICES_MAX; ++v) {
+		SasVoice &voice = sas->voices[v];
+		voice.type = VOICETYPE_VAG;
+		voice.vagAddr = VAG_ADDR;
+		voice.vagSize = numBlocks * 16;
+		voice.loop = true;
+		// A spread of pitches around the native rate.
+		voice.pitch = PSP_SAS_PITCH_BASE / 2 + v * 0x80;
+		voice.volumeLeft = PSP_SAS_VOL_MAX - v * 0x40;
+		voice.volumeRight = v * 0x40;
+		voice.effectLeft = v & 1 ? 0x400 : 0;
+		voice.effectRight = v & 1 ? 0x400 : 0;
+		// Fast attack, then sustain at full height.
+		voice.envelope.SetSimpleEnvelope(0x000F, 0x1FC0);
+		voice.KeyOn();
+	}
+}
+
+static double BenchmarkMix(SasInstance *sas) {
+	int grains = 0;
+	double st = real_time_now();
+	do {
+		for (int j = 0; j < 100; ++j) {
+			sas->Mix(OUT_ADDR);
+		}
+		grains += 100;
+	} while (real_time_now() - st < 0.5);
+	return grains / (real_time_now() - st);
+}
+
+// What it costs to hand an empty loop to the pool and wait for it, in seconds.
+static double BenchmarkPoolWake(int slices) {
+	int loops = 0;
+	double st = real_time_now();
+	do {
+		for (int j = 0; j < 100; ++j) {
+			GlobalThreadPool::Loop([](int lower, int upper) {}, 0, slices);
+		}
+		loops += 100;
+	} while (real_time_now() - st < 0.5);
+	return (real_time_now() - st) / loops;
+}
+
+bool TestSasMixer() {
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	const int oldThreads = g_Config.iNumWorkerThreads;
+
+	bool success = TestVagDecode();
+
+	const int numBlocks = 512;
+	const int grainSize = 256;
+	WriteSyntheticVag(VAG_ADDR, numBlocks, false);
+
+	// Serially, then split across workers, then with the pool busy with something else.
+	// The output has to be identical.
+	const int workers = std::max(oldThreads, 4);
+	std::vector<s16> results[3];
+	double speeds[3];
+	for (int pass = 0; pass < 3; ++pass) {
+		g_Config.iNumWorkerThreads = pass == 0 ? 1 : workers;
+
+		std::atomic<bool> poolBusy(false);
+		std::atomic<bool> releasePool(false);
+		std::thread poolUser;
+		if (pass == 2) {
+			poolUser = std::thread([&] {
+				GlobalThreadPool::Loop([&](int lower, int upper) {
+					poolBusy = true;
+					while (!releasePool)
+						std::this_thread::yield();
+				}, 0, workers * 2);
+			});
+			while (!poolBusy)
+				std::this_thread::yield();
+		}
+
+		SasInstance *sas = new SasInstance();
+		sas->SetGrainSize(grainSize);
+		sas->waveformEffect.isWetOn = 1;
+		sas->waveformEffect.leftVol = PSP_SAS_VOL_MAX;
+		sas->waveformEffect.rightVol = PSP_SAS_VOL_MAX;
+		sas->SetWaveformEffectType(PSP_SAS_EFFECT_TYPE_HALL);
+		SetupVoices(sas, numBlocks);
+
+		const s16 *out = (const s16 *)Memory::GetPointer(OUT_ADDR);
+		for (int j = 0; j < 200; ++j) {
+			sas->Mix(OUT_ADDR);
+			results[pass].insert(results[pass].end(), out, out + grainSize * 2);
+		}
+		speeds[pass] = BenchmarkMix(sas);
+
+		int playing = 0;
+		for (int v = 0; v < PSP_SAS_VOICES_MAX; ++v) {
+			if (sas->voices[v].playing)
+				playing++;
+		}
+		if (playing != PSP_SAS_VOICES_MAX) {
+			printf("Only %d voices still playing, looping is broken\n", playing);
+			success = false;
+		}
+		delete sas;
+
+		if (pass == 2) {
+			releasePool = true;
+			poolUser.join();
+		}
+	}
+
+	for (int pass = 1; pass < 3; ++pass) {
+		for (size_t i = 0; i < results[0].size(); ++i) {
+			if (results[0][i] != results[pass][i]) {
+				printf("Parallel SAS output (pass %d) differs at sample %d: %d vs %d\n", pass, (int)i, results[0][i], results[pass][i]);
+				success = false;
+				break;
+			}
+		}
+	}
+
+	printf("SAS mixing %d voices: %0.0f grains/s (%0.1fx realtime), %0.0f grains/s on %d workers, %0.0f grains/s with the pool busy\n", PSP_SAS_VOICES_MAX, speeds[0], speeds[0] * grainSize / 44100.0, speeds[1], workers, speeds[2]);
+	// Only worth using the pool if waking it is a lot cheaper than mixing.
+	printf("SAS pool wake: %0.1f us, mixing one grain serially: %0.1f us\n", BenchmarkPoolWake(workers * 2) * 1000000.0, 1000000.0 / speeds[0]);
+
+	g_Config.iNumWorkerThreads = oldThreads;
+	Memory::Shutdown();
+	return success;
+}
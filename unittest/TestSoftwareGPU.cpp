@@ -0,0 +1,327 @@
+// Copyright (c) 2017- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Core/Config.h"
+#include "GPU/GPUState.h"
+#include "GPU/Software/DrawPixel.h"
+#include "GPU/Software/Rasterizer.h"
+#include "GPU/Software/Sampler.h"
+#include "GPU/Software/SoftGpu.h"
+#include "unittest/TestSoftwareGPU.h"
+#include "unittest/UnitTest.h"
+
+bool TestSoftwareBinning() {
+	const int w = 480;
+	const int h = 272;
+	const int stride = 512;
+	// A fractional offset, so bins don't start on whole screen pixels.
+	const int offset = (2048 << 4) + 8;
+
+	// Overlapping, blended triangles: any change in draw order would show up.
+	// Mostly small ones, with a few covering much of the screen.
+	const int numTriangles = 20000;
+	std::vector<VertexData> verts(numTriangles * 3);
+	u32 seed = 7;
+	auto rand = [&](int range) {
+		seed = seed * 1103515245 + 12345;
+		return (int)((seed >> 8) % range);
+	};
+	for (int i = 0; i < numTriangles; ++i) {
+		const int size = (i % 100) == 0 ? 300 : 4 + rand(28);
+		const int cx = rand(w);
+		const int cy = rand(h);
+		for (int j = 0; j < 3; ++j) {
+			VertexData &v = verts[i * 3 + j];
+			v.screenpos = ScreenCoords((cx + rand(size) - size / 2) * 16 + rand(16) + offset, (cy + rand(size) - size / 2) * 16 + rand(16) + offset, 0);
+			v.color0 = Vec4<int>(rand(256), rand(256), rand(256), rand(256));
+			v.color1 = Vec3<int>(0, 0, 0);
+			v.texturecoords = Vec2<float>(0.0f, 0.0f);
+			v.fogdepth = 1.0f;
+		}
+		const ScreenCoords &a = verts[i * 3].screenpos;
+		const ScreenCoords &b = verts[i * 3 + 1].screenpos;
+		const ScreenCoords &c = verts[i * 3 + 2].screenpos;
+		if ((a.x - b.x) * (a.y - c.y) - (a.y - b.y) * (a.x - c.x) < 0) {
+			std::swap(verts[i * 3 + 1], verts[i * 3 + 2]);
+		}
+	}
+
+	const GPUgstate oldState = gstate;
+	const FormatBuffer oldFb = fb;
+	const int oldThreads = g_Config.iNumWorkerThreads;
+	// Normally done by SoftGPU.
+	Sampler::Init();
+	Rasterizer::Init();
+	memset(&gstate, 0, sizeof(gstate));
+	gstate.framebufpixformat = GE_FORMAT_8888;
+	gstate.fbwidth = stride;
+	gstate.scissor2 = ((h - 1) << 10) | (w - 1);
+	gstate.offsetx = offset;
+	gstate.offsety = offset;
+	gstate.vertType = GE_VTYPE_THROUGH;
+	gstate.shademodel = GE_SHADE_GOURAUD;
+	gstate.alphaBlendEnable = 1;
+	gstate.blend = GE_SRCBLEND_SRCALPHA | (GE_DSTBLEND_INVSRCALPHA << 4);
+
+	std::vector<u32> results[2];
+	double elapsed[2];
+	for (int pass = 0; pass < 2; ++pass) {
+		// One worker draws directly, more bin.
+		g_Config.iNumWorkerThreads = pass == 0 ? 1 : std::max(oldThreads, 2);
+		results[pass].assign(stride * h, 0xFF000000);
+		fb.data = (u8 *)&results[pass][0];
+
+		double st = real_time_now();
+		for (int i = 0; i < numTriangles; ++i) {
+			Rasterizer::DrawTriangle(verts[i * 3], verts[i * 3 + 1], verts[i * 3 + 2]);
+		}
+		Rasterizer::Flush();
+		elapsed[pass] = real_time_now() - st;
+	}
+
+	gstate = oldState;
+	fb = oldFb;
+	g_Config.iNumWorkerThreads = oldThreads;
+	Sampler::Shutdown();
+	Rasterizer::Shutdown();
+
+	printf("Software rasterizer: %0.0f triangles/s direct, %0.0f triangles/s binned\n", numTriangles / elapsed[0], numTriangles / elapsed[1]);
+	EXPECT_TRUE(results[0] == results[1]);
+	return true;
+}
+
+// The scissor is inclusive in drawing coordinates, whatever the offset.
+bool TestSoftwareScissor() {
+	const int w = 480;
+	const int h = 272;
+	const int stride = 512;
+
+	const GPUgstate oldState = gstate;
+	const FormatBuffer oldFb = fb;
+	const int oldThreads = g_Config.iNumWorkerThreads;
+	Sampler::Init();
+	Rasterizer::Init();
+
+	struct Rect {
+		int x1, y1, x2, y2;
+	};
+	static const Rect rects[] = {
+		{ 0, 0, w - 1, h - 1 },
+		{ 10, 20, 100, 200 },
+		{ 11, 21, 100, 200 },
+		{ 33, 7, 34, 8 },
+		{ 50, 50, 50, 50 },
+	};
+	static const int offsets[] = { 2048 << 4, (2048 << 4) + 8, (2048 << 4) + 15, (2048 << 4) - 1 };
+
+	bool success = true;
+	std::vector<u32> pixels(stride * h);
+	for (int threads = 1; threads <= 2; ++threads) {
+		for (int offset : offsets) {
+			for (const Rect &r : rects) {
+				memset(&gstate, 0, sizeof(gstate));
+				gstate.framebufpixformat = GE_FORMAT_8888;
+				gstate.fbwidth = stride;
+				gstate.scissor1 = (r.y1 << 10) | r.x1;
+				gstate.scissor2 = (r.y2 << 10) | r.x2;
+				gstate.offsetx = offset;
+				gstate.offsety = offset;
+				gstate.vertType = GE_VTYPE_THROUGH;
+				gstate.shademodel = GE_SHADE_FLAT;
+				g_Config.iNumWorkerThreads = threads;
+				std::fill(pixels.begin(), pixels.end(), 0);
+				fb.data = (u8 *)&pixels[0];
+
+				// Two triangles well past the edges of the screen.
+				VertexData v[4];
+				const int corners[4][2] = { { -8, -8 }, { w + 8, -8 }, { -8, h + 8 }, { w + 8, h + 8 } };
+				for (int i = 0; i < 4; ++i) {
+					v[i].screenpos = ScreenCoords(offset + corners[i][0] * 16, offset + corners[i][1] * 16, 0);
+					v[i].color0 = Vec4<int>(255, 255, 255, 255);
+					v[i].color1 = Vec3<int>(0, 0, 0);
+					v[i].texturecoords = Vec2<float>(0.0f, 0.0f);
+					v[i].fogdepth = 1.0f;
+				}
+				Rasterizer::DrawTriangle(v[0], v[1], v[2]);
+				Rasterizer::DrawTriangle(v[1], v[3], v[2]);
+				Rasterizer::Flush();
+
+				for (int y = 0; y < h && success; ++y) {
+					for (int x = 0; x < w; ++x) {
+						bool inside = x >= r.x1 && x <= r.x2 && y >= r.y1 && y <= r.y2;
+						if ((pixels[y * stride + x] != 0) != inside) {
+							printf("Scissor %d,%d-%d,%d offset %04x: pixel %d,%d %s\n", r.x1, r.y1, r.x2, r.y2, offset, x, y, inside ? "not drawn" : "drawn");
+							success = false;
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	gstate = oldState;
+	fb = oldFb;
+	g_Config.iNumWorkerThreads = oldThreads;
+	Sampler::Shutdown();
+	Rasterizer::Shutdown();
+	return success;
+}
+
+bool TestSoftwarePixelJit() {
+	const int w = 16;
+	const int h = 16;
+	const int stride = 16;
+
+	u32 seed = 11;
+	auto rand = [&](int range) {
+		seed = seed * 1103515245 + 12345;
+		return (int)((seed >> 8) % range);
+	};
+
+	struct Pixel {
+		int x, y, z, fog;
+		Vec4<int> color;
+	};
+	std::vector<Pixel> pixels(256);
+	auto randomizePixels = [&](int numPixels) {
+		pixels.resize(numPixels);
+		for (Pixel &p : pixels) {
+			p.x = rand(w);
+			p.y = rand(h);
+			// Keep some z values near the depth range limits.
+			p.z = rand(4) == 0 ? 0xFFFF - rand(4) : rand(0x10000);
+			p.fog = rand(256);
+			p.color = Vec4<int>(rand(256), rand(256), rand(256), rand(256));
+		}
+	};
+
+	const GPUgstate oldState = gstate;
+	const FormatBuffer oldFb = fb;
+	const FormatBuffer oldDepth = depthbuf;
+	const bool oldJit = g_Config.bSoftwareRenderingJit;
+	Rasterizer::Init();
+
+	std::vector<u32> initialColor(stride * h), color[2];
+	std::vector<u16> initialDepth(stride * h), depth[2];
+	auto drawPixels = [&](int pass) {
+		color[pass] = initialColor;
+		depth[pass] = initialDepth;
+		fb.data = (u8 *)&color[pass][0];
+		depthbuf.data = (u8 *)&depth[pass][0];
+
+		g_Config.bSoftwareRenderingJit = pass == 1;
+		PixelFuncID id;
+		Rasterizer::ComputePixelFuncID(&id);
+		Rasterizer::SingleFunc func = Rasterizer::GetSingleFunc(id);
+		for (const Pixel &p : pixels) {
+			func(p.x, p.y, p.z, p.fog, p.color, id);
+		}
+		return func;
+	};
+
+	int compiled = 0;
+	const int numStates = 4000;
+	for (int i = 0; i < numStates; ++i) {
+		memset(&gstate, 0, sizeof(gstate));
+		gstate.framebufpixformat = rand(2) ? GE_FORMAT_8888 : GE_FORMAT_565;
+		gstate.fbwidth = stride;
+		gstate.zbwidth = stride;
+		gstate.vertType = rand(2) ? GE_VTYPE_THROUGH : 0;
+		gstate.clearmode = rand(8) == 0 ? 1 | (rand(8) << 8) : 0;
+		gstate.minz = rand(4) == 0 ? rand(0x10000) : 0;
+		gstate.maxz = rand(4) == 0 ? rand(0x10000) : 0xFFFF;
+		gstate.alphaTestEnable = rand(4) == 0;
+		gstate.alphatest = rand(8) | (rand(256) << 8) | ((rand(2) ? 0xFF : rand(256)) << 16);
+		gstate.zTestEnable = rand(2);
+		gstate.ztestfunc = rand(8);
+		gstate.zmsk = rand(2);
+		gstate.textureMapEnable = rand(2);
+		gstate.texfunc = rand(2) << 16;
+		gstate.fogEnable = rand(2);
+		gstate.fogcolor = rand(0x1000000);
+		gstate.alphaBlendEnable = rand(4) != 0;
+		// Includes the invalid equations and factors, which should match too.
+		gstate.blend = rand(16) | (rand(16) << 4) | (rand(8) << 8);
+		gstate.blendfixa = rand(0x1000000);
+		gstate.blendfixb = rand(0x1000000);
+		gstate.logicOpEnable = rand(4) == 0;
+		gstate.lop = rand(16);
+		gstate.pmskc = rand(4) == 0 ? rand(0x1000000) : 0;
+		gstate.pmska = rand(4) == 0 ? rand(256) : 0;
+		// These aren't compiled yet, but the fallback should still be used.
+		gstate.stencilTestEnable = rand(16) == 0;
+		gstate.colorTestEnable = rand(16) == 0;
+
+		for (size_t j = 0; j < initialColor.size(); ++j) {
+			initialColor[j] = rand(0x10000) | (rand(0x10000) << 16);
+			initialDepth[j] = rand(0x10000);
+		}
+		randomizePixels(256);
+
+		Rasterizer::SingleFunc funcs[2];
+		funcs[0] = drawPixels(0);
+		funcs[1] = drawPixels(1);
+		if (funcs[0] != funcs[1])
+			compiled++;
+
+		if (color[0] != color[1] || depth[0] != depth[1]) {
+			PixelFuncID id;
+			Rasterizer::ComputePixelFuncID(&id);
+			printf("Pixel JIT mismatch for state %d, id %016llx\n", i, (unsigned long long)id.fullKey);
+			EXPECT_TRUE(false);
+		}
+	}
+
+	// A common 3D state: depth tested, fogged, and alpha blended.
+	memset(&gstate, 0, sizeof(gstate));
+	gstate.framebufpixformat = GE_FORMAT_8888;
+	gstate.fbwidth = stride;
+	gstate.zbwidth = stride;
+	gstate.maxz = 0xFFFF;
+	gstate.zTestEnable = 1;
+	gstate.ztestfunc = GE_COMP_GEQUAL;
+	gstate.fogEnable = 1;
+	gstate.alphaBlendEnable = 1;
+	gstate.blend = GE_SRCBLEND_SRCALPHA | (GE_DSTBLEND_INVSRCALPHA << 4);
+	randomizePixels(1 << 20);
+
+	double elapsed[2];
+	for (int pass = 0; pass < 2; ++pass) {
+		double st = real_time_now();
+		drawPixels(pass);
+		elapsed[pass] = real_time_now() - st;
+	}
+
+	gstate = oldState;
+	fb = oldFb;
+	depthbuf = oldDepth;
+	g_Config.bSoftwareRenderingJit = oldJit;
+	Rasterizer::Shutdown();
+
+	printf("Software pixel funcs: %0.0f pixels/s interpreted, %0.0f pixels/s compiled (%d/%d states compiled)\n", pixels.size() / elapsed[0], pixels.size() / elapsed[1], compiled, numStates);
+	EXPECT_TRUE(color[0] == color[1] && depth[0] == depth[1]);
+#if PPSSPP_ARCH(AMD64)
+	EXPECT_TRUE(compiled > numStates / 2);
+#endif
+	return true;
+}
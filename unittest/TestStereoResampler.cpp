@@ -0,0 +1,134 @@
+// Copyright (c) 2017- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "base/timeutil.h"
+#include "Core/Config.h"
+#include "Core/HLE/__sceAudio.h"
+#include "Core/HW/StereoResampler.h"
+#include "unittest/TestStereoResampler.h"
+#include "unittest/UnitTest.h"
+
+// How far above everything else the strongest tone is, in dB.  Blackman-Harris window, plain DFT.
+static double MeasureSinad(const std::vector<s16> &frames, int count) {
+	std::vector<double> windowed(count);
+	for (int i = 0; i < count; ++i) {
+		double x = 2.0 * 3.14159265358979323846 * i / (count - 1);
+		double w = 0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2.0 * x) - 0.01168 * cos(3.0 * x);
+		windowed[i] = frames[i * 2] * w;
+	}
+
+	std::vector<double> power(count / 2);
+	for (int k = 0; k < count / 2; ++k) {
+		double step = -2.0 * 3.14159265358979323846 * k / count;
+		double re = 0.0, im = 0.0;
+		for (int i = 0; i < count; ++i) {
+			re += windowed[i] * cos(step * i);
+			im += windowed[i] * sin(step * i);
+		}
+		power[k] = re * re + im * im;
+	}
+
+	int peak = (int)(std::max_element(power.begin(), power.end()) - power.begin());
+	double signal = 0.0, noise = 0.0;
+	for (int k = 1; k < count / 2; ++k) {
+		if (abs(k - peak) <= 8)
+			signal += power[k];
+		else
+			noise += power[k];
+	}
+	return 10.0 * log10(signal / std::max(noise, 1e-9));
+}
+
+// Resamples a 44.1 kHz tone to 48 kHz, keeping the buffer fed like the audio thread would.
+static double ResampleTone(int type, double freq, double *framesPerSecond) {
+	g_Config.iAudioResamplerType = type;
+	StereoResampler *resampler = new StereoResampler();
+
+	const int pushSize = 256;
+	const int outputRate = 48000;
+	const int measureFrames = 4096;
+	std::vector<s32> input(pushSize * 2);
+	std::vector<s16> output;
+	s16 mixed[1024 * 2];
+	int inputPos = 0;
+	int64_t outputTotal = 0;
+	double mixTime = 0.0;
+
+	for (int block = 0; block < 2000; ++block) {
+		for (int i = 0; i < pushSize; ++i) {
+			double v = 16384.0 * sin(2.0 * 3.14159265358979323846 * freq * inputPos++ / 44100.0);
+			input[i * 2] = (s32)v;
+			input[i * 2 + 1] = (s32)-v;
+		}
+		resampler->PushSamples(&input[0], pushSize);
+		// Prime it to around the low watermark.
+		if (block < 6)
+			continue;
+
+		int frames = (int)((int64_t)(block - 5) * pushSize * outputRate / 44100 - outputTotal);
+		outputTotal += frames;
+		double st = real_time_now();
+		resampler->Mix(mixed, frames, false, outputRate);
+		mixTime += real_time_now() - st;
+		// Give the drift control time to settle before measuring.
+		if (block >= 1000 && (int)output.size() < measureFrames * 2)
+			output.insert(output.end(), mixed, mixed + frames * 2);
+	}
+
+	AudioDebugStats stats;
+	memset(&stats, 0, sizeof(stats));
+	resampler->GetAudioDebugStats(&stats);
+	delete resampler;
+
+	*framesPerSecond = outputTotal / mixTime;
+	if (stats.underrunCount != 0 || stats.overrunCount != 0) {
+		printf("Resampler ran out of samples: %d underruns, %d overruns\n", stats.underrunCount, stats.overrunCount);
+		return 0.0;
+	}
+	return MeasureSinad(output, measureFrames);
+}
+
+bool TestResampler() {
+	const int oldType = g_Config.iAudioResamplerType;
+	const bool oldResampler = g_Config.bAudioResampler;
+	const int oldVolume = g_Config.iGlobalVolume;
+	g_Config.bAudioResampler = true;
+	g_Config.iGlobalVolume = VOLUME_MAX;
+
+	bool success = true;
+	static const double freqs[] = { 1000.0, 15000.0 };
+	for (double freq : freqs) {
+		double linearSpeed, sincSpeed;
+		double linear = ResampleTone(AUDIO_RESAMPLER_LINEAR, freq, &linearSpeed);
+		double sinc = ResampleTone(AUDIO_RESAMPLER_SINC, freq, &sincSpeed);
+		printf("Resampling %0.0f Hz: linear %0.1f dB SINAD (%0.0f frames/s), sinc %0.1f dB SINAD (%0.0f frames/s)\n", freq, linear, linearSpeed, sinc, sincSpeed);
+		if (sinc < 60.0 || sinc < linear) {
+			printf("Sinc resampler quality too low\n");
+			success = false;
+		}
+	}
+
+	g_Config.iAudioResamplerType = oldType;
+	g_Config.bAudioResampler = oldResampler;
+	g_Config.iGlobalVolume = oldVolume;
+	return success;
+}
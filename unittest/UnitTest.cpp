@@ -25,14 +25,19 @@
 // Or just integrate with an existing testing framework.
 
 
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
 #include <string>
 #include <sstream>
+#include <thread>
+#include <vector>
+#include <snappy-c.h>
 
 #include "base/NativeApp.h"
 #include "base/logging.h"
+#include "base/timeutil.h"
 #include "input/input_state.h"
 #include "ext/disarm.h"
 #include "math/math_util.h"
@@ -40,11 +45,22 @@
 
 #include "Common/CPUDetect.h"
 #include "Common/ArmEmitter.h"
+#include "Common/ChunkFile.h"
+#include "Common/FileUtil.h"
+#include "Common/LockFreeQueue.h"
 #include "Core/Config.h"
+#include "Core/CoreTiming.h"
+#include "Core/MIPS/MIPS.h"
 #include "Core/MIPS/MIPSVFPUUtils.h"
 #include "Core/FileSystems/ISOFileSystem.h"
+#include "GPU/Common/TextureCacheCommon.h"
+#include "GPU/Common/TextureDecoder.h"
+#include "GPU/GPUState.h"
 
 #include "unittest/JitHarness.h"
+#include "unittest/TestSasAudio.h"
+#include "unittest/TestSoftwareGPU.h"
+#include "unittest/TestStereoResampler.h"
 #include "unittest/TestVertexJit.h"
 #include "unittest/UnitTest.h"
 
@@ -401,6 +417,466 @@ bool TestParseLBN() {
 	return true;
 }
 
+static std::vector<u64> firedEvents;
+static int timingBenchEvent;
+
+static void RecordEvent(u64 userdata, int cyclesLate) {
+	firedEvents.push_back(userdata);
+}
+
+static void RescheduleEvent(u64 userdata, int cyclesLate) {
+	// Spread the periods out so the queue order keeps changing.
+	CoreTiming::ScheduleEvent(1000 + (userdata * 7919) % 5000 - cyclesLate, timingBenchEvent, userdata);
+}
+
+static void RunCoreTimingEvents(int count) {
+	while (count-- > 0) {
+		CoreTiming::Idle();
+		CoreTiming::Advance();
+	}
+}
+
+bool TestCoreTiming() {
+	CoreTiming::Init();
+	int recordEvent = CoreTiming::RegisterEvent("Record", &RecordEvent);
+	timingBenchEvent = CoreTiming::RegisterEvent("Bench", &RescheduleEvent);
+
+	// Same-time events must fire in the order they were scheduled.
+	firedEvents.clear();
+	CoreTiming::ScheduleEvent(3000, recordEvent, 0);
+	CoreTiming::ScheduleEvent(1000, recordEvent, 1);
+	CoreTiming::ScheduleEvent(2000, recordEvent, 2);
+	CoreTiming::ScheduleEvent(1000, recordEvent, 3);
+	CoreTiming::ScheduleEvent(1000, recordEvent, 4);
+	CoreTiming::ScheduleEvent(2500, recordEvent, 2);
+	bool indexCorrect = CoreTiming::IsScheduled(recordEvent, 2);
+	// Removes both, and reports the later one.
+	s64 left = CoreTiming::UnscheduleEvent(recordEvent, 2);
+	indexCorrect = indexCorrect && !CoreTiming::IsScheduled(recordEvent, 2) && CoreTiming::IsScheduled(recordEvent, 3);
+	RunCoreTimingEvents(10);
+	std::vector<u64> expected = { 1, 3, 4, 0 };
+	bool orderCorrect = firedEvents == expected && left > 2000 && !CoreTiming::IsScheduled(recordEvent);
+
+	static const int pendingCounts[] = { 10, 100, 1000 };
+	for (int pending : pendingCounts) {
+		for (int i = 0; i < pending; ++i) {
+			CoreTiming::ScheduleEvent(1000 + i, timingBenchEvent, i);
+		}
+
+		const int advances = 200000;
+		double st = real_time_now();
+		RunCoreTimingEvents(advances);
+		double advanceTime = real_time_now() - st;
+
+		// Timers being reset, like VTimers and alarms do.
+		const int reschedules = 200000;
+		st = real_time_now();
+		for (int i = 0; i < reschedules; ++i) {
+			u64 userdata = (i * 31) % pending;
+			CoreTiming::UnscheduleEvent(timingBenchEvent, userdata);
+			CoreTiming::ScheduleEvent(1000 + i % 3000, timingBenchEvent, userdata);
+		}
+		double rescheduleTime = real_time_now() - st;
+
+		printf("CoreTiming with %d events: %0.0f advances/s, %0.0f reschedules/s\n", pending, advances / advanceTime, reschedules / rescheduleTime);
+		CoreTiming::RemoveEvent(timingBenchEvent);
+	}
+
+	CoreTiming::ClearPendingEvents();
+	CoreTiming::Shutdown();
+
+	EXPECT_TRUE(orderCorrect);
+	EXPECT_TRUE(indexCorrect);
+	return true;
+}
+
+static std::atomic<int> threadsafeEventsFired;
+
+static void CountThreadsafeEvent(u64 userdata, int cyclesLate) {
+	threadsafeEventsFired++;
+}
+
+bool TestLockFreeQueue() {
+	const int numProducers = 4;
+	const int perProducer = 250000;
+
+	// A small pool, so the heap fallback gets exercised too.
+	LockFreeMPSCQueue<u64, 64> *queue = new LockFreeMPSCQueue<u64, 64>();
+	std::vector<std::thread> producers;
+	double st = real_time_now();
+	for (int t = 0; t < numProducers; ++t) {
+		producers.push_back(std::thread([=] {
+			for (int i = 0; i < perProducer; ++i) {
+				queue->Push(((u64)t << 32) | i);
+			}
+		}));
+	}
+
+	// Each producer's items must come out in order, and all of them exactly once.
+	std::vector<int> nextSeq(numProducers);
+	bool inOrder = true;
+	int received = 0;
+	while (received < numProducers * perProducer) {
+		u64 item;
+		if (!queue->Pop(item)) {
+			std::this_thread::yield();
+			continue;
+		}
+		int t = (int)(item >> 32);
+		if (t >= numProducers || (int)(u32)item != nextSeq[t]) {
+			inOrder = false;
+			break;
+		}
+		nextSeq[t]++;
+		received++;
+	}
+	for (auto &th : producers) {
+		th.join();
+	}
+	double queueTime = real_time_now() - st;
+	u64 leftover;
+	bool empty = !queue->Pop(leftover);
+	printf("LockFreeMPSCQueue: %0.0f items/s with %d producers, %d pool overflows\n", received / queueTime, numProducers, queue->OverflowAllocations());
+	delete queue;
+
+	EXPECT_TRUE(inOrder);
+	EXPECT_TRUE(empty);
+
+	// Now through CoreTiming, while the "CPU thread" keeps advancing.
+	CoreTiming::Init();
+	int countEvent = CoreTiming::RegisterEvent("CountThreadsafe", &CountThreadsafeEvent);
+	threadsafeEventsFired = 0;
+	const int perEventProducer = 20000;
+	std::atomic<int> producersDone(0);
+	producers.clear();
+	for (int t = 0; t < numProducers; ++t) {
+		producers.push_back(std::thread([&] {
+			for (int i = 0; i < perEventProducer; ++i) {
+				CoreTiming::ScheduleEvent_Threadsafe(0, countEvent, i);
+			}
+			producersDone++;
+		}));
+	}
+	while (producersDone < numProducers || threadsafeEventsFired < numProducers * perEventProducer) {
+		CoreTiming::Idle();
+		CoreTiming::Advance();
+		if (producersDone == numProducers && threadsafeEventsFired < numProducers * perEventProducer && !CoreTiming::IsScheduled(countEvent)) {
+			// Let a half-finished push land.
+			std::this_thread::yield();
+		}
+	}
+	for (auto &th : producers) {
+		th.join();
+	}
+	int fired = threadsafeEventsFired;
+	CoreTiming::ClearPendingEvents();
+	CoreTiming::Shutdown();
+
+	EXPECT_EQ_INT(fired, numProducers * perEventProducer);
+	return true;
+}
+
+struct StreamTestState {
+	std::vector<u8> data;
+	std::string name;
+
+	void DoState(PointerWrap &p) {
+		auto s = p.Section("StreamTest", 1);
+		if (!s)
+			return;
+		p.Do(name);
+		p.Do(data);
+	}
+};
+
+bool TestChunkedSave() {
+	StreamTestState state;
+	state.name = "streaming";
+	state.data.resize(3 * 1024 * 1024 + 17);
+	for (size_t i = 0; i < state.data.size(); ++i) {
+		// Half compressible, half noise.
+		state.data[i] = (i & 0x1000) ? (u8)rand() : (u8)(i >> 8);
+	}
+
+	double st = real_time_now();
+	size_t sz = CChunkFileReader::MeasurePtr(state);
+	std::vector<u8> flat(sz);
+	EXPECT_TRUE(CChunkFileReader::SavePtr(&flat[0], state) == CChunkFileReader::ERROR_NONE);
+	double twoPassTime = real_time_now() - st;
+
+	// Use small blocks so there are plenty, and blocks end in the middle of writes.
+	st = real_time_now();
+	ChunkedSaveBuffer buffer(64 * 1024 + 3);
+	EXPECT_TRUE(CChunkFileReader::SaveStream(buffer, state) == CChunkFileReader::ERROR_NONE);
+	double streamTime = real_time_now() - st;
+	printf("ChunkedSave: %0.2f ms two pass (uncompressed), %0.2f ms streaming (compressed)\n", twoPassTime * 1000.0, streamTime * 1000.0);
+	EXPECT_EQ_INT((int)buffer.UncompressedSize(), (int)sz);
+
+	std::vector<u8> joined(sz);
+	size_t pos = 0;
+	for (size_t i = 0; i < buffer.NumBlocks(); ++i) {
+		size_t rawSize = buffer.BlockRawSize(i);
+		EXPECT_TRUE(pos + rawSize <= sz);
+		if (buffer.BlockCompressedSize(i) == rawSize) {
+			memcpy(&joined[pos], buffer.BlockData(i), rawSize);
+		} else {
+			size_t len = rawSize;
+			EXPECT_TRUE(snappy_uncompress((const char *)buffer.BlockData(i), buffer.BlockCompressedSize(i), (char *)&joined[pos], &len) == SNAPPY_OK);
+			EXPECT_EQ_INT((int)len, (int)rawSize);
+		}
+		pos += rawSize;
+	}
+	EXPECT_EQ_INT((int)pos, (int)sz);
+	EXPECT_TRUE(joined == flat);
+
+	// Single pass into memory, like rewind.  The second save reuses the buffer.
+	std::vector<u8> grown;
+	EXPECT_TRUE(CChunkFileReader::SaveVector(grown, state) == CChunkFileReader::ERROR_NONE);
+	st = real_time_now();
+	EXPECT_TRUE(CChunkFileReader::SaveVector(grown, state) == CChunkFileReader::ERROR_NONE);
+	double vectorTime = real_time_now() - st;
+	printf("ChunkedSave: %0.2f ms single pass into a reused buffer\n", vectorTime * 1000.0);
+	EXPECT_TRUE(grown == flat);
+	return true;
+}
+
+struct BulkTestState {
+	std::string name;
+	std::vector<u8> ram;
+	u32 tail = 0;
+
+	void DoState(PointerWrap &p) {
+		auto s = p.Section("BulkTest", 1);
+		if (!s)
+			return;
+		p.Do(name);
+		p.DoBulk(&ram[0], (u32)ram.size());
+		p.Do(tail);
+	}
+};
+
+static bool LoadBulkTestState(const std::string &filename, const BulkTestState &expected) {
+	BulkTestState loaded;
+	loaded.ram.resize(expected.ram.size());
+	std::string failureReason;
+	EXPECT_TRUE(CChunkFileReader::Load(filename, "unittest", loaded, &failureReason) == CChunkFileReader::ERROR_NONE);
+	EXPECT_TRUE(loaded.name == expected.name);
+	EXPECT_TRUE(loaded.ram == expected.ram);
+	EXPECT_EQ_INT((int)loaded.tail, (int)expected.tail);
+	return true;
+}
+
+bool TestChunkFileRevisions() {
+	BulkTestState state;
+	state.name = "revisions";
+	state.ram.resize(256 * 1024);
+	for (size_t i = 0; i < state.ram.size(); ++i) {
+		state.ram[i] = (i & 0x100) ? (u8)rand() : (u8)i;
+	}
+	state.tail = 0x1234567;
+
+	const std::string filename = File::GetExeDirectory() + "unittest_state.ppst";
+
+	// Revision 6 (and older) states have everything inline and uncompressed here.
+	size_t sz = CChunkFileReader::MeasurePtr(state);
+	std::vector<u8> flat(sz);
+	EXPECT_TRUE(CChunkFileReader::SavePtr(&flat[0], state) == CChunkFileReader::ERROR_NONE);
+	{
+		struct {
+			int Revision;
+			int Compress;
+			u32 ExpectedSize;
+			u32 UncompressedSize;
+			char GitVersion[32];
+		} header{ 6, 0, (u32)sz, (u32)sz, "unittest" };
+		char titleFixed[128]{ "inline" };
+
+		File::IOFile pFile(filename, "wb");
+		EXPECT_TRUE(pFile.WriteArray(&header, 1) && pFile.WriteArray(titleFixed, sizeof(titleFixed)) && pFile.WriteBytes(&flat[0], sz));
+	}
+	if (!LoadBulkTestState(filename, state)) {
+		File::Delete(filename);
+		return false;
+	}
+
+	// Current revision, with RAM in its own stream.
+	EXPECT_TRUE(CChunkFileReader::Save(filename, "bulk", "unittest", state) == CChunkFileReader::ERROR_NONE);
+	bool success = LoadBulkTestState(filename, state);
+	File::Delete(filename);
+	return success;
+}
+
+bool TestTexCache() {
+	TexCache cache;
+	std::map<u64, std::unique_ptr<TexCacheEntry>> reference;
+
+	// Roughly what a busy game keeps around: a few hundred textures, some with CLUT variants.
+	const int numTextures = 400;
+	std::vector<u64> keys;
+	for (int i = 0; i < numTextures; ++i) {
+		u32 addr = 0x04100000 + (i / 4) * 0x8000;
+		u32 cluthash = (i & 3) == 0 ? 0 : 0x9E3779B9 * i;
+		u64 key = TexCacheEntry::CacheKey(addr, GE_TFMT_CLUT8, 0x0808, cluthash);
+		TexCacheEntry *entry = new TexCacheEntry{};
+		entry->addr = addr;
+		entry->cluthash = cluthash;
+		cache.Set(key, entry);
+		reference[key].reset(new TexCacheEntry(*entry));
+		keys.push_back(key);
+	}
+	EXPECT_EQ_INT((int)cache.size(), numTextures);
+
+	// Replacing keeps the count, erasing removes it from both indexes.
+	cache.Set(keys[1], new TexCacheEntry(*reference[keys[1]]));
+	EXPECT_EQ_INT((int)cache.size(), numTextures);
+	cache.erase(cache.find(keys[2]));
+	EXPECT_TRUE(cache.Get(keys[2]) == nullptr);
+	EXPECT_TRUE(cache.find(keys[2]) == cache.end());
+	EXPECT_TRUE(cache.Get(keys[3]) != nullptr && cache.Get(keys[3])->cluthash == 0x9E3779B9 * 3);
+	cache.Set(keys[2], new TexCacheEntry(*reference[keys[2]]));
+
+	// Range queries by address still see the CLUT variants.
+	const u64 rangeStart = (u64)0x04100000 << 32;
+	int found = 0;
+	for (auto it = cache.lower_bound(rangeStart), end = cache.upper_bound(rangeStart + (1ULL << 32)); it != end; ++it) {
+		found++;
+	}
+	EXPECT_EQ_INT(found, 4);
+
+	// Binds have strong locality, a few textures (font, UI, terrain) dominate each frame.
+	std::vector<u64> binds;
+	u32 seed = 1;
+	for (int i = 0; i < 1000000; ++i) {
+		seed = seed * 1103515245 + 12345;
+		int which = (seed >> 16) % 100 < 80 ? (seed >> 8) % 24 : (seed >> 8) % numTextures;
+		binds.push_back(keys[which]);
+	}
+
+	double st = real_time_now();
+	uintptr_t sumMap = 0;
+	for (u64 key : binds) {
+		auto it = reference.find(key);
+		sumMap += it != reference.end() ? it->second->addr : 0;
+	}
+	double mapTime = real_time_now() - st;
+
+	st = real_time_now();
+	uintptr_t sumHash = 0;
+	for (u64 key : binds) {
+		TexCacheEntry *entry = cache.Get(key);
+		sumHash += entry ? entry->addr : 0;
+	}
+	double hashTime = real_time_now() - st;
+
+	printf("TexCache: %0.1f M binds/s with std::map, %0.1f M binds/s hashed\n", binds.size() / mapTime / 1000000.0, binds.size() / hashTime / 1000000.0);
+	EXPECT_TRUE(sumMap == sumHash);
+	return true;
+}
+
+// Runs fn enough times to get a stable number, returns MB/s of output.
+template <typename F>
+static double MeasureTextureDecoder(F fn, size_t bytesOut) {
+	int iterations = 0;
+	double st = real_time_now();
+	double elapsed;
+	do {
+		for (int i = 0; i < 16; ++i) {
+			fn();
+		}
+		iterations += 16;
+		elapsed = real_time_now() - st;
+	} while (elapsed < 0.1);
+	return (double)bytesOut * iterations / elapsed / (1024.0 * 1024.0);
+}
+
+bool TestTextureDecoders() {
+	const int pixels = 512 * 512;
+	std::vector<u8> indexed(pixels);
+	u32 seed = 1;
+	for (u8 &b : indexed) {
+		seed = seed * 1103515245 + 12345;
+		b = (u8)(seed >> 16);
+	}
+	// DeIndexTexture8To16 may read one entry past the end.
+	std::vector<u16> clut16(257);
+	std::vector<u32> clut32(256);
+	for (int i = 0; i < 256; ++i) {
+		clut16[i] = (u16)(i * 0x0101 ^ 0x5A5A);
+		clut32[i] = 0x01010101U * (u32)i ^ 0xA5C3E10F;
+	}
+
+	// DXT blocks are just random bits, that covers both color modes and all alpha modes.
+	const int blocks = pixels / 16;
+	std::vector<DXT5Block> dxt(blocks);
+	for (size_t i = 0; i < sizeof(DXT5Block) * blocks; ++i) {
+		seed = seed * 1103515245 + 12345;
+		((u8 *)&dxt[0])[i] = (u8)(seed >> 16);
+	}
+	const int texW = 512;
+
+	std::vector<u16> out16[2];
+	std::vector<u32> out32[2];
+	double speed[2][7]{};
+	static const char *names[7] = { "CLUT4 to 16", "CLUT4 to 32", "CLUT8 to 16", "CLUT8 to 32", "DXT1", "DXT3", "DXT5" };
+
+	// Plain indexing, no shift, mask, or offset.
+	const u32 oldClutFormat = gstate.clutformat;
+	gstate.clutformat = 0xC500FF00;
+
+	const bool hadSSSE3 = cpu_info.bSSSE3;
+	const bool hadAVX2 = cpu_info.bAVX2;
+	const bool hadNEON = cpu_info.bNEON;
+	for (int pass = 0; pass < 2; ++pass) {
+		// First pass is the plain C reference.
+		cpu_info.bSSSE3 = pass == 0 ? false : hadSSSE3;
+		cpu_info.bAVX2 = pass == 0 ? false : hadAVX2;
+		cpu_info.bNEON = pass == 0 ? false : hadNEON;
+		SetupTextureDecoder();
+
+		std::vector<u16> &o16 = out16[pass];
+		std::vector<u32> &o32 = out32[pass];
+		o16.assign(pixels * 2, 0);
+		o32.assign(pixels * 5, 0);
+		u16 *d16 = &o16[0];
+		u32 *d32 = &o32[0];
+
+		speed[pass][0] = MeasureTextureDecoder([&] { DeIndexTexture4(d16, &indexed[0], pixels, &clut16[0]); }, pixels * 2);
+		speed[pass][1] = MeasureTextureDecoder([&] { DeIndexTexture4(d32, &indexed[0], pixels, &clut32[0]); }, pixels * 4);
+		speed[pass][2] = MeasureTextureDecoder([&] { DeIndexTexture(d16 + pixels, &indexed[0], pixels, &clut16[0]); }, pixels * 2);
+		speed[pass][3] = MeasureTextureDecoder([&] { DeIndexTexture(d32 + pixels, &indexed[0], pixels, &clut32[0]); }, pixels * 4);
+
+		const DXT1Block *dxt1 = (const DXT1Block *)&dxt[0];
+		const DXT3Block *dxt3 = (const DXT3Block *)&dxt[0];
+		u32 *dxtOut[3] = { d32 + pixels * 2, d32 + pixels * 3, d32 + pixels * 4 };
+		auto decodeDXT = [&](int type) {
+			for (int b = 0; b < blocks; ++b) {
+				u32 *dst = dxtOut[type] + (b / (texW / 4)) * 4 * texW + (b % (texW / 4)) * 4;
+				if (type == 0)
+					DecodeDXT1Block(dst, &dxt1[b], texW, 4, false);
+				else if (type == 1)
+					DecodeDXT3Block(dst, &dxt3[b], texW, 4);
+				else
+					DecodeDXT5Block(dst, &dxt[b], texW, 4);
+			}
+		};
+		speed[pass][4] = MeasureTextureDecoder([&] { decodeDXT(0); }, pixels * 4);
+		speed[pass][5] = MeasureTextureDecoder([&] { decodeDXT(1); }, pixels * 4);
+		speed[pass][6] = MeasureTextureDecoder([&] { decodeDXT(2); }, pixels * 4);
+	}
+	cpu_info.bSSSE3 = hadSSSE3;
+	cpu_info.bAVX2 = hadAVX2;
+	cpu_info.bNEON = hadNEON;
+	SetupTextureDecoder();
+	gstate.clutformat = oldClutFormat;
+
+	for (int i = 0; i < 7; ++i) {
+		printf("%s: %0.0f MB/s plain, %0.0f MB/s SIMD\n", names[i], speed[0][i], speed[1][i]);
+	}
+	EXPECT_TRUE(out16[0] == out16[1]);
+	EXPECT_TRUE(out32[0] == out32[1]);
+	return true;
+}
+
 typedef bool (*TestFunc)();
 struct TestItem {
 	const char *name;
@@ -430,6 +906,23 @@ TestItem availableTests[] = {
 	TEST_ITEM(MathUtil),
 	TEST_ITEM(Parsers),
 	TEST_ITEM(Jit),
+	TEST_ITEM(IRDispatch),
+	TEST_ITEM(IRNative),
+	TEST_ITEM(IRTrace),
+	TEST_ITEM(IRChaining),
+	TEST_ITEM(JitInvalidate),
+	TEST_ITEM(JitFastmem),
+	TEST_ITEM(CoreTiming),
+	TEST_ITEM(LockFreeQueue),
+	TEST_ITEM(ChunkedSave),
+	TEST_ITEM(ChunkFileRevisions),
+	TEST_ITEM(TexCache),
+	TEST_ITEM(TextureDecoders),
+	TEST_ITEM(SoftwareBinning),
+	TEST_ITEM(SoftwareScissor),
+	TEST_ITEM(SoftwarePixelJit),
+	TEST_ITEM(SasMixer),
+	TEST_ITEM(Resampler),
 	TEST_ITEM(MatrixTranspose),
 	TEST_ITEM(ParseLBN),
 };